@@ -0,0 +1,394 @@
+export module bench.Corpus;
+
+import std.core;
+import BasicTypes;
+
+using std::u32string;
+
+export enum class CorpusKind {
+  minified,
+  commented,
+  strings,
+  unicode,
+  templates,
+};
+
+export const char* corpus_name(CorpusKind kind) {
+  switch (kind) {
+    case CorpusKind::minified: return "minified";
+    case CorpusKind::commented: return "commented";
+    case CorpusKind::strings: return "strings";
+    case CorpusKind::unicode: return "unicode";
+    case CorpusKind::templates: return "templates";
+  }
+  return "";
+}
+
+export constexpr CorpusKind corpus_kinds[] = {
+  CorpusKind::minified,
+  CorpusKind::commented,
+  CorpusKind::strings,
+  CorpusKind::unicode,
+  CorpusKind::templates,
+};
+
+// A small fixed-algorithm generator, so that every platform and standard
+// library produces the same corpus
+struct Random {
+  uint64 state;
+
+  uint32 next() {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return uint32(state >> 32);
+  }
+
+  uint32 below(uint32 n) {
+    return next() % n;
+  }
+
+  bool chance(uint32 percent) {
+    return below(100) < percent;
+  }
+
+  template<typename T, size_t N>
+  const T& pick(const T (&items)[N]) {
+    return items[below(N)];
+  }
+};
+
+// Generates JavaScript source text which resembles real-world code of a given
+// kind. The output depends only on the kind, the size and the seed.
+export struct CorpusGenerator {
+
+  CorpusGenerator(uint64 seed = 0x9e3779b97f4a7c15) : _random {seed} {}
+
+  u32string generate(CorpusKind kind, size_t size) {
+    _out.clear();
+    for (size_t bytes = 0; bytes < size;) {
+      size_t begin = _out.size();
+      switch (kind) {
+        case CorpusKind::minified: minified_module(); break;
+        case CorpusKind::commented: commented_function(); break;
+        case CorpusKind::strings: string_table(); break;
+        case CorpusKind::unicode: unicode_function(); break;
+        case CorpusKind::templates: template_function(); break;
+      }
+      bytes += utf8_size(_out, begin);
+    }
+    return std::move(_out);
+  }
+
+  // The number of bytes needed to encode the text as UTF-8
+  static size_t utf8_size(const u32string& text, size_t begin = 0) {
+    size_t size = 0;
+    for (size_t i = begin; i < text.size(); ++i) {
+      char32_t cp = text[i];
+      size += cp < 0x80 ? 1 : cp < 0x800 ? 2 : cp < 0x10000 ? 3 : 4;
+    }
+    return size;
+  }
+
+  void emit(const char* text) {
+    while (*text) {
+      _out.push_back(char32_t(uint8(*text++)));
+    }
+  }
+
+  void emit(const char32_t* text) {
+    _out.append(text);
+  }
+
+  void emit_number() {
+    switch (_random.below(4)) {
+      case 0: emit(std::to_string(_random.below(10)).c_str()); break;
+      case 1: emit(std::to_string(_random.below(100000)).c_str()); break;
+      case 2: emit("0x"); emit(hex(_random.next()).c_str()); break;
+      case 3: emit(std::to_string(_random.below(1000)).c_str()); emit(".5e-3"); break;
+    }
+  }
+
+  static std::string hex(uint32 value) {
+    static const char digits[] = "0123456789abcdef";
+    std::string out;
+    do {
+      out.push_back(digits[value & 15]);
+      value >>= 4;
+    } while (value);
+    return out;
+  }
+
+  void newline(int indent) {
+    _out.push_back('\n');
+    for (int i = 0; i < indent; ++i) {
+      emit("  ");
+    }
+  }
+
+  // Minified bundles: short names, no whitespace and long lines
+
+  void minified_module() {
+    emit("!function(e,t){\"use strict\";");
+    int statements = 20 + _random.below(20);
+    for (int i = 0; i < statements; ++i) {
+      minified_statement(0);
+    }
+    emit("}(this,function(){return this}());");
+    if (_random.chance(10)) {
+      _out.push_back('\n');
+    }
+  }
+
+  void short_name() {
+    static const char* names[] = {
+      "e", "t", "n", "r", "o", "i", "a", "s", "u", "c", "l", "f", "d", "p", "h",
+      "$", "_", "Oe", "xt", "Fn", "jQ", "nt", "ie",
+    };
+    emit(_random.pick(names));
+  }
+
+  void minified_expression(int depth) {
+    switch (depth > 3 ? _random.below(3) : _random.below(9)) {
+      case 0: short_name(); break;
+      case 1: emit_number(); break;
+      case 2: short_name(); emit("."); short_name(); break;
+      case 3:
+        minified_expression(depth + 1);
+        emit(_random.pick({"+", "-", "*", "/", "%", "&&", "||", "===", "!==", "<", ">>>", "|", "&"}));
+        minified_expression(depth + 1);
+        break;
+      case 4:
+        short_name(); emit("("); minified_expression(depth + 1);
+        emit(","); minified_expression(depth + 1); emit(")");
+        break;
+      case 5:
+        emit("("); minified_expression(depth + 1); emit("?");
+        minified_expression(depth + 1); emit(":"); minified_expression(depth + 1); emit(")");
+        break;
+      case 6:
+        // A regexp after a division would start a comment
+        if (_out.back() == '/') {
+          emit(" ");
+        }
+        emit("/[a-z_$][\\w$]*/gi.test("); short_name(); emit(")");
+        break;
+      case 7:
+        emit("(function("); short_name(); emit("){return ");
+        minified_expression(depth + 1); emit("})");
+        break;
+      case 8:
+        emit("{"); short_name(); emit(":"); minified_expression(depth + 1);
+        emit(",\""); short_name(); emit("\":"); minified_expression(depth + 1); emit("}");
+        break;
+    }
+  }
+
+  void minified_statement(int depth) {
+    switch (depth > 2 ? 0 : _random.below(5)) {
+      case 0:
+        emit("var "); short_name(); emit("="); minified_expression(0); emit(";");
+        break;
+      case 1:
+        emit("if("); minified_expression(0); emit(")"); minified_statement(depth + 1);
+        emit("else "); minified_statement(depth + 1);
+        break;
+      case 2:
+        emit("for(var "); short_name(); emit("=0;"); short_name(); emit("<");
+        short_name(); emit(".length;++"); short_name(); emit("){");
+        minified_statement(depth + 1); minified_statement(depth + 1); emit("}");
+        break;
+      case 3:
+        // Declared only where it cannot clash with a "var" of a block, and
+        // with distinct parameters, so that the corpus parses in strict mode
+        if (depth > 0) {
+          emit("var "); short_name(); emit("="); minified_expression(0); emit(";");
+          break;
+        }
+        emit("function "); short_name(); emit("(e,t){");
+        minified_statement(depth + 1); emit("return "); minified_expression(0); emit("}");
+        break;
+      case 4:
+        short_name(); emit("="); minified_expression(0); emit(";");
+        break;
+    }
+  }
+
+  // Library code with documentation comments and generous whitespace
+
+  void word() {
+    static const char* words[] = {
+      "the", "value", "of", "returns", "a", "new", "object", "which", "is", "used",
+      "when", "parsing", "input", "options", "callback", "default", "string",
+      "for", "each", "element", "in", "array", "if", "not", "provided",
+    };
+    emit(_random.pick(words));
+  }
+
+  void sentence() {
+    int count = 4 + _random.below(10);
+    for (int i = 0; i < count; ++i) {
+      if (i > 0) {
+        emit(" ");
+      }
+      word();
+    }
+    emit(".");
+  }
+
+  void long_name() {
+    static const char* names[] = {
+      "options", "callback", "result", "element", "index", "context", "buffer",
+      "parseValue", "normalizeOptions", "defaultHandler", "isArray", "hasOwn",
+    };
+    emit(_random.pick(names));
+  }
+
+  void commented_function() {
+    emit("/**");
+    int lines = 2 + _random.below(5);
+    for (int i = 0; i < lines; ++i) {
+      newline(0);
+      emit(" * ");
+      sentence();
+    }
+    newline(0);
+    emit(" * @param {Object} options");
+    newline(0);
+    emit(" * @returns {Array}");
+    newline(0);
+    emit(" */");
+    newline(0);
+    emit("function ");
+    long_name();
+    emit("(options, callback) {");
+    int statements = 3 + _random.below(6);
+    for (int i = 0; i < statements; ++i) {
+      newline(1);
+      if (_random.chance(40)) {
+        emit("// ");
+        sentence();
+        newline(1);
+      }
+      switch (_random.below(3)) {
+        case 0:
+          emit("var "); long_name(); emit(" = "); long_name(); emit("("); long_name(); emit(", ");
+          emit_number(); emit(");");
+          break;
+        case 1:
+          emit("if ("); long_name(); emit(" === null) {"); newline(2);
+          emit("return callback(new Error('"); sentence(); emit("'));"); newline(1); emit("}");
+          break;
+        case 2:
+          emit("/* "); sentence(); emit(" */"); newline(1);
+          long_name(); emit("."); long_name(); emit(" = "); long_name(); emit(" / 2;");
+          break;
+      }
+    }
+    newline(1);
+    emit("return result;");
+    newline(0);
+    emit("}");
+    newline(0);
+    newline(0);
+  }
+
+  // Localization tables: object literals of escaped and non-ASCII strings
+
+  void string_table() {
+    static const char32_t* phrases[] = {
+      U"Save changes?", U"Änderungen speichern?", U"Enregistrer les modifications ?",
+      U"変更を保存しますか?",
+      U"Сохранить?",
+      U"Line one\\nLine two", U"Tab\\tseparated\\tvalues", U"Quote \\\"here\\\"",
+      U"Escaped \\u00e9 and \\x41", U"¡Hola, señor!",
+    };
+    emit("export default {");
+    int entries = 20 + _random.below(20);
+    for (int i = 0; i < entries; ++i) {
+      newline(1);
+      emit("\"msg_");
+      emit(std::to_string(_random.below(100000)).c_str());
+      emit("\": ");
+      bool single = _random.chance(30);
+      emit(single ? "'" : "\"");
+      emit(_random.pick(phrases));
+      emit(single ? "'" : "\"");
+      emit(",");
+    }
+    newline(0);
+    emit("};");
+    newline(0);
+  }
+
+  // Code with identifiers outside of ASCII
+
+  void unicode_name() {
+    static const char32_t* names[] = {
+      U"größe", U"π", U"λάθος", U"変数",
+      U"значение", U"café", U"år", U"Ω",
+    };
+    emit(_random.pick(names));
+  }
+
+  void unicode_function() {
+    emit("function ");
+    unicode_name();
+    emit("(");
+    unicode_name();
+    emit(") {");
+    int statements = 3 + _random.below(5);
+    for (int i = 0; i < statements; ++i) {
+      newline(1);
+      emit("const ");
+      unicode_name();
+      emit(std::to_string(i).c_str());
+      emit(" = ");
+      unicode_name();
+      emit(_random.pick({" * ", " + ", " - "}));
+      emit_number();
+      emit(";");
+    }
+    newline(1);
+    emit("return ");
+    unicode_name();
+    emit(";");
+    newline(0);
+    emit("}");
+    newline(0);
+  }
+
+  // Template literals nested within substitutions
+
+  void nested_template(int depth) {
+    emit("`");
+    word();
+    int parts = 1 + _random.below(3);
+    for (int i = 0; i < parts; ++i) {
+      emit("${ ");
+      if (depth < 4 && _random.chance(60)) {
+        nested_template(depth + 1);
+      } else if (_random.chance(50)) {
+        emit("{ a: "); long_name(); emit(" }.a");
+      } else {
+        long_name(); emit(" / 2");
+      }
+      emit(" }");
+      word();
+    }
+    emit("`");
+  }
+
+  void template_function() {
+    emit("var render = (");
+    long_name();
+    emit(") => ");
+    nested_template(0);
+    emit(";");
+    newline(0);
+  }
+
+  Random _random;
+  u32string _out;
+
+};
@@ -0,0 +1,133 @@
+module;
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+export module bench.PerfCounters;
+
+import std.core;
+import BasicTypes;
+
+export enum class Counter {
+  cycles,
+  instructions,
+  branch_misses,
+  l1d_read_misses,
+};
+
+export constexpr int counter_count = 4;
+
+export const char* counter_name(Counter counter) {
+  switch (counter) {
+    case Counter::cycles: return "cycles";
+    case Counter::instructions: return "instructions";
+    case Counter::branch_misses: return "branch_misses";
+    case Counter::l1d_read_misses: return "l1d_read_misses";
+  }
+  return "";
+}
+
+export struct CounterValues {
+  std::optional<uint64> values[counter_count];
+
+  const std::optional<uint64>& operator[](Counter counter) const {
+    return values[int(counter)];
+  }
+};
+
+// Hardware counters for the calling thread, read as a single group with
+// perf_event_open. Counters which the kernel or the hardware does not provide
+// are reported as missing; on other platforms every counter is missing.
+export struct PerfCounters {
+
+  PerfCounters() {
+#if defined(__linux__)
+    open(Counter::cycles, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    open(Counter::instructions, PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    open(Counter::branch_misses, PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+    open(
+      Counter::l1d_read_misses,
+      PERF_TYPE_HW_CACHE,
+      PERF_COUNT_HW_CACHE_L1D |
+        (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+        (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+#endif
+  }
+
+  PerfCounters(const PerfCounters&) = delete;
+  PerfCounters& operator=(const PerfCounters&) = delete;
+
+  ~PerfCounters() {
+#if defined(__linux__)
+    for (int fd : _fds) {
+      if (fd >= 0) {
+        close(fd);
+      }
+    }
+#endif
+  }
+
+  bool available() const {
+    return _leader >= 0;
+  }
+
+  void start() {
+#if defined(__linux__)
+    if (available()) {
+      ioctl(_leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+      ioctl(_leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+#endif
+  }
+
+  CounterValues stop() {
+    CounterValues result;
+#if defined(__linux__)
+    if (!available()) {
+      return result;
+    }
+    ioctl(_leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+    // The group is read as a count followed by one value per member, in the
+    // order the members were opened
+    uint64 buffer[1 + counter_count] {};
+    if (read(_leader, buffer, sizeof(buffer)) < ssize_t(sizeof(uint64))) {
+      return result;
+    }
+    int member = 0;
+    for (int i = 0; i < counter_count; ++i) {
+      if (_fds[i] >= 0 && member < int(buffer[0])) {
+        result.values[i] = buffer[1 + member++];
+      }
+    }
+#endif
+    return result;
+  }
+
+#if defined(__linux__)
+  void open(Counter counter, uint32 type, uint64 config) {
+    perf_event_attr attr {};
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = _leader < 0 ? 1 : 0;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP;
+
+    int fd = int(syscall(SYS_perf_event_open, &attr, 0, -1, _leader, 0));
+    _fds[int(counter)] = fd;
+    if (fd >= 0 && _leader < 0) {
+      _leader = fd;
+    }
+  }
+#endif
+
+  int _fds[counter_count] {-1, -1, -1, -1};
+  int _leader {-1};
+
+};
@@ -0,0 +1,300 @@
+import std.core;
+import Scanner;
+import Tokenizer;
+import ScanKernels;
+import SegmentedText;
+import ModuleLexer;
+import Ast;
+import Parser;
+import bench.Corpus;
+
+using std::string;
+using std::u32string;
+using std::vector;
+
+using Iterator = u32string::const_iterator;
+using Context = Scanner<Iterator>::Context;
+using Diagnostic = Scanner<Iterator>::Diagnostic;
+
+enum class Configuration {
+  scanner,
+  tokenizer,
+  strict,
+  recovery,
+  lean,
+  bytes,
+  pieces,
+  modules,
+  parser,
+};
+
+const char* configuration_name(Configuration configuration) {
+  switch (configuration) {
+    case Configuration::scanner: return "scanner";
+    case Configuration::tokenizer: return "tokenizer";
+    case Configuration::strict: return "strict";
+    case Configuration::recovery: return "recovery";
+    case Configuration::lean: return "lean";
+    case Configuration::bytes: return "bytes";
+    case Configuration::pieces: return "pieces";
+    case Configuration::modules: return "modules";
+    case Configuration::parser: return "parser";
+  }
+  return "";
+}
+
+constexpr Configuration configurations[] = {
+  Configuration::scanner,
+  Configuration::tokenizer,
+  Configuration::strict,
+  Configuration::recovery,
+  Configuration::lean,
+  Configuration::bytes,
+  Configuration::pieces,
+  Configuration::modules,
+  Configuration::parser,
+};
+
+// A tokenizer which skips comments and compiles out strict mode switching and
+// error recovery
+struct LeanPolicy : ScannerPolicy {
+  static constexpr StrictMode strict_mode = StrictMode::sloppy;
+  static constexpr bool emit_comments = false;
+  static constexpr bool recovery = false;
+};
+
+struct Options {
+  size_t size {4 << 20};
+  int warmup {2};
+  int repeat {10};
+};
+
+[[noreturn]] void fail(const string& message) {
+  std::cerr << "Error: " << message << "\n";
+  std::exit(1);
+}
+
+// The scanner context required by each token, found with a tokenizer pass so
+// that the plain scanner can be measured without the inference overhead
+vector<Context> scan_contexts(const u32string& input) {
+  Tokenizer tokenizer {input.cbegin(), input.cend()};
+  vector<Context> contexts;
+  while (true) {
+    Token t = tokenizer.next();
+    if (t == Token::error) {
+      fail("generated corpus contains an invalid token");
+    }
+    switch (t) {
+      case Token::regexp:
+        contexts.push_back(Context::expression);
+        break;
+      case Token::template_middle:
+      case Token::template_tail:
+        contexts.push_back(Context::template_string);
+        break;
+      default:
+        contexts.push_back(Context::div);
+        break;
+    }
+    if (t == Token::end) {
+      return contexts;
+    }
+  }
+}
+
+size_t scan(const u32string& input, const vector<Context>& contexts) {
+  Scanner<Iterator> scanner {input.cbegin(), input.cend()};
+  size_t count = 0;
+  while (scanner.next(contexts[count]) != Token::end) {
+    ++count;
+  }
+  return count;
+}
+
+template<typename I, typename Policy>
+size_t count_tokens(Tokenizer<I, Policy>& tokenizer) {
+  size_t count = 0;
+  while (true) {
+    Token t = tokenizer.next();
+    if (t == Token::end) {
+      return count;
+    }
+    if (t == Token::error) {
+      fail("generated corpus contains an invalid token");
+    }
+    ++count;
+  }
+}
+
+size_t tokenize(Configuration configuration, const u32string& input) {
+  if (configuration == Configuration::lean) {
+    Tokenizer<Iterator, LeanPolicy> tokenizer {input.cbegin(), input.cend(), true};
+    return count_tokens(tokenizer);
+  }
+  Tokenizer tokenizer {input.cbegin(), input.cend(), true};
+  vector<Diagnostic> diagnostics;
+  if (configuration == Configuration::strict) {
+    tokenizer.scanner().set_strict_mode(true);
+  } else if (configuration == Configuration::recovery) {
+    tokenizer.scanner().set_recovery(&diagnostics);
+  }
+  return count_tokens(tokenizer);
+}
+
+// Single byte sources are scanned with the vector kernels. Code points above
+// ASCII are replaced, since bytes are scanned as Latin-1 code units.
+string ascii_input(const u32string& input) {
+  string ascii;
+  ascii.reserve(input.size());
+  for (char32_t c : input) {
+    ascii.push_back(c < 128 ? char(c) : 'x');
+  }
+  return ascii;
+}
+
+size_t tokenize_bytes(const string& input) {
+  Tokenizer<string::const_iterator, LeanPolicy> tokenizer {input.cbegin(), input.cend(), true};
+  return count_tokens(tokenizer);
+}
+
+// The byte source held in pieces of 4 KB, as an editor's piece table would
+// hold it. The piece list is rebuilt on each run, as it would be after an
+// edit.
+size_t tokenize_pieces(const string& input) {
+  SegmentedText<char> text;
+  for (size_t i = 0; i < input.size(); i += 4096) {
+    text.append(input.data() + i, std::min<size_t>(4096, input.size() - i));
+  }
+  Tokenizer<SegmentIterator<char>, LeanPolicy> tokenizer {text.begin(), text.end(), true};
+  return count_tokens(tokenizer);
+}
+
+// The module lexer against a full parse of the same source, which it is
+// meant to replace when only the import and export sites are needed. Both
+// count the tokens of the source, as the other configurations do.
+size_t lex_modules(const u32string& input, size_t tokens) {
+  ModuleLexer lexer {input.cbegin(), input.cend()};
+  if (!lexer.lex()) {
+    fail("generated corpus contains an invalid token");
+  }
+  return tokens;
+}
+
+// The string tables are the only corpus with exports, and the only one
+// parsed as a module
+size_t parse(CorpusKind kind, const u32string& input, size_t tokens) {
+  Ast ast;
+  Parser parser {input.cbegin(), input.cend(), ast};
+  if (kind == CorpusKind::strings) {
+    parser.parse_module();
+  } else {
+    parser.parse_script();
+  }
+  if (parser.error() != decltype(parser)::Error::none) {
+    fail("generated corpus does not parse");
+  }
+  return tokens;
+}
+
+size_t run(
+  CorpusKind kind,
+  Configuration configuration,
+  const u32string& input,
+  const string& ascii,
+  const vector<Context>& contexts)
+{
+  switch (configuration) {
+    case Configuration::scanner:
+      return scan(input, contexts);
+    case Configuration::bytes:
+      return tokenize_bytes(ascii);
+    case Configuration::pieces:
+      return tokenize_pieces(ascii);
+    case Configuration::modules:
+      return lex_modules(input, contexts.size() - 1);
+    case Configuration::parser:
+      return parse(kind, input, contexts.size() - 1);
+    default:
+      return tokenize(configuration, input);
+  }
+}
+
+void measure(
+  CorpusKind kind,
+  Configuration configuration,
+  const u32string& input,
+  const string& ascii,
+  size_t bytes,
+  const vector<Context>& contexts,
+  const Options& options
+) {
+  using Clock = std::chrono::steady_clock;
+
+  size_t tokens = 0;
+  for (int i = 0; i < options.warmup; ++i) {
+    tokens = run(kind, configuration, input, ascii, contexts);
+  }
+
+  vector<double> seconds;
+  for (int i = 0; i < options.repeat; ++i) {
+    auto start = Clock::now();
+    tokens = run(kind, configuration, input, ascii, contexts);
+    seconds.push_back(std::chrono::duration<double>(Clock::now() - start).count());
+  }
+
+  std::sort(seconds.begin(), seconds.end());
+  double median = seconds[seconds.size() / 2];
+  double spread = (seconds.back() - seconds.front()) / median * 100;
+
+  std::printf(
+    "%-10s %-10s %9.1f %12.1f %10.2f %8.1f%%\n",
+    corpus_name(kind),
+    configuration_name(configuration),
+    bytes / median / 1e6,
+    tokens / median / 1e6,
+    median * 1e9 / tokens,
+    spread);
+}
+
+Options parse_options(int argc, char** argv) {
+  Options options;
+  for (int i = 1; i < argc; ++i) {
+    string arg = argv[i];
+    if (i + 1 >= argc) {
+      fail("missing value for " + arg);
+    }
+    int value = std::atoi(argv[++i]);
+    if (value <= 0) {
+      fail("invalid value for " + arg);
+    }
+    if (arg == "--size") {
+      options.size = size_t(value) << 20;
+    } else if (arg == "--warmup") {
+      options.warmup = value;
+    } else if (arg == "--repeat") {
+      options.repeat = value;
+    } else {
+      fail("unknown option " + arg);
+    }
+  }
+  return options;
+}
+
+int main(int argc, char** argv) {
+  Options options = parse_options(argc, argv);
+
+  std::printf("kernels: %s\n", kernel_level_name(scan_kernels().level));
+  std::printf(
+    "%-10s %-10s %9s %12s %10s %9s\n",
+    "corpus", "config", "MB/s", "Mtokens/s", "ns/token", "spread");
+
+  for (CorpusKind kind : corpus_kinds) {
+    u32string input = CorpusGenerator().generate(kind, options.size);
+    size_t bytes = CorpusGenerator::utf8_size(input);
+    string ascii = ascii_input(input);
+    vector<Context> contexts = scan_contexts(input);
+    for (Configuration configuration : configurations) {
+      measure(kind, configuration, input, ascii, bytes, contexts, options);
+    }
+  }
+}
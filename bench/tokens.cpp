@@ -0,0 +1,189 @@
+import std.core;
+import Scanner;
+import bench.PerfCounters;
+
+using std::string;
+using std::u32string;
+using std::vector;
+
+using Iterator = u32string::const_iterator;
+using Context = Scanner<Iterator>::Context;
+
+// Each benchmark scans a buffer made of a single kind of token, so that the
+// measurement isolates one path through Scanner::start
+struct TokenBenchmark {
+  const char* name;
+  Context context;
+  vector<const char*> samples;
+  const char* separator;
+};
+
+const TokenBenchmark benchmarks[] = {
+  {"identifier", Context::div, {
+    "a", "value", "_private", "$el", "camelCaseName", "snake_case_name", "x1", "HTMLElement",
+  }, " "},
+  {"number", Context::div, {
+    "0", "42", "3.14159", "1e10", "6.02e+23", ".5", "0xdeadbeef", "0b1010", "0o777",
+  }, " "},
+  {"string", Context::div, {
+    "'a'", "\"hello world\"", "'it\\'s'", "\"tab\\tnewline\\n\"", "'\\u00e9\\x41'",
+    "\"a somewhat longer string literal with ordinary text\"",
+  }, " "},
+  {"template_string", Context::div, {
+    "``", "`text`", "`a longer template literal without substitutions`", "`line\\nbreak`",
+  }, " "},
+  {"regexp", Context::expression, {
+    "/a/", "/ab+c/gi", "/[a-z_$][\\w$]*/", "/\\d{3}-\\d{4}/", "/[/\\]]+/u", "/^\\s*$/m",
+  }, " "},
+  {"line_comment", Context::div, {
+    "//", "// short", "// a longer line comment describing the code below",
+  }, "\n"},
+  {"block_comment", Context::div, {
+    "/**/", "/* short */", "/* a longer block comment\n * spanning\n * lines */",
+  }, " "},
+  {"punctuator", Context::div, {
+    "{", "}", "(", ")", "[", "]", ";", ",", "<", ">", "<=", ">=", "==", "!=", "===",
+    "!==", "+", "-", "*", "%", "++", "--", "<<", ">>", ">>>", "&", "|", "^", "!",
+    "~", "&&", "||", "?", ":", "=", "+=", "-=", "*=", "%=", "=>", "...", ".", "**",
+  }, " "},
+  {"whitespace", Context::div, {
+    ";",
+  }, "  \t  \n    \n\t\t  "},
+};
+
+struct Options {
+  size_t size {1 << 20};
+  int warmup {2};
+  int repeat {10};
+};
+
+[[noreturn]] void fail(const string& message) {
+  std::cerr << "Error: " << message << "\n";
+  std::exit(1);
+}
+
+u32string make_input(const TokenBenchmark& benchmark, size_t size) {
+  u32string input;
+  for (size_t i = 0; input.size() < size; ++i) {
+    const char* sample = benchmark.samples[i % benchmark.samples.size()];
+    for (const char* p = sample; *p; ++p) {
+      input.push_back(char32_t(*p));
+    }
+    for (const char* p = benchmark.separator; *p; ++p) {
+      input.push_back(char32_t(*p));
+    }
+  }
+  return input;
+}
+
+size_t scan(const u32string& input, Context context) {
+  Scanner<Iterator> scanner {input.cbegin(), input.cend()};
+  size_t count = 0;
+  while (true) {
+    Token t = scanner.next(context);
+    if (t == Token::end) {
+      return count;
+    }
+    if (t == Token::error) {
+      fail("benchmark input contains an invalid token");
+    }
+    ++count;
+  }
+}
+
+void print_json_counters(const CounterValues& counters, double tokens) {
+  bool first = true;
+  std::printf("{");
+  for (int i = 0; i < counter_count; ++i) {
+    std::printf("%s\"%s\": ", first ? "" : ", ", counter_name(Counter(i)));
+    if (auto& value = counters.values[i]) {
+      std::printf("%.3f", double(*value) / tokens);
+    } else {
+      std::printf("null");
+    }
+    first = false;
+  }
+  std::printf("}");
+}
+
+void measure(const TokenBenchmark& benchmark, const Options& options, PerfCounters& counters, bool last) {
+  using Clock = std::chrono::steady_clock;
+
+  u32string input = make_input(benchmark, options.size);
+  size_t tokens = 0;
+  for (int i = 0; i < options.warmup; ++i) {
+    tokens = scan(input, benchmark.context);
+  }
+
+  vector<double> seconds;
+  counters.start();
+  for (int i = 0; i < options.repeat; ++i) {
+    auto start = Clock::now();
+    scan(input, benchmark.context);
+    seconds.push_back(std::chrono::duration<double>(Clock::now() - start).count());
+  }
+  CounterValues values = counters.stop();
+
+  std::sort(seconds.begin(), seconds.end());
+  double median = seconds[seconds.size() / 2];
+  double total_tokens = double(tokens) * options.repeat;
+
+  std::printf(
+    "    {\"name\": \"%s\", \"bytes\": %zu, \"tokens\": %zu, "
+    "\"ns_per_token\": %.3f, \"ns_per_byte\": %.3f, \"per_token\": ",
+    benchmark.name,
+    input.size(),
+    tokens,
+    median * 1e9 / tokens,
+    median * 1e9 / input.size());
+  print_json_counters(values, total_tokens);
+  std::printf("}%s\n", last ? "" : ",");
+}
+
+Options parse_options(int argc, char** argv, vector<string>& filter) {
+  Options options;
+  for (int i = 1; i < argc; ++i) {
+    string arg = argv[i];
+    if (arg.rfind("--", 0) != 0) {
+      filter.push_back(arg);
+      continue;
+    }
+    if (i + 1 >= argc) {
+      fail("missing value for " + arg);
+    }
+    int value = std::atoi(argv[++i]);
+    if (value <= 0) {
+      fail("invalid value for " + arg);
+    }
+    if (arg == "--size") {
+      options.size = size_t(value) << 20;
+    } else if (arg == "--warmup") {
+      options.warmup = value;
+    } else if (arg == "--repeat") {
+      options.repeat = value;
+    } else {
+      fail("unknown option " + arg);
+    }
+  }
+  return options;
+}
+
+// Writes one JSON document to stdout. Benchmarks may be selected by name.
+int main(int argc, char** argv) {
+  vector<string> filter;
+  Options options = parse_options(argc, argv, filter);
+
+  vector<const TokenBenchmark*> selected;
+  for (const TokenBenchmark& benchmark : benchmarks) {
+    if (filter.empty() || std::find(filter.begin(), filter.end(), benchmark.name) != filter.end()) {
+      selected.push_back(&benchmark);
+    }
+  }
+
+  PerfCounters counters;
+  std::printf("{\n  \"counters\": %s,\n  \"benchmarks\": [\n", counters.available() ? "true" : "false");
+  for (size_t i = 0; i < selected.size(); ++i) {
+    measure(*selected[i], options, counters, i + 1 == selected.size());
+  }
+  std::printf("  ]\n}\n");
+}
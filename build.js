@@ -2,18 +2,19 @@ import * as Path from 'path';
 import { fileURLToPath } from 'url';
 import { spawnSync } from 'child_process';
 
-import { compile } from './tools/compiler/compile.js';
+import { compile, compileWithProfile, defaultCompiler } from './tools/compiler/compile.js';
 import { parseArgs } from './tools/parse-args.js';
 import { emptyDir } from './tools/empty-dir.js';
 
 const dirname = Path.dirname(fileURLToPath(import.meta.url));
 const sourceDirectory = Path.resolve(dirname, './src');
-const outputDirectory = Path.resolve(dirname, './build');
+const buildDirectory = Path.resolve(dirname, './build');
 
 async function resolveModule(name) {
   let dir = sourceDirectory;
-  // Modules starting with "test." are in the test dir
-  if (name.startsWith('test.')) {
+  // Modules starting with "test.", "bench." or "cli." are in the test, bench
+  // and cli dirs
+  if (name.startsWith('test.') || name.startsWith('bench.') || name.startsWith('cli.')) {
     dir = dirname;
   }
   return Path.resolve(dir, name.replace('.', '/') + '.cpp');
@@ -32,20 +33,48 @@ if (!main) {
   process.exit(1);
 }
 
+// Build modes: "debug", "release", "lto" and "pgo". Each mode other than
+// debug builds into its own subdirectory.
+let mode = args.named.get('--mode') || 'debug';
+let compiler = args.named.get('--compiler') || defaultCompiler();
+let outputDirectory = mode === 'debug'
+  ? buildDirectory
+  : Path.resolve(buildDirectory, mode);
+
 if (args.named.has('--clean')) {
   emptyDir(outputDirectory);
 }
 
-compile({
+let options = {
   main,
   outputDirectory,
   resolveModule,
   log(msg) { console.log(`=> ${ msg }`); },
-  compiler: 'msvs',
-}).then(filename => {
+  compiler,
+  mode,
+};
+
+// Arguments for the training run of PGO builds, by main module. Only modules
+// listed here can be built with PGO.
+const trainingArgs = {
+  'bench.throughput': ['--size', '1', '--warmup', '1', '--repeat', '1'],
+};
+
+let build;
+if (mode === 'pgo') {
+  if (!trainingArgs[main]) {
+    console.log(`No PGO training run for ${ main }`);
+    process.exit(1);
+  }
+  build = compileWithProfile({ ...options, trainingArgs: trainingArgs[main] });
+} else {
+  build = compile(options);
+}
+
+build.then(filename => {
   if (args.named.has('--run')) {
     console.log(`=> Running ${ filename }`);
-    let { status } = spawnSync(filename, [], {
+    let { status } = spawnSync(filename, args.slice(1), {
       stdio: 'inherit',
     });
     console.log(`=> Process exited with status: ${ status }`);
@@ -0,0 +1,378 @@
+module;
+
+#include <stdio.h>
+
+#if defined(__unix__)
+#include <dlfcn.h>
+#endif
+
+#if __has_include(<zlib.h>)
+#include <zlib.h>
+#define XX_HAS_ZLIB 1
+#endif
+
+export module cli.Compressed;
+
+import std.core;
+import BasicTypes;
+
+// Streaming decoders for gzip and zstd sources, for use with StreamSource.
+// The libraries are loaded when first used rather than linked, so neither is
+// a build dependency; where a library cannot be loaded its format is
+// reported as unavailable.
+
+export enum class Compression {
+  none,
+  gzip,
+  zstd,
+};
+
+export const char* compression_name(Compression compression) {
+  switch (compression) {
+    case Compression::none: return "none";
+    case Compression::gzip: return "gzip";
+    case Compression::zstd: return "zstd";
+  }
+  return "";
+}
+
+// Detects the format from the magic number at the start of the data
+export Compression detect_compression(const uint8* data, size_t size) {
+  if (size >= 2 && data[0] == 0x1f && data[1] == 0x8b) {
+    return Compression::gzip;
+  }
+  if (size >= 4 && data[0] == 0x28 && data[1] == 0xb5 && data[2] == 0x2f && data[3] == 0xfd) {
+    return Compression::zstd;
+  }
+  return Compression::none;
+}
+
+// Compressed input held in memory
+export struct MemoryInput {
+
+  MemoryInput(const uint8* data, size_t size) : _data {data}, _size {size} {}
+
+  size_t read(uint8* out, size_t size) {
+    size_t n = std::min(size, _size - _position);
+    std::memcpy(out, _data + _position, n);
+    _position += n;
+    return n;
+  }
+
+  const uint8* _data;
+  size_t _size;
+  size_t _position {0};
+
+};
+
+// Compressed input read from a file as it is decoded, so that memory use does
+// not depend on the size of the file
+export struct FileInput {
+
+  explicit FileInput(FILE* file) : _file {file} {}
+
+  size_t read(uint8* out, size_t size) {
+    return std::fread(out, 1, size, _file);
+  }
+
+  FILE* _file;
+
+};
+
+void* load_library(const char* name) {
+#if defined(__unix__)
+  return ::dlopen(name, RTLD_NOW | RTLD_LOCAL);
+#else
+  return nullptr;
+#endif
+}
+
+template<typename F>
+bool load_symbol(void* library, const char* name, F& function) {
+#if defined(__unix__)
+  function = reinterpret_cast<F>(::dlsym(library, name));
+#endif
+  return function != nullptr;
+}
+
+#if defined(XX_HAS_ZLIB)
+
+struct ZlibLibrary {
+  const char* (*version)();
+  int (*init)(z_stream*, int, const char*, int);
+  int (*inflate)(z_stream*, int);
+  int (*reset)(z_stream*);
+  int (*end)(z_stream*);
+};
+
+const ZlibLibrary* zlib_library() {
+  static const std::optional<ZlibLibrary> library = []() -> std::optional<ZlibLibrary> {
+    void* handle = load_library("libz.so.1");
+    ZlibLibrary zlib {};
+    if (!handle ||
+        !load_symbol(handle, "zlibVersion", zlib.version) ||
+        !load_symbol(handle, "inflateInit2_", zlib.init) ||
+        !load_symbol(handle, "inflate", zlib.inflate) ||
+        !load_symbol(handle, "inflateReset", zlib.reset) ||
+        !load_symbol(handle, "inflateEnd", zlib.end)) {
+      return {};
+    }
+    return zlib;
+  }();
+  return library ? &*library : nullptr;
+}
+
+#endif
+
+// The stable streaming interface of libzstd
+struct ZstdInBuffer {
+  const void* src;
+  size_t size;
+  size_t pos;
+};
+
+struct ZstdOutBuffer {
+  void* dst;
+  size_t size;
+  size_t pos;
+};
+
+struct ZstdLibrary {
+  void* (*create)();
+  size_t (*free)(void*);
+  size_t (*init)(void*);
+  size_t (*decompress)(void*, ZstdOutBuffer*, ZstdInBuffer*);
+  unsigned (*is_error)(size_t);
+};
+
+const ZstdLibrary* zstd_library() {
+  static const std::optional<ZstdLibrary> library = []() -> std::optional<ZstdLibrary> {
+    void* handle = load_library("libzstd.so.1");
+    ZstdLibrary zstd {};
+    if (!handle ||
+        !load_symbol(handle, "ZSTD_createDStream", zstd.create) ||
+        !load_symbol(handle, "ZSTD_freeDStream", zstd.free) ||
+        !load_symbol(handle, "ZSTD_initDStream", zstd.init) ||
+        !load_symbol(handle, "ZSTD_decompressStream", zstd.decompress) ||
+        !load_symbol(handle, "ZSTD_isError", zstd.is_error)) {
+      return {};
+    }
+    return zstd;
+  }();
+  return library ? &*library : nullptr;
+}
+
+export bool compression_available(Compression compression) {
+  switch (compression) {
+    case Compression::none:
+      return true;
+    case Compression::gzip:
+#if defined(XX_HAS_ZLIB)
+      return zlib_library() != nullptr;
+#else
+      return false;
+#endif
+    case Compression::zstd:
+      return zstd_library() != nullptr;
+  }
+  return false;
+}
+
+constexpr size_t compressed_buffer_size = 64 << 10;
+
+// Decodes gzip or zlib data, including concatenated gzip members. Any bytes
+// after a member which are not another member are ignored. Both
+// decoders provide read for StreamSource, and error, which is non-null once
+// the data has been found to be invalid or truncated.
+export template<typename Input>
+struct GzipDecoder {
+
+  explicit GzipDecoder(Input& input) : _input {input} {
+#if defined(XX_HAS_ZLIB)
+    _zlib = zlib_library();
+    if (!_zlib) {
+      _error = "gzip is not available";
+      return;
+    }
+    // A window of 15 bits, with the header format detected
+    if (_zlib->init(&_stream, 15 + 32, _zlib->version(), int(sizeof(z_stream))) != Z_OK) {
+      _zlib = nullptr;
+      _error = "cannot start gzip decoder";
+    }
+#else
+    _error = "gzip is not available";
+#endif
+  }
+
+  GzipDecoder(const GzipDecoder&) = delete;
+  GzipDecoder& operator=(const GzipDecoder&) = delete;
+
+  ~GzipDecoder() {
+#if defined(XX_HAS_ZLIB)
+    if (_zlib) {
+      _zlib->end(&_stream);
+    }
+#endif
+  }
+
+  size_t read(uint8* out, size_t size) {
+#if defined(XX_HAS_ZLIB)
+    if (_error || _done) {
+      return 0;
+    }
+    _stream.next_out = out;
+    _stream.avail_out = uInt(size);
+    while (_stream.avail_out > 0) {
+      if (_stream.avail_in == 0) {
+        size_t n = _input.read(_in, compressed_buffer_size);
+        if (n == 0) {
+          if (!_member_end) {
+            _error = "truncated gzip data";
+          }
+          _done = true;
+          break;
+        }
+        _stream.next_in = _in;
+        _stream.avail_in = uInt(n);
+      }
+      if (_member_end) {
+        // Bytes after a member which do not begin another, such as the zero
+        // padding of a tape archive, end the data as they do for gzip
+        if (!member_follows()) {
+          _done = true;
+          break;
+        }
+        _zlib->reset(&_stream);
+        _member_end = false;
+      }
+      int result = _zlib->inflate(&_stream, Z_NO_FLUSH);
+      if (result == Z_STREAM_END) {
+        _member_end = true;
+      } else if (result != Z_OK) {
+        _error = "invalid gzip data";
+        break;
+      }
+    }
+    size_t count = size - _stream.avail_out;
+    _output_size += count;
+    return count;
+#else
+    return 0;
+#endif
+  }
+
+  const char* error() const {
+    return _error;
+  }
+
+  // The number of bytes decoded so far
+  uint64 output_size() const {
+    return _output_size;
+  }
+
+#if defined(XX_HAS_ZLIB)
+  // True if the remaining input starts with the gzip magic number. A first
+  // byte which ends the buffer is moved to its start, and the rest refilled.
+  bool member_follows() {
+    if (_stream.avail_in == 1 && _stream.next_in[0] == 0x1f) {
+      _in[0] = 0x1f;
+      size_t n = _input.read(_in + 1, compressed_buffer_size - 1);
+      _stream.next_in = _in;
+      _stream.avail_in = uInt(n + 1);
+    }
+    return detect_compression(_stream.next_in, _stream.avail_in) == Compression::gzip;
+  }
+#endif
+
+  Input& _input;
+#if defined(XX_HAS_ZLIB)
+  const ZlibLibrary* _zlib {nullptr};
+  z_stream _stream {};
+#endif
+  uint8 _in[compressed_buffer_size];
+  const char* _error {nullptr};
+  uint64 _output_size {0};
+  bool _member_end {false};
+  bool _done {false};
+
+};
+
+// Decodes zstd data, including concatenated frames
+export template<typename Input>
+struct ZstdDecoder {
+
+  explicit ZstdDecoder(Input& input) : _input {input} {
+    _zstd = zstd_library();
+    _stream = _zstd ? _zstd->create() : nullptr;
+    if (!_stream || _zstd->is_error(_zstd->init(_stream))) {
+      _error = "zstd is not available";
+    }
+  }
+
+  ZstdDecoder(const ZstdDecoder&) = delete;
+  ZstdDecoder& operator=(const ZstdDecoder&) = delete;
+
+  ~ZstdDecoder() {
+    if (_stream) {
+      _zstd->free(_stream);
+    }
+  }
+
+  size_t read(uint8* out, size_t size) {
+    if (_error || _done) {
+      return 0;
+    }
+    ZstdOutBuffer output {out, size, 0};
+    while (output.pos < output.size) {
+      if (_buffer.pos == _buffer.size) {
+        size_t n = _input.read(_in, compressed_buffer_size);
+        if (n == 0) {
+          // Output can remain buffered in the decoder after the last input,
+          // and a frame which is still incomplete once it is flushed is
+          // truncated
+          size_t flushed = output.pos;
+          size_t result = _zstd->decompress(_stream, &output, &_buffer);
+          if (_zstd->is_error(result)) {
+            _error = "invalid zstd data";
+          } else if (output.pos == flushed) {
+            _done = true;
+            if (!_frame_end) {
+              _error = "truncated zstd data";
+            }
+          } else {
+            _frame_end = result == 0;
+          }
+          break;
+        }
+        _buffer = {_in, n, 0};
+      }
+      size_t result = _zstd->decompress(_stream, &output, &_buffer);
+      if (_zstd->is_error(result)) {
+        _error = "invalid zstd data";
+        break;
+      }
+      _frame_end = result == 0;
+    }
+    _output_size += output.pos;
+    return output.pos;
+  }
+
+  const char* error() const {
+    return _error;
+  }
+
+  uint64 output_size() const {
+    return _output_size;
+  }
+
+  Input& _input;
+  const ZstdLibrary* _zstd {nullptr};
+  void* _stream {nullptr};
+  ZstdInBuffer _buffer {nullptr, 0, 0};
+  uint8 _in[compressed_buffer_size];
+  const char* _error {nullptr};
+  uint64 _output_size {0};
+  bool _frame_end {false};    // True if the last output completed a frame
+  bool _done {false};
+
+};
@@ -0,0 +1,439 @@
+module;
+
+#if defined(__unix__)
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+export module cli.Daemon;
+
+import std.core;
+import BasicTypes;
+import cli.FileReader;
+import cli.Tokenize;
+
+using std::string;
+using std::vector;
+
+// A long-running tokenizer which serves batches from build tools over a Unix
+// domain socket, so that each batch avoids process startup and reuses warm
+// state: the worker threads and their buffers, the scan kernels selected at
+// startup, and a cache of results keyed by a hash of each file's path and
+// contents.
+//
+// Each message is a uint32 length in host byte order followed by a payload.
+// A request payload is a command line followed by one absolute path per line:
+//
+//   tokenize <output mode>\n<path>\n<path>\n...
+//   shutdown\n
+//
+// A response payload is a DaemonResponse (see encode_response). Requests are
+// served one at a time, and the files of each batch are spread over the pool.
+// A connection which does not send or receive for connection_timeout is
+// closed, so that a stalled client cannot hold up the others.
+
+// A 64-bit hash for cache keys. Not for untrusted input.
+export uint64 hash_bytes(const char* data, size_t size, uint64 seed = 0) {
+  constexpr uint64 k1 = 0x9e3779b97f4a7c15;
+  constexpr uint64 k2 = 0xff51afd7ed558ccd;
+  uint64 h = seed ^ (size * k1);
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    uint64 word;
+    std::memcpy(&word, data + i, 8);
+    h = std::rotl(h ^ word * k1, 31) * k2;
+  }
+  if (i < size) {
+    uint64 word = 0;
+    std::memcpy(&word, data + i, size - i);
+    h = std::rotl(h ^ word * k1, 31) * k2;
+  }
+  h ^= h >> 33;
+  h *= k2;
+  h ^= h >> 33;
+  return h;
+}
+
+// The output of previously tokenized files. When the entries exceed the
+// capacity the cache is emptied, which is enough for the repeated batches of
+// a build. Entries also hold the path and content size of their file, so
+// that a hash collision between different files is not taken as a hit.
+export struct ContentCache {
+
+  static constexpr size_t default_capacity = size_t(256) << 20;
+
+  struct Entry {
+    string path;
+    size_t content_size {0};
+    string out;
+    string errors;
+    Totals totals;
+  };
+
+  explicit ContentCache(size_t capacity = default_capacity) : _capacity {capacity} {}
+
+  bool find(
+    uint64 key,
+    const string& path,
+    size_t content_size,
+    string& out,
+    string& errors,
+    Totals& totals)
+  {
+    std::lock_guard lock {_mutex};
+    auto iter = _entries.find(key);
+    if (
+      iter == _entries.end() ||
+      iter->second.content_size != content_size ||
+      iter->second.path != path
+    ) {
+      return false;
+    }
+    out = iter->second.out;
+    errors = iter->second.errors;
+    totals = iter->second.totals;
+    return true;
+  }
+
+  // An entry with the same key is replaced
+  void insert(
+    uint64 key,
+    const string& path,
+    size_t content_size,
+    const string& out,
+    const string& errors,
+    const Totals& totals)
+  {
+    size_t size = path.size() + out.size() + errors.size() + sizeof(Entry);
+    std::lock_guard lock {_mutex};
+    if (auto iter = _entries.find(key); iter != _entries.end()) {
+      auto& entry = iter->second;
+      _size -= entry.path.size() + entry.out.size() + entry.errors.size() + sizeof(Entry);
+      _entries.erase(iter);
+    }
+    if (_size + size > _capacity) {
+      _entries.clear();
+      _size = 0;
+    }
+    _entries.try_emplace(key, Entry {path, content_size, out, errors, totals});
+    _size += size;
+  }
+
+  size_t size() const {
+    return _entries.size();
+  }
+
+  std::mutex _mutex;
+  std::unordered_map<uint64, Entry> _entries;
+  size_t _size {0};
+  size_t _capacity;
+
+};
+
+export struct DaemonResponse {
+  Totals totals;
+  uint64 peak_rss {0};      // Of the daemon process
+  string out;
+  string errors;
+};
+
+export string encode_request(OutputMode output, const vector<string>& files) {
+  string request = "tokenize ";
+  request += output_mode_name(output);
+  request += "\n";
+  for (auto& file : files) {
+    request += file;
+    request += "\n";
+  }
+  return request;
+}
+
+// The totals, the peak RSS, the output length, the output and the errors
+string encode_response(const DaemonResponse& response) {
+  string payload;
+  append_raw(payload, response.totals);
+  append_raw(payload, response.peak_rss);
+  append_raw(payload, uint64(response.out.size()));
+  payload += response.out;
+  payload += response.errors;
+  return payload;
+}
+
+export bool decode_response(const string& payload, DaemonResponse& response) {
+  size_t header = sizeof(Totals) + 2 * sizeof(uint64);
+  if (payload.size() < header) {
+    return false;
+  }
+  uint64 out_size;
+  const char* p = payload.data();
+  std::memcpy(&response.totals, p, sizeof(Totals));
+  std::memcpy(&response.peak_rss, p + sizeof(Totals), sizeof(uint64));
+  std::memcpy(&out_size, p + sizeof(Totals) + sizeof(uint64), sizeof(uint64));
+  if (out_size > payload.size() - header) {
+    return false;
+  }
+  response.out = payload.substr(header, out_size);
+  response.errors = payload.substr(header + out_size);
+  return true;
+}
+
+#if defined(__unix__)
+
+constexpr uint32 max_message_size = 1u << 30;
+constexpr timeval connection_timeout {10, 0};
+
+bool read_exactly(int fd, char* data, size_t size) {
+  while (size > 0) {
+    ssize_t n = ::read(fd, data, size);
+    if (n <= 0) {
+      if (n < 0 && errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    data += n;
+    size -= size_t(n);
+  }
+  return true;
+}
+
+bool write_exactly(int fd, const char* data, size_t size) {
+  while (size > 0) {
+    ssize_t n = ::send(fd, data, size, MSG_NOSIGNAL);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    data += n;
+    size -= size_t(n);
+  }
+  return true;
+}
+
+bool read_message(int fd, string& payload) {
+  uint32 size;
+  if (!read_exactly(fd, reinterpret_cast<char*>(&size), sizeof(size)) || size > max_message_size) {
+    return false;
+  }
+  payload.resize(size);
+  return read_exactly(fd, payload.data(), size);
+}
+
+bool write_message(int fd, const string& payload) {
+  if (payload.size() > max_message_size) {
+    return false;
+  }
+  uint32 size = uint32(payload.size());
+  return
+    write_exactly(fd, reinterpret_cast<const char*>(&size), sizeof(size)) &&
+    write_exactly(fd, payload.data(), payload.size());
+}
+
+bool socket_address(const string& path, sockaddr_un& address) {
+  address = {};
+  address.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(address.sun_path)) {
+    return false;
+  }
+  std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+  return true;
+}
+
+// True if a daemon accepts connections on the socket
+bool socket_in_use(const sockaddr_un& address) {
+  int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) {
+    return false;
+  }
+  bool connected = ::connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0;
+  ::close(fd);
+  return connected;
+}
+
+// Removes a socket left by a daemon which did not shut down. Returns false
+// if the path is taken by another file or by a running daemon.
+bool remove_stale_socket(const string& path, const sockaddr_un& address) {
+  struct stat info;
+  if (::lstat(path.c_str(), &info) != 0) {
+    return errno == ENOENT;
+  }
+  if (!S_ISSOCK(info.st_mode) || socket_in_use(address)) {
+    return false;
+  }
+  return ::unlink(path.c_str()) == 0;
+}
+
+#endif
+
+export struct Daemon {
+
+  explicit Daemon(uint32 jobs, size_t cache_capacity = ContentCache::default_capacity) :
+    _pool {jobs},
+    _cache {cache_capacity}
+  {}
+
+  // Returns the response payload for a request payload. Sets shutdown for a
+  // shutdown request.
+  string handle(const string& request, bool& shutdown) {
+    DaemonResponse response;
+    size_t line_end = std::min(request.find('\n'), request.size());
+    string command = request.substr(0, line_end);
+    shutdown = false;
+
+    std::optional<OutputMode> output;
+    if (command == "shutdown") {
+      shutdown = true;
+    } else if (command.starts_with("tokenize ")) {
+      output = parse_output_mode(command.substr(9));
+    }
+
+    if (output) {
+      vector<string> files;
+      for (size_t start = line_end + 1; start < request.size();) {
+        size_t end = request.find('\n', start);
+        end = end == string::npos ? request.size() : end;
+        if (end > start) {
+          files.push_back(request.substr(start, end - start));
+        }
+        start = end + 1;
+      }
+      tokenize(*output, files, response);
+    } else if (!shutdown) {
+      response.errors = "invalid request\n";
+    }
+
+    response.peak_rss = peak_rss();
+    return encode_response(response);
+  }
+
+  void tokenize(OutputMode output, const vector<string>& files, DaemonResponse& response) {
+    // Scanner stats are not cached, since they are totalled over the batch
+    bool cache = output != OutputMode::stats;
+    uint64 seed = uint64(output);
+
+    auto process = [&](const string& path, Workspace& workspace, string& out, string& errors) {
+      Totals totals;
+      uint64 key = 0;
+      if (cache) {
+        key = hash_bytes(path.data(), path.size(), seed);
+        key = hash_bytes(workspace.contents.data(), workspace.contents.size(), key);
+        if (_cache.find(key, path, workspace.contents.size(), out, errors, totals)) {
+          totals.cached = 1;
+          totals.scan_seconds = 0;
+          return totals;
+        }
+      }
+      totals = tokenize_contents(path, output, workspace, out, errors);
+      if (cache) {
+        _cache.insert(key, path, workspace.contents.size(), out, errors, totals);
+      }
+      return totals;
+    };
+
+    auto sink = [&](const string& out, const string& errors) {
+      response.out += out;
+      response.errors += errors;
+    };
+
+    BatchResult result = run_batch(_pool, files, ReadBackend::automatic, process, sink);
+    response.totals = result.totals;
+    if (output == OutputMode::stats) {
+      response.out += result.stats.to_json();
+      response.out += "\n";
+    }
+  }
+
+  // Serves requests until a shutdown request. Returns false with a message if
+  // the socket cannot be opened.
+  bool serve(const string& socket_path, string& error) {
+#if defined(__unix__)
+    sockaddr_un address;
+    if (!socket_address(socket_path, address)) {
+      error = "socket path is too long";
+      return false;
+    }
+    if (!remove_stale_socket(socket_path, address)) {
+      error = "address in use: " + socket_path;
+      return false;
+    }
+    int listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) {
+      error = "cannot create socket";
+      return false;
+    }
+    // Connecting needs write permission on the socket, so only the owner may
+    // send requests. The mode is set before listening, while connections
+    // are still refused.
+    if (::bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        ::chmod(socket_path.c_str(), 0600) != 0 ||
+        ::listen(listener, 16) != 0) {
+      ::close(listener);
+      error = "cannot listen on " + socket_path;
+      return false;
+    }
+
+    bool shutdown = false;
+    while (!shutdown) {
+      int connection = ::accept(listener, nullptr, nullptr);
+      if (connection < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        break;
+      }
+      ::setsockopt(connection, SOL_SOCKET, SO_RCVTIMEO, &connection_timeout, sizeof(connection_timeout));
+      ::setsockopt(connection, SOL_SOCKET, SO_SNDTIMEO, &connection_timeout, sizeof(connection_timeout));
+      string request;
+      if (read_message(connection, request)) {
+        write_message(connection, handle(request, shutdown));
+      }
+      ::close(connection);
+    }
+
+    ::close(listener);
+    ::unlink(socket_path.c_str());
+    return true;
+#else
+    error = "Unix domain sockets are not supported";
+    return false;
+#endif
+  }
+
+  WorkerPool _pool;
+  ContentCache _cache;
+
+};
+
+// Sends a request payload to a daemon and waits for its response
+export std::optional<DaemonResponse> send_request(const string& socket_path, const string& request) {
+#if defined(__unix__)
+  sockaddr_un address;
+  if (!socket_address(socket_path, address)) {
+    return {};
+  }
+  int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) {
+    return {};
+  }
+  DaemonResponse response;
+  string payload;
+  bool ok =
+    ::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0 &&
+    write_message(fd, request) &&
+    read_message(fd, payload) &&
+    decode_response(payload, response);
+  ::close(fd);
+  if (!ok) {
+    return {};
+  }
+  return response;
+#else
+  return {};
+#endif
+}
@@ -0,0 +1,575 @@
+module;
+
+#include <stdio.h>
+#include <filesystem>
+
+#if defined(__unix__)
+#include <sys/resource.h>
+#endif
+
+export module cli.Tokenize;
+
+import std.core;
+import BasicTypes;
+import ScanKernels;
+import Scanner;
+import ScriptBlocks;
+import Token;
+import TokenBuffer;
+import TokenNames;
+import Tokenizer;
+import StreamSource;
+import Unicode;
+import cli.Compressed;
+import cli.FileReader;
+
+using std::string;
+using std::u32string;
+using std::vector;
+
+// Tokenization of source files for xxtok and its daemon. Files are tokenized
+// with error recovery, and errors are listed as "path:position: error". ASCII
+// files are scanned as bytes; other files are decoded from UTF-8 first, and
+// their token positions are in code points. Files compressed with gzip or
+// zstd are decoded as they are scanned, and their positions are code points
+// of the decompressed text. In HTML and component files the JavaScript of each
+// <script> element is scanned in place; its positions are offsets into the
+// host file, and each script ends with its own end token.
+
+export enum class OutputMode {
+  none,
+  tokens,
+  json,
+  binary,
+  stats,
+};
+
+export const char* output_mode_name(OutputMode mode) {
+  switch (mode) {
+    case OutputMode::none: return "none";
+    case OutputMode::tokens: return "tokens";
+    case OutputMode::json: return "json";
+    case OutputMode::binary: return "binary";
+    case OutputMode::stats: return "stats";
+  }
+  return "";
+}
+
+export std::optional<OutputMode> parse_output_mode(const string& name) {
+  for (auto mode : {
+    OutputMode::none,
+    OutputMode::tokens,
+    OutputMode::json,
+    OutputMode::binary,
+    OutputMode::stats,
+  }) {
+    if (name == output_mode_name(mode)) {
+      return mode;
+    }
+  }
+  return {};
+}
+
+// The totals of a file or of a batch
+export struct Totals {
+  uint64 files {0};
+  uint64 bytes {0};
+  uint64 tokens {0};
+  uint64 errors {0};
+  uint64 cached {0};        // Files whose output was found in a cache
+  double scan_seconds {0};  // Time spent in the tokenizer
+
+  void add(const Totals& other) {
+    files += other.files;
+    bytes += other.bytes;
+    tokens += other.tokens;
+    errors += other.errors;
+    cached += other.cached;
+    scan_seconds += other.scan_seconds;
+  }
+};
+
+// The totals of a file which could not be tokenized
+Totals failed_file() {
+  Totals totals;
+  totals.files = 1;
+  totals.errors = 1;
+  return totals;
+}
+
+// Buffers which are kept by each worker and reused for every file
+export struct Workspace {
+  string contents;
+  u32string decoded;
+  TokenBuffer tokens;
+  ScannerStats stats;
+  vector<ScriptBlock> blocks;
+};
+
+struct StatsPolicy : ScannerPolicy {
+  static constexpr bool instrument = true;
+};
+
+bool is_markup_file(const std::filesystem::path& path) {
+  auto extension = path.extension();
+  return extension == ".html" || extension == ".htm" || extension == ".vue" || extension == ".svelte";
+}
+
+// Single-file components, whose scripts are ES modules
+bool is_component_file(const std::filesystem::path& path) {
+  auto extension = path.extension();
+  return extension == ".vue" || extension == ".svelte";
+}
+
+bool is_source_file(std::filesystem::path path) {
+  if (is_markup_file(path)) {
+    return true;
+  }
+  auto extension = path.extension();
+  if (extension == ".gz" || extension == ".zst") {
+    extension = path.replace_extension().extension();
+  }
+  return extension == ".js" || extension == ".mjs" || extension == ".cjs";
+}
+
+// Directories are searched for .js, .mjs and .cjs files, which may be
+// compressed with a .gz or .zst extension, and for .html, .htm, .vue and
+// .svelte files. Listings are sorted so that the output order is stable.
+// Files named directly are included whatever their extension. Returns false
+// and sets missing if a path cannot be found.
+export bool find_files(const vector<string>& paths, vector<string>& files, string& missing) {
+  namespace fs = std::filesystem;
+  for (auto& path : paths) {
+    std::error_code error;
+    if (fs::is_directory(path, error)) {
+      vector<string> found;
+      for (auto& entry : fs::recursive_directory_iterator(path, error)) {
+        if (entry.is_regular_file() && is_source_file(entry.path())) {
+          found.push_back(entry.path().string());
+        }
+      }
+      std::sort(found.begin(), found.end());
+      files.insert(files.end(), found.begin(), found.end());
+    } else if (fs::is_regular_file(path, error)) {
+      files.push_back(path);
+    } else {
+      missing = path;
+      return false;
+    }
+  }
+  return true;
+}
+
+bool is_ascii(const string& text) {
+  for (char c : text) {
+    if (uint8(c) >= 0x80) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void append_json_string(string& out, const string& text) {
+  out += '"';
+  for (char c : text) {
+    if (c == '"' || c == '\\') {
+      out += '\\';
+      out += c;
+    } else if (uint8(c) < 0x20) {
+      char escape[8];
+      std::snprintf(escape, sizeof(escape), "\\u%04x", uint8(c));
+      out += escape;
+    } else {
+      out += c;
+    }
+  }
+  out += '"';
+}
+
+export template<typename T>
+void append_raw(string& out, const T& value) {
+  out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+// The binary stream is a sequence of files in host byte order, each written
+// as: uint32 path length, path bytes, uint32 record count, the 8-byte
+// TokenRecords, uint32 long length count, and the (index, length) pairs for
+// tokens whose length does not fit in a record. The end token is included.
+void write_binary(string& out, const string& path, const TokenBuffer& tokens) {
+  append_raw(out, uint32(path.size()));
+  out += path;
+  append_raw(out, tokens.size());
+  out.append(
+    reinterpret_cast<const char*>(tokens._records.data()),
+    tokens._records.size() * sizeof(TokenRecord));
+  append_raw(out, uint32(tokens._long_lengths.size()));
+  out.append(
+    reinterpret_cast<const char*>(tokens._long_lengths.data()),
+    tokens._long_lengths.size() * sizeof(TokenBuffer::LongLength));
+}
+
+// Scans the range, or the JavaScript script blocks within it if a list of
+// blocks is given
+template<typename Policy, typename I>
+Totals tokenize_range(
+  const string& path,
+  I begin,
+  I end,
+  const vector<ScriptBlock>* blocks,
+  OutputMode output,
+  Workspace& workspace,
+  string& out,
+  string& errors)
+{
+  using Clock = std::chrono::steady_clock;
+  using Diagnostic = typename Scanner<I, Policy>::Diagnostic;
+
+  vector<Diagnostic> diagnostics;
+  TokenBuffer& buffer = workspace.tokens;
+  buffer.clear();
+  Totals totals;
+  auto start = Clock::now();
+
+  auto scan = [&](Tokenizer<I, Policy>& tokenizer) {
+    tokenizer.scanner().set_recovery(&diagnostics);
+    if constexpr (Policy::instrument) {
+      tokenizer.scanner().set_stats(&workspace.stats);
+    }
+    if (output == OutputMode::none || output == OutputMode::stats) {
+      while (tokenizer.next() != Token::end) {
+        ++totals.tokens;
+      }
+    } else {
+      while (true) {
+        Token t = tokenizer.next();
+        buffer.push_back(tokenizer.result());
+        if (t == Token::end) {
+          break;
+        }
+        ++totals.tokens;
+      }
+    }
+  };
+
+  if (!blocks) {
+    // The iterator is moved so that a stream can release the text behind it
+    Tokenizer<I, Policy> tokenizer {std::move(begin), end, true};
+    scan(tokenizer);
+  } else if constexpr (std::random_access_iterator<I>) {
+    for (auto& block : *blocks) {
+      if (block.kind != ScriptKind::other) {
+        Tokenizer<I, Policy> tokenizer {script_scanner<Policy>(begin, block)};
+        scan(tokenizer);
+      }
+    }
+  }
+
+  totals.scan_seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  totals.files = 1;
+  totals.errors = diagnostics.size();
+
+  for (auto& diagnostic : diagnostics) {
+    errors += path + ":" + std::to_string(diagnostic.start) + ": ";
+    errors += scanner_error_name(diagnostic.error);
+    errors += "\n";
+  }
+
+  switch (output) {
+    case OutputMode::tokens:
+      out += "# " + path + "\n";
+      for (uint32 i = 0; i < buffer.size(); ++i) {
+        out += std::to_string(buffer[i].start) + " " + std::to_string(buffer.end(i)) + " ";
+        out += token_name(buffer[i].token);
+        out += "\n";
+      }
+      break;
+
+    case OutputMode::json:
+      out += "{\"path\":";
+      append_json_string(out, path);
+      out += ",\"tokens\":[";
+      for (uint32 i = 0; i < buffer.size(); ++i) {
+        out += i > 0 ? ",[\"" : "[\"";
+        out += token_name(buffer[i].token);
+        out += "\"," + std::to_string(buffer[i].start) + "," + std::to_string(buffer.end(i)) + "]";
+      }
+      out += "],\"errors\":[";
+      for (size_t i = 0; i < diagnostics.size(); ++i) {
+        out += i > 0 ? ",[\"" : "[\"";
+        out += scanner_error_name(diagnostics[i].error);
+        out += "\"," + std::to_string(diagnostics[i].start);
+        out += "," + std::to_string(diagnostics[i].end) + "]";
+      }
+      out += "]}\n";
+      break;
+
+    case OutputMode::binary:
+      write_binary(out, path, buffer);
+      break;
+
+    default:
+      break;
+  }
+
+  return totals;
+}
+
+// Decodes and scans compressed contents a block at a time, so that the
+// decompressed text is never held in full
+template<typename Policy, typename Decoder>
+Totals tokenize_stream(
+  const string& path,
+  Decoder& decoder,
+  OutputMode output,
+  Workspace& workspace,
+  string& out,
+  string& errors)
+{
+  StreamSource<char32_t, Decoder> source {decoder};
+  Totals totals = tokenize_range<Policy>(
+    path, source.begin(), source.end(), nullptr, output, workspace, out, errors);
+  if (decoder.error()) {
+    errors += path + ": " + decoder.error() + "\n";
+    ++totals.errors;
+  }
+  totals.bytes = decoder.output_size();
+  return totals;
+}
+
+template<typename Policy>
+Totals tokenize_with(const string& path, OutputMode output, Workspace& workspace, string& out, string& errors) {
+  const string& contents = workspace.contents;
+  auto data = reinterpret_cast<const uint8*>(contents.data());
+  MemoryInput input {data, contents.size()};
+  Compression compression = detect_compression(data, contents.size());
+  bool markup = is_markup_file(path);
+  if (markup && compression != Compression::none) {
+    errors += path + ": compressed markup files are not supported\n";
+    return failed_file();
+  }
+
+  switch (compression) {
+    case Compression::gzip: {
+      auto decoder = std::make_unique<GzipDecoder<MemoryInput>>(input);
+      return tokenize_stream<Policy>(path, *decoder, output, workspace, out, errors);
+    }
+    case Compression::zstd: {
+      auto decoder = std::make_unique<ZstdDecoder<MemoryInput>>(input);
+      return tokenize_stream<Policy>(path, *decoder, output, workspace, out, errors);
+    }
+    case Compression::none:
+      break;
+  }
+
+  // Line breaks are counted on the raw bytes, since a UTF-8 sequence never
+  // contains "\n". Compressed files are not counted.
+  if (output == OutputMode::stats) {
+    workspace.stats.newlines += scan_kernels().count_newlines(data, data + contents.size());
+  }
+
+  Totals totals;
+  vector<ScriptBlock>* blocks = markup ? &workspace.blocks : nullptr;
+  ScriptKind default_kind = is_component_file(path) ? ScriptKind::module : ScriptKind::classic;
+  workspace.blocks.clear();
+  if (is_ascii(contents)) {
+    auto begin = reinterpret_cast<const uint8*>(contents.data());
+    auto end = begin + contents.size();
+    if (markup) {
+      find_script_blocks(begin, end, workspace.blocks, default_kind);
+    }
+    totals = tokenize_range<Policy>(path, begin, end, blocks, output, workspace, out, errors);
+  } else {
+    auto first = reinterpret_cast<const uint8*>(contents.data());
+    auto& decoded = workspace.decoded;
+    decoded.resize(contents.size());
+    decoded.resize(decode_utf8(first, first + contents.size(), decoded.data(), true));
+    if (markup) {
+      find_script_blocks(decoded.data(), decoded.data() + decoded.size(), workspace.blocks, default_kind);
+    }
+    totals = tokenize_range<Policy>(path, decoded.cbegin(), decoded.cend(), blocks, output, workspace, out, errors);
+  }
+  totals.bytes = contents.size();
+  return totals;
+}
+
+// Tokenizes the file contents held in the workspace. In the stats output mode
+// the scanner counts are added to the workspace stats.
+export Totals tokenize_contents(
+  const string& path,
+  OutputMode output,
+  Workspace& workspace,
+  string& out,
+  string& errors)
+{
+  return output == OutputMode::stats
+    ? tokenize_with<StatsPolicy>(path, output, workspace, out, errors)
+    : tokenize_with<ScannerPolicy>(path, output, workspace, out, errors);
+}
+
+export Totals tokenize_file(
+  const string& path,
+  OutputMode output,
+  Workspace& workspace,
+  string& out,
+  string& errors)
+{
+  if (!read_file(path, workspace.contents)) {
+    errors += path + ": cannot read file\n";
+    return failed_file();
+  }
+  return tokenize_contents(path, output, workspace, out, errors);
+}
+
+// A fixed set of threads, each with its own workspace. The threads and their
+// buffers are kept between batches.
+export struct WorkerPool {
+
+  using Task = std::function<void(Workspace&)>;
+
+  explicit WorkerPool(uint32 size) : _workspaces(std::max(size, 1u)) {
+    for (uint32 i = 1; i < _workspaces.size(); ++i) {
+      _threads.emplace_back([this, i]() { work(_workspaces[i]); });
+    }
+  }
+
+  WorkerPool(const WorkerPool&) = delete;
+  WorkerPool& operator=(const WorkerPool&) = delete;
+
+  ~WorkerPool() {
+    {
+      std::lock_guard lock {_mutex};
+      _stop = true;
+    }
+    _wake.notify_all();
+    for (auto& thread : _threads) {
+      thread.join();
+    }
+  }
+
+  // Runs the task once on every worker, including the calling thread, and
+  // returns when all of them have finished
+  void run(const Task& task) {
+    {
+      std::lock_guard lock {_mutex};
+      _task = &task;
+      _running = uint32(_threads.size());
+      ++_generation;
+    }
+    _wake.notify_all();
+    task(_workspaces[0]);
+    std::unique_lock lock {_mutex};
+    _done.wait(lock, [&]() { return _running == 0; });
+    _task = nullptr;
+  }
+
+  uint32 size() const {
+    return uint32(_workspaces.size());
+  }
+
+  void work(Workspace& workspace) {
+    uint64 generation = 0;
+    while (true) {
+      const Task* task;
+      {
+        std::unique_lock lock {_mutex};
+        _wake.wait(lock, [&]() { return _stop || _generation != generation; });
+        if (_stop) {
+          return;
+        }
+        generation = _generation;
+        task = _task;
+      }
+      (*task)(workspace);
+      {
+        std::lock_guard lock {_mutex};
+        --_running;
+      }
+      _done.notify_one();
+    }
+  }
+
+  vector<Workspace> _workspaces;
+  vector<std::thread> _threads;
+  std::mutex _mutex;
+  std::condition_variable _wake;
+  std::condition_variable _done;
+  const Task* _task {nullptr};
+  uint64 _generation {0};
+  uint32 _running {0};
+  bool _stop {false};
+
+};
+
+export struct BatchResult {
+  Totals totals;
+  ScannerStats stats;
+  ReadBackend backend {ReadBackend::pread};
+};
+
+// Reads the files with a FileReader and processes each one on the pool with
+// process(path, workspace, out, errors), which finds the contents in the
+// workspace and returns the totals for the file. The output of each file is
+// passed to sink(out, errors) in the order of the file list, whichever
+// worker finishes first.
+export template<typename Process, typename Sink>
+BatchResult run_batch(
+  WorkerPool& pool,
+  const vector<string>& files,
+  ReadBackend backend,
+  Process process,
+  Sink sink)
+{
+  struct Pending {
+    string out;
+    string errors;
+    bool ready {false};
+  };
+
+  vector<Pending> pending(files.size());
+  size_t next_output = 0;
+  std::mutex mutex;
+  BatchResult result;
+  FileReader reader {files, backend, pool.size()};
+  result.backend = reader.backend();
+
+  pool.run([&](Workspace& workspace) {
+    Totals totals;
+    workspace.stats.clear();
+    for (ReadFile file; reader.pop(file);) {
+      string out;
+      string errors;
+      const string& path = files[file.index];
+      if (file.ok) {
+        workspace.contents.swap(file.contents);
+        totals.add(process(path, workspace, out, errors));
+      } else {
+        errors += path + ": cannot read file\n";
+        totals.add(failed_file());
+      }
+
+      std::lock_guard lock {mutex};
+      pending[file.index] = {std::move(out), std::move(errors), true};
+      for (; next_output < pending.size() && pending[next_output].ready; ++next_output) {
+        sink(pending[next_output].out, pending[next_output].errors);
+        pending[next_output] = {};
+      }
+    }
+    std::lock_guard lock {mutex};
+    result.totals.add(totals);
+    result.stats.add(workspace.stats);
+  });
+
+  return result;
+}
+
+// The peak resident set size of the process in bytes, or zero where it is
+// not available
+export uint64 peak_rss() {
+#if defined(__unix__)
+  rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) == 0) {
+    return uint64(usage.ru_maxrss) * 1024;
+  }
+#endif
+  return 0;
+}
@@ -0,0 +1,235 @@
+#include <stdio.h>
+#include <filesystem>
+
+import std.core;
+import BasicTypes;
+import ScanKernels;
+import Writer;
+import cli.FileReader;
+import cli.Tokenize;
+import cli.Daemon;
+
+using std::string;
+using std::vector;
+
+// Tokenizes files and directories and reports the throughput.
+//
+//   xxtok [--output none|tokens|json|binary|stats] [--jobs N] [--io auto|uring|pread] <path>...
+//   xxtok --serve <socket> [--jobs N]
+//   xxtok --connect <socket> [--output MODE] <path>...
+//
+// Directories are searched for .js, .mjs and .cjs files, and for gzip and
+// zstd files with those extensions followed by .gz or .zst, which are
+// decompressed as they are scanned, and for .html, .htm, .vue and .svelte
+// files, whose <script> elements are scanned in place (see cli.Tokenize).
+// The summary is written to stderr, so that it does not mix with the token
+// output on stdout. The exit status is 1 if any file has errors. Files are
+// read ahead of the jobs with io_uring, or by pread threads with --io pread.
+// --io auto, the default, uses io_uring only with more than one job, since
+// with a single job it is no faster (see cli.FileReader).
+//
+// Output modes:
+//
+//   none     No output besides the summary
+//   tokens   "start end name" for each token, after a "# path" line per file
+//   json     One object per file and line, with the tokens as [name, start, end]
+//   binary   The packed token records of each file (see write_binary)
+//   stats    Scanner statistics totalled over all files, as JSON
+//
+// With --serve, xxtok runs as a daemon on a Unix domain socket (see
+// cli.Daemon) until it receives a shutdown request. With --connect, the files
+// are tokenized by that daemon and the summary reports the daemon's peak RSS
+// and cache hits. "--connect <socket> --shutdown" stops the daemon.
+
+struct Options {
+  OutputMode output {OutputMode::none};
+  uint32 jobs {1};
+  ReadBackend io {ReadBackend::automatic};
+  string serve;
+  string connect;
+  bool shutdown {false};
+  vector<string> paths;
+};
+
+[[noreturn]] void fail(const string& message) {
+  std::cerr << "Error: " << message << "\n";
+  std::exit(1);
+}
+
+vector<string> expand_paths(const vector<string>& paths) {
+  vector<string> files;
+  string missing;
+  if (!find_files(paths, files, missing)) {
+    fail("cannot read " + missing);
+  }
+  return files;
+}
+
+BatchResult run_local(const vector<string>& files, const Options& options) {
+  WorkerPool pool {options.jobs};
+  FileWriter writer {stdout};
+
+  auto process = [&](const string& path, Workspace& workspace, string& out, string& errors) {
+    return tokenize_contents(path, options.output, workspace, out, errors);
+  };
+
+  auto sink = [&](const string& out, const string& errors) {
+    writer.write(out.begin(), out.end());
+    if (!errors.empty()) {
+      writer.flush();
+      std::fputs(errors.c_str(), stderr);
+    }
+  };
+
+  BatchResult result = run_batch(pool, files, options.io, process, sink);
+  if (options.output == OutputMode::stats) {
+    string json = result.stats.to_json() + "\n";
+    writer.write(json.begin(), json.end());
+  }
+  return result;
+}
+
+// The daemon has its own working directory, so paths are sent as absolute
+DaemonResponse run_remote(const vector<string>& files, const Options& options) {
+  vector<string> absolute;
+  for (auto& file : files) {
+    absolute.push_back(std::filesystem::absolute(file).string());
+  }
+  auto response = send_request(options.connect, encode_request(options.output, absolute));
+  if (!response) {
+    fail("cannot reach the daemon at " + options.connect);
+  }
+  std::fwrite(response->out.data(), 1, response->out.size(), stdout);
+  std::fflush(stdout);
+  std::fputs(response->errors.c_str(), stderr);
+  return *response;
+}
+
+void print_summary(
+  const Totals& totals,
+  double seconds,
+  uint64 rss,
+  ReadBackend io,
+  const Options& options)
+{
+  double megabytes = totals.bytes / 1e6;
+  std::fprintf(stderr, "files      %llu\n", (unsigned long long)totals.files);
+  std::fprintf(stderr, "bytes      %llu\n", (unsigned long long)totals.bytes);
+  std::fprintf(stderr, "tokens     %llu\n", (unsigned long long)totals.tokens);
+  std::fprintf(stderr, "errors     %llu\n", (unsigned long long)totals.errors);
+  if (!options.connect.empty()) {
+    std::fprintf(stderr, "cached     %llu\n", (unsigned long long)totals.cached);
+  } else {
+    std::fprintf(stderr, "jobs       %u\n", options.jobs);
+    std::fprintf(stderr, "kernels    %s\n", kernel_level_name(scan_kernels().level));
+    std::fprintf(stderr, "io         %s\n", read_backend_name(io));
+  }
+  std::fprintf(stderr, "wall       %.3f s\n", seconds);
+  std::fprintf(stderr, "MB/s       %.1f\n", megabytes / seconds);
+  std::fprintf(stderr, "tokens/s   %.0f\n", totals.tokens / seconds);
+  // Time spent in the tokenizer alone, summed over the jobs
+  if (totals.scan_seconds > 0) {
+    std::fprintf(stderr, "scan MB/s  %.1f\n", megabytes / totals.scan_seconds);
+  }
+  std::fprintf(stderr, "peak RSS   %.1f MB\n", rss / 1e6);
+}
+
+// A job count of zero uses one job per hardware thread
+Options parse_options(int argc, char** argv) {
+  Options options;
+  for (int i = 1; i < argc; ++i) {
+    string arg = argv[i];
+    if (!arg.starts_with("--")) {
+      options.paths.push_back(arg);
+      continue;
+    }
+    if (arg == "--shutdown") {
+      options.shutdown = true;
+      continue;
+    }
+    if (i + 1 >= argc) {
+      fail("missing value for " + arg);
+    }
+    string value = argv[++i];
+    if (arg == "--output") {
+      auto output = parse_output_mode(value);
+      if (!output) {
+        fail("unknown output mode " + value);
+      }
+      options.output = *output;
+    } else if (arg == "--jobs") {
+      int jobs = std::atoi(value.c_str());
+      if (jobs < 0 || (jobs == 0 && value != "0")) {
+        fail("invalid value for " + arg);
+      }
+      options.jobs = jobs > 0 ? uint32(jobs) : std::max(1u, std::thread::hardware_concurrency());
+    } else if (arg == "--io") {
+      auto io = parse_read_backend(value);
+      if (!io) {
+        fail("unknown I/O backend " + value);
+      }
+      options.io = *io;
+    } else if (arg == "--serve") {
+      options.serve = value;
+    } else if (arg == "--connect") {
+      options.connect = value;
+    } else {
+      fail("unknown option " + arg);
+    }
+  }
+  if (options.shutdown && options.connect.empty()) {
+    fail("--shutdown requires --connect");
+  }
+  if (options.paths.empty() && options.serve.empty() && !options.shutdown) {
+    fail(
+      "usage: xxtok [--output none|tokens|json|binary|stats] [--jobs N] [--io auto|uring|pread] <path>...\n"
+      "       xxtok --serve <socket> [--jobs N]\n"
+      "       xxtok --connect <socket> [--output MODE] <path>...\n"
+      "       xxtok --connect <socket> --shutdown");
+  }
+  return options;
+}
+
+int main(int argc, char** argv) {
+  using Clock = std::chrono::steady_clock;
+
+  Options options = parse_options(argc, argv);
+
+  if (!options.serve.empty()) {
+    std::fprintf(stderr, "listening on %s\n", options.serve.c_str());
+    string error;
+    if (!Daemon(options.jobs).serve(options.serve, error)) {
+      fail(error);
+    }
+    return 0;
+  }
+
+  if (options.shutdown) {
+    if (!send_request(options.connect, "shutdown\n")) {
+      fail("cannot reach the daemon at " + options.connect);
+    }
+    return 0;
+  }
+
+  auto start = Clock::now();
+  vector<string> files = expand_paths(options.paths);
+
+  Totals totals;
+  uint64 rss;
+  ReadBackend io = ReadBackend::automatic;
+  if (options.connect.empty()) {
+    BatchResult result = run_local(files, options);
+    totals = result.totals;
+    io = result.backend;
+    rss = peak_rss();
+  } else {
+    DaemonResponse response = run_remote(files, options);
+    totals = response.totals;
+    rss = response.peak_rss;
+  }
+  std::fflush(stdout);
+
+  double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  print_summary(totals, seconds, rss, io, options);
+  return totals.errors > 0 ? 1 : 0;
+}
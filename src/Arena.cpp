@@ -0,0 +1,74 @@
+module;
+
+#include <cassert>
+
+export module Arena;
+
+import std.core;
+import BasicTypes;
+
+// A bump allocator for records which live exactly as long as a single parse.
+// Records are addressed by 32-bit indices rather than pointers, and are stored
+// in fixed-size pages so that references remain valid as the arena grows.
+// Index zero is reserved so that it can be used as a null reference. Calling
+// reset rewinds the arena in constant time and keeps its pages for reuse by
+// the next parse.
+export template<typename T, uint32 page_bits = 12>
+struct Arena {
+
+  static constexpr uint32 page_size = 1 << page_bits;
+  static constexpr uint32 page_mask = page_size - 1;
+
+  Arena() {
+    reset();
+  }
+
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+
+  uint32 allocate() {
+    if ((_count & page_mask) == 0 && (_count >> page_bits) == _pages.size()) {
+      _pages.push_back(std::make_unique<T[]>(page_size));
+    }
+    uint32 index = _count++;
+    (*this)[index] = {};
+    return index;
+  }
+
+  T& operator[](uint32 index) {
+    assert(index < _count);
+    return _pages[index >> page_bits][index & page_mask];
+  }
+
+  const T& operator[](uint32 index) const {
+    assert(index < _count);
+    return _pages[index >> page_bits][index & page_mask];
+  }
+
+  void reset() {
+    _count = 0;
+    allocate();
+  }
+
+  // Releases the records from count onwards. Their pages are kept for reuse.
+  void truncate(uint32 count) {
+    assert(count > 0 && count <= _count);
+    _count = count;
+  }
+
+  uint32 size() const {
+    return _count;
+  }
+
+  size_t bytes_used() const {
+    return size_t(_count) * sizeof(T);
+  }
+
+  size_t bytes_reserved() const {
+    return _pages.size() * page_size * sizeof(T);
+  }
+
+  std::vector<std::unique_ptr<T[]>> _pages;
+  uint32 _count {0};
+
+};
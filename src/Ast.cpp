@@ -0,0 +1,394 @@
+module;
+
+#include <cassert>
+
+export module Ast;
+
+import std.core;
+import BasicTypes;
+import Token;
+import Scanner;
+import Arena;
+
+// Nodes are stored in post-order: the children of a node are the subtrees
+// which immediately precede it, in source order. Each node records the size
+// of its subtree instead of links, so the last child of a node is the node
+// before it and the previous sibling of a child is the node before the
+// child's subtree. Nodes store only where they start; the end of a node is
+// found by rescanning the source. The order of children for each node kind
+// is given below. Optional children which are missing are left out, and
+// where the children present would be ambiguous a flag records which of
+// them are there. A "none" node only stands in for a child which could not
+// be parsed after a syntax error.
+export enum class NodeKind : uint8 {
+  none,
+
+  // Top level
+  script,                     // statement...
+  module,                     // statement...
+
+  // Statements
+  empty_statement,            //
+  block,                      // statement...
+  expression_statement,       // expression
+  directive,                  // (a leaf at the string)
+  variable_declaration,       // variable_declarator... (op: kw_var, kw_let, kw_const)
+  variable_declarator,        // pattern?, initializer? (starts at an identifier bound, flag_has_init)
+  if_statement,               // test, consequent, alternate?
+  for_statement,              // init?, test?, update?, body (flag_has_init, flag_has_test, flag_has_update)
+  for_in_statement,           // left, right, body
+  for_of_statement,           // left, right, body
+  while_statement,            // test, body
+  do_while_statement,         // body, test
+  continue_statement,         // label?
+  break_statement,            // label?
+  return_statement,           // argument?
+  with_statement,             // object, body
+  switch_statement,           // discriminant, switch_case...
+  switch_case,                // test?, statement... (flag_has_test)
+  throw_statement,            // argument
+  try_statement,              // block, catch_clause?, finalizer?
+  catch_clause,               // param?, block
+  labelled_statement,         // label, statement
+  debugger_statement,         //
+
+  // Functions and classes
+  function_declaration,       // name, formal_parameters, function_body
+  function_expression,        // name?, formal_parameters, function_body
+  arrow_function,             // formal_parameters, function_body or expression
+  formal_parameters,          // pattern...
+  function_body,              // statement...
+  class_declaration,          // name?, heritage?, class_body (flag_has_heritage)
+  class_expression,           // name?, heritage?, class_body (flag_has_heritage)
+  class_body,                 // method_definition...
+  method_definition,          // name, formal_parameters, function_body
+
+  // Modules
+  import_declaration,         // identifier?, import_namespace?, import_specifier..., string
+  import_namespace,           // (starts at the local name)
+  import_specifier,           // imported, local?
+  export_declaration,         // declaration
+  export_default,             // declaration or expression
+  export_named,               // export_specifier..., string?
+  export_all,                 // identifier?, string
+  export_specifier,           // local, exported?
+
+  // Expressions
+  identifier,                 //
+  number,                     //
+  string,                     //
+  regexp,                     //
+  null_literal,               //
+  boolean_literal,            // (op: kw_true, kw_false)
+  this_expression,            //
+  super_keyword,              //
+  template_literal,           // template_part, expression, template_part...
+  template_part,              //
+  tagged_template,            // tag, template_literal
+  array_literal,              // element...
+  elision,                    //
+  spread,                     // expression
+  object_literal,             // property_definition...
+  property_definition,        // name?, value (starts at an identifier name)
+  shorthand_property,         // identifier, initializer?
+  computed_name,              // expression
+  paren_expression,           // expression?
+  member_expression,          // object (starts at the property name)
+  computed_member,            // object, expression
+  call_expression,            // callee, argument...
+  new_expression,             // callee, argument...
+  import_call,                // expression
+  import_meta,                //
+  new_target,                 //
+  unary_expression,           // argument (op)
+  update_expression,          // argument (op, flag_prefix)
+  binary_expression,          // left, right (op)
+  conditional_expression,     // test, consequent, alternate
+  assignment_expression,      // target, value (op)
+  sequence_expression,        // expression...
+  yield_expression,           // argument? (flag_delegate)
+  await_expression,           // argument
+
+  // Patterns
+  object_pattern,             // pattern_property... rest_element?
+  array_pattern,              // pattern or elision... rest_element?
+  pattern_property,           // name?, pattern (starts at an identifier name)
+  pattern_default,            // pattern, initializer
+  rest_element,               // pattern
+};
+
+export enum NodeFlag : uint16 {
+  flag_none = 0,
+  flag_async = 1 << 0,
+  flag_generator = 1 << 1,
+  flag_static = 1 << 2,
+  flag_getter = 1 << 3,
+  flag_setter = 1 << 4,
+  flag_constructor = 1 << 5,
+  flag_delegate = 1 << 6,
+  flag_strict = 1 << 8,
+  flag_expression_body = 1 << 9,
+  flag_lazy = 1 << 10,
+  flag_has_init = 1 << 11,
+  flag_has_test = 1 << 12,
+  flag_has_update = 1 << 13,
+  flag_has_heritage = 1 << 14,
+  flag_prefix = 1 << 15,
+};
+
+// Nodes with an operator keep it in the low byte of their flags, and use
+// only the flags above it
+export constexpr uint16 op_mask = 0xff;
+
+// Nodes refer to each other by index into the Ast's node arena. Index zero is
+// never a valid node.
+export using NodeIndex = uint32;
+
+export constexpr NodeIndex no_node = 0;
+
+// A subtree of at least large_size nodes keeps its size in a side table
+export constexpr uint8 large_size = 0xff;
+
+export struct Node {
+  NodeKind kind {NodeKind::none};
+  uint8 size {1};
+  uint16 flags {0};
+  SourcePosition position {0};
+
+  Token op() const {
+    return Token(flags & op_mask);
+  }
+
+  void set_op(Token op) {
+    flags = uint16((flags & ~op_mask) | uint8(op));
+  }
+
+  bool has_flag(NodeFlag flag) const {
+    return (flags & flag) != 0;
+  }
+};
+
+static_assert(sizeof(Node) == 8);
+
+export enum LazyFlag : uint16 {
+  lazy_none = 0,
+  lazy_uses_arguments = 1 << 0,
+  lazy_uses_eval = 1 << 1,
+  lazy_uses_await = 1 << 2,
+  lazy_uses_yield = 1 << 3,
+};
+
+// Summary of a function body which was skipped rather than parsed. The body
+// node is marked with flag_lazy and has no children of its own. Parsing it
+// later appends the parsed body to the Ast, and the children of the skipped
+// body are then those of the parsed one. Free variables are a conservative
+// superset: every identifier referenced in the body which is not a parameter
+// or a simple declaration within the body.
+export struct LazyFunction {
+  NodeIndex body {no_node};
+  NodeIndex parsed {no_node};
+  uint16 function_flags {flag_none};
+  uint16 uses {lazy_none};
+  bool strict {false};
+  bool new_target {false};
+  bool super_property {false};
+  bool super_call {false};
+  NodeIndex params {no_node};
+  uint32 free_begin {0};
+  uint32 free_end {0};
+
+  bool has_use(LazyFlag flag) const {
+    return (uses & flag) != 0;
+  }
+};
+
+// Accumulates a sibling chain with constant time append
+export struct NodeList {
+  NodeIndex first {no_node};
+  NodeIndex last {no_node};
+};
+
+export struct Ast {
+
+  // Makes a node whose children are the subtrees from that of first to the
+  // end of the Ast
+  NodeIndex make(NodeKind kind, SourcePosition position, NodeIndex first = no_node) {
+    NodeIndex begin = first ? subtree_begin(first) : no_node;
+    NodeIndex index = _nodes.allocate();
+    Node& node = _nodes[index];
+    node.kind = kind;
+    node.position = position;
+    set_size(index, first ? index - begin + 1 : 1);
+    return index;
+  }
+
+  NodeIndex none(SourcePosition position) {
+    return make(NodeKind::none, position);
+  }
+
+  Node& operator[](NodeIndex index) {
+    return _nodes[index];
+  }
+
+  const Node& operator[](NodeIndex index) const {
+    return _nodes[index];
+  }
+
+  void append(NodeList& list, NodeIndex index) {
+    if (!list.first) {
+      list.first = index;
+    }
+    list.last = index;
+  }
+
+  uint32 size(NodeIndex index) const {
+    uint8 size = _nodes[index].size;
+    if (size != large_size) {
+      return size;
+    }
+    auto iter = std::lower_bound(
+      _large_sizes.begin(),
+      _large_sizes.end(),
+      index,
+      [](const LargeSize& large, NodeIndex index) { return large.index < index; });
+    return iter->size;
+  }
+
+  // The first node of a subtree
+  NodeIndex subtree_begin(NodeIndex index) const {
+    return index - size(index) + 1;
+  }
+
+  // The start of a node. A member expression stores the position of its
+  // property name, and starts where its object does.
+  SourcePosition start(NodeIndex index) const {
+    while (_nodes[index].kind == NodeKind::member_expression) {
+      --index;
+    }
+    return _nodes[index].position;
+  }
+
+  // The parsed body of a skipped function body, or the node itself
+  NodeIndex resolve(NodeIndex index) const {
+    if (_nodes[index].has_flag(flag_lazy)) {
+      if (const LazyFunction* lazy = find_lazy(index); lazy && lazy->parsed) {
+        return lazy->parsed;
+      }
+    }
+    return index;
+  }
+
+  NodeIndex last_child(NodeIndex parent) const {
+    parent = resolve(parent);
+    return size(parent) > 1 ? parent - 1 : no_node;
+  }
+
+  NodeIndex previous_sibling(NodeIndex parent, NodeIndex child) const {
+    NodeIndex previous = child - size(child);
+    return previous >= subtree_begin(resolve(parent)) ? previous : no_node;
+  }
+
+  NodeIndex first_child(NodeIndex parent) const {
+    NodeIndex first = last_child(parent);
+    for (NodeIndex child = first; child; child = previous_sibling(parent, child)) {
+      first = child;
+    }
+    return first;
+  }
+
+  NodeIndex child(NodeIndex parent, int index) const {
+    int skip = child_count(parent) - 1 - index;
+    NodeIndex node = last_child(parent);
+    for (; node && skip > 0; --skip) {
+      node = previous_sibling(parent, node);
+    }
+    return skip == 0 ? node : no_node;
+  }
+
+  int child_count(NodeIndex parent) const {
+    int count = 0;
+    for (NodeIndex node = last_child(parent); node; node = previous_sibling(parent, node)) {
+      ++count;
+    }
+    return count;
+  }
+
+  // Removes the nodes from index onwards
+  void truncate(NodeIndex index) {
+    _nodes.truncate(index);
+    while (!_large_sizes.empty() && _large_sizes.back().index >= index) {
+      _large_sizes.pop_back();
+    }
+  }
+
+  // Removes a subtree of one node which no later node contains, moving the
+  // nodes after it down by one
+  void remove(NodeIndex index) {
+    assert(size(index) == 1);
+    for (NodeIndex i = index + 1; i < _nodes.size(); ++i) {
+      _nodes[i - 1] = _nodes[i];
+    }
+    _nodes.truncate(_nodes.size() - 1);
+    for (LargeSize& large : _large_sizes) {
+      large.index -= large.index > index;
+    }
+    for (LazyFunction& lazy : lazy_functions) {
+      lazy.body -= lazy.body > index;
+      lazy.params -= lazy.params > index;
+      lazy.parsed -= lazy.parsed > index;
+    }
+  }
+
+  // Lazy functions are recorded in parse order, so their body indices are
+  // increasing
+  const LazyFunction* find_lazy(NodeIndex body) const {
+    auto iter = std::lower_bound(
+      lazy_functions.begin(),
+      lazy_functions.end(),
+      body,
+      [](const LazyFunction& lazy, NodeIndex index) { return lazy.body < index; });
+    return iter != lazy_functions.end() && iter->body == body ? &*iter : nullptr;
+  }
+
+  LazyFunction* find_lazy(NodeIndex body) {
+    return const_cast<LazyFunction*>(std::as_const(*this).find_lazy(body));
+  }
+
+  // Releases all nodes in constant time
+  void reset() {
+    _nodes.reset();
+    _large_sizes.clear();
+    lazy_functions.clear();
+    free_variables.clear();
+    root = no_node;
+  }
+
+  uint32 node_count() const {
+    return _nodes.size() - 1;
+  }
+
+  size_t bytes_used() const {
+    return _nodes.bytes_used() + _large_sizes.size() * sizeof(LargeSize);
+  }
+
+  struct LargeSize {
+    NodeIndex index;
+    uint32 size;
+  };
+
+  void set_size(NodeIndex index, uint32 size) {
+    if (size < large_size) {
+      _nodes[index].size = uint8(size);
+    } else {
+      _nodes[index].size = large_size;
+      _large_sizes.push_back({index, size});
+    }
+  }
+
+  Arena<Node> _nodes;
+  std::vector<LargeSize> _large_sizes;
+  NodeIndex root {no_node};
+  std::vector<LazyFunction> lazy_functions;
+  std::vector<SourceSpan> free_variables;
+
+};
@@ -1,11 +1,15 @@
+module;
+
 #include <stdint.h>
 
 export module BasicTypes;
 
+export using uint8 = uint8_t;
 export using uint16 = uint16_t;
 export using uint32 = uint32_t;
 export using uint64 = uint64_t;
 
+export using int8 = int8_t;
 export using int16 = int16_t;
 export using int32 = int32_t;
 export using int64 = int64_t;
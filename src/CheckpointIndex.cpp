@@ -0,0 +1,182 @@
+export module CheckpointIndex;
+
+import std.core;
+import BasicTypes;
+import Scanner;
+import Tokenizer;
+
+// Records the tokenizer state at intervals while a source is scanned, so
+// that scanning can later resume near any position instead of at the start.
+// Each checkpoint follows a token other than a comment or trivia, where no
+// newline_before flag is pending, and holds the scanner context: the last
+// token, whether a regular expression may follow, the open brackets and
+// template substitutions, and whether the code is strict, for a policy whose
+// strict mode is selected as the source is read.
+export template<typename T, typename Policy = ScannerPolicy>
+struct CheckpointIndex {
+
+  using Nesting = typename Tokenizer<T, Policy>::Nesting;
+  using Diagnostic = typename Scanner<T, Policy>::Diagnostic;
+
+  static constexpr uint32 default_interval = 16 * 1024;
+
+  struct Checkpoint {
+    SourcePosition position {0};
+    Token previous {Token::end};
+    bool regexp_allowed {true};
+    bool strict_mode {false};
+    uint32 nesting_begin {0};
+    uint32 nesting_end {0};
+  };
+
+  explicit CheckpointIndex(uint32 interval = default_interval) : _interval {interval} {
+    clear();
+  }
+
+  // Called after each token of a scan from the start of the source. A
+  // checkpoint is added when the tokenizer is at least one interval past the
+  // last checkpoint.
+  void update(const Tokenizer<T, Policy>& tokenizer) {
+    auto& result = tokenizer.result();
+    switch (result.token) {
+      case Token::comment:
+      case Token::whitespace:
+      case Token::error:
+      case Token::end:
+        return;
+      default:
+        break;
+    }
+
+    if (result.end - _checkpoints.back().position < _interval) {
+      return;
+    }
+
+    auto& nesting = tokenizer.nesting();
+    Checkpoint checkpoint;
+    checkpoint.position = result.end;
+    checkpoint.previous = tokenizer.previous();
+    checkpoint.regexp_allowed = tokenizer.regexp_allowed();
+    checkpoint.strict_mode = tokenizer.scanner().strict_mode();
+    checkpoint.nesting_begin = uint32(_nesting.size());
+    _nesting.insert(_nesting.end(), nesting.begin(), nesting.end());
+    checkpoint.nesting_end = uint32(_nesting.size());
+    _checkpoints.push_back(checkpoint);
+  }
+
+  // Scans a source from the start and records its checkpoints. Without a
+  // diagnostics list the scan stops at the first error; with one, the
+  // scanner runs in recovery mode and errors are appended to it. A caller
+  // which selects strict mode as it reads, as a parser does for a "use
+  // strict" directive, calls update after each token instead.
+  void scan(T begin, T end, std::vector<Diagnostic>* diagnostics = nullptr) {
+    clear();
+    Tokenizer<T, Policy> tokenizer {begin, end};
+    set_recovery(tokenizer, diagnostics);
+    while (true) {
+      Token t = tokenizer.next();
+      if (t == Token::end || t == Token::error) {
+        break;
+      }
+      update(tokenizer);
+    }
+  }
+
+  // Returns a tokenizer which continues from the last checkpoint at or
+  // before the position. The tokens before the position are returned first
+  // and can be skipped by the caller. If the source was scanned in recovery
+  // mode, the diagnostics list should be given again; diagnostics at or after
+  // the checkpoint are replaced by those of the new scan.
+  Tokenizer<T, Policy> resume(
+    T begin,
+    T end,
+    SourcePosition position,
+    std::vector<Diagnostic>* diagnostics = nullptr) const
+  {
+    Tokenizer<T, Policy> tokenizer {begin, end};
+    set_recovery(tokenizer, diagnostics);
+    restore(tokenizer, begin, position);
+    return tokenizer;
+  }
+
+  // Moves a tokenizer over the same source to the last checkpoint at or
+  // before the position, keeping its other scanner settings, and returns the
+  // checkpoint
+  const Checkpoint& restore(Tokenizer<T, Policy>& tokenizer, T begin, SourcePosition position) const {
+    const Checkpoint& checkpoint = find(position);
+    tokenizer.seek(
+      begin + checkpoint.position,
+      checkpoint.position,
+      checkpoint.previous,
+      checkpoint.regexp_allowed,
+      _nesting.begin() + checkpoint.nesting_begin,
+      _nesting.begin() + checkpoint.nesting_end);
+    if constexpr (Policy::strict_mode == StrictMode::dynamic) {
+      tokenizer.scanner().set_strict_mode(checkpoint.strict_mode);
+    }
+    return checkpoint;
+  }
+
+  const Checkpoint& find(SourcePosition position) const {
+    auto iter = std::upper_bound(
+      _checkpoints.begin(),
+      _checkpoints.end(),
+      position,
+      [](SourcePosition position, const Checkpoint& checkpoint) { return position < checkpoint.position; });
+    return *(iter - 1);
+  }
+
+  // Updates the checkpoints after an edit whose effect on the tokens ends at
+  // last, in positions before the edit. Checkpoints after first and before
+  // last are dropped, and those at or after last are moved by shift.
+  void edit(SourcePosition first, SourcePosition last, int32 shift) {
+    std::vector<Nesting> nesting;
+    uint32 count = 0;
+    for (auto checkpoint : _checkpoints) {
+      if (checkpoint.position > first && checkpoint.position < last) {
+        continue;
+      }
+      if (checkpoint.position >= last) {
+        checkpoint.position = SourcePosition(int64(checkpoint.position) + shift);
+      }
+      uint32 nesting_begin = uint32(nesting.size());
+      nesting.insert(
+        nesting.end(),
+        _nesting.begin() + checkpoint.nesting_begin,
+        _nesting.begin() + checkpoint.nesting_end);
+      checkpoint.nesting_begin = nesting_begin;
+      checkpoint.nesting_end = uint32(nesting.size());
+      _checkpoints[count++] = checkpoint;
+    }
+    _checkpoints.resize(count);
+    _nesting.swap(nesting);
+  }
+
+  static void set_recovery(Tokenizer<T, Policy>& tokenizer, std::vector<Diagnostic>* diagnostics) {
+    if constexpr (Policy::recovery) {
+      if (diagnostics) {
+        tokenizer.scanner().set_recovery(diagnostics);
+      }
+    }
+  }
+
+  // The start of the source is always a checkpoint
+  void clear() {
+    _checkpoints.clear();
+    _checkpoints.push_back({});
+    _nesting.clear();
+  }
+
+  uint32 size() const {
+    return uint32(_checkpoints.size());
+  }
+
+  const Checkpoint& operator[](uint32 index) const {
+    return _checkpoints[index];
+  }
+
+  uint32 _interval;
+  std::vector<Checkpoint> _checkpoints;
+  std::vector<Nesting> _nesting;
+
+};
@@ -0,0 +1,269 @@
+export module Highlighter;
+
+import std.core;
+import BasicTypes;
+import Scanner;
+import Tokenizer;
+
+// Source fragments such as diff hunks are often not complete scripts, so the
+// scanner recovers from errors and does not assume strict mode
+export struct HighlighterPolicy : ScannerPolicy {
+  static constexpr StrictMode strict_mode = StrictMode::sloppy;
+};
+
+export enum class HighlightClass : uint8 {
+  plain,
+  keyword,
+  literal,
+  number,
+  string,
+  template_string,
+  regexp,
+  comment,
+  error,
+};
+
+// Maps a token and its keyword to a style. Identifiers and punctuators are
+// not styled. Reserved words are keywords, and so are the identifiers "let",
+// "static", "yield", "async" and "await", which usually act as keywords;
+// other contextual keywords such as "of" and "from" are more often names.
+export HighlightClass highlight_class(Token token, Token keyword) {
+  switch (token) {
+    case Token::number:
+      return HighlightClass::number;
+    case Token::string:
+      return HighlightClass::string;
+    case Token::template_basic:
+    case Token::template_head:
+    case Token::template_middle:
+    case Token::template_tail:
+      return HighlightClass::template_string;
+    case Token::regexp:
+      return HighlightClass::regexp;
+    case Token::comment:
+      return HighlightClass::comment;
+    case Token::kw_true:
+    case Token::kw_false:
+    case Token::kw_null:
+      return HighlightClass::literal;
+    case Token::identifier:
+      switch (keyword) {
+        case Token::kw_let:
+        case Token::kw_static:
+        case Token::kw_yield:
+        case Token::kw_async:
+        case Token::kw_await:
+          return HighlightClass::keyword;
+        default:
+          return HighlightClass::plain;
+      }
+    default:
+      return token > Token::kw_begin && token < Token::kw_end
+        ? HighlightClass::keyword
+        : HighlightClass::plain;
+  }
+}
+
+template<typename Writer>
+void write_ascii(Writer& writer, std::string_view text) {
+  writer.write(text.data(), text.data() + text.size());
+}
+
+// Writes each styled token as <span class="name">, with the characters "&",
+// "<" and ">" escaped
+export struct HtmlFormat {
+
+  static std::string_view class_name(HighlightClass c) {
+    switch (c) {
+      case HighlightClass::keyword: return "kw";
+      case HighlightClass::literal: return "lit";
+      case HighlightClass::number: return "num";
+      case HighlightClass::string: return "str";
+      case HighlightClass::template_string: return "tpl";
+      case HighlightClass::regexp: return "re";
+      case HighlightClass::comment: return "com";
+      case HighlightClass::error: return "err";
+      default: return "";
+    }
+  }
+
+  template<typename Writer>
+  static void open(Writer& writer, HighlightClass c) {
+    write_ascii(writer, "<span class=\"");
+    write_ascii(writer, class_name(c));
+    write_ascii(writer, "\">");
+  }
+
+  template<typename Writer>
+  static void close(Writer& writer, HighlightClass) {
+    write_ascii(writer, "</span>");
+  }
+
+  // Runs of characters which need no escaping are written in one call
+  template<typename Writer, typename I>
+  static void text(Writer& writer, I first, I last) {
+    I run = first;
+    for (; first != last; ++first) {
+      std::string_view entity;
+      switch (uint32(*first)) {
+        case '&': entity = "&amp;"; break;
+        case '<': entity = "&lt;"; break;
+        case '>': entity = "&gt;"; break;
+        default: continue;
+      }
+      writer.write(run, first);
+      write_ascii(writer, entity);
+      run = first + 1;
+    }
+    writer.write(run, last);
+  }
+
+};
+
+// Writes each styled token between SGR color sequences for terminals. Control
+// characters other than tab and line feed, including ESC, are written in caret
+// notation ("^[" for ESC), so that the source cannot send sequences of its own
+// to the terminal.
+export struct AnsiFormat {
+
+  static std::string_view color(HighlightClass c) {
+    switch (c) {
+      case HighlightClass::keyword: return "\x1b[35m";
+      case HighlightClass::literal: return "\x1b[36m";
+      case HighlightClass::number: return "\x1b[33m";
+      case HighlightClass::string: return "\x1b[32m";
+      case HighlightClass::template_string: return "\x1b[32m";
+      case HighlightClass::regexp: return "\x1b[31m";
+      case HighlightClass::comment: return "\x1b[90m";
+      case HighlightClass::error: return "\x1b[41m";
+      default: return "";
+    }
+  }
+
+  template<typename Writer>
+  static void open(Writer& writer, HighlightClass c) {
+    write_ascii(writer, color(c));
+  }
+
+  template<typename Writer>
+  static void close(Writer& writer, HighlightClass) {
+    write_ascii(writer, "\x1b[0m");
+  }
+
+  template<typename Writer, typename I>
+  static void text(Writer& writer, I first, I last) {
+    I run = first;
+    for (; first != last; ++first) {
+      uint32 c = uint32(*first);
+      if ((c >= 0x20 && c != 0x7f) || c == '\t' || c == '\n') {
+        continue;
+      }
+      writer.write(run, first);
+      char caret[] = {'^', char(c ^ 0x40)};
+      write_ascii(writer, std::string_view(caret, 2));
+      run = first + 1;
+    }
+    writer.write(run, last);
+  }
+
+};
+
+// Writes a script with its tokens marked up by style. Unstyled tokens and the
+// whitespace between tokens are not written one at a time: each run of source
+// between two styled tokens is passed to the format in a single call.
+//
+// The scanner runs in recovery mode, so any input is highlighted to its end.
+// Malformed tokens keep their usual style and characters which cannot begin a
+// token are styled as errors. Input which begins inside a comment or template
+// cannot be recognized as such and is highlighted as code.
+//
+// Token positions are used as offsets into the source, so T must be a random
+// access iterator over code units. Output is sent to a writer from the Writer
+// module.
+export template<typename T, typename Writer, typename Format = HtmlFormat>
+struct Highlighter {
+
+  using Diagnostic = typename Scanner<T, HighlighterPolicy>::Diagnostic;
+  using Error = typename Scanner<T, HighlighterPolicy>::Error;
+
+  Highlighter(T begin, T end, Writer& writer) :
+    _begin {begin},
+    _length {SourcePosition(end - begin)},
+    _tokenizer {begin, end},
+    _writer {writer}
+  {
+    _tokenizer.scanner().set_recovery(&_diagnostics);
+  }
+
+  void highlight() {
+    while (true) {
+      Token t = _tokenizer.next();
+      auto& result = _tokenizer.result();
+
+      write_skipped(result.start);
+
+      if (t == Token::end) {
+        break;
+      }
+
+      // Reserved words are property names after "."
+      HighlightClass c = _previous == Token::dot
+        ? HighlightClass::plain
+        : highlight_class(t, result.keyword);
+
+      if (c != HighlightClass::plain) {
+        write_span(c, result.start, result.end);
+      }
+
+      if (t != Token::comment) {
+        _previous = t;
+      }
+    }
+    write_plain(_length);
+  }
+
+  // Errors found while highlighting, for callers which report them
+  const std::vector<Diagnostic>& diagnostics() const {
+    return _diagnostics;
+  }
+
+  // Characters skipped by the scanner before a token are styled as errors.
+  // Diagnostics for the token itself begin at or after its start.
+  void write_skipped(SourcePosition start) {
+    for (; _next_diagnostic < _diagnostics.size(); ++_next_diagnostic) {
+      auto& diagnostic = _diagnostics[_next_diagnostic];
+      if (diagnostic.start >= start) {
+        break;
+      }
+      if (diagnostic.error == Error::unexpected_character) {
+        write_span(HighlightClass::error, diagnostic.start, diagnostic.end);
+      }
+    }
+  }
+
+  void write_span(HighlightClass c, SourcePosition start, SourcePosition end) {
+    write_plain(start);
+    Format::open(_writer, c);
+    Format::text(_writer, _begin + start, _begin + end);
+    Format::close(_writer, c);
+    _plain_start = end;
+  }
+
+  // Writes the unstyled source between the last span and the position
+  void write_plain(SourcePosition end) {
+    if (end > _plain_start) {
+      Format::text(_writer, _begin + _plain_start, _begin + end);
+      _plain_start = end;
+    }
+  }
+
+  T _begin;
+  SourcePosition _length;
+  Tokenizer<T, HighlighterPolicy> _tokenizer;
+  Writer& _writer;
+  std::vector<Diagnostic> _diagnostics;
+  size_t _next_diagnostic {0};
+  SourcePosition _plain_start {0};
+  Token _previous {Token::end};
+
+};
@@ -0,0 +1,229 @@
+export module Minifier;
+
+import std.core;
+import BasicTypes;
+import Scanner;
+import Tokenizer;
+
+// Comments are skipped by the scanner and collected as trivia, so that
+// license comments can be copied to the output
+export struct MinifierPolicy : ScannerPolicy {
+  static constexpr StrictMode strict_mode = StrictMode::sloppy;
+  static constexpr bool emit_comments = false;
+  static constexpr bool recovery = false;
+  static constexpr bool collect_trivia = true;
+};
+
+// Removes comments and whitespace from a script without parsing it. Tokens
+// are copied from the source unchanged, separated only where they would
+// otherwise run together, and line breaks are kept where automatic semicolon
+// insertion or a restricted production may depend on them. License comments
+// ("/*!") are kept.
+//
+// Token positions are used as offsets into the source, so T must be a random
+// access iterator over code units. Output is sent to a writer from the Writer
+// module.
+export template<typename T, typename Writer>
+struct Minifier {
+
+  Minifier(T begin, T end, Writer& writer) :
+    _begin {begin},
+    _tokenizer {begin, end},
+    _writer {writer}
+  {
+    _tokenizer.scanner().set_trivia(&_trivia);
+  }
+
+  // Returns false if the source contains an invalid token. Output up to the
+  // invalid token has been written.
+  bool minify() {
+    while (true) {
+      Token t = _tokenizer.next();
+      auto& result = _tokenizer.result();
+
+      for (auto& trivia : _trivia) {
+        if (trivia.kind == TriviaKind::license_comment) {
+          write_comment(trivia, line_break_between(trivia.end, result.start));
+        }
+      }
+      // Trivia are only needed until the next token
+      _trivia.clear();
+
+      if (t == Token::end) {
+        return true;
+      }
+
+      if (t == Token::error) {
+        _error_position = result.start;
+        return false;
+      }
+
+      write_token(t, result.keyword, result.start, result.end, result.newline_before);
+    }
+  }
+
+  SourcePosition error_position() const {
+    return _error_position;
+  }
+
+  void write_token(Token t, Token keyword, SourcePosition start, SourcePosition end, bool newline_before) {
+    uint32 first = unit(start);
+    if (_last == '\n') {
+      // At the start of the output or after a license comment
+    } else if (newline_before && line_break_needed(t)) {
+      _writer.put('\n');
+    } else if (space_needed(first)) {
+      _writer.put(' ');
+    }
+    _writer.write(_begin + start, _begin + end);
+    _last = unit(end - 1);
+    _previous = t;
+    _previous_keyword = keyword;
+  }
+
+  // A line break is written after the comment only if one follows it in the
+  // source, since "return /*! a */ b" would otherwise become "return;"
+  void write_comment(const Trivia& trivia, bool line_break_after) {
+    if (_last == '/' || is_word(_last)) {
+      _writer.put(' ');
+    }
+    _writer.write(_begin + trivia.start, _begin + trivia.end);
+    if (line_break_after) {
+      _writer.put('\n');
+      _last = '\n';
+    } else {
+      _last = '/';
+    }
+  }
+
+  // Only whitespace and comments lie between the two positions
+  bool line_break_between(SourcePosition start, SourcePosition end) const {
+    for (SourcePosition i = start; i < end; ++i) {
+      uint32 c = unit(i);
+      if (c == '\n' || c == '\r' || c == 0x2028 || c == 0x2029) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  uint32 unit(SourcePosition position) const {
+    return uint32(*(_begin + position));
+  }
+
+  // A line break between two tokens matters only if the first can end a
+  // statement and the second can start one, or if the first is a keyword
+  // which may not be followed by a line break. Tokens such as "(" and "+"
+  // usually continue an expression, but not after the binding of a
+  // declaration ("let a\n[b] = c"), which cannot be told from the tokens.
+  bool line_break_needed(Token t) const {
+    if (is_restricted(_previous) || is_restricted(_previous_keyword)) {
+      return true;
+    }
+    return can_end_statement(_previous) && can_start_statement(t);
+  }
+
+  // Numbers and regular expressions are followed by a space before a word,
+  // since "1." and "/a/" would otherwise take the word as a suffix or flags
+  bool space_needed(uint32 first) const {
+    if (is_word(first) || first == '\\') {
+      return
+        is_word(_last) ||
+        _previous == Token::number ||
+        _previous == Token::regexp;
+    }
+    switch (first) {
+      case '+':
+      case '-':
+        return _last == first;
+      case '/':
+      case '*':
+        return _last == '/';
+      case '!':
+        return _last == '<';
+      case '>':
+        return _previous == Token::decrement;
+      case '.':
+        return _previous == Token::number;
+    }
+    return false;
+  }
+
+  // Code units above ASCII are treated as identifier parts
+  static bool is_word(uint32 c) {
+    return
+      c >= 'a' && c <= 'z' ||
+      c >= 'A' && c <= 'Z' ||
+      c >= '0' && c <= '9' ||
+      c == '_' ||
+      c == '$' ||
+      c >= 128;
+  }
+
+  static bool is_restricted(Token t) {
+    switch (t) {
+      case Token::kw_return:
+      case Token::kw_break:
+      case Token::kw_continue:
+      case Token::kw_throw:
+      case Token::kw_yield:
+        return true;
+      default:
+        return false;
+    }
+  }
+
+  static bool can_end_statement(Token t) {
+    switch (t) {
+      case Token::identifier:
+      case Token::number:
+      case Token::string:
+      case Token::regexp:
+      case Token::template_basic:
+      case Token::template_tail:
+      case Token::right_paren:
+      case Token::right_bracket:
+      case Token::right_brace:
+      case Token::increment:
+      case Token::decrement:
+        return true;
+      default:
+        return t > Token::kw_begin && t < Token::kw_end;
+    }
+  }
+
+  static bool can_start_statement(Token t) {
+    switch (t) {
+      case Token::identifier:
+      case Token::number:
+      case Token::string:
+      case Token::regexp:
+      case Token::template_basic:
+      case Token::template_head:
+      case Token::left_brace:
+      case Token::left_paren:
+      case Token::left_bracket:
+      case Token::plus:
+      case Token::minus:
+      case Token::divide:
+      case Token::divide_assign:
+      case Token::increment:
+      case Token::decrement:
+      case Token::logical_not:
+      case Token::bitwise_not:
+        return true;
+      default:
+        return t > Token::kw_begin && t < Token::kw_end;
+    }
+  }
+
+  T _begin;
+  Tokenizer<T, MinifierPolicy> _tokenizer;
+  Writer& _writer;
+  std::vector<Trivia> _trivia;
+  Token _previous {Token::end};
+  Token _previous_keyword {Token::error};
+  uint32 _last {'\n'};
+  SourcePosition _error_position {0};
+
+};
@@ -0,0 +1,443 @@
+module;
+
+#include <cassert>
+
+export module ModuleLexer;
+
+import std.core;
+import BasicTypes;
+import Scanner;
+import Tokenizer;
+
+export enum class ImportKind : uint8 {
+  static_import,              // import ... from "x", import "x"
+  reexport,                   // export ... from "x"
+  dynamic_import,             // import(...)
+  import_meta,                // import.meta
+};
+
+export struct ModuleImport {
+  ImportKind kind {ImportKind::static_import};
+  SourceSpan span;            // From "import" or "export" to the specifier
+  SourceSpan specifier;       // String literal including quotes, or empty
+};
+
+export struct ModuleExport {
+  SourceSpan name;            // The "default" keyword for default exports
+  SourceSpan local;           // Empty for default exports and re-exports
+};
+
+// Modules are always strict. Comments are skipped by the scanner, which
+// recovers from errors.
+export struct ModuleLexerPolicy : ScannerPolicy {
+  static constexpr StrictMode strict_mode = StrictMode::strict;
+  static constexpr bool emit_comments = false;
+};
+
+// Extracts the import and export sites of a module without building a syntax
+// tree. Only the tokens following "import" and "export" are examined; all
+// other tokens are scanned and discarded. Since scanning dominates, the
+// lexer runs at close to the speed of the tokenizer, which is 1.7 to 3 times
+// that of a full parse (the "modules" and "parser" configurations of
+// bench.throughput).
+//
+// Errors do not end the lex. Invalid tokens are scanned as in recovery mode
+// and a malformed import or export is skipped; both are reported as
+// diagnostics along with the sites found.
+export template<typename T>
+struct ModuleLexer {
+
+  using Context = typename Scanner<T, ModuleLexerPolicy>::Context;
+  using Result = typename Scanner<T, ModuleLexerPolicy>::Result;
+  using Nesting = typename Tokenizer<T, ModuleLexerPolicy>::Nesting;
+
+  enum class Error {
+    none,
+    invalid_token,
+    unexpected_token,
+  };
+
+  // The scanner error is set for an invalid token
+  struct Diagnostic {
+    Error error {Error::none};
+    ScannerError scanner_error {ScannerError::none};
+    SourceSpan span;
+  };
+
+  ModuleLexer(T begin, T end) : _begin {begin}, _tokenizer {begin, end} {}
+
+  // The scanner refers to the lexer's list of its errors
+  ModuleLexer(const ModuleLexer&) = delete;
+  ModuleLexer& operator=(const ModuleLexer&) = delete;
+
+  // Returns false if there are diagnostics
+  bool lex() {
+    _tokenizer.scanner().set_recovery(&_scanner_diagnostics);
+    while (next() != Token::end) {
+      switch (_token) {
+
+        case Token::kw_import:
+          if (_before != Token::dot) {
+            lex_import();
+          }
+          break;
+
+        case Token::kw_export:
+          if (_before != Token::dot) {
+            lex_export();
+          }
+          break;
+
+        default:
+          break;
+      }
+    }
+
+    // Scanner errors are merged in source order
+    for (auto& scanner_diagnostic : _scanner_diagnostics) {
+      Diagnostic diagnostic {
+        Error::invalid_token,
+        scanner_diagnostic.error,
+        {scanner_diagnostic.start, scanner_diagnostic.end},
+      };
+      auto iter = std::upper_bound(
+        _diagnostics.begin(),
+        _diagnostics.end(),
+        diagnostic,
+        [](const Diagnostic& a, const Diagnostic& b) { return a.span.start < b.span.start; });
+      _diagnostics.insert(iter, diagnostic);
+    }
+    _scanner_diagnostics.clear();
+    return _diagnostics.empty();
+  }
+
+  const std::vector<Diagnostic>& diagnostics() const {
+    return _diagnostics;
+  }
+
+  // Tokens
+
+  Token next() {
+    if (_pushed) {
+      _pushed = false;
+      return _token;
+    }
+    Token t = _tokenizer.next();
+    _before = _token;
+    _before_keyword = _keyword;
+    _token = t;
+    _keyword = result().keyword;
+    return t;
+  }
+
+  // Returns the current token again from the following call to next
+  void push_back() {
+    _pushed = true;
+  }
+
+  const Result& result() const {
+    return _tokenizer.result();
+  }
+
+  SourceSpan span() const {
+    return {result().start, result().end};
+  }
+
+  bool is_keyword(Token keyword) const {
+    return _token == Token::identifier && result().keyword == keyword;
+  }
+
+  // Identifiers and reserved words may both be used as export names
+  static bool is_name(Token token) {
+    return token == Token::identifier || token > Token::kw_begin && token < Token::kw_end;
+  }
+
+  // Lexing continues after the current token, or stops at the end
+  void fail(Error error) {
+    _diagnostics.push_back({error, ScannerError::none, span()});
+    if (_token == Token::end) {
+      push_back();
+    }
+  }
+
+  // Imports
+
+  void lex_import() {
+    SourcePosition start = result().start;
+    Token before = _before;
+    Token before_keyword = _before_keyword;
+    switch (next()) {
+      case Token::left_paren:
+        if (!is_method_name(before, before_keyword)) {
+          lex_dynamic_import(start);
+        }
+        return;
+
+      case Token::dot:
+        if (next() == Token::identifier && source_equals("meta")) {
+          _imports.push_back({ImportKind::import_meta, {start, result().end}, {}});
+        } else {
+          push_back();
+        }
+        return;
+
+      case Token::string:
+      case Token::identifier:
+      case Token::left_brace:
+      case Token::multiply:
+        break;
+
+      default:
+        // A property name such as "{ import: 1 }"
+        push_back();
+        return;
+    }
+
+    while (_token != Token::string) {
+      switch (next()) {
+        case Token::end:
+        case Token::error:
+        case Token::semicolon:
+          return fail(Error::unexpected_token);
+        default:
+          break;
+      }
+    }
+    _imports.push_back({ImportKind::static_import, {start, result().end}, span()});
+  }
+
+  // True if the current token is spelled as the text
+  bool source_equals(const char* text) const {
+    auto iter = std::next(_begin, result().start);
+    for (auto pos = result().start; pos < result().end; ++pos, ++iter, ++text) {
+      if (*text == 0 || uint32(*iter) != uint32(*text)) {
+        return false;
+      }
+    }
+    return *text == 0;
+  }
+
+  // True if "import(" begins a method named "import", as in
+  // "class { import() {} }", rather than a dynamic import. A method is a
+  // member of an object literal or class body, which directly encloses the
+  // "(", follows the start of the body, another member or a modifier such as
+  // "static", and has a parameter list followed by a "{". Since a block after
+  // a label or case clause is taken to be an object literal, the parameter
+  // list is scanned ahead so that "label: { import('x') }" is still an import.
+  bool is_method_name(Token before, Token before_keyword) const {
+    auto& nesting = _tokenizer.nesting();
+    if (nesting.size() < 2 || nesting[nesting.size() - 2] != Nesting::object) {
+      return false;
+    }
+    switch (before) {
+      case Token::identifier:
+        // "await import(x)" and "yield import(x)" are imports
+        if (before_keyword == Token::kw_await || before_keyword == Token::kw_yield) {
+          return false;
+        }
+        break;
+      case Token::left_brace:
+      case Token::right_brace:
+      case Token::comma:
+      case Token::semicolon:
+      case Token::multiply:
+      case Token::kw_static:
+        break;
+      default:
+        return false;
+    }
+    Tokenizer<T, ModuleLexerPolicy> ahead = _tokenizer;
+    uint32 depth = ahead.depth();
+    while (ahead.depth() >= depth) {
+      Token t = ahead.next();
+      if (t == Token::end || t == Token::error) {
+        return false;
+      }
+    }
+    return ahead.next() == Token::left_brace;
+  }
+
+  // The specifier is recorded only when the argument is a string literal.
+  // The argument tokens are left for the main loop.
+  void lex_dynamic_import(SourcePosition start) {
+    ModuleImport entry {ImportKind::dynamic_import, {start, result().end}, {}};
+    Scanner<T, ModuleLexerPolicy> scanner = _tokenizer.scanner();
+    if (scanner.next(Context::expression) == Token::string) {
+      SourceSpan specifier {scanner.result().start, scanner.result().end};
+      if (Token t = scanner.next(Context::div); t == Token::right_paren || t == Token::comma) {
+        entry.span.end = scanner.result().end;
+        entry.specifier = specifier;
+      }
+    }
+    _imports.push_back(entry);
+  }
+
+  // Exports
+
+  void lex_export() {
+    SourcePosition start = result().start;
+    switch (next()) {
+      case Token::multiply:
+        return lex_export_all(start);
+
+      case Token::left_brace:
+        return lex_export_list(start);
+
+      case Token::kw_default:
+        _exports.push_back({span(), {}});
+        return;
+
+      case Token::kw_function:
+      case Token::kw_class:
+        return lex_export_declaration_name();
+
+      case Token::kw_var:
+      case Token::kw_let:
+      case Token::kw_const:
+        return lex_export_variables();
+
+      case Token::identifier:
+        if (is_keyword(Token::kw_async) && next() == Token::kw_function) {
+          return lex_export_declaration_name();
+        }
+        push_back();
+        return;
+
+      default:
+        push_back();
+        return;
+    }
+  }
+
+  // export * from "x", export * as name from "x"
+  void lex_export_all(SourcePosition start) {
+    next();
+    if (is_keyword(Token::kw_as)) {
+      if (!is_name(next())) {
+        return fail(Error::unexpected_token);
+      }
+      _exports.push_back({span(), {}});
+      next();
+    }
+    lex_reexport_from(start);
+  }
+
+  // export { a, b as c } [from "x"]
+  void lex_export_list(SourcePosition start) {
+    size_t first = _exports.size();
+    while (next() != Token::right_brace) {
+      if (!is_name(_token)) {
+        return fail(Error::unexpected_token);
+      }
+      SourceSpan local = span();
+      SourceSpan name = local;
+      next();
+      if (is_keyword(Token::kw_as)) {
+        if (!is_name(next())) {
+          return fail(Error::unexpected_token);
+        }
+        name = span();
+        next();
+      }
+      _exports.push_back({name, local});
+      if (_token == Token::right_brace) {
+        break;
+      }
+      if (_token != Token::comma) {
+        return fail(Error::unexpected_token);
+      }
+    }
+
+    if (next() == Token::identifier && is_keyword(Token::kw_from)) {
+      for (size_t i = first; i < _exports.size(); ++i) {
+        _exports[i].local = {};
+      }
+      lex_reexport_from(start);
+    } else {
+      push_back();
+    }
+  }
+
+  void lex_reexport_from(SourcePosition start) {
+    if (!is_keyword(Token::kw_from) || next() != Token::string) {
+      return fail(Error::unexpected_token);
+    }
+    _imports.push_back({ImportKind::reexport, {start, result().end}, span()});
+  }
+
+  // export function name, export class name
+  void lex_export_declaration_name() {
+    if (next() == Token::multiply) {
+      next();
+    }
+    if (_token != Token::identifier) {
+      return fail(Error::unexpected_token);
+    }
+    _exports.push_back({span(), span()});
+  }
+
+  // export var a = 1, b; Names bound by destructuring patterns are not
+  // reported.
+  void lex_export_variables() {
+    uint32 depth = _tokenizer.depth();
+    bool binding = true;
+    while (true) {
+      bool after_operand = !_tokenizer.regexp_allowed();
+      Token t = next();
+      if (t == Token::end || t == Token::error) {
+        return push_back();
+      }
+      if (_tokenizer.depth() == depth) {
+        if (t == Token::semicolon) {
+          return;
+        }
+        if (result().newline_before && after_operand && starts_statement(t)) {
+          return push_back();
+        }
+        if (binding && t == Token::identifier) {
+          _exports.push_back({span(), span()});
+        }
+      }
+      binding = t == Token::comma && _tokenizer.depth() == depth;
+    }
+  }
+
+  // True if automatic semicolon insertion applies before a token which
+  // follows a newline and the end of an operand
+  static bool starts_statement(Token t) {
+    switch (t) {
+      case Token::identifier:
+      case Token::string:
+      case Token::number:
+      case Token::template_basic:
+      case Token::template_head:
+      case Token::left_brace:
+      case Token::increment:
+      case Token::decrement:
+        return true;
+      default:
+        return is_name(t);
+    }
+  }
+
+  const std::vector<ModuleImport>& imports() const {
+    return _imports;
+  }
+
+  const std::vector<ModuleExport>& exports() const {
+    return _exports;
+  }
+
+  T _begin;
+  Tokenizer<T, ModuleLexerPolicy> _tokenizer;
+  Token _token {Token::end};
+  Token _before {Token::end};
+  Token _keyword {Token::error};
+  Token _before_keyword {Token::error};
+  bool _pushed {false};
+  std::vector<ModuleImport> _imports;
+  std::vector<ModuleExport> _exports;
+  std::vector<Diagnostic> _diagnostics;
+  std::vector<typename Scanner<T, ModuleLexerPolicy>::Diagnostic> _scanner_diagnostics;
+
+};
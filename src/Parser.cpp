@@ -0,0 +1,2913 @@
+module;
+
+#include <cassert>
+
+export module Parser;
+
+import std.core;
+import BasicTypes;
+import Token;
+import Scanner;
+import Ast;
+import Probes;
+import Tokenizer;
+
+using std::initializer_list;
+using std::optional;
+
+// A recursive descent parser for scripts and modules, which builds an Ast.
+// The grammar is that of ES2019: optional chaining ("?."), nullish
+// coalescing ("??"), logical assignment ("||=", "&&=" and "??=") and class
+// fields are reported as syntax errors. These early errors are not reported:
+// duplicate parameter names, duplicate or undeclared exported names, yield
+// and await expressions in formal parameters, and invalid regular
+// expression patterns or flags.
+export template<typename T>
+struct Parser {
+
+  using Context = typename Scanner<T>::Context;
+  using Result = typename Scanner<T>::Result;
+
+  enum class Error {
+    none,
+    invalid_token,
+    unexpected_token,
+    invalid_assignment_target,
+    invalid_cover_initializer,
+    invalid_exponent_operand,
+    invalid_reserved_word,
+    invalid_return,
+    invalid_break,
+    invalid_continue,
+    invalid_import_meta,
+    invalid_new_target,
+    invalid_with,
+    missing_initializer,
+    invalid_for_initializer,
+    missing_catch_or_finally,
+    newline_after_throw,
+    undefined_label,
+    duplicate_label,
+    invalid_super,
+    invalid_delete,
+    duplicate_proto,
+    duplicate_default,
+    duplicate_declaration,
+    invalid_strict_directive,
+  };
+
+  struct FunctionState {
+    bool in_function {false};
+    bool new_target {false};        // "new.target" is allowed
+    bool is_async {false};
+    bool is_generator {false};
+    bool super_property {false};    // "super.x" is allowed
+    bool super_call {false};        // "super()" is allowed
+    int loop_depth {0};
+    int breakable_depth {0};
+    uint32 label_base {0};          // The first label of _labels in the function
+  };
+
+  // A label of an enclosing statement. The labels of a statement such as
+  // "a: b: while (x);" are iteration labels, and may be used by "continue".
+  struct Label {
+    SourceSpan name;
+    SourcePosition body_start {0};
+    bool iteration {false};
+  };
+
+  Parser(T begin, T end, Ast& ast) :
+    _scanner {begin, end},
+    _rewind {begin, end},
+    _begin {begin},
+    _length {uint64(end - begin)},
+    _ast {ast},
+    _rescan {begin, end}
+  {}
+
+  // The parse__start and parse__end probes fire around each parse
+  NodeIndex parse_script() {
+    probe_parse_start(_length);
+    enter_scope(0, true);
+    NodeList list;
+    parse_directives(list);
+    while (peek() != Token::end) {
+      _ast.append(list, parse_statement_list_item());
+    }
+    exit_scope();
+    check_cover_init();
+    _ast.root = node_list(NodeKind::script, 0, list);
+    probe_parse_end(_length, _token_count, uint64(_error));
+    return _ast.root;
+  }
+
+  NodeIndex parse_module() {
+    probe_parse_start(_length);
+    _module = true;
+    set_strict(true);
+    enter_scope(0, true);
+    NodeList list;
+    while (peek() != Token::end) {
+      _ast.append(list, parse_module_item());
+    }
+    exit_scope();
+    check_cover_init();
+    _ast.root = node_list(NodeKind::module, 0, list);
+    probe_parse_end(_length, _token_count, uint64(_error));
+    return _ast.root;
+  }
+
+  Error error() const {
+    return _error;
+  }
+
+  // When enabled, function bodies are skipped by matching braces over the
+  // token stream instead of being parsed. Skipped bodies are recorded in the
+  // Ast's lazy function table and can be parsed later with parse_lazy_body.
+  void set_lazy_functions(bool lazy_functions) {
+    _lazy_functions = lazy_functions;
+  }
+
+  // Parses a function body which was skipped, attaching its statements to the
+  // body node. Function bodies nested within it are skipped again if lazy
+  // parsing is still enabled.
+  NodeIndex parse_lazy_body(NodeIndex body) {
+    const LazyFunction* lazy = _ast.find_lazy(body);
+    if (!lazy || lazy->parsed || _error != Error::none) {
+      return body;
+    }
+    LazyFunction summary = *lazy;
+
+    Scanner<T> scanner = _scanner;
+    Scanner<T> rewind = _rewind;
+    Result peek = _peek;
+    Context peek_context = _peek_context;
+    bool peeked = _peeked;
+    SourcePosition last_end = _last_end;
+    bool strict_mode = _strict_mode;
+
+    // Scanning resumes after the opening brace of the body
+    SourcePosition resume = _ast[body].position + 1;
+    _scanner.set_strict_mode(summary.strict);
+    _scanner.seek(std::next(_begin, resume), resume);
+    _peeked = false;
+    _strict_mode = summary.strict;
+    _cover_init.reset();
+    _duplicate_proto.reset();
+
+    FunctionState saved = enter_function(summary.function_flags);
+    _function.new_target = summary.new_target;
+    _function.super_property = summary.super_property;
+    _function.super_call = summary.super_call;
+    enter_function_scope(summary.params);
+    NodeList list;
+    if (parse_directives(list)) {
+      check_strict_parameters(summary.params);
+    }
+    bool strict_body = _strict_mode && !summary.strict;
+    while (more(Token::right_brace)) {
+      _ast.append(list, parse_statement_list_item());
+    }
+    expect(Token::right_brace);
+    exit_scope();
+    check_cover_init();
+    _function = saved;
+
+    NodeIndex parsed = node_list(NodeKind::function_body, _ast[body].position, list);
+    if (_error == Error::none) {
+      _ast.find_lazy(body)->parsed = parsed;
+      if (strict_body) {
+        _ast[body].flags |= flag_strict;
+        _ast[parsed].flags |= flag_strict;
+      }
+      _scanner = scanner;
+      _rewind = rewind;
+      _peek = peek;
+      _peek_context = peek_context;
+      _peeked = peeked;
+      _last_end = last_end;
+      _strict_mode = strict_mode;
+    }
+    return body;
+  }
+
+  // Lookahead
+
+  Token peek(Context context = Context::expression) {
+    if (_error != Error::none) {
+      return Token::end;
+    }
+    if (_peeked) {
+      if (!needs_rescan(_peek.token, _peek_context, context)) {
+        return _peek.token;
+      }
+      _scanner = _rewind;
+    }
+    _rewind = _scanner;
+    while (_scanner.next(context) == Token::comment);
+    _peek = _scanner.result();
+    _peek_context = context;
+    _peeked = true;
+    return _peek.token;
+  }
+
+  // Returns the token after the current lookahead token, without consuming
+  // either of them
+  Result peek_next(Context context = Context::div) {
+    if (!_peeked) {
+      peek();
+    }
+    Scanner<T> scanner = _scanner;
+    while (scanner.next(context) == Token::comment);
+    return scanner.result();
+  }
+
+  bool peek_keyword(Token keyword, Context context = Context::expression) {
+    Token t = peek(context);
+    return t == keyword || t == Token::identifier && _peek.keyword == keyword;
+  }
+
+  SourcePosition peek_start() {
+    peek();
+    return _peek.start;
+  }
+
+  bool more(Token close, Context context = Context::expression) {
+    Token t = peek(context);
+    return t != close && t != Token::end;
+  }
+
+  Result read() {
+    if (!_peeked) {
+      peek();
+    }
+    if (_error == Error::none) {
+      if (is_invalid_token()) {
+        fail_token();
+      } else {
+        _peeked = false;
+        _last_end = _peek.end;
+        ++_token_count;
+      }
+    }
+    return _peek;
+  }
+
+  Result expect(Token token, Context context = Context::expression) {
+    if (peek(context) != token) {
+      unexpected();
+    }
+    return read();
+  }
+
+  Result expect_keyword(Token keyword) {
+    if (!peek_keyword(keyword, Context::div)) {
+      unexpected();
+    }
+    return read();
+  }
+
+  static bool needs_rescan(Token token, Context before, Context after) {
+    switch (token) {
+      case Token::regexp:
+      case Token::divide:
+      case Token::divide_assign:
+        return (before == Context::div) != (after == Context::div);
+      case Token::right_brace:
+      case Token::template_middle:
+      case Token::template_tail:
+        return
+          (before == Context::template_string) !=
+          (after == Context::template_string);
+      default:
+        return false;
+    }
+  }
+
+  void set_strict(bool strict_mode) {
+    if (strict_mode == _strict_mode) {
+      return;
+    }
+    if (_peeked) {
+      _scanner = _rewind;
+      _peeked = false;
+    }
+    _scanner.set_strict_mode(strict_mode);
+    _strict_mode = strict_mode;
+  }
+
+  // Errors
+
+  void fail(Error error, SourcePosition start, SourcePosition end) {
+    if (_error != Error::none) {
+      return;
+    }
+    _error = error;
+    _error_start = start;
+    _error_end = end;
+    // All further lookahead reports the end of input, which unwinds the
+    // parser without requiring every production to check for failure
+    _peek = {};
+    _peek.token = Token::end;
+    _peek.start = _peek.end = _last_end;
+    _peeked = true;
+  }
+
+  void fail(Error error, NodeIndex node) {
+    fail(error, _ast.start(node), node_end(node));
+  }
+
+  void fail_token() {
+    _scanner_error = _peek.error;
+    fail(Error::invalid_token, _peek.start, _peek.end);
+  }
+
+  void unexpected() {
+    if (_error != Error::none) {
+      return;
+    }
+    if (is_invalid_token()) {
+      return fail_token();
+    }
+    fail(Error::unexpected_token, _peek.start, _peek.end);
+  }
+
+  // Strict mode errors, such as legacy octal literals, are reported by the
+  // scanner with the token's usual type
+  bool is_invalid_token() const {
+    return _peek.token == Token::error || _peek.error != Scanner<T>::Error::none;
+  }
+
+  // Reports the errors of the cover grammar which an assignment pattern would
+  // have excused
+  void check_cover_init() {
+    if (_cover_init) {
+      fail(Error::invalid_cover_initializer, *_cover_init, *_cover_init);
+    }
+    if (_duplicate_proto) {
+      fail(Error::duplicate_proto, *_duplicate_proto, *_duplicate_proto);
+    }
+  }
+
+  // Nodes
+
+  NodeIndex node(
+    NodeKind kind,
+    SourcePosition start,
+    initializer_list<NodeIndex> children = {}
+  ) {
+    NodeList list;
+    for (NodeIndex child : children) {
+      if (child) {
+        _ast.append(list, child);
+      }
+    }
+    return node_list(kind, start, list);
+  }
+
+  // The children of a node are the subtrees parsed since the first of them,
+  // so every node parsed must become part of the next node which is made
+  NodeIndex node_list(NodeKind kind, SourcePosition start, const NodeList& list) {
+    NodeIndex n = _ast.make(kind, start, list.first);
+    assert(list.last == (list.first ? n - 1 : no_node));
+    return n;
+  }
+
+  // An identifier which starts the node it belongs to is left out, as the
+  // position of that node finds it. It must be the last node parsed.
+  NodeIndex drop_identifier(NodeIndex name) {
+    if (_ast[name].kind != NodeKind::identifier) {
+      return name;
+    }
+    assert(name == _ast.node_count());
+    _ast.truncate(name);
+    return no_node;
+  }
+
+  NodeIndex leaf(NodeKind kind) {
+    Result r = read();
+    NodeIndex n = _ast.make(kind, r.start);
+    _ast[n].set_op(r.token == Token::identifier ? r.keyword : r.token);
+    return n;
+  }
+
+  NodeIndex none() {
+    return _ast.none(_last_end);
+  }
+
+  // The end of a node is that of the last leaf within it, which leaves out
+  // any closing punctuation. Only the spans of errors depend on it.
+  SourcePosition node_end(NodeIndex node) {
+    while (_ast[node].kind != NodeKind::member_expression && _ast.last_child(node)) {
+      node = _ast.last_child(node);
+    }
+    return token_end(node);
+  }
+
+  // The end of the token at the position of a node, found by rescanning it
+  SourcePosition token_end(NodeIndex node) {
+    SourcePosition position = _ast[node].position;
+    Context context = Context::div;
+    switch (_ast[node].kind) {
+      case NodeKind::none:
+      case NodeKind::elision:
+        return position;
+      case NodeKind::regexp:
+        context = Context::expression;
+        break;
+      case NodeKind::template_part:
+        context = Context::template_string;
+        break;
+      default:
+        break;
+    }
+    _rescan.seek(std::next(_begin, position), position);
+    _rescan.next(context);
+    return _rescan.result().end;
+  }
+
+  SourceSpan span(NodeIndex node) {
+    return {_ast.start(node), node_end(node)};
+  }
+
+  bool source_equals(NodeIndex node, const char* text) {
+    return source_equals(_ast[node].position, token_end(node), text);
+  }
+
+  bool source_equals(SourcePosition start, SourcePosition end, SourceSpan other) const {
+    return
+      end - start == other.end - other.start &&
+      std::equal(std::next(_begin, start), std::next(_begin, end), std::next(_begin, other.start));
+  }
+
+  bool source_equals(SourcePosition start, SourcePosition end, const char* text) {
+    auto iter = std::next(_begin, start);
+    for (auto pos = start; pos < end; ++pos, ++iter, ++text) {
+      if (*text == 0 || uint32(*iter) != uint32(*text)) {
+        return false;
+      }
+    }
+    return *text == 0;
+  }
+
+  // Statements
+
+  NodeIndex parse_module_item() {
+    if (peek() == Token::kw_import) {
+      if (Token t = peek_next().token; t != Token::left_paren && t != Token::dot) {
+        return parse_import_declaration();
+      }
+    } else if (peek() == Token::kw_export) {
+      return parse_export_declaration();
+    }
+    return parse_statement_list_item();
+  }
+
+  NodeIndex parse_statement_list_item() {
+    switch (peek()) {
+      case Token::kw_function:
+        return parse_function(false, peek_start(), flag_none);
+
+      case Token::kw_class:
+        return parse_class(false);
+
+      case Token::kw_const:
+      case Token::kw_let:
+        return parse_variable_declaration(false, false);
+
+      case Token::identifier:
+        if (is_let_declaration()) {
+          return parse_variable_declaration(false, false);
+        } else if (is_async_function()) {
+          return parse_async_function(false);
+        }
+        break;
+
+      default:
+        break;
+    }
+    return parse_statement();
+  }
+
+  bool is_let_declaration() {
+    if (!peek_keyword(Token::kw_let)) {
+      return false;
+    }
+    switch (peek_next().token) {
+      case Token::identifier:
+      case Token::left_bracket:
+      case Token::left_brace:
+        return true;
+      default:
+        return false;
+    }
+  }
+
+  bool is_async_function() {
+    if (!peek_keyword(Token::kw_async)) {
+      return false;
+    }
+    auto next = peek_next();
+    return next.token == Token::kw_function && !next.newline_before;
+  }
+
+  NodeIndex parse_statement() {
+    switch (peek()) {
+      case Token::left_brace: return parse_block();
+      case Token::semicolon: return parse_empty_statement();
+      case Token::kw_var: return parse_variable_declaration(false, false);
+      case Token::kw_if: return parse_if();
+      case Token::kw_for: return parse_for();
+      case Token::kw_while: return parse_while();
+      case Token::kw_do: return parse_do_while();
+      case Token::kw_continue: return parse_continue();
+      case Token::kw_break: return parse_break();
+      case Token::kw_return: return parse_return();
+      case Token::kw_with: return parse_with();
+      case Token::kw_switch: return parse_switch();
+      case Token::kw_throw: return parse_throw();
+      case Token::kw_try: return parse_try();
+      case Token::kw_debugger: return parse_debugger();
+      case Token::kw_function:
+      case Token::kw_class:
+        // A declaration is not a statement, so it may only be an item of a
+        // statement list
+        unexpected();
+        return parse_statement_list_item();
+      default: return parse_expression_statement();
+    }
+  }
+
+  // The body of an if or labelled statement may be a function declaration
+  // in sloppy mode (Annex B)
+  NodeIndex parse_statement_or_sloppy_function() {
+    if (peek() == Token::kw_function && !_strict_mode) {
+      return parse_function(false, peek_start(), flag_none);
+    }
+    return parse_statement();
+  }
+
+  void semicolon() {
+    if (Token t = peek(Context::div); t == Token::semicolon) {
+      read();
+    } else if (t != Token::right_brace && t != Token::end && !_peek.newline_before) {
+      unexpected();
+    }
+  }
+
+  // Returns true if the directives include "use strict"
+  bool parse_directives(NodeList& list) {
+    bool use_strict = false;
+    while (peek() == Token::string) {
+      NodeIndex statement = parse_statement();
+      NodeIndex string = _ast.last_child(statement);
+      if (
+        _ast[statement].kind != NodeKind::expression_statement ||
+        _ast[string].kind != NodeKind::string
+      ) {
+        _ast.append(list, statement);
+        break;
+      }
+      // A directive is a leaf in place of its string
+      _ast.truncate(statement);
+      statement = string;
+      _ast[statement].kind = NodeKind::directive;
+      _ast[statement].flags = flag_none;
+      _ast.append(list, statement);
+      if (source_equals(statement, "'use strict'") || source_equals(statement, "\"use strict\"")) {
+        if (!_strict_mode) {
+          check_strict_directives(list.first, statement);
+        }
+        set_strict(true);
+        use_strict = true;
+      }
+    }
+    return use_strict;
+  }
+
+  // Directives before "use strict" were scanned in sloppy mode, and may
+  // contain legacy octal escapes
+  void check_strict_directives(NodeIndex first, NodeIndex last) {
+    Scanner<T> scanner = _scanner;
+    scanner.set_strict_mode(true);
+    for (NodeIndex statement = last - _ast.size(last); statement >= first; statement -= _ast.size(statement)) {
+      if (_ast[statement].kind != NodeKind::directive) {
+        continue;
+      }
+      SourcePosition start = _ast.start(statement);
+      scanner.seek(std::next(_begin, start), start);
+      scanner.next();
+      if (scanner.result().error != Scanner<T>::Error::none) {
+        _scanner_error = scanner.result().error;
+        return fail(Error::invalid_token, scanner.result().start, scanner.result().end);
+      }
+    }
+  }
+
+  // A catch clause parses its block in the scope of its parameter
+  NodeIndex parse_block(bool scope = true) {
+    auto start = expect(Token::left_brace).start;
+    if (scope) {
+      enter_scope(start, false);
+    }
+    NodeList list;
+    while (more(Token::right_brace)) {
+      _ast.append(list, parse_statement_list_item());
+    }
+    if (scope) {
+      exit_scope();
+    }
+    expect(Token::right_brace);
+    return node_list(NodeKind::block, start, list);
+  }
+
+  NodeIndex parse_empty_statement() {
+    auto start = read().start;
+    return node(NodeKind::empty_statement, start);
+  }
+
+  NodeIndex parse_expression_statement() {
+    auto start = peek_start();
+    NodeIndex expression = parse_expression();
+    if (_ast[expression].kind == NodeKind::identifier && peek(Context::div) == Token::colon) {
+      read();
+      push_label(expression);
+      NodeIndex statement = parse_statement_or_sloppy_function();
+      _labels.pop_back();
+      return node(NodeKind::labelled_statement, start, {expression, statement});
+    }
+    semicolon();
+    return node(NodeKind::expression_statement, start, {expression});
+  }
+
+  // An unlabelled "break" is allowed only within iteration and switch
+  // statements, so labels are tracked apart from the breakable depth
+  void push_label(NodeIndex name) {
+    SourceSpan span = this->span(name);
+    if (find_label(span)) {
+      fail(Error::duplicate_label, name);
+    }
+    Label label {span, peek_start(), false};
+    switch (peek()) {
+      case Token::kw_for:
+      case Token::kw_while:
+      case Token::kw_do:
+        label.iteration = true;
+        // The labels before this one in "a: b: while (x);" label the loop
+        for (size_t i = _labels.size(); i > _function.label_base; --i) {
+          Label& outer = _labels[i - 1];
+          if (outer.body_start != span.start) {
+            break;
+          }
+          outer.iteration = true;
+          span = outer.name;
+        }
+        break;
+      default:
+        break;
+    }
+    _labels.push_back(label);
+  }
+
+  const Label* find_label(SourceSpan name) const {
+    for (size_t i = _labels.size(); i > _function.label_base; --i) {
+      const Label& label = _labels[i - 1];
+      if (source_equals(label.name.start, label.name.end, name)) {
+        return &label;
+      }
+    }
+    return nullptr;
+  }
+
+  NodeIndex parse_variable_declaration(bool no_in, bool for_init) {
+    auto kind = read();
+    Token op = kind.token == Token::identifier ? kind.keyword : kind.token;
+    NodeList list;
+    while (true) {
+      auto start = peek_start();
+      NodeIndex target = parse_binding_target();
+      for_each_bound_name(target, [&](NodeIndex name) {
+        if (op == Token::kw_var) {
+          declare_var(name);
+        } else {
+          declare_lexical(name, Binding::lexical);
+        }
+      });
+      target = drop_identifier(target);
+      NodeIndex init = no_node;
+      if (peek(Context::div) == Token::assign) {
+        read();
+        init = parse_assignment(no_in);
+        check_cover_init();
+      }
+      NodeIndex declarator = node(NodeKind::variable_declarator, start, {target, init});
+      if (init) {
+        _ast[declarator].flags |= flag_has_init;
+      } else if (!for_init) {
+        check_initializer(op, declarator);
+      }
+      _ast.append(list, declarator);
+      if (peek(Context::div) != Token::comma) {
+        break;
+      }
+      read();
+    }
+    if (!for_init) {
+      semicolon();
+    }
+    NodeIndex declaration = node_list(NodeKind::variable_declaration, kind.start, list);
+    _ast[declaration].set_op(op);
+    return declaration;
+  }
+
+  // Constants and patterns must be initialized, except in the head of a
+  // for-in or for-of loop
+  void check_initializer(Token op, NodeIndex declarator) {
+    if (op == Token::kw_const || _ast.last_child(declarator)) {
+      fail(Error::missing_initializer, declarator);
+    }
+  }
+
+  void check_initializers(NodeIndex declaration) {
+    for (
+      NodeIndex declarator = _ast.last_child(declaration);
+      declarator;
+      declarator = _ast.previous_sibling(declaration, declarator)
+    ) {
+      if (!_ast[declarator].has_flag(flag_has_init)) {
+        check_initializer(_ast[declaration].op(), declarator);
+      }
+    }
+  }
+
+  NodeIndex parse_if() {
+    auto start = read().start;
+    expect(Token::left_paren);
+    NodeIndex test = parse_expression();
+    expect(Token::right_paren, Context::div);
+    NodeIndex consequent = parse_statement_or_sloppy_function();
+    NodeIndex alternate = no_node;
+    if (peek() == Token::kw_else) {
+      read();
+      alternate = parse_statement_or_sloppy_function();
+    }
+    return node(NodeKind::if_statement, start, {test, consequent, alternate});
+  }
+
+  NodeIndex parse_loop_body() {
+    ++_function.loop_depth;
+    ++_function.breakable_depth;
+    NodeIndex body = parse_statement();
+    --_function.loop_depth;
+    --_function.breakable_depth;
+    return body;
+  }
+
+  // The declarations in the head of a for statement are scoped to it
+  NodeIndex parse_for() {
+    enter_scope(peek_start(), false);
+    NodeIndex result = parse_for_statement();
+    exit_scope();
+    return result;
+  }
+
+  NodeIndex parse_for_statement() {
+    auto start = read().start;
+    uint16 flags = flag_none;
+    if (_function.is_async && peek_keyword(Token::kw_await)) {
+      read();
+      flags |= flag_async;
+    }
+    expect(Token::left_paren);
+
+    NodeIndex init = no_node;
+    if (peek() == Token::semicolon) {
+      // No initializer
+    } else if (
+      peek() == Token::kw_var ||
+      peek() == Token::kw_const ||
+      peek() == Token::kw_let ||
+      is_let_declaration()
+    ) {
+      init = parse_variable_declaration(true, true);
+    } else {
+      init = parse_sequence(true);
+    }
+
+    NodeKind kind = NodeKind::for_statement;
+    if (peek(Context::div) == Token::kw_in) {
+      kind = NodeKind::for_in_statement;
+    } else if (peek_keyword(Token::kw_of, Context::div)) {
+      kind = NodeKind::for_of_statement;
+    }
+
+    // "for await" takes only an "of" head
+    if ((flags & flag_async) && kind != NodeKind::for_of_statement) {
+      unexpected();
+    }
+
+    if (kind != NodeKind::for_statement) {
+      if (_ast[init].kind != NodeKind::variable_declaration) {
+        to_pattern(init, false);
+      } else if (_ast.child_count(init) != 1) {
+        unexpected();
+      } else {
+        // Only a sloppy mode "var" binding of a for-in loop may have an
+        // initializer (Annex B)
+        NodeIndex declarator = _ast.last_child(init);
+        if (_ast[declarator].has_flag(flag_has_init) && (
+          kind == NodeKind::for_of_statement ||
+          _strict_mode ||
+          _ast[init].op() != Token::kw_var ||
+          _ast.child_count(declarator) != 1
+        )) {
+          fail(Error::invalid_for_initializer, declarator);
+        }
+      }
+      read();
+      NodeIndex right = kind == NodeKind::for_of_statement
+        ? parse_assignment(false)
+        : parse_expression();
+      expect(Token::right_paren, Context::div);
+      NodeIndex body = parse_loop_body();
+      NodeIndex result = node(kind, start, {init, right, body});
+      _ast[result].flags = flags;
+      return result;
+    }
+
+    if (init) {
+      flags |= flag_has_init;
+      if (_ast[init].kind != NodeKind::variable_declaration) {
+        check_cover_init();
+      } else {
+        check_initializers(init);
+      }
+    }
+    expect(Token::semicolon, Context::div);
+    NodeIndex test = no_node;
+    if (peek() != Token::semicolon) {
+      test = parse_expression();
+      flags |= flag_has_test;
+    }
+    expect(Token::semicolon, Context::div);
+    NodeIndex update = no_node;
+    if (peek() != Token::right_paren) {
+      update = parse_expression();
+      flags |= flag_has_update;
+    }
+    expect(Token::right_paren, Context::div);
+    NodeIndex body = parse_loop_body();
+    NodeIndex result = node(kind, start, {init, test, update, body});
+    _ast[result].flags = flags;
+    return result;
+  }
+
+  NodeIndex parse_while() {
+    auto start = read().start;
+    expect(Token::left_paren);
+    NodeIndex test = parse_expression();
+    expect(Token::right_paren, Context::div);
+    NodeIndex body = parse_loop_body();
+    return node(NodeKind::while_statement, start, {test, body});
+  }
+
+  NodeIndex parse_do_while() {
+    auto start = read().start;
+    NodeIndex body = parse_loop_body();
+    expect(Token::kw_while);
+    expect(Token::left_paren);
+    NodeIndex test = parse_expression();
+    expect(Token::right_paren, Context::div);
+    if (peek(Context::div) == Token::semicolon) {
+      read();
+    }
+    return node(NodeKind::do_while_statement, start, {body, test});
+  }
+
+  NodeIndex parse_jump_label() {
+    if (peek(Context::div) == Token::identifier && !_peek.newline_before) {
+      return parse_identifier();
+    }
+    return no_node;
+  }
+
+  NodeIndex parse_continue() {
+    auto start = read().start;
+    NodeIndex label = parse_jump_label();
+    if (label) {
+      const Label* target = find_label(span(label));
+      if (!target) {
+        fail(Error::undefined_label, label);
+      } else if (!target->iteration) {
+        fail(Error::invalid_continue, start, _last_end);
+      }
+    }
+    if (_function.loop_depth == 0) {
+      fail(Error::invalid_continue, start, _last_end);
+    }
+    semicolon();
+    return label
+      ? node(NodeKind::continue_statement, start, {label})
+      : node(NodeKind::continue_statement, start);
+  }
+
+  NodeIndex parse_break() {
+    auto start = read().start;
+    NodeIndex label = parse_jump_label();
+    if (label) {
+      if (!find_label(span(label))) {
+        fail(Error::undefined_label, label);
+      }
+    } else if (_function.breakable_depth == 0) {
+      fail(Error::invalid_break, start, _last_end);
+    }
+    semicolon();
+    return label
+      ? node(NodeKind::break_statement, start, {label})
+      : node(NodeKind::break_statement, start);
+  }
+
+  NodeIndex parse_return() {
+    auto start = read().start;
+    if (!_function.in_function) {
+      fail(Error::invalid_return, start, _last_end);
+    }
+    NodeIndex argument = no_node;
+    if (
+      Token t = peek();
+      t != Token::semicolon &&
+      t != Token::right_brace &&
+      t != Token::end &&
+      !_peek.newline_before
+    ) {
+      argument = parse_expression();
+    }
+    semicolon();
+    return argument
+      ? node(NodeKind::return_statement, start, {argument})
+      : node(NodeKind::return_statement, start);
+  }
+
+  NodeIndex parse_with() {
+    auto start = read().start;
+    if (_strict_mode) {
+      fail(Error::invalid_with, start, _last_end);
+    }
+    expect(Token::left_paren);
+    NodeIndex object = parse_expression();
+    expect(Token::right_paren, Context::div);
+    NodeIndex body = parse_statement();
+    return node(NodeKind::with_statement, start, {object, body});
+  }
+
+  NodeIndex parse_switch() {
+    auto start = read().start;
+    expect(Token::left_paren);
+    NodeIndex discriminant = parse_expression();
+    expect(Token::right_paren, Context::div);
+    enter_scope(expect(Token::left_brace).start, false);
+
+    NodeList list;
+    _ast.append(list, discriminant);
+    ++_function.breakable_depth;
+    bool has_default = false;
+    while (more(Token::right_brace)) {
+      auto case_start = peek_start();
+      NodeList statements;
+      uint16 flags = flag_none;
+      if (peek() == Token::kw_case) {
+        read();
+        _ast.append(statements, parse_expression());
+        flags |= flag_has_test;
+      } else {
+        auto default_start = expect(Token::kw_default).start;
+        if (has_default) {
+          fail(Error::duplicate_default, default_start, _last_end);
+        }
+        has_default = true;
+      }
+      expect(Token::colon, Context::div);
+      while (true) {
+        Token t = peek();
+        if (
+          t == Token::kw_case ||
+          t == Token::kw_default ||
+          t == Token::right_brace ||
+          t == Token::end
+        ) {
+          break;
+        }
+        _ast.append(statements, parse_statement_list_item());
+      }
+      NodeIndex switch_case = node_list(NodeKind::switch_case, case_start, statements);
+      _ast[switch_case].flags = flags;
+      _ast.append(list, switch_case);
+    }
+    --_function.breakable_depth;
+    exit_scope();
+    expect(Token::right_brace);
+    return node_list(NodeKind::switch_statement, start, list);
+  }
+
+  NodeIndex parse_throw() {
+    auto start = read().start;
+    if (peek(); _peek.newline_before) {
+      fail(Error::newline_after_throw, start, _last_end);
+    }
+    NodeIndex argument = parse_expression();
+    semicolon();
+    return node(NodeKind::throw_statement, start, {argument});
+  }
+
+  NodeIndex parse_try() {
+    auto start = read().start;
+    NodeIndex block = parse_block();
+    NodeIndex handler = no_node;
+    NodeIndex finalizer = no_node;
+    if (peek() == Token::kw_catch) {
+      auto catch_start = read().start;
+      enter_scope(catch_start, false);
+      NodeIndex param = no_node;
+      if (peek() == Token::left_paren) {
+        read();
+        param = parse_binding_target();
+        // A "var" in the block may redeclare a simple parameter (Annex B)
+        Binding kind = _ast[param].kind == NodeKind::identifier ? Binding::catch_parameter : Binding::lexical;
+        for_each_bound_name(param, [&](NodeIndex name) { declare_lexical(name, kind); });
+        expect(Token::right_paren);
+      }
+      NodeIndex body = parse_block(false);
+      exit_scope();
+      handler = node(NodeKind::catch_clause, catch_start, {param, body});
+    }
+    if (peek() == Token::kw_finally) {
+      read();
+      finalizer = parse_block();
+    }
+    if (!handler && !finalizer) {
+      fail(Error::missing_catch_or_finally, start, _last_end);
+    }
+    return node(NodeKind::try_statement, start, {block, handler, finalizer});
+  }
+
+  NodeIndex parse_debugger() {
+    auto start = read().start;
+    semicolon();
+    return node(NodeKind::debugger_statement, start);
+  }
+
+  // Functions and classes
+
+  NodeIndex parse_async_function(bool expression) {
+    auto start = read().start;
+    return parse_function(expression, start, flag_async);
+  }
+
+  NodeIndex parse_function(bool expression, SourcePosition start, uint16 flags) {
+    bool default_export = _default_export;
+    _default_export = false;
+    expect(Token::kw_function);
+    if (peek() == Token::multiply) {
+      read();
+      flags |= flag_generator;
+    }
+
+    NodeIndex name = no_node;
+    if (peek() == Token::identifier) {
+      name = parse_binding_identifier();
+      if (!expression) {
+        declare_function(name);
+      }
+    } else if (!expression && !default_export) {
+      unexpected();
+      name = none();
+    }
+
+    FunctionState saved = enter_function(flags);
+    NodeIndex params = parse_formal_parameters();
+    NodeIndex body = parse_function_body(params);
+    _function = saved;
+
+    NodeIndex result = node(
+      expression ? NodeKind::function_expression : NodeKind::function_declaration,
+      start,
+      {name, params, body});
+    _ast[result].flags = flags;
+    return result;
+  }
+
+  FunctionState enter_function(uint16 flags) {
+    FunctionState saved = _function;
+    _function = {};
+    _function.in_function = true;
+    _function.new_target = true;
+    _function.label_base = uint32(_labels.size());
+    _function.is_async = (flags & flag_async) != 0;
+    _function.is_generator = (flags & flag_generator) != 0;
+    return saved;
+  }
+
+  NodeIndex parse_formal_parameters() {
+    auto start = expect(Token::left_paren).start;
+    NodeList list;
+    while (more(Token::right_paren)) {
+      if (peek() == Token::dot_3) {
+        _ast.append(list, parse_rest_element());
+        break;
+      }
+      _ast.append(list, parse_binding_element());
+      if (peek(Context::div) != Token::right_paren) {
+        expect(Token::comma, Context::div);
+      }
+    }
+    expect(Token::right_paren, Context::div);
+    return node_list(NodeKind::formal_parameters, start, list);
+  }
+
+  NodeIndex parse_function_body(NodeIndex params) {
+    if (_lazy_functions) {
+      return skip_function_body(params);
+    }
+    bool strict_mode = _strict_mode;
+    auto start = expect(Token::left_brace).start;
+    enter_function_scope(params);
+    NodeList list;
+    if (parse_directives(list)) {
+      check_strict_parameters(params);
+    }
+    bool strict_body = _strict_mode && !strict_mode;
+    while (more(Token::right_brace)) {
+      _ast.append(list, parse_statement_list_item());
+    }
+    exit_scope();
+    if (strict_body) {
+      set_strict(strict_mode);
+    }
+    expect(Token::right_brace);
+    NodeIndex body = node_list(NodeKind::function_body, start, list);
+    if (strict_body) {
+      _ast[body].flags |= flag_strict;
+    }
+    return body;
+  }
+
+  // Lazy function bodies
+
+  // Hashes and compares identifier spans by their source text
+  struct SpanText {
+    T begin;
+
+    size_t operator()(const SourceSpan& span) const {
+      uint64 h = 0xcbf29ce484222325;
+      for (auto i = std::next(begin, span.start), last = std::next(begin, span.end); i != last; ++i) {
+        h = (h ^ uint32(*i)) * 0x100000001b3;
+      }
+      return size_t(h);
+    }
+
+    bool operator()(const SourceSpan& a, const SourceSpan& b) const {
+      return
+        a.end - a.start == b.end - b.start &&
+        std::equal(std::next(begin, a.start), std::next(begin, a.end), std::next(begin, b.start));
+    }
+  };
+
+  using SpanSet = std::unordered_set<SourceSpan, SpanText, SpanText>;
+  using SpanMap = std::unordered_map<SourceSpan, uint32, SpanText, SpanText>;
+
+  enum class Binding : uint8 {
+    lexical,
+    function,
+    var,
+    catch_parameter,
+  };
+
+  static constexpr uint32 no_declaration = ~0u;
+
+  // A declared name and the previous declaration of the same name
+  struct Declaration {
+    SourceSpan name;
+    uint32 previous {no_declaration};
+    uint32 scope {0};
+    Binding kind {Binding::lexical};
+  };
+
+  // The scope of a function, block, for statement, switch or catch clause.
+  // Block scopes share the var declarations of their function.
+  struct Scope {
+    SourcePosition start {0};
+    uint32 lexical_first {0};
+    uint32 var_first {0};
+    uint32 function_scope {0};
+  };
+
+  NodeIndex skip_function_body(NodeIndex params) {
+    auto start = expect(Token::left_brace).start;
+    if (_error != Error::none) {
+      return none();
+    }
+
+    LazyFunction lazy;
+    lazy.function_flags =
+      (_function.is_async ? flag_async : flag_none) |
+      (_function.is_generator ? flag_generator : flag_none);
+    lazy.strict = _strict_mode;
+    lazy.new_target = _function.new_target;
+    lazy.super_property = _function.super_property;
+    lazy.super_call = _function.super_call;
+    lazy.params = params;
+    lazy.free_begin = uint32(_ast.free_variables.size());
+
+    _declared.clear();
+    for_each_bound_name(params, [&](NodeIndex name) {
+      _declared.insert(span(name));
+    });
+    if (!skip_tokens(lazy)) {
+      return none();
+    }
+
+    // Remove declared names and duplicates from the references
+    auto& free = _ast.free_variables;
+    uint32 count = lazy.free_begin;
+    _referenced.clear();
+    for (uint32 i = lazy.free_begin; i < free.size(); ++i) {
+      SourceSpan span = free[i];
+      if (!_declared.contains(span) && _referenced.insert(span).second) {
+        free[count++] = span;
+      }
+    }
+    free.resize(count);
+    lazy.free_end = count;
+
+    NodeIndex body = _ast.make(NodeKind::function_body, start);
+    _ast[body].flags |= flag_lazy;
+    lazy.body = body;
+    _ast.lazy_functions.push_back(lazy);
+    return body;
+  }
+
+  // A function body opened by a skipped scan, and whether "await" is a
+  // keyword within it
+  struct SkippedBody {
+    uint32 depth;
+    bool is_async;
+  };
+
+  // True if "function" or "class" following the token in a skipped body
+  // begins a declaration rather than an expression
+  static bool starts_declaration(Token previous) {
+    switch (previous) {
+      case Token::left_brace:
+      case Token::right_brace:
+      case Token::semicolon:
+        return true;
+      default:
+        return false;
+    }
+  }
+
+  // Scans up to and including the brace which closes the current function
+  // body, collecting identifier references and simple declarations. Nested
+  // function bodies are tracked so that "await" is not taken as a reference
+  // within async functions. A "{" after the parentheses of a call or
+  // parameter list, or after "=>", is taken as a function body; a block such
+  // as that of a catch clause may be mistaken for one, which can only add
+  // references.
+  bool skip_tokens(LazyFunction& lazy) {
+    Tokenizer<T> tokenizer {_scanner};
+    Token previous = Token::left_brace;
+    bool binding = false;
+    bool declaring = false;
+    bool pending = false;
+    Token pending_after = Token::end;
+    Token pending_keyword = Token::error;
+    SourceSpan pending_span;
+    bool async_statement = false;
+    bool async_pending = false;
+    _skipped_bodies.clear();
+
+    while (true) {
+      uint32 depth = tokenizer.depth();
+      bool after_operand = !tokenizer.regexp_allowed();
+      Token t;
+      while ((t = tokenizer.next()) == Token::comment);
+      const Result& r = tokenizer.result();
+      bool top_level = tokenizer.depth() == 0;
+
+      if (pending) {
+        // An identifier followed by a colon after "{" or "," is a property
+        // name or label rather than a reference, and "async" followed by
+        // "function" or a name on the same line is a modifier
+        bool property_name =
+          t == Token::colon &&
+          (pending_after == Token::left_brace || pending_after == Token::comma);
+        bool modifier =
+          pending_keyword == Token::kw_async &&
+          !r.newline_before &&
+          (t == Token::kw_function || t == Token::identifier);
+        if (!property_name && !modifier) {
+          _ast.free_variables.push_back(pending_span);
+        }
+        pending = false;
+      }
+
+      if (
+        declaring && top_level && r.newline_before && after_operand &&
+        t != Token::comma && previous != Token::comma
+      ) {
+        declaring = false;
+      }
+
+      bool binding_next = false;
+      switch (t) {
+        case Token::end:
+          _peek = r;
+          unexpected();
+          return false;
+
+        case Token::error:
+          _peek = r;
+          fail_token();
+          return false;
+
+        case Token::left_brace:
+          if ((previous == Token::right_paren && after_operand) || previous == Token::fat_arrow) {
+            _skipped_bodies.push_back({tokenizer.depth(), async_pending});
+          }
+          async_pending = false;
+          break;
+
+        case Token::right_brace:
+          if (depth == 0) {
+            _scanner = tokenizer.scanner();
+            _last_end = r.end;
+            return true;
+          }
+          if (!_skipped_bodies.empty() && _skipped_bodies.back().depth == depth) {
+            _skipped_bodies.pop_back();
+          }
+          break;
+
+        case Token::semicolon:
+          if (top_level) {
+            declaring = false;
+          }
+          async_pending = false;
+          break;
+
+        case Token::comma:
+          binding_next = declaring && top_level;
+          break;
+
+        case Token::kw_var:
+        case Token::kw_let:
+        case Token::kw_const:
+          declaring = top_level;
+          binding_next = declaring;
+          break;
+
+        case Token::kw_function:
+          // The name of a function expression is bound only within it
+          binding_next = top_level && (
+            previous == Token::identifier ? async_statement : starts_declaration(previous));
+          break;
+
+        case Token::kw_class:
+          binding_next = top_level && starts_declaration(previous);
+          break;
+
+        case Token::multiply:
+          binding_next = binding && previous == Token::kw_function;
+          break;
+
+        case Token::kw_yield:
+          lazy.uses |= lazy_uses_yield;
+          break;
+
+        case Token::identifier:
+          if (r.keyword == Token::kw_await && (_function.is_async || _module)) {
+            lazy.uses |= lazy_uses_await;
+          } else if (r.keyword == Token::kw_await && in_async_body()) {
+            // A keyword within a nested async function
+          } else if (r.keyword == Token::kw_yield && _function.is_generator) {
+            lazy.uses |= lazy_uses_yield;
+          } else if (r.keyword == Token::kw_let && previous != Token::dot) {
+            declaring = top_level;
+            binding_next = declaring;
+          } else if (previous == Token::dot) {
+            // Property access
+          } else if (binding) {
+            _declared.insert({r.start, r.end});
+          } else if (source_equals(r.start, r.end, "arguments")) {
+            lazy.uses |= lazy_uses_arguments;
+          } else {
+            if (source_equals(r.start, r.end, "eval")) {
+              lazy.uses |= lazy_uses_eval;
+            } else if (r.keyword == Token::kw_async) {
+              async_statement = starts_declaration(previous);
+              async_pending = true;
+            }
+            pending = true;
+            pending_after = previous;
+            pending_keyword = r.keyword;
+            pending_span = {r.start, r.end};
+          }
+          break;
+
+        default:
+          break;
+      }
+
+      binding = binding_next;
+      previous = t;
+    }
+  }
+
+  // True if the innermost function body opened by a skipped scan is async
+  bool in_async_body() const {
+    return !_skipped_bodies.empty() && _skipped_bodies.back().is_async;
+  }
+
+  // Calls f with each identifier bound by a parameter list or binding
+  // pattern
+  template<typename F>
+  void for_each_bound_name(NodeIndex pattern, F&& f) {
+    const Node& node = _ast[pattern];
+    switch (node.kind) {
+      case NodeKind::identifier:
+        f(pattern);
+        break;
+
+      case NodeKind::formal_parameters:
+      case NodeKind::array_pattern:
+      case NodeKind::object_pattern:
+        for (NodeIndex child = _ast.last_child(pattern); child; child = _ast.previous_sibling(pattern, child)) {
+          for_each_bound_name(child, f);
+        }
+        break;
+
+      case NodeKind::pattern_default:
+      case NodeKind::rest_element:
+      case NodeKind::shorthand_property:
+        for_each_bound_name(_ast.first_child(pattern), f);
+        break;
+
+      case NodeKind::pattern_property:
+        for_each_bound_name(_ast.last_child(pattern), f);
+        break;
+
+      default:
+        break;
+    }
+  }
+
+  // Scopes
+
+  // Lexical declarations may not redeclare a name within their scope, and
+  // var declarations may not redeclare a lexical name of the scopes which
+  // they are hoisted through. Declarations are kept in a stack for each
+  // kind, with the latest declaration of each name in a map, and are
+  // removed as their scopes close.
+  void enter_scope(SourcePosition start, bool function) {
+    uint32 index = uint32(_scopes.size());
+    Scope scope {start, uint32(_lexical.size()), uint32(_vars.size()), index};
+    if (!function) {
+      scope.var_first = _scopes.back().var_first;
+      scope.function_scope = _scopes.back().function_scope;
+    }
+    _scopes.push_back(scope);
+  }
+
+  void exit_scope() {
+    Scope scope = _scopes.back();
+    _scopes.pop_back();
+    pop_declarations(_lexical, _lexical_heads, scope.lexical_first);
+    if (scope.function_scope == _scopes.size()) {
+      pop_declarations(_vars, _var_heads, scope.var_first);
+    }
+  }
+
+  // Parameters are declared in the scope of the function body
+  void enter_function_scope(NodeIndex params) {
+    enter_scope(_ast.start(params), true);
+    for_each_bound_name(params, [&](NodeIndex name) { declare_var(name); });
+  }
+
+  void pop_declarations(std::vector<Declaration>& stack, SpanMap& heads, uint32 first) {
+    while (stack.size() > first) {
+      const Declaration& declaration = stack.back();
+      auto iter = heads.find(declaration.name);
+      if (declaration.previous == no_declaration) {
+        heads.erase(iter);
+      } else {
+        iter->second = declaration.previous;
+      }
+      stack.pop_back();
+    }
+  }
+
+  void push_declaration(std::vector<Declaration>& stack, SpanMap& heads, Declaration declaration) {
+    uint32 index = uint32(stack.size());
+    auto [iter, inserted] = heads.try_emplace(declaration.name, index);
+    if (!inserted) {
+      declaration.previous = iter->second;
+      iter->second = index;
+    }
+    stack.push_back(declaration);
+  }
+
+  static uint32 latest(const SpanMap& heads, SourceSpan name) {
+    auto iter = heads.find(name);
+    return iter == heads.end() ? no_declaration : iter->second;
+  }
+
+  void declare_lexical(NodeIndex name, Binding kind) {
+    SourceSpan span = this->span(name);
+    uint32 scope_index = uint32(_scopes.size() - 1);
+    const Scope& scope = _scopes.back();
+    if (uint32 i = latest(_lexical_heads, span); i != no_declaration && _lexical[i].scope == scope_index) {
+      // Sloppy blocks may declare a function twice (Annex B)
+      bool block_functions =
+        !_strict_mode &&
+        scope.function_scope != scope_index &&
+        kind == Binding::function &&
+        _lexical[i].kind == Binding::function;
+      if (!block_functions) {
+        return fail(Error::duplicate_declaration, name);
+      }
+    }
+    if (uint32 i = latest(_var_heads, span); i != no_declaration && i >= scope.var_first && _vars[i].name.start >= scope.start) {
+      return fail(Error::duplicate_declaration, name);
+    }
+    push_declaration(_lexical, _lexical_heads, {span, no_declaration, scope_index, kind});
+  }
+
+  void declare_var(NodeIndex name, Binding kind = Binding::var) {
+    SourceSpan span = this->span(name);
+    uint32 function_scope = _scopes.back().function_scope;
+    for (uint32 i = latest(_lexical_heads, span); i != no_declaration && _lexical[i].scope >= function_scope; i = _lexical[i].previous) {
+      if (!(kind == Binding::var && _lexical[i].kind == Binding::catch_parameter)) {
+        return fail(Error::duplicate_declaration, name);
+      }
+    }
+    push_declaration(_vars, _var_heads, {span, no_declaration, function_scope, kind});
+  }
+
+  // Function declarations are var declarations at the top level of a function
+  // or script, and lexical declarations in blocks and at the top level of a
+  // module
+  void declare_function(NodeIndex name) {
+    const Scope& scope = _scopes.back();
+    bool top_level = scope.function_scope == _scopes.size() - 1;
+    if (top_level && !(_module && _scopes.size() == 1)) {
+      declare_var(name, Binding::function);
+    } else {
+      declare_lexical(name, Binding::function);
+    }
+  }
+
+  // "use strict" is not allowed in a function whose parameters are not all
+  // plain identifiers
+  void check_strict_parameters(NodeIndex params) {
+    for (NodeIndex param = _ast.last_child(params); param; param = _ast.previous_sibling(params, param)) {
+      if (_ast[param].kind != NodeKind::identifier) {
+        return fail(Error::invalid_strict_directive, params);
+      }
+    }
+  }
+
+  NodeIndex parse_arrow_function(NodeIndex left, SourcePosition start, bool no_in) {
+    if (_peek.newline_before) {
+      unexpected();
+    }
+    read();
+
+    // The parameters are the subtrees parsed within the parentheses, and the
+    // nodes around them are removed
+    uint16 flags = flag_none;
+    SourcePosition params_start = _ast.start(left);
+    NodeIndex first = no_node;
+    switch (_ast[left].kind) {
+      case NodeKind::identifier:
+        check_binding_identifier(left);
+        first = left;
+        break;
+
+      case NodeKind::paren_expression: {
+        NodeIndex inner = _ast.last_child(left);
+        _ast.truncate(left);
+        if (!inner) {
+          // No parameters
+        } else if (_ast[inner].kind == NodeKind::sequence_expression) {
+          first = _ast.first_child(inner);
+          _ast.truncate(inner);
+        } else {
+          first = inner;
+        }
+        break;
+      }
+
+      case NodeKind::call_expression:
+        if (_ast[left].has_flag(flag_async)) {
+          flags |= flag_async;
+          NodeIndex callee = _ast.subtree_begin(left);
+          NodeIndex argument = _ast.child(left, 1);
+          _ast.truncate(left);
+          _ast.remove(callee);
+          first = argument ? argument - 1 : no_node;
+          break;
+        }
+        fail(Error::invalid_assignment_target, left);
+        first = left;
+        break;
+
+      default:
+        fail(Error::invalid_assignment_target, left);
+        first = left;
+        break;
+    }
+
+    if (first) {
+      NodeIndex last = _ast.node_count();
+      for (NodeIndex param = last; param >= first; param -= _ast.size(param)) {
+        if (_ast[param].kind == NodeKind::spread && param == last) {
+          _ast[param].kind = NodeKind::rest_element;
+        }
+        to_pattern(param, true);
+      }
+    }
+
+    NodeIndex params = _ast.make(NodeKind::formal_parameters, params_start, first);
+    return parse_arrow_body(params, start, flags, no_in);
+  }
+
+  NodeIndex parse_arrow_body(NodeIndex params, SourcePosition start, uint16 flags, bool no_in) {
+    FunctionState saved = enter_function(flags);
+    _function.new_target = saved.new_target;
+    _function.super_property = saved.super_property;
+    _function.super_call = saved.super_call;
+    NodeIndex body = no_node;
+    if (peek() == Token::left_brace) {
+      body = parse_function_body(params);
+    } else {
+      body = parse_assignment(no_in);
+      flags |= flag_expression_body;
+    }
+    _function = saved;
+    NodeIndex result = node(NodeKind::arrow_function, start, {params, body});
+    _ast[result].flags = flags;
+    return result;
+  }
+
+  NodeIndex parse_class(bool expression) {
+    bool default_export = _default_export;
+    _default_export = false;
+    bool strict_mode = _strict_mode;
+    set_strict(true);
+    auto start = expect(Token::kw_class).start;
+
+    NodeIndex name = no_node;
+    if (peek() == Token::identifier) {
+      name = parse_binding_identifier();
+      if (!expression) {
+        declare_lexical(name, Binding::lexical);
+      }
+    } else if (!expression && !default_export) {
+      unexpected();
+      name = none();
+    }
+
+    NodeIndex heritage = no_node;
+    if (peek() == Token::kw_extends) {
+      read();
+      heritage = parse_member_expression(true);
+    }
+
+    bool derived_class = _derived_class;
+    _derived_class = heritage != no_node;
+    auto body_start = expect(Token::left_brace).start;
+    NodeList list;
+    while (more(Token::right_brace)) {
+      if (peek() == Token::semicolon) {
+        read();
+        continue;
+      }
+      _ast.append(list, parse_class_element());
+    }
+    _derived_class = derived_class;
+    set_strict(strict_mode);
+    expect(Token::right_brace);
+    NodeIndex body = node_list(NodeKind::class_body, body_start, list);
+
+    NodeIndex result = node(
+      expression ? NodeKind::class_expression : NodeKind::class_declaration,
+      start,
+      {name, heritage, body});
+    if (heritage) {
+      _ast[result].flags |= flag_has_heritage;
+    }
+    return result;
+  }
+
+  NodeIndex parse_class_element() {
+    auto start = peek_start();
+    uint16 flags = flag_none;
+    if (peek_keyword(Token::kw_static) && is_method_modifier()) {
+      read();
+      flags |= flag_static;
+    }
+    flags |= parse_method_modifiers();
+    NodeIndex name = parse_property_name();
+    if (
+      !(flags & flag_static) &&
+      _ast[name].kind == NodeKind::identifier &&
+      source_equals(name, "constructor")
+    ) {
+      flags |= flag_constructor;
+    }
+    return parse_method(name, start, flags);
+  }
+
+  // True if the current identifier is followed by a property name, rather
+  // than being a property name itself
+  bool is_method_modifier() {
+    auto next = peek_next();
+    switch (next.token) {
+      case Token::left_paren:
+      case Token::right_brace:
+      case Token::comma:
+      case Token::colon:
+      case Token::assign:
+      case Token::semicolon:
+      case Token::end:
+        return false;
+      default:
+        return true;
+    }
+  }
+
+  uint16 parse_method_modifiers() {
+    uint16 flags = flag_none;
+    if (peek_keyword(Token::kw_async) && is_method_modifier() && !peek_next().newline_before) {
+      read();
+      flags |= flag_async;
+    }
+    if (peek() == Token::multiply) {
+      read();
+      flags |= flag_generator;
+    } else if (!flags && peek() == Token::identifier && is_method_modifier()) {
+      if (source_equals(_peek.start, _peek.end, "get")) {
+        read();
+        flags |= flag_getter;
+      } else if (source_equals(_peek.start, _peek.end, "set")) {
+        read();
+        flags |= flag_setter;
+      }
+    }
+    return flags;
+  }
+
+  NodeIndex parse_method(NodeIndex name, SourcePosition start, uint16 flags) {
+    FunctionState saved = enter_function(flags);
+    _function.super_property = true;
+    _function.super_call = (flags & flag_constructor) && _derived_class;
+    NodeIndex params = parse_formal_parameters();
+    NodeIndex body = parse_function_body(params);
+    _function = saved;
+    NodeIndex result = node(NodeKind::method_definition, start, {name, params, body});
+    _ast[result].flags = flags;
+    return result;
+  }
+
+  // Modules
+
+  NodeIndex parse_import_declaration() {
+    auto start = read().start;
+    NodeList list;
+    if (peek() != Token::string) {
+      if (peek() == Token::identifier) {
+        NodeIndex local = parse_binding_identifier();
+        declare_lexical(local, Binding::lexical);
+        _ast.append(list, local);
+        if (peek(Context::div) == Token::comma) {
+          read();
+        }
+      }
+      if (peek() == Token::multiply) {
+        read();
+        expect_keyword(Token::kw_as);
+        NodeIndex local = parse_binding_identifier();
+        declare_lexical(local, Binding::lexical);
+        _ast[local].kind = NodeKind::import_namespace;
+        _ast.append(list, local);
+      } else if (peek() == Token::left_brace) {
+        read();
+        while (more(Token::right_brace)) {
+          auto specifier_start = peek_start();
+          NodeIndex imported = parse_identifier_name();
+          NodeIndex local = no_node;
+          if (peek_keyword(Token::kw_as, Context::div)) {
+            read();
+            local = parse_binding_identifier();
+            declare_lexical(local, Binding::lexical);
+          } else {
+            check_binding_identifier(imported);
+            declare_lexical(imported, Binding::lexical);
+          }
+          _ast.append(list, node(NodeKind::import_specifier, specifier_start, {imported, local}));
+          if (peek(Context::div) != Token::right_brace) {
+            expect(Token::comma, Context::div);
+          }
+        }
+        expect(Token::right_brace, Context::div);
+      }
+      expect_keyword(Token::kw_from);
+    }
+    _ast.append(list, parse_string());
+    semicolon();
+    return node_list(NodeKind::import_declaration, start, list);
+  }
+
+  NodeIndex parse_export_declaration() {
+    auto start = read().start;
+    switch (peek()) {
+      case Token::multiply: {
+        read();
+        NodeList list;
+        if (peek_keyword(Token::kw_as, Context::div)) {
+          read();
+          _ast.append(list, parse_identifier_name());
+        }
+        expect_keyword(Token::kw_from);
+        _ast.append(list, parse_string());
+        semicolon();
+        return node_list(NodeKind::export_all, start, list);
+      }
+
+      case Token::left_brace: {
+        read();
+        NodeList list;
+        while (more(Token::right_brace)) {
+          auto specifier_start = peek_start();
+          NodeIndex local = parse_identifier_name();
+          NodeIndex exported = no_node;
+          if (peek_keyword(Token::kw_as, Context::div)) {
+            read();
+            exported = parse_identifier_name();
+          }
+          _ast.append(list, node(NodeKind::export_specifier, specifier_start, {local, exported}));
+          if (peek(Context::div) != Token::right_brace) {
+            expect(Token::comma, Context::div);
+          }
+        }
+        expect(Token::right_brace, Context::div);
+        if (peek_keyword(Token::kw_from, Context::div)) {
+          read();
+          _ast.append(list, parse_string());
+        }
+        semicolon();
+        return node_list(NodeKind::export_named, start, list);
+      }
+
+      case Token::kw_default: {
+        read();
+        NodeIndex declaration = no_node;
+        if (peek() == Token::kw_function) {
+          _default_export = true;
+          declaration = parse_function(false, peek_start(), flag_none);
+        } else if (is_async_function()) {
+          _default_export = true;
+          declaration = parse_async_function(false);
+        } else if (peek() == Token::kw_class) {
+          _default_export = true;
+          declaration = parse_class(false);
+        } else {
+          declaration = parse_assignment(false);
+          check_cover_init();
+          semicolon();
+        }
+        return node(NodeKind::export_default, start, {declaration});
+      }
+
+      case Token::kw_var:
+      case Token::kw_let:
+      case Token::kw_const:
+        return node(NodeKind::export_declaration, start, {
+          parse_variable_declaration(false, false),
+        });
+
+      case Token::kw_function:
+        return node(NodeKind::export_declaration, start, {
+          parse_function(false, peek_start(), flag_none),
+        });
+
+      case Token::kw_class:
+        return node(NodeKind::export_declaration, start, {
+          parse_class(false),
+        });
+
+      default:
+        if (is_async_function()) {
+          return node(NodeKind::export_declaration, start, {
+            parse_async_function(false),
+          });
+        }
+        unexpected();
+        return node(NodeKind::export_declaration, start, {none()});
+    }
+  }
+
+  // Expressions
+
+  NodeIndex parse_expression(bool no_in = false) {
+    NodeIndex expression = parse_sequence(no_in);
+    check_cover_init();
+    return expression;
+  }
+
+  NodeIndex parse_sequence(bool no_in) {
+    auto start = peek_start();
+    NodeIndex expression = parse_assignment(no_in);
+    if (peek(Context::div) != Token::comma) {
+      return expression;
+    }
+    NodeList list;
+    _ast.append(list, expression);
+    while (peek(Context::div) == Token::comma) {
+      read();
+      _ast.append(list, parse_assignment(no_in));
+    }
+    return node_list(NodeKind::sequence_expression, start, list);
+  }
+
+  NodeIndex parse_assignment(bool no_in) {
+    if (_function.is_generator && peek_keyword(Token::kw_yield)) {
+      return parse_yield(no_in);
+    }
+
+    auto start = peek_start();
+
+    if (peek_keyword(Token::kw_async)) {
+      if (
+        auto next = peek_next();
+        next.token == Token::identifier && !next.newline_before
+      ) {
+        read();
+        NodeIndex param = parse_binding_identifier();
+        if (peek(Context::div) != Token::fat_arrow) {
+          unexpected();
+        }
+        read();
+        NodeIndex params = node(NodeKind::formal_parameters, _ast.start(param), {param});
+        return parse_arrow_body(params, start, flag_async, no_in);
+      }
+    }
+
+    NodeIndex left = parse_conditional(no_in);
+    Token op = peek(Context::div);
+
+    if (op == Token::fat_arrow) {
+      return parse_arrow_function(left, start, no_in);
+    }
+
+    if (!is_assignment_operator(op)) {
+      return left;
+    }
+
+    if (op == Token::assign) {
+      to_pattern(left, false);
+    } else {
+      check_simple_target(left);
+    }
+
+    read();
+    NodeIndex right = parse_assignment(no_in);
+    NodeIndex result = node(NodeKind::assignment_expression, start, {left, right});
+    _ast[result].set_op(op);
+    return result;
+  }
+
+  NodeIndex parse_yield(bool no_in) {
+    auto start = read().start;
+    uint16 flags = flag_none;
+    NodeIndex argument = no_node;
+    if (peek() == Token::multiply && !_peek.newline_before) {
+      read();
+      flags |= flag_delegate;
+      argument = parse_assignment(no_in);
+    } else if (!_peek.newline_before) {
+      switch (peek()) {
+        case Token::right_paren:
+        case Token::right_bracket:
+        case Token::right_brace:
+        case Token::comma:
+        case Token::semicolon:
+        case Token::colon:
+        case Token::end:
+          break;
+        default:
+          if (!(no_in && _peek.token == Token::kw_in)) {
+            argument = parse_assignment(no_in);
+          }
+          break;
+      }
+    }
+    NodeIndex result = argument
+      ? node(NodeKind::yield_expression, start, {argument})
+      : node(NodeKind::yield_expression, start);
+    _ast[result].flags = flags;
+    return result;
+  }
+
+  NodeIndex parse_conditional(bool no_in) {
+    auto start = peek_start();
+    NodeIndex test = parse_binary(0, no_in);
+    if (peek(Context::div) != Token::question) {
+      return test;
+    }
+    read();
+    NodeIndex consequent = parse_assignment(false);
+    expect(Token::colon, Context::div);
+    NodeIndex alternate = parse_assignment(no_in);
+    return node(NodeKind::conditional_expression, start, {test, consequent, alternate});
+  }
+
+  NodeIndex parse_binary(int min_precedence, bool no_in) {
+    NodeIndex left = parse_unary();
+    while (true) {
+      Token op = peek(Context::div);
+      int precedence = binary_precedence(op, no_in);
+      if (precedence <= min_precedence) {
+        break;
+      }
+      if (op == Token::pow && (_ast[left].kind == NodeKind::unary_expression ||
+                               _ast[left].kind == NodeKind::await_expression)) {
+        fail(Error::invalid_exponent_operand, left);
+      }
+      read();
+      // Exponentiation is right-associative
+      NodeIndex right = parse_binary(op == Token::pow ? precedence - 1 : precedence, no_in);
+      left = node(NodeKind::binary_expression, _ast.start(left), {left, right});
+      _ast[left].set_op(op);
+    }
+    return left;
+  }
+
+  NodeIndex parse_unary() {
+    auto start = peek_start();
+    Token op = peek();
+
+    if (is_unary_operator(op)) {
+      read();
+      NodeIndex argument = parse_unary();
+      if (op == Token::kw_delete && _strict_mode && _ast[unparenthesized(argument)].kind == NodeKind::identifier) {
+        fail(Error::invalid_delete, argument);
+      }
+      NodeIndex result = node(NodeKind::unary_expression, start, {argument});
+      _ast[result].set_op(op);
+      return result;
+    }
+
+    if (op == Token::increment || op == Token::decrement) {
+      read();
+      NodeIndex argument = parse_unary();
+      check_simple_target(argument);
+      NodeIndex result = node(NodeKind::update_expression, start, {argument});
+      _ast[result].set_op(op);
+      _ast[result].flags = flag_prefix;
+      return result;
+    }
+
+    if (_function.is_async && peek_keyword(Token::kw_await)) {
+      read();
+      NodeIndex argument = parse_unary();
+      return node(NodeKind::await_expression, start, {argument});
+    }
+
+    NodeIndex expression = parse_member_expression(true);
+    if (
+      op = peek(Context::div);
+      (op == Token::increment || op == Token::decrement) && !_peek.newline_before
+    ) {
+      check_simple_target(expression);
+      read();
+      NodeIndex result = node(NodeKind::update_expression, start, {expression});
+      _ast[result].set_op(op);
+      return result;
+    }
+    return expression;
+  }
+
+  NodeIndex parse_member_expression(bool allow_call) {
+    auto start = peek_start();
+    NodeIndex expression = no_node;
+
+    switch (peek()) {
+      case Token::kw_new:
+        expression = parse_new();
+        break;
+
+      case Token::kw_super:
+        expression = parse_super(allow_call);
+        break;
+
+      case Token::kw_import:
+        expression = parse_import_expression();
+        break;
+
+      default:
+        expression = parse_primary();
+        break;
+    }
+
+    while (true) {
+      switch (peek(Context::div)) {
+        case Token::dot: {
+          read();
+          // The property name is not a node of its own
+          SourcePosition property = read_identifier_name().start;
+          expression = node(NodeKind::member_expression, property, {expression});
+          break;
+        }
+
+        case Token::left_bracket: {
+          read();
+          NodeIndex property = parse_expression();
+          expect(Token::right_bracket, Context::div);
+          expression = node(NodeKind::computed_member, start, {expression, property});
+          break;
+        }
+
+        case Token::left_paren: {
+          if (!allow_call) {
+            return expression;
+          }
+          bool async_call =
+            _ast[expression].kind == NodeKind::identifier &&
+            _ast[expression].op() == Token::kw_async &&
+            !_peek.newline_before;
+          NodeList list;
+          _ast.append(list, expression);
+          parse_arguments(list);
+          expression = node_list(NodeKind::call_expression, start, list);
+          if (async_call) {
+            _ast[expression].flags |= flag_async;
+          }
+          break;
+        }
+
+        case Token::template_basic:
+        case Token::template_head: {
+          NodeIndex quasi = parse_template();
+          expression = node(NodeKind::tagged_template, start, {expression, quasi});
+          break;
+        }
+
+        default:
+          return expression;
+      }
+    }
+  }
+
+  // "super" is followed by a property within methods, and by arguments within
+  // the constructors of derived classes
+  NodeIndex parse_super(bool allow_call) {
+    NodeIndex expression = leaf(NodeKind::super_keyword);
+    switch (peek(Context::div)) {
+      case Token::dot:
+      case Token::left_bracket:
+        if (!_function.super_property) {
+          fail(Error::invalid_super, expression);
+        }
+        break;
+      case Token::left_paren:
+        if (!allow_call || !_function.super_call) {
+          fail(Error::invalid_super, expression);
+        }
+        break;
+      default:
+        unexpected();
+        break;
+    }
+    return expression;
+  }
+
+  NodeIndex parse_new() {
+    auto start = read().start;
+    if (peek() == Token::dot) {
+      read();
+      Result name = read_identifier_name();
+      if (!source_equals(name.start, name.end, "target")) {
+        fail(Error::unexpected_token, name.start, name.end);
+      } else if (!_function.new_target) {
+        fail(Error::invalid_new_target, start, _last_end);
+      }
+      return node(NodeKind::new_target, start);
+    }
+    NodeList list;
+    _ast.append(list, parse_member_expression(false));
+    if (peek(Context::div) == Token::left_paren) {
+      parse_arguments(list);
+    }
+    return node_list(NodeKind::new_expression, start, list);
+  }
+
+  NodeIndex parse_import_expression() {
+    auto start = read().start;
+    if (peek(Context::div) == Token::dot) {
+      read();
+      Result name = read_identifier_name();
+      if (!source_equals(name.start, name.end, "meta")) {
+        fail(Error::unexpected_token, name.start, name.end);
+      } else if (!_module) {
+        fail(Error::invalid_import_meta, start, _last_end);
+      }
+      return node(NodeKind::import_meta, start);
+    }
+    expect(Token::left_paren, Context::div);
+    NodeIndex specifier = parse_assignment(false);
+    expect(Token::right_paren, Context::div);
+    return node(NodeKind::import_call, start, {specifier});
+  }
+
+  void parse_arguments(NodeList& list) {
+    expect(Token::left_paren, Context::div);
+    while (more(Token::right_paren)) {
+      if (peek() == Token::dot_3) {
+        auto start = read().start;
+        NodeIndex argument = parse_assignment(false);
+        _ast.append(list, node(NodeKind::spread, start, {argument}));
+      } else {
+        _ast.append(list, parse_assignment(false));
+      }
+      if (peek(Context::div) != Token::right_paren) {
+        expect(Token::comma, Context::div);
+      }
+    }
+    expect(Token::right_paren, Context::div);
+  }
+
+  NodeIndex parse_primary() {
+    switch (peek()) {
+      case Token::kw_function:
+        return parse_function(true, peek_start(), flag_none);
+
+      case Token::kw_class:
+        return parse_class(true);
+
+      case Token::kw_this:
+        return leaf(NodeKind::this_expression);
+
+      case Token::kw_null:
+        return leaf(NodeKind::null_literal);
+
+      case Token::kw_true:
+      case Token::kw_false:
+        return leaf(NodeKind::boolean_literal);
+
+      case Token::number:
+        return leaf(NodeKind::number);
+
+      case Token::string:
+        return leaf(NodeKind::string);
+
+      case Token::regexp:
+        return leaf(NodeKind::regexp);
+
+      case Token::template_basic:
+      case Token::template_head:
+        return parse_template();
+
+      case Token::left_paren:
+        return parse_paren_expression();
+
+      case Token::left_bracket:
+        return parse_array_literal();
+
+      case Token::left_brace:
+        return parse_object_literal();
+
+      case Token::identifier:
+        if (is_async_function()) {
+          return parse_async_function(true);
+        }
+        return parse_identifier();
+
+      default:
+        unexpected();
+        return none();
+    }
+  }
+
+  NodeIndex parse_template() {
+    auto start = peek_start();
+    NodeList list;
+    if (peek() == Token::template_basic) {
+      _ast.append(list, leaf(NodeKind::template_part));
+      return node_list(NodeKind::template_literal, start, list);
+    }
+    _ast.append(list, leaf(NodeKind::template_part));
+    while (true) {
+      _ast.append(list, parse_expression());
+      if (Token t = peek(Context::template_string); t == Token::template_middle) {
+        _ast.append(list, leaf(NodeKind::template_part));
+      } else if (t == Token::template_tail) {
+        _ast.append(list, leaf(NodeKind::template_part));
+        break;
+      } else {
+        unexpected();
+        break;
+      }
+    }
+    return node_list(NodeKind::template_literal, start, list);
+  }
+
+  NodeIndex parse_paren_expression() {
+    auto start = read().start;
+    NodeList list;
+    bool arrow_only = false;
+    while (more(Token::right_paren)) {
+      if (peek() == Token::dot_3) {
+        _ast.append(list, parse_rest_element());
+        arrow_only = true;
+        break;
+      }
+      _ast.append(list, parse_assignment(false));
+      if (peek(Context::div) != Token::comma) {
+        break;
+      }
+      read();
+      if (peek() == Token::right_paren) {
+        arrow_only = true;
+      }
+    }
+    expect(Token::right_paren, Context::div);
+
+    if ((arrow_only || !list.first) && peek(Context::div) != Token::fat_arrow) {
+      unexpected();
+    }
+
+    NodeIndex expression = no_node;
+    if (!list.first) {
+      // "()" before an arrow
+    } else if (list.first == list.last) {
+      expression = list.first;
+    } else {
+      expression = node_list(NodeKind::sequence_expression, _ast.start(list.first), list);
+    }
+    return node(NodeKind::paren_expression, start, {expression});
+  }
+
+  NodeIndex parse_array_literal() {
+    auto start = read().start;
+    NodeList list;
+    while (more(Token::right_bracket)) {
+      if (peek() == Token::comma) {
+        auto comma = read();
+        _ast.append(list, _ast.make(NodeKind::elision, comma.start));
+        continue;
+      }
+      if (peek() == Token::dot_3) {
+        auto spread_start = read().start;
+        NodeIndex argument = parse_assignment(false);
+        _ast.append(list, node(NodeKind::spread, spread_start, {argument}));
+      } else {
+        _ast.append(list, parse_assignment(false));
+      }
+      if (peek(Context::div) != Token::right_bracket) {
+        expect(Token::comma, Context::div);
+      }
+    }
+    expect(Token::right_bracket, Context::div);
+    return node_list(NodeKind::array_literal, start, list);
+  }
+
+  NodeIndex parse_object_literal() {
+    auto start = read().start;
+    NodeList list;
+    bool has_proto = false;
+    while (more(Token::right_brace)) {
+      NodeIndex property = parse_property_definition();
+      _ast.append(list, property);
+      if (is_proto_property(property)) {
+        // Duplicates are only valid if the object literal is later
+        // reinterpreted as an assignment pattern
+        if (has_proto && !_duplicate_proto) {
+          _duplicate_proto = _ast.start(property);
+        }
+        has_proto = true;
+      }
+      if (peek(Context::div) != Token::right_brace) {
+        expect(Token::comma, Context::div);
+      }
+    }
+    expect(Token::right_brace, Context::div);
+    return node_list(NodeKind::object_literal, start, list);
+  }
+
+  bool is_proto_property(NodeIndex property) {
+    if (_ast[property].kind != NodeKind::property_definition) {
+      return false;
+    }
+    NodeIndex name = _ast.child_count(property) == 2 ? _ast.first_child(property) : property;
+    return
+      source_equals(name, "__proto__") ||
+      source_equals(name, "'__proto__'") ||
+      source_equals(name, "\"__proto__\"");
+  }
+
+  NodeIndex parse_property_definition() {
+    auto start = peek_start();
+
+    if (peek() == Token::dot_3) {
+      read();
+      NodeIndex argument = parse_assignment(false);
+      return node(NodeKind::spread, start, {argument});
+    }
+
+    uint16 flags = parse_method_modifiers();
+    Token name_token = peek();
+    NodeIndex name = parse_property_name();
+
+    if (flags || peek(Context::div) == Token::left_paren) {
+      return parse_method(name, start, flags);
+    }
+
+    if (peek(Context::div) == Token::colon) {
+      read();
+      name = drop_identifier(name);
+      NodeIndex value = parse_assignment(false);
+      return node(NodeKind::property_definition, start, {name, value});
+    }
+
+    if (name_token != Token::identifier) {
+      unexpected();
+    }
+    check_identifier(name);
+
+    if (peek(Context::div) == Token::assign) {
+      // A cover initialized name is only valid if the object literal is
+      // later reinterpreted as an assignment pattern
+      if (!_cover_init) {
+        _cover_init = _peek.start;
+      }
+      read();
+      NodeIndex init = parse_assignment(false);
+      return node(NodeKind::shorthand_property, start, {name, init});
+    }
+
+    return node(NodeKind::shorthand_property, start, {name});
+  }
+
+  NodeIndex parse_property_name() {
+    switch (peek()) {
+      case Token::string:
+        return leaf(NodeKind::string);
+
+      case Token::number:
+        return leaf(NodeKind::number);
+
+      case Token::left_bracket: {
+        auto start = read().start;
+        NodeIndex expression = parse_assignment(false);
+        expect(Token::right_bracket, Context::div);
+        return node(NodeKind::computed_name, start, {expression});
+      }
+
+      default:
+        return parse_identifier_name();
+    }
+  }
+
+  NodeIndex parse_identifier() {
+    if (peek() != Token::identifier) {
+      unexpected();
+      return none();
+    }
+    NodeIndex identifier = leaf(NodeKind::identifier);
+    check_identifier(identifier);
+    return identifier;
+  }
+
+  NodeIndex parse_binding_identifier() {
+    NodeIndex identifier = parse_identifier();
+    check_binding_identifier(identifier);
+    return identifier;
+  }
+
+  NodeIndex parse_identifier_name() {
+    if (Token t = peek(Context::div); !is_identifier_name(t)) {
+      unexpected();
+      return none();
+    }
+    return leaf(NodeKind::identifier);
+  }
+
+  Result read_identifier_name() {
+    if (Token t = peek(Context::div); !is_identifier_name(t)) {
+      unexpected();
+    }
+    return read();
+  }
+
+  NodeIndex parse_string() {
+    if (peek(Context::div) != Token::string) {
+      unexpected();
+      return none();
+    }
+    return leaf(NodeKind::string);
+  }
+
+  void check_identifier(NodeIndex identifier) {
+    switch (_ast[identifier].op()) {
+      case Token::kw_await:
+        if (_module || _function.is_async) {
+          fail(Error::invalid_reserved_word, identifier);
+        }
+        break;
+
+      case Token::kw_yield:
+        if (_strict_mode || _function.is_generator) {
+          fail(Error::invalid_reserved_word, identifier);
+        }
+        break;
+
+      default:
+        break;
+    }
+  }
+
+  void check_binding_identifier(NodeIndex identifier) {
+    if (_ast[identifier].kind != NodeKind::identifier) {
+      return fail(Error::invalid_assignment_target, identifier);
+    }
+    if (
+      _strict_mode &&
+      (source_equals(identifier, "eval") || source_equals(identifier, "arguments"))
+    ) {
+      fail(Error::invalid_reserved_word, identifier);
+    }
+    check_identifier(identifier);
+  }
+
+  // Patterns
+
+  NodeIndex parse_binding_target() {
+    switch (peek()) {
+      case Token::left_bracket: return parse_array_binding();
+      case Token::left_brace: return parse_object_binding();
+      default: return parse_binding_identifier();
+    }
+  }
+
+  NodeIndex parse_binding_element() {
+    auto start = peek_start();
+    NodeIndex target = parse_binding_target();
+    if (peek(Context::div) != Token::assign) {
+      return target;
+    }
+    read();
+    NodeIndex init = parse_assignment(false);
+    return node(NodeKind::pattern_default, start, {target, init});
+  }
+
+  NodeIndex parse_rest_element() {
+    auto start = expect(Token::dot_3).start;
+    NodeIndex target = parse_binding_target();
+    return node(NodeKind::rest_element, start, {target});
+  }
+
+  NodeIndex parse_array_binding() {
+    auto start = read().start;
+    NodeList list;
+    while (more(Token::right_bracket)) {
+      if (peek() == Token::comma) {
+        auto comma = read();
+        _ast.append(list, _ast.make(NodeKind::elision, comma.start));
+        continue;
+      }
+      if (peek() == Token::dot_3) {
+        _ast.append(list, parse_rest_element());
+        break;
+      }
+      _ast.append(list, parse_binding_element());
+      if (peek(Context::div) != Token::right_bracket) {
+        expect(Token::comma, Context::div);
+      }
+    }
+    expect(Token::right_bracket, Context::div);
+    return node_list(NodeKind::array_pattern, start, list);
+  }
+
+  NodeIndex parse_object_binding() {
+    auto start = read().start;
+    NodeList list;
+    while (more(Token::right_brace)) {
+      auto property_start = peek_start();
+      if (peek() == Token::dot_3) {
+        read();
+        NodeIndex target = parse_binding_identifier();
+        _ast.append(list, node(NodeKind::rest_element, property_start, {target}));
+        break;
+      }
+      Token name_token = peek();
+      NodeIndex name = parse_property_name();
+      if (peek(Context::div) == Token::colon) {
+        read();
+        name = drop_identifier(name);
+        NodeIndex target = parse_binding_element();
+        _ast.append(list, node(NodeKind::pattern_property, property_start, {name, target}));
+      } else {
+        if (name_token != Token::identifier) {
+          unexpected();
+        }
+        check_binding_identifier(name);
+        if (peek(Context::div) == Token::assign) {
+          read();
+          NodeIndex init = parse_assignment(false);
+          _ast.append(list, node(NodeKind::shorthand_property, property_start, {name, init}));
+        } else {
+          _ast.append(list, node(NodeKind::shorthand_property, property_start, {name}));
+        }
+      }
+      if (peek(Context::div) != Token::right_brace) {
+        expect(Token::comma, Context::div);
+      }
+    }
+    expect(Token::right_brace, Context::div);
+    return node_list(NodeKind::object_pattern, start, list);
+  }
+
+  // Reinterprets an expression parsed with the cover grammar as an
+  // assignment or binding pattern
+  void to_pattern(NodeIndex node, bool binding) {
+    convert_pattern(node, binding);
+    if (_cover_init && contains(node, *_cover_init)) {
+      _cover_init.reset();
+    }
+    if (_duplicate_proto && contains(node, *_duplicate_proto)) {
+      _duplicate_proto.reset();
+    }
+  }
+
+  bool contains(NodeIndex node, SourcePosition position) {
+    return position >= _ast.start(node) && position < node_end(node);
+  }
+
+  void convert_pattern(NodeIndex node, bool binding) {
+    switch (_ast[node].kind) {
+      case NodeKind::identifier:
+        if (binding) {
+          check_binding_identifier(node);
+        } else {
+          check_strict_target(node);
+        }
+        break;
+
+      case NodeKind::member_expression:
+      case NodeKind::computed_member:
+        if (binding) {
+          fail(Error::invalid_assignment_target, node);
+        }
+        break;
+
+      case NodeKind::paren_expression:
+        if (binding || !is_simple_target(_ast.last_child(node))) {
+          fail(Error::invalid_assignment_target, node);
+        }
+        check_strict_target(unparenthesized(node));
+        break;
+
+      case NodeKind::object_literal:
+        _ast[node].kind = NodeKind::object_pattern;
+        for (NodeIndex child = _ast.last_child(node); child; child = _ast.previous_sibling(node, child)) {
+          switch (_ast[child].kind) {
+            case NodeKind::property_definition:
+              _ast[child].kind = NodeKind::pattern_property;
+              convert_pattern(_ast.last_child(child), binding);
+              break;
+
+            case NodeKind::shorthand_property:
+              if (binding) {
+                check_binding_identifier(_ast.first_child(child));
+              } else {
+                check_strict_target(_ast.first_child(child));
+              }
+              break;
+
+            case NodeKind::spread:
+              _ast[child].kind = NodeKind::rest_element;
+              if (child != _ast.last_child(node) || !is_simple_target(_ast.last_child(child))) {
+                fail(Error::invalid_assignment_target, child);
+              }
+              convert_pattern(_ast.last_child(child), binding);
+              break;
+
+            default:
+              fail(Error::invalid_assignment_target, child);
+              break;
+          }
+        }
+        break;
+
+      case NodeKind::array_literal:
+        _ast[node].kind = NodeKind::array_pattern;
+        for (NodeIndex child = _ast.last_child(node); child; child = _ast.previous_sibling(node, child)) {
+          if (_ast[child].kind == NodeKind::elision) {
+            continue;
+          }
+          if (_ast[child].kind == NodeKind::spread) {
+            _ast[child].kind = NodeKind::rest_element;
+            if (child != _ast.last_child(node)) {
+              fail(Error::invalid_assignment_target, child);
+            }
+            convert_pattern(_ast.last_child(child), binding);
+          } else {
+            convert_pattern(child, binding);
+          }
+        }
+        break;
+
+      case NodeKind::assignment_expression:
+        if (_ast[node].op() != Token::assign) {
+          fail(Error::invalid_assignment_target, node);
+        }
+        _ast[node].kind = NodeKind::pattern_default;
+        _ast[node].set_op(Token::error);
+        if (binding) {
+          convert_pattern(_ast.first_child(node), binding);
+        }
+        break;
+
+      case NodeKind::rest_element:
+        convert_pattern(_ast.last_child(node), binding);
+        break;
+
+      case NodeKind::object_pattern:
+      case NodeKind::array_pattern:
+      case NodeKind::pattern_default:
+        break;
+
+      default:
+        fail(Error::invalid_assignment_target, node);
+        break;
+    }
+  }
+
+  bool is_simple_target(NodeIndex node) {
+    switch (_ast[node].kind) {
+      case NodeKind::identifier:
+      case NodeKind::member_expression:
+      case NodeKind::computed_member:
+        return true;
+      case NodeKind::paren_expression:
+        return _ast.last_child(node) && is_simple_target(_ast.last_child(node));
+      default:
+        return false;
+    }
+  }
+
+  void check_simple_target(NodeIndex node) {
+    if (!is_simple_target(node)) {
+      fail(Error::invalid_assignment_target, node);
+    }
+    check_strict_target(unparenthesized(node));
+  }
+
+  // "eval" and "arguments" cannot be assigned in strict code
+  void check_strict_target(NodeIndex node) {
+    if (
+      _strict_mode &&
+      _ast[node].kind == NodeKind::identifier &&
+      (source_equals(node, "eval") || source_equals(node, "arguments"))
+    ) {
+      fail(Error::invalid_assignment_target, node);
+    }
+  }
+
+  NodeIndex unparenthesized(NodeIndex node) {
+    while (_ast[node].kind == NodeKind::paren_expression && _ast.last_child(node)) {
+      node = _ast.last_child(node);
+    }
+    return node;
+  }
+
+  // Token classification
+
+  static bool is_identifier_name(Token t) {
+    return t == Token::identifier || t > Token::kw_begin && t < Token::kw_end;
+  }
+
+  static bool is_unary_operator(Token t) {
+    switch (t) {
+      case Token::kw_delete:
+      case Token::kw_void:
+      case Token::kw_typeof:
+      case Token::plus:
+      case Token::minus:
+      case Token::bitwise_not:
+      case Token::logical_not:
+        return true;
+      default:
+        return false;
+    }
+  }
+
+  static bool is_assignment_operator(Token t) {
+    switch (t) {
+      case Token::assign:
+      case Token::plus_assign:
+      case Token::minus_assign:
+      case Token::multiply_assign:
+      case Token::divide_assign:
+      case Token::mod_assign:
+      case Token::pow_assign:
+      case Token::left_shift_assign:
+      case Token::right_shift_assign:
+      case Token::right_shift_zero_assign:
+      case Token::bitwise_and_assign:
+      case Token::bitwise_or_assign:
+      case Token::bitwise_xor_assign:
+        return true;
+      default:
+        return false;
+    }
+  }
+
+  static int binary_precedence(Token t, bool no_in) {
+    switch (t) {
+      case Token::logical_or:
+        return 1;
+      case Token::logical_and:
+        return 2;
+      case Token::bitwise_or:
+        return 3;
+      case Token::bitwise_xor:
+        return 4;
+      case Token::bitwise_and:
+        return 5;
+      case Token::equal:
+      case Token::not_equal:
+      case Token::strict_equal:
+      case Token::strict_not_equal:
+        return 6;
+      case Token::less_than:
+      case Token::less_than_equal:
+      case Token::greater_than:
+      case Token::greater_than_equal:
+      case Token::kw_instanceof:
+        return 7;
+      case Token::kw_in:
+        return no_in ? 0 : 7;
+      case Token::left_shift:
+      case Token::right_shift:
+      case Token::right_shift_zero:
+        return 8;
+      case Token::plus:
+      case Token::minus:
+        return 9;
+      case Token::multiply:
+      case Token::divide:
+      case Token::mod:
+        return 10;
+      case Token::pow:
+        return 11;
+      default:
+        return 0;
+    }
+  }
+
+  Scanner<T> _scanner;
+  Scanner<T> _rewind;
+  T _begin;
+  uint64 _length;
+  Ast& _ast;
+  Scanner<T> _rescan;
+  Result _peek;
+  Context _peek_context {Context::expression};
+  bool _peeked {false};
+  SourcePosition _last_end {0};
+  bool _module {false};
+  bool _strict_mode {false};
+  bool _default_export {false};
+  bool _derived_class {false};
+  FunctionState _function;
+  optional<SourcePosition> _cover_init;
+  optional<SourcePosition> _duplicate_proto;
+  Error _error {Error::none};
+  SourcePosition _error_start {0};
+  SourcePosition _error_end {0};
+  uint32 _token_count {0};
+  typename Scanner<T>::Error _scanner_error {Scanner<T>::Error::none};
+  bool _lazy_functions {false};
+  SpanSet _declared {0, SpanText {_begin}, SpanText {_begin}};
+  SpanSet _referenced {0, SpanText {_begin}, SpanText {_begin}};
+  std::vector<SkippedBody> _skipped_bodies;
+  std::vector<Label> _labels;
+  std::vector<Scope> _scopes;
+  std::vector<Declaration> _lexical;
+  std::vector<Declaration> _vars;
+  SpanMap _lexical_heads {0, SpanText {_begin}, SpanText {_begin}};
+  SpanMap _var_heads {0, SpanText {_begin}, SpanText {_begin}};
+
+};
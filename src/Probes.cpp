@@ -0,0 +1,102 @@
+module;
+
+// Probes are emitted in the SystemTap SDT format, as in <sys/sdt.h>: a nop at
+// the probe site and an ELF note which describes the site and the location
+// of each argument. Tools such as perf and bpftrace list the notes and place
+// breakpoints on the nops only while a probe is in use.
+#if !defined(XXPARSEJS_NO_PROBES) && defined(__ELF__) && defined(__GNUC__) && \
+  (defined(__x86_64__) || defined(__aarch64__))
+#define XX_PROBE_ENABLED 1
+#endif
+
+#if defined(XX_PROBE_ENABLED)
+
+// Each probe has a semaphore in the .probes section, which tracers increment
+// while they are attached, so that arguments are computed only when read
+#define XX_PROBE_SEMAPHORE(name) \
+  extern "C" { \
+    inline volatile unsigned short xxparsejs_##name##_semaphore \
+      __attribute__((section(".probes"), used)) = 0; \
+  }
+
+#define XX_PROBE_ACTIVE(name) (xxparsejs_##name##_semaphore != 0)
+
+#define XX_PROBE_NOTE(name, args) \
+  "990: nop\n" \
+  ".pushsection .note.stapsdt,\"?\",\"note\"\n" \
+  ".balign 4\n" \
+  ".4byte 992f-991f, 994f-993f, 3\n" \
+  "991: .asciz \"stapsdt\"\n" \
+  "992: .balign 4\n" \
+  "993: .8byte 990b\n" \
+  ".8byte _.stapsdt.base\n" \
+  ".8byte xxparsejs_" #name "_semaphore\n" \
+  ".asciz \"xxparsejs\"\n" \
+  ".asciz \"" #name "\"\n" \
+  ".asciz \"" args "\"\n" \
+  "994: .balign 4\n" \
+  ".popsection\n" \
+  ".ifndef _.stapsdt.base\n" \
+  ".pushsection .stapsdt.base,\"aG\",\"progbits\",.stapsdt.base,comdat\n" \
+  ".weak _.stapsdt.base\n" \
+  ".hidden _.stapsdt.base\n" \
+  "_.stapsdt.base: .space 1\n" \
+  ".size _.stapsdt.base, 1\n" \
+  ".popsection\n" \
+  ".endif\n"
+
+#define XX_PROBE1(name, arg1) \
+  __asm__ __volatile__(XX_PROBE_NOTE(name, "8@%[a]") :: [a] "r"(arg1))
+
+#define XX_PROBE3(name, arg1, arg2, arg3) \
+  __asm__ __volatile__(XX_PROBE_NOTE(name, "8@%[a] 8@%[b] 8@%[c]") \
+    :: [a] "r"(arg1), [b] "r"(arg2), [c] "r"(arg3))
+
+#else
+
+#define XX_PROBE_SEMAPHORE(name)
+#define XX_PROBE_ACTIVE(name) false
+#define XX_PROBE1(name, arg1) ((void)(arg1))
+#define XX_PROBE3(name, arg1, arg2, arg3) ((void)(arg1), (void)(arg2), (void)(arg3))
+
+#endif
+
+export module Probes;
+
+import BasicTypes;
+
+// Static tracepoints at the start and end of each scan and parse, under the
+// provider "xxparsejs". Sizes are in code units and errors are the scanner or
+// parser error code, zero for success. For example, the distribution of
+// tokens per scan:
+//
+//   bpftrace -e 'usdt:./app:xxparsejs:scan__end { @tokens = hist(arg1); }'
+//
+// Building with XXPARSEJS_NO_PROBES defined removes them.
+
+XX_PROBE_SEMAPHORE(scan__start)
+XX_PROBE_SEMAPHORE(scan__end)
+XX_PROBE_SEMAPHORE(parse__start)
+XX_PROBE_SEMAPHORE(parse__end)
+
+// True while a tracer is attached to scan__start or scan__end. Callers check
+// it before computing probe arguments which are not already at hand.
+export inline bool probe_scan_active() {
+  return XX_PROBE_ACTIVE(scan__start) || XX_PROBE_ACTIVE(scan__end);
+}
+
+export inline void probe_scan_start(uint64 size) {
+  XX_PROBE1(scan__start, size);
+}
+
+export inline void probe_scan_end(uint64 size, uint64 tokens, uint64 error) {
+  XX_PROBE3(scan__end, size, tokens, error);
+}
+
+export inline void probe_parse_start(uint64 size) {
+  XX_PROBE1(parse__start, size);
+}
+
+export inline void probe_parse_end(uint64 size, uint64 tokens, uint64 error) {
+  XX_PROBE3(parse__end, size, tokens, error);
+}
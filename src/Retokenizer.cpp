@@ -0,0 +1,217 @@
+export module Retokenizer;
+
+import std.core;
+import BasicTypes;
+import Scanner;
+import Tokenizer;
+import TokenBuffer;
+import CheckpointIndex;
+
+// A change to the source: deleted code units at offset were replaced by
+// inserted code units
+export struct TextEdit {
+  SourcePosition offset {0};
+  uint32 deleted {0};
+  uint32 inserted {0};
+};
+
+// The change to a token buffer which follows from an edit. Records from
+// first to first + removed are replaced by the inserted records, and the
+// start of each record after them moves by shift.
+export struct TokenDelta {
+  uint32 first {0};
+  uint32 removed {0};
+  TokenBuffer inserted;
+  int32 shift {0};
+  uint32 replayed {0};      // Records before first replayed to rebuild the tokenizer state
+};
+
+export void apply_delta(TokenBuffer& tokens, const TokenDelta& delta) {
+  tokens.replace(delta.first, delta.removed, delta.inserted, delta.shift);
+}
+
+// The index of the first record which starts at or after the position
+uint32 first_record_after(const TokenBuffer& tokens, SourcePosition position) {
+  uint32 first = 0;
+  uint32 last = tokens.size();
+  while (first < last) {
+    uint32 middle = first + (last - first) / 2;
+    if (tokens[middle].start < position) {
+      first = middle + 1;
+    } else {
+      last = middle;
+    }
+  }
+  return first;
+}
+
+// The index of the first record which may change. The scanner looks one code
+// unit past the end of a token, so a token which ends at the offset of the
+// edit may change. Scanning does not resume after a comment or whitespace
+// record, since the newline_before flag is carried over from them. The last
+// record is always rescanned, as an edit after a Token::error record follows
+// no record.
+uint32 retokenize_start(const TokenBuffer& tokens, SourcePosition offset) {
+  uint32 first = std::min(first_record_after(tokens, offset), tokens.size() - 1);
+  while (first > 0) {
+    const TokenRecord& previous = tokens[first - 1];
+    bool trivia = previous.token == Token::comment || previous.token == Token::whitespace;
+    if (!trivia && tokens.end(first - 1) < offset) {
+      break;
+    }
+    --first;
+  }
+  return first;
+}
+
+template<typename T, typename Policy>
+void retokenize_replay(Tokenizer<T, Policy>& tokenizer, const TokenRecord& record) {
+  Token t = record.token;
+  if (t != Token::comment && t != Token::whitespace && t != Token::error) {
+    tokenizer.update(t, record.keyword());
+  }
+}
+
+// Updates the token stream of a source after an edit, given the edited
+// source and the stream of the original, which must end with Token::end or
+// Token::error. Scanning resumes after the last token before the edit, with
+// the tokenizer state rebuilt from the records before it, and stops at the
+// first token after the edit which matches the original stream and follows
+// the same tokenizer state; the rest of the stream is unchanged apart from
+// its positions.
+//
+// The tokenizer state is rebuilt by replaying every record before the edit,
+// unless checkpoints of the original source are given, in which case only
+// the records after the last checkpoint before the edit are replayed. The
+// checkpoints can be kept up to date with apply_delta.
+//
+// If the original stream was scanned in recovery mode, its diagnostics list
+// must be given, and is updated to the diagnostics of the edited source: the
+// diagnostics of the rescanned code are replaced by those of the rescan, and
+// the diagnostics after it are moved by the shift of the delta.
+//
+// The records do not say whether the code was strict, so strict code must be
+// given as such for the rescan to report the errors of a strict scan: with
+// strict_mode for code which is strict from the start, such as a module, or
+// with checkpoints recorded after a "use strict" directive took effect.
+//
+// The iterator must support adding an offset to begin. Iterators of a
+// SegmentedText do so, so that a piece table can be rescanned without
+// flattening it.
+export template<typename Policy = ScannerPolicy, typename T>
+TokenDelta retokenize(
+  const TokenBuffer& tokens,
+  const TextEdit& edit,
+  T begin,
+  T end,
+  std::vector<typename Scanner<T, Policy>::Diagnostic>* diagnostics = nullptr,
+  const std::type_identity_t<CheckpointIndex<T, Policy>>* checkpoints = nullptr,
+  bool strict_mode = false)
+{
+  using Result = typename Scanner<T, Policy>::Result;
+
+  TokenDelta delta;
+  delta.first = retokenize_start(tokens, edit.offset);
+  delta.shift = int32(edit.inserted) - int32(edit.deleted);
+
+  SourcePosition position = delta.first > 0 ? tokens.end(delta.first - 1) : 0;
+  Scanner<T, Policy> scanner {begin, end};
+  scanner.seek(begin + position, position);
+
+  // The scanner discards the diagnostics after the position when it resumes.
+  // Those after the rescanned code are kept, in original positions, and put
+  // back once the stream matches the original again.
+  std::vector<typename Scanner<T, Policy>::Diagnostic> tail;
+  if constexpr (Policy::recovery) {
+    if (diagnostics) {
+      auto iter = diagnostics->end();
+      while (iter != diagnostics->begin() && std::prev(iter)->start >= position) {
+        --iter;
+      }
+      tail.assign(iter, diagnostics->end());
+      diagnostics->erase(iter, diagnostics->end());
+      scanner.set_recovery(diagnostics);
+    }
+  }
+
+  Tokenizer<T, Policy> tokenizer {scanner};
+  uint32 replay_first = 0;
+  if (checkpoints) {
+    // Checkpoints before the edit are unchanged
+    auto& checkpoint = checkpoints->restore(tokenizer, begin, position);
+    replay_first = first_record_after(tokens, checkpoint.position);
+    tokenizer.scanner().seek(begin + position, position);
+    strict_mode = strict_mode || checkpoint.strict_mode;
+  }
+  if constexpr (Policy::strict_mode == StrictMode::dynamic) {
+    tokenizer.scanner().set_strict_mode(strict_mode);
+  }
+  for (uint32 i = replay_first; i < delta.first; ++i) {
+    retokenize_replay(tokenizer, tokens[i]);
+  }
+  delta.replayed = delta.first - replay_first;
+
+  // Follows the original stream from the same starting state
+  Tokenizer<T, Policy> original = tokenizer;
+  uint32 index = delta.first;
+  SourcePosition edit_end = edit.offset + edit.inserted;
+
+  while (true) {
+    Token t = tokenizer.next();
+    const Result& result = tokenizer.result();
+
+    if (result.start >= edit_end) {
+      SourcePosition original_start = result.start - SourcePosition(delta.shift);
+      for (; index < tokens.size() && tokens[index].start < original_start; ++index) {
+        retokenize_replay(original, tokens[index]);
+      }
+      if (index < tokens.size() && tokens[index].start == original_start) {
+        Result previous = tokens.result<Result>(index);
+        retokenize_replay(original, tokens[index]);
+        bool same =
+          previous.token == result.token &&
+          previous.keyword == result.keyword &&
+          previous.end - previous.start == result.end - result.start &&
+          previous.newline_before == result.newline_before &&
+          previous.error == result.error &&
+          tokenizer.same_state(original);
+        if (same) {
+          delta.removed = index - delta.first;
+          for (auto& diagnostic : tail) {
+            if (diagnostic.start >= previous.end) {
+              diagnostic.start += SourcePosition(delta.shift);
+              diagnostic.end += SourcePosition(delta.shift);
+              diagnostics->push_back(diagnostic);
+            }
+          }
+          return delta;
+        }
+        ++index;
+      }
+    }
+
+    delta.inserted.push_back(result);
+    if (t == Token::end || t == Token::error) {
+      delta.removed = tokens.size() - delta.first;
+      return delta;
+    }
+  }
+}
+
+// Updates the checkpoints of a source for an edit, given its token delta and
+// the token buffer before the delta is applied. The tokenizer state after
+// the records which follow the rescanned ones is unchanged, so checkpoints
+// there are moved rather than dropped.
+export template<typename T, typename Policy>
+void apply_delta(
+  CheckpointIndex<T, Policy>& checkpoints,
+  const TokenBuffer& tokens,
+  const TokenDelta& delta)
+{
+  SourcePosition first = delta.first > 0 ? tokens.end(delta.first - 1) : 0;
+  uint32 matched = delta.first + delta.removed;
+  SourcePosition last = matched < tokens.size()
+    ? tokens.end(matched)
+    : std::numeric_limits<SourcePosition>::max();
+  checkpoints.edit(first, last, delta.shift);
+}
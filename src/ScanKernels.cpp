@@ -0,0 +1,532 @@
+module;
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define SCAN_KERNELS_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+#if defined(__GNUC__)
+#define SCAN_TARGET(isa) __attribute__((target(isa)))
+#else
+#define SCAN_TARGET(isa)
+#endif
+
+export module ScanKernels;
+
+import std.core;
+import BasicTypes;
+
+// Loops of the scanner which run over many bytes of single byte source, with
+// vector implementations for each level of x86 CPU. The implementation is
+// selected when the kernels are first used, from the CPU features reported by
+// cpuid, and can be limited with the XXPARSEJS_KERNELS environment variable
+// ("scalar", "sse4.2", "avx2" or "avx512").
+//
+// Each kernel returns the first byte which it does not skip, and stops at any
+// byte above ASCII so that the scanner can handle it.
+
+export enum class KernelLevel : uint8 {
+  scalar,
+  sse42,
+  avx2,
+  avx512,
+};
+
+export struct ScanKernels {
+  using Skip = const uint8* (*)(const uint8* first, const uint8* last);
+
+  KernelLevel level {KernelLevel::scalar};
+  Skip identifier {nullptr};      // ASCII identifier parts
+  const uint8* (*string_body)(const uint8* first, const uint8* last, uint8 delim) {nullptr};
+  Skip line_comment {nullptr};    // Up to a line break
+  Skip block_comment {nullptr};   // Up to "*" or a line break
+  Skip whitespace {nullptr};      // Spaces and tabs
+  size_t (*count_newlines)(const uint8* first, const uint8* last) {nullptr};
+};
+
+export const char* kernel_level_name(KernelLevel level) {
+  switch (level) {
+    case KernelLevel::scalar: return "scalar";
+    case KernelLevel::sse42: return "sse4.2";
+    case KernelLevel::avx2: return "avx2";
+    case KernelLevel::avx512: return "avx512";
+  }
+  return "";
+}
+
+bool is_ascii_identifier_part(uint8 c) {
+  return
+    c >= 'a' && c <= 'z' ||
+    c >= 'A' && c <= 'Z' ||
+    c >= '0' && c <= '9' ||
+    c == '_' ||
+    c == '$';
+}
+
+const uint8* identifier_scalar(const uint8* p, const uint8* last) {
+  while (p != last && is_ascii_identifier_part(*p)) {
+    ++p;
+  }
+  return p;
+}
+
+const uint8* string_body_scalar(const uint8* p, const uint8* last, uint8 delim) {
+  for (; p != last; ++p) {
+    uint8 c = *p;
+    if (c == delim || c == '\\' || c == '\n' || c == '\r' || c >= 0x80) {
+      break;
+    }
+  }
+  return p;
+}
+
+const uint8* line_comment_scalar(const uint8* p, const uint8* last) {
+  while (p != last && *p != '\n' && *p != '\r' && *p < 0x80) {
+    ++p;
+  }
+  return p;
+}
+
+const uint8* block_comment_scalar(const uint8* p, const uint8* last) {
+  while (p != last && *p != '*' && *p != '\n' && *p != '\r' && *p < 0x80) {
+    ++p;
+  }
+  return p;
+}
+
+const uint8* whitespace_scalar(const uint8* p, const uint8* last) {
+  while (p != last && (*p == ' ' || *p == '\t')) {
+    ++p;
+  }
+  return p;
+}
+
+size_t count_newlines_scalar(const uint8* p, const uint8* last) {
+  size_t count = 0;
+  for (; p != last; ++p) {
+    count += *p == '\n';
+  }
+  return count;
+}
+
+#if defined(SCAN_KERNELS_X86)
+
+// SSE4.2 kernels compare 16 bytes at a time against a list of byte ranges
+constexpr int sse42_find_mode = _SIDD_UBYTE_OPS | _SIDD_CMP_RANGES | _SIDD_LEAST_SIGNIFICANT;
+constexpr int sse42_skip_mode = sse42_find_mode | _SIDD_NEGATIVE_POLARITY;
+
+template<int mode>
+SCAN_TARGET("sse4.2")
+const uint8* sse42_ranges(const uint8* p, const uint8* last, __m128i ranges, int count) {
+  while (last - p >= 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    int index = _mm_cmpestri(ranges, count, v, 16, mode);
+    if (index < 16) {
+      return p + index;
+    }
+    p += 16;
+  }
+  return p;
+}
+
+SCAN_TARGET("sse4.2")
+const uint8* identifier_sse42(const uint8* p, const uint8* last) {
+  __m128i ranges = _mm_setr_epi8('a', 'z', 'A', 'Z', '0', '9', '_', '_', '$', '$', 0, 0, 0, 0, 0, 0);
+  return identifier_scalar(sse42_ranges<sse42_skip_mode>(p, last, ranges, 10), last);
+}
+
+SCAN_TARGET("sse4.2")
+const uint8* string_body_sse42(const uint8* p, const uint8* last, uint8 delim) {
+  char d = char(delim);
+  __m128i ranges = _mm_setr_epi8(d, d, '\\', '\\', '\n', '\n', '\r', '\r', char(0x80), char(0xff), 0, 0, 0, 0, 0, 0);
+  return string_body_scalar(sse42_ranges<sse42_find_mode>(p, last, ranges, 10), last, delim);
+}
+
+SCAN_TARGET("sse4.2")
+const uint8* line_comment_sse42(const uint8* p, const uint8* last) {
+  __m128i ranges = _mm_setr_epi8('\n', '\n', '\r', '\r', char(0x80), char(0xff), 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+  return line_comment_scalar(sse42_ranges<sse42_find_mode>(p, last, ranges, 6), last);
+}
+
+SCAN_TARGET("sse4.2")
+const uint8* block_comment_sse42(const uint8* p, const uint8* last) {
+  __m128i ranges = _mm_setr_epi8('*', '*', '\n', '\n', '\r', '\r', char(0x80), char(0xff), 0, 0, 0, 0, 0, 0, 0, 0);
+  return block_comment_scalar(sse42_ranges<sse42_find_mode>(p, last, ranges, 8), last);
+}
+
+SCAN_TARGET("sse4.2")
+const uint8* whitespace_sse42(const uint8* p, const uint8* last) {
+  __m128i ranges = _mm_setr_epi8(' ', ' ', '\t', '\t', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+  return whitespace_scalar(sse42_ranges<sse42_skip_mode>(p, last, ranges, 4), last);
+}
+
+SCAN_TARGET("sse4.2,popcnt")
+size_t count_newlines_sse42(const uint8* p, const uint8* last) {
+  size_t count = 0;
+  __m128i newline = _mm_set1_epi8('\n');
+  for (; last - p >= 16; p += 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    count += std::popcount(uint32(_mm_movemask_epi8(_mm_cmpeq_epi8(v, newline))));
+  }
+  return count + count_newlines_scalar(p, last);
+}
+
+// AVX2 kernels build a mask of the bytes at which to stop, 32 bytes at a time.
+// The upper halves of the vector registers are cleared before returning to
+// SSE code, which runs slowly while they are in use; compilers do not always
+// do so before a tail call.
+SCAN_TARGET("avx2")
+__m256i avx2_in_range(__m256i v, uint8 low, uint8 high) {
+  __m256i offset = _mm256_sub_epi8(v, _mm256_set1_epi8(char(low)));
+  return _mm256_cmpeq_epi8(_mm256_min_epu8(offset, _mm256_set1_epi8(char(high - low))), offset);
+}
+
+SCAN_TARGET("avx2")
+__m256i avx2_equal(__m256i v, char c) {
+  return _mm256_cmpeq_epi8(v, _mm256_set1_epi8(c));
+}
+
+template<typename StopMask>
+SCAN_TARGET("avx2,bmi")
+const uint8* avx2_find(const uint8* p, const uint8* last, StopMask stop_mask) {
+  while (last - p >= 32) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    if (uint32 mask = stop_mask(v)) {
+      _mm256_zeroupper();
+      return p + std::countr_zero(mask);
+    }
+    p += 32;
+  }
+  _mm256_zeroupper();
+  return p;
+}
+
+struct Avx2IdentifierStop {
+  SCAN_TARGET("avx2")
+  uint32 operator()(__m256i v) const {
+    __m256i part = _mm256_or_si256(
+      _mm256_or_si256(
+        avx2_in_range(_mm256_or_si256(v, _mm256_set1_epi8(0x20)), 'a', 'z'),
+        avx2_in_range(v, '0', '9')),
+      _mm256_or_si256(avx2_equal(v, '_'), avx2_equal(v, '$')));
+    return ~uint32(_mm256_movemask_epi8(part));
+  }
+};
+
+struct Avx2StringStop {
+  uint8 delim;
+
+  SCAN_TARGET("avx2")
+  uint32 operator()(__m256i v) const {
+    __m256i stop = _mm256_or_si256(
+      _mm256_or_si256(avx2_equal(v, char(delim)), avx2_equal(v, '\\')),
+      _mm256_or_si256(avx2_equal(v, '\n'), avx2_equal(v, '\r')));
+    return uint32(_mm256_movemask_epi8(_mm256_or_si256(stop, v)));
+  }
+};
+
+struct Avx2LineCommentStop {
+  SCAN_TARGET("avx2")
+  uint32 operator()(__m256i v) const {
+    __m256i stop = _mm256_or_si256(avx2_equal(v, '\n'), avx2_equal(v, '\r'));
+    return uint32(_mm256_movemask_epi8(_mm256_or_si256(stop, v)));
+  }
+};
+
+struct Avx2BlockCommentStop {
+  SCAN_TARGET("avx2")
+  uint32 operator()(__m256i v) const {
+    __m256i stop = _mm256_or_si256(
+      avx2_equal(v, '*'),
+      _mm256_or_si256(avx2_equal(v, '\n'), avx2_equal(v, '\r')));
+    return uint32(_mm256_movemask_epi8(_mm256_or_si256(stop, v)));
+  }
+};
+
+struct Avx2WhitespaceStop {
+  SCAN_TARGET("avx2")
+  uint32 operator()(__m256i v) const {
+    __m256i blank = _mm256_or_si256(avx2_equal(v, ' '), avx2_equal(v, '\t'));
+    return ~uint32(_mm256_movemask_epi8(blank));
+  }
+};
+
+SCAN_TARGET("avx2,bmi")
+const uint8* identifier_avx2(const uint8* p, const uint8* last) {
+  return identifier_scalar(avx2_find(p, last, Avx2IdentifierStop {}), last);
+}
+
+SCAN_TARGET("avx2,bmi")
+const uint8* string_body_avx2(const uint8* p, const uint8* last, uint8 delim) {
+  return string_body_scalar(avx2_find(p, last, Avx2StringStop {delim}), last, delim);
+}
+
+SCAN_TARGET("avx2,bmi")
+const uint8* line_comment_avx2(const uint8* p, const uint8* last) {
+  return line_comment_scalar(avx2_find(p, last, Avx2LineCommentStop {}), last);
+}
+
+SCAN_TARGET("avx2,bmi")
+const uint8* block_comment_avx2(const uint8* p, const uint8* last) {
+  return block_comment_scalar(avx2_find(p, last, Avx2BlockCommentStop {}), last);
+}
+
+SCAN_TARGET("avx2,bmi")
+const uint8* whitespace_avx2(const uint8* p, const uint8* last) {
+  return whitespace_scalar(avx2_find(p, last, Avx2WhitespaceStop {}), last);
+}
+
+SCAN_TARGET("avx2,popcnt")
+size_t count_newlines_avx2(const uint8* p, const uint8* last) {
+  size_t count = 0;
+  for (; last - p >= 32; p += 32) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    count += std::popcount(uint32(_mm256_movemask_epi8(avx2_equal(v, '\n'))));
+  }
+  _mm256_zeroupper();
+  return count + count_newlines_scalar(p, last);
+}
+
+// AVX-512 kernels compare directly into 64 bit masks, 64 bytes at a time
+SCAN_TARGET("avx512f,avx512bw")
+__mmask64 avx512_in_range(__m512i v, uint8 low, uint8 high) {
+  __m512i offset = _mm512_sub_epi8(v, _mm512_set1_epi8(char(low)));
+  return _mm512_cmple_epu8_mask(offset, _mm512_set1_epi8(char(high - low)));
+}
+
+SCAN_TARGET("avx512f,avx512bw")
+__mmask64 avx512_equal(__m512i v, char c) {
+  return _mm512_cmpeq_epi8_mask(v, _mm512_set1_epi8(c));
+}
+
+template<typename StopMask>
+SCAN_TARGET("avx512f,avx512bw,bmi")
+const uint8* avx512_find(const uint8* p, const uint8* last, StopMask stop_mask) {
+  while (last - p >= 64) {
+    __m512i v = _mm512_loadu_si512(p);
+    if (uint64 mask = stop_mask(v)) {
+      _mm256_zeroupper();
+      return p + std::countr_zero(mask);
+    }
+    p += 64;
+  }
+  _mm256_zeroupper();
+  return p;
+}
+
+struct Avx512IdentifierStop {
+  SCAN_TARGET("avx512f,avx512bw")
+  uint64 operator()(__m512i v) const {
+    __mmask64 part =
+      avx512_in_range(_mm512_or_si512(v, _mm512_set1_epi8(0x20)), 'a', 'z') |
+      avx512_in_range(v, '0', '9') |
+      avx512_equal(v, '_') |
+      avx512_equal(v, '$');
+    return ~uint64(part);
+  }
+};
+
+struct Avx512StringStop {
+  uint8 delim;
+
+  SCAN_TARGET("avx512f,avx512bw")
+  uint64 operator()(__m512i v) const {
+    return
+      avx512_equal(v, char(delim)) |
+      avx512_equal(v, '\\') |
+      avx512_equal(v, '\n') |
+      avx512_equal(v, '\r') |
+      _mm512_movepi8_mask(v);
+  }
+};
+
+struct Avx512LineCommentStop {
+  SCAN_TARGET("avx512f,avx512bw")
+  uint64 operator()(__m512i v) const {
+    return avx512_equal(v, '\n') | avx512_equal(v, '\r') | _mm512_movepi8_mask(v);
+  }
+};
+
+struct Avx512BlockCommentStop {
+  SCAN_TARGET("avx512f,avx512bw")
+  uint64 operator()(__m512i v) const {
+    return
+      avx512_equal(v, '*') |
+      avx512_equal(v, '\n') |
+      avx512_equal(v, '\r') |
+      _mm512_movepi8_mask(v);
+  }
+};
+
+struct Avx512WhitespaceStop {
+  SCAN_TARGET("avx512f,avx512bw")
+  uint64 operator()(__m512i v) const {
+    return ~uint64(avx512_equal(v, ' ') | avx512_equal(v, '\t'));
+  }
+};
+
+SCAN_TARGET("avx512f,avx512bw,bmi")
+const uint8* identifier_avx512(const uint8* p, const uint8* last) {
+  return identifier_scalar(avx512_find(p, last, Avx512IdentifierStop {}), last);
+}
+
+SCAN_TARGET("avx512f,avx512bw,bmi")
+const uint8* string_body_avx512(const uint8* p, const uint8* last, uint8 delim) {
+  return string_body_scalar(avx512_find(p, last, Avx512StringStop {delim}), last, delim);
+}
+
+SCAN_TARGET("avx512f,avx512bw,bmi")
+const uint8* line_comment_avx512(const uint8* p, const uint8* last) {
+  return line_comment_scalar(avx512_find(p, last, Avx512LineCommentStop {}), last);
+}
+
+SCAN_TARGET("avx512f,avx512bw,bmi")
+const uint8* block_comment_avx512(const uint8* p, const uint8* last) {
+  return block_comment_scalar(avx512_find(p, last, Avx512BlockCommentStop {}), last);
+}
+
+SCAN_TARGET("avx512f,avx512bw,bmi")
+const uint8* whitespace_avx512(const uint8* p, const uint8* last) {
+  return whitespace_scalar(avx512_find(p, last, Avx512WhitespaceStop {}), last);
+}
+
+SCAN_TARGET("avx512f,avx512bw,popcnt")
+size_t count_newlines_avx512(const uint8* p, const uint8* last) {
+  size_t count = 0;
+  for (; last - p >= 64; p += 64) {
+    count += std::popcount(uint64(avx512_equal(_mm512_loadu_si512(p), '\n')));
+  }
+  _mm256_zeroupper();
+  return count + count_newlines_scalar(p, last);
+}
+
+void cpuid(uint32 leaf, uint32 subleaf, uint32 (&regs)[4]) {
+#if defined(_MSC_VER)
+  int values[4];
+  __cpuidex(values, int(leaf), int(subleaf));
+  for (int i = 0; i < 4; ++i) {
+    regs[i] = uint32(values[i]);
+  }
+#else
+  __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+// The register state which the operating system saves on context switches
+uint64 xgetbv() {
+#if defined(_MSC_VER)
+  return _xgetbv(0);
+#else
+  uint32 low, high;
+  __asm__("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+  return uint64(high) << 32 | low;
+#endif
+}
+
+#endif
+
+// The highest kernel level which the CPU and operating system support
+export KernelLevel detect_kernel_level() {
+#if defined(SCAN_KERNELS_X86)
+  uint32 regs[4];
+  cpuid(0, 0, regs);
+  uint32 max_leaf = regs[0];
+
+  cpuid(1, 0, regs);
+  bool sse42 = regs[2] & 1 << 20;
+  bool osxsave = regs[2] & 1 << 27;
+  if (!sse42) {
+    return KernelLevel::scalar;
+  }
+  if (!osxsave || max_leaf < 7) {
+    return KernelLevel::sse42;
+  }
+
+  uint64 xcr0 = xgetbv();
+  cpuid(7, 0, regs);
+  bool avx2 = (regs[1] & 1 << 5) && (regs[1] & 1 << 3) && (xcr0 & 0x6) == 0x6;
+  bool avx512 = (regs[1] & 1 << 16) && (regs[1] & 1 << 30) && (xcr0 & 0xe6) == 0xe6;
+  if (avx2 && avx512) {
+    return KernelLevel::avx512;
+  }
+  if (avx2) {
+    return KernelLevel::avx2;
+  }
+  return KernelLevel::sse42;
+#else
+  return KernelLevel::scalar;
+#endif
+}
+
+// The kernels of a level, which must be supported by the CPU
+export ScanKernels scan_kernels_for(KernelLevel level) {
+  switch (level) {
+#if defined(SCAN_KERNELS_X86)
+    case KernelLevel::avx512:
+      return {
+        level,
+        identifier_avx512,
+        string_body_avx512,
+        line_comment_avx512,
+        block_comment_avx512,
+        whitespace_avx512,
+        count_newlines_avx512,
+      };
+    case KernelLevel::avx2:
+      return {
+        level,
+        identifier_avx2,
+        string_body_avx2,
+        line_comment_avx2,
+        block_comment_avx2,
+        whitespace_avx2,
+        count_newlines_avx2,
+      };
+    case KernelLevel::sse42:
+      return {
+        level,
+        identifier_sse42,
+        string_body_sse42,
+        line_comment_sse42,
+        block_comment_sse42,
+        whitespace_sse42,
+        count_newlines_sse42,
+      };
+#endif
+    default:
+      return {
+        KernelLevel::scalar,
+        identifier_scalar,
+        string_body_scalar,
+        line_comment_scalar,
+        block_comment_scalar,
+        whitespace_scalar,
+        count_newlines_scalar,
+      };
+  }
+}
+
+// Parses the value of the override variable. Unknown names select the
+// detected level.
+export KernelLevel kernel_level_override(const char* name, KernelLevel detected) {
+  if (!name) {
+    return detected;
+  }
+  for (auto level : {KernelLevel::scalar, KernelLevel::sse42, KernelLevel::avx2, KernelLevel::avx512}) {
+    if (std::strcmp(name, kernel_level_name(level)) == 0) {
+      return std::min(level, detected);
+    }
+  }
+  return detected;
+}
+
+export const ScanKernels& scan_kernels() {
+  static const ScanKernels kernels = scan_kernels_for(
+    kernel_level_override(std::getenv("XXPARSEJS_KERNELS"), detect_kernel_level()));
+  return kernels;
+}
@@ -1,21 +1,252 @@
+module;
+
 #include <cassert>
 
+// MSVC ignores the standard attribute
+#if defined(_MSC_VER)
+#define SCANNER_NO_UNIQUE_ADDRESS [[msvc::no_unique_address]]
+#else
+#define SCANNER_NO_UNIQUE_ADDRESS [[no_unique_address]]
+#endif
+
 export module Scanner;
 
 import std.core;
 import BasicTypes;
 import Unicode;
-import Token;
+export import Token;
+import ScanKernels;
+import TokenNames;
 import TokenStartTable;
 import TokenTrie;
 
 using std::optional;
 
-export Token;
-
 export using SourcePosition = uint32;
 
+export struct SourceSpan {
+  SourcePosition start {0};
+  SourcePosition end {0};
+};
+
+// An iterator over text held in separate contiguous segments, such as the
+// pieces of a rope, which exposes the code units from its position to the
+// end of its segment. Skipping to the end of a segment moves to the start of
+// the next one. The end of a scan over segments is the default-constructed
+// iterator.
 export template<typename T>
+concept SegmentedIterator =
+  std::forward_iterator<T> &&
+  requires(T iter, const T& citer, size_t count) {
+    { citer.segment_first() } -> std::same_as<const std::iter_value_t<T>*>;
+    { citer.segment_last() } -> std::same_as<const std::iter_value_t<T>*>;
+    iter.skip(count);
+  };
+
+export enum class StrictMode : uint8 {
+  dynamic,                    // Selected with Scanner::set_strict_mode
+  sloppy,
+  strict,
+};
+
+// Scanner features which are fixed at compile time. Consumers derive from
+// ScannerPolicy and redefine the members they need; a feature which is turned
+// off adds no state to the scanner and no work to its hot paths.
+export struct ScannerPolicy {
+  static constexpr StrictMode strict_mode = StrictMode::dynamic;
+  static constexpr bool emit_comments = true;     // Otherwise comments are skipped
+  static constexpr bool emit_trivia = false;      // Return whitespace and line breaks
+  static constexpr bool decode_values = false;    // Cooked values of strings and templates
+  static constexpr bool track_lines = false;      // Line and column of each token
+  static constexpr bool recovery = true;          // Allow set_recovery
+  static constexpr bool collect_trivia = false;   // Allow set_trivia
+  static constexpr bool instrument = false;       // Allow set_stats
+};
+
+export enum class ScannerError : uint8 {
+  none,
+  unexpected_character,
+  invalid_hex_escape,
+  invalid_unicode_escape,
+  invalid_identifier_escape,
+  unterminated_string,
+  unterminated_comment,
+  unterminated_template,
+  unterminated_regexp,
+  missing_exponent,
+  invalid_octal_literal,
+  invalid_hex_literal,
+  invalid_binary_literal,
+  invalid_number_suffix,
+  legacy_octal_escape,
+  legacy_octal_number,
+};
+
+export const char* scanner_error_name(ScannerError error) {
+  switch (error) {
+    case ScannerError::none: return "none";
+    case ScannerError::unexpected_character: return "unexpected_character";
+    case ScannerError::invalid_hex_escape: return "invalid_hex_escape";
+    case ScannerError::invalid_unicode_escape: return "invalid_unicode_escape";
+    case ScannerError::invalid_identifier_escape: return "invalid_identifier_escape";
+    case ScannerError::unterminated_string: return "unterminated_string";
+    case ScannerError::unterminated_comment: return "unterminated_comment";
+    case ScannerError::unterminated_template: return "unterminated_template";
+    case ScannerError::unterminated_regexp: return "unterminated_regexp";
+    case ScannerError::missing_exponent: return "missing_exponent";
+    case ScannerError::invalid_octal_literal: return "invalid_octal_literal";
+    case ScannerError::invalid_hex_literal: return "invalid_hex_literal";
+    case ScannerError::invalid_binary_literal: return "invalid_binary_literal";
+    case ScannerError::invalid_number_suffix: return "invalid_number_suffix";
+    case ScannerError::legacy_octal_escape: return "legacy_octal_escape";
+    case ScannerError::legacy_octal_number: return "legacy_octal_number";
+  }
+  return "?";
+}
+
+// The last start type counts tokens which start above ASCII
+const char* token_start_type_name(size_t index) {
+  return index < std::size(token_start_type_names) ? token_start_type_names[index] : "non_ascii";
+}
+
+// Counts of the work done by a scanner, for finding the cause of a slow scan
+// without a profiler. Skipped comments and whitespace are counted as tokens.
+export struct ScannerStats {
+
+  static constexpr size_t token_count = size_t(Token::kw_end) + 1;
+  static constexpr size_t error_count = size_t(ScannerError::legacy_octal_number) + 1;
+
+  // The last entry counts tokens which start above ASCII
+  static constexpr size_t start_type_count = std::size(token_start_type_names) + 1;
+
+  std::array<uint64, start_type_count> start_types {};
+  std::array<uint64, token_count> tokens {};
+  std::array<uint64, token_count> token_code_units {};
+  std::array<uint64, error_count> errors {};
+  uint64 unicode_identifier_chars {0};  // Identifier code points above ASCII
+  uint64 escapes {0};                   // Escapes in strings and templates
+  uint64 unicode_escapes {0};           // "\u" in strings, templates and identifiers
+  uint64 newlines {0};                  // "\n" in the source, counted by the caller
+
+  void clear() {
+    *this = {};
+  }
+
+  // Adds the counts of another scanner, for totals over several sources
+  void add(const ScannerStats& other) {
+    for (size_t i = 0; i < start_type_count; ++i) {
+      start_types[i] += other.start_types[i];
+    }
+    for (size_t i = 0; i < token_count; ++i) {
+      tokens[i] += other.tokens[i];
+      token_code_units[i] += other.token_code_units[i];
+    }
+    for (size_t i = 0; i < error_count; ++i) {
+      errors[i] += other.errors[i];
+    }
+    unicode_identifier_chars += other.unicode_identifier_chars;
+    escapes += other.escapes;
+    unicode_escapes += other.unicode_escapes;
+    newlines += other.newlines;
+  }
+
+  // Zero counts are left out of the maps
+  std::string to_json() const {
+    std::string out = "{\"start_types\":{";
+    const char* separator = "";
+    for (size_t i = 0; i < start_type_count; ++i) {
+      if (start_types[i] > 0) {
+        out += separator;
+        append_count(out, token_start_type_name(i), start_types[i]);
+        separator = ",";
+      }
+    }
+
+    out += "},\"tokens\":{";
+    separator = "";
+    for (size_t i = 0; i < token_count; ++i) {
+      if (tokens[i] > 0) {
+        out += separator;
+        out += "\"";
+        out += token_name(Token(i));
+        out += "\":{";
+        append_count(out, "count", tokens[i]);
+        out += ",";
+        append_count(out, "code_units", token_code_units[i]);
+        out += "}";
+        separator = ",";
+      }
+    }
+
+    out += "},\"errors\":{";
+    separator = "";
+    for (size_t i = 1; i < error_count; ++i) {
+      if (errors[i] > 0) {
+        out += separator;
+        append_count(out, scanner_error_name(ScannerError(i)), errors[i]);
+        separator = ",";
+      }
+    }
+
+    out += "},";
+    append_count(out, "unicode_identifier_chars", unicode_identifier_chars);
+    out += ",";
+    append_count(out, "escapes", escapes);
+    out += ",";
+    append_count(out, "unicode_escapes", unicode_escapes);
+    out += ",";
+    append_count(out, "newlines", newlines);
+    out += "}";
+    return out;
+  }
+
+  static void append_count(std::string& out, const char* name, uint64 count) {
+    out += "\"";
+    out += name;
+    out += "\":";
+    out += std::to_string(count);
+  }
+
+};
+
+export enum class TriviaKind : uint8 {
+  whitespace,                 // A run of whitespace and line breaks
+  line_comment,
+  block_comment,
+  license_comment,            // A block comment starting with "/*!"
+};
+
+export struct Trivia {
+  TriviaKind kind {TriviaKind::whitespace};
+  SourcePosition start {0};
+  SourcePosition end {0};
+};
+
+// The trivia which precede a token, as indices into the trivia list
+export struct TriviaRange {
+  uint32 begin {0};
+  uint32 end {0};
+};
+
+// Stands in for the state of a feature which is turned off. Each feature
+// has its own empty type, so that none of them takes up space.
+template<typename State>
+struct ScannerFeatureOff {};
+
+struct ScannerTrivia {
+  std::vector<Trivia>* list {nullptr};
+  TriviaRange range;
+  TriviaKind comment_kind {TriviaKind::line_comment};
+};
+
+struct ScannerLines {
+  uint32 line {1};
+  SourcePosition line_start {0};
+  uint32 token_line {1};
+  SourcePosition token_column {0};
+};
+
+export template<typename T, typename Policy = ScannerPolicy>
 struct Scanner {
 
   enum class Context {
@@ -24,24 +255,7 @@ struct Scanner {
     div,
   };
 
-  enum class Error {
-    none,
-    unexpected_character,
-    invalid_hex_escape,
-    invalid_unicode_escape,
-    invalid_identifier_escape,
-    unterminated_string,
-    unterminated_comment,
-    unterminated_template,
-    unterminated_regexp,
-    missing_exponent,
-    invalid_octal_literal,
-    invalid_hex_literal,
-    invalid_binary_literal,
-    invalid_number_suffix,
-    legacy_octal_escape,
-    legacy_octal_number,
-  };
+  using Error = ScannerError;
 
   struct Result {
     Token token {Token::error};
@@ -52,29 +266,190 @@ struct Scanner {
     Error error {Error::none};
   };
 
-  Scanner(T& begin, T& end) : _iter {begin}, _end {end} {}
+  struct Diagnostic {
+    Error error {Error::none};
+    SourcePosition start {0};
+    SourcePosition end {0};
+  };
+
+  Scanner(const T& begin, const T& end) : _iter {begin}, _end {end} {
+    if constexpr (SegmentedIterator<T>) {
+      assert(end == T {});
+    }
+  }
 
   void set_strict_mode(bool strict_mode) {
+    static_assert(Policy::strict_mode == StrictMode::dynamic);
     _strict_mode = strict_mode;
   }
 
+  bool strict_mode() const {
+    if constexpr (Policy::strict_mode == StrictMode::dynamic) {
+      return _strict_mode;
+    } else {
+      return Policy::strict_mode == StrictMode::strict;
+    }
+  }
+
+  // In recovery mode errors are appended to the diagnostics list instead of
+  // producing Token::error. Malformed tokens are returned with their usual
+  // type, unterminated strings and regular expressions end at the line break,
+  // and unexpected characters are skipped. The list is shared by copies of
+  // the scanner; diagnostics at or after the position where a scanner resumes
+  // are discarded, so rescanning does not report errors twice.
+  void set_recovery(std::vector<Diagnostic>* diagnostics) {
+    static_assert(Policy::recovery);
+    _diagnostics = diagnostics;
+  }
+
+  // When a trivia list is given, the comments and whitespace which the
+  // scanner skips are appended to it and each token records the range of
+  // trivia before it. Like diagnostics, trivia at or after the position where
+  // a scanner resumes are discarded, so the list is shared by copies of the
+  // scanner.
+  void set_trivia(std::vector<Trivia>* trivia) {
+    static_assert(Policy::collect_trivia);
+    _trivia.list = trivia;
+  }
+
+  // Counts are added to the stats, which are shared by copies of the
+  // scanner. Tokens which a tokenizer rescans in another context are counted
+  // again.
+  void set_stats(ScannerStats* stats) {
+    static_assert(Policy::instrument);
+    _stats = stats;
+  }
+
+  // Continues scanning from the end of a token, where the iterator refers to
+  // the code unit at the given position. Line numbers cannot be recovered
+  // from a position, so line tracking is not supported.
+  void seek(const T& iter, SourcePosition position) {
+    static_assert(!Policy::track_lines);
+    _iter = iter;
+    _position = position;
+    _result = {};
+    _result.start = position;
+    _result.end = position;
+  }
+
+  // The number of code units after the current position, or zero if the
+  // iterator type cannot measure it
+  uint64 remaining() const {
+    if constexpr (std::random_access_iterator<T>) {
+      return uint64(_end - _iter);
+    } else {
+      return 0;
+    }
+  }
+
+  // The newline_before flag of a token is carried over from any comments and
+  // trivia returned before it
   Token next(Context context = Context::expression) {
-    if (_result.token != Token::comment) {
+    if (_result.token != Token::comment && _result.token != Token::whitespace) {
       _result.newline_before = false;
     }
 
-    _result.start = _position;
+    _result.keyword = Token::error;
     _result.error = Error::none;
 
+    if constexpr (Policy::recovery) {
+      if (_diagnostics) {
+        while (!_diagnostics->empty() && _diagnostics->back().start >= _position) {
+          _diagnostics->pop_back();
+        }
+      }
+    }
+
+    if constexpr (Policy::collect_trivia) {
+      if (auto list = _trivia.list) {
+        while (!list->empty() && list->back().start >= _position) {
+          list->pop_back();
+        }
+        _trivia.range.begin = uint32(list->size());
+      }
+    }
+
     while (true) {
+      _result.start = _position;
+      if constexpr (Policy::track_lines) {
+        _lines.token_line = _lines.line;
+        _lines.token_column = _position - _lines.line_start;
+      }
       start(context);
-      if (_result.token != Token::whitespace) {
+      record([&](ScannerStats& stats) {
+        stats.tokens[size_t(_result.token)] += 1;
+        stats.token_code_units[size_t(_result.token)] += _position - _result.start;
+      });
+      if (!skip_token(_result.token)) {
         _result.end = _position;
+        if constexpr (Policy::collect_trivia) {
+          if (_trivia.list) {
+            _trivia.range.end = uint32(_trivia.list->size());
+          }
+        }
         return _result.token;
       }
+      if constexpr (Policy::collect_trivia) {
+        if (_trivia.list) {
+          add_trivia();
+        }
+      }
+      _result.error = Error::none;
+    }
+  }
+
+  // Adjacent whitespace is merged into a single entry
+  void add_trivia() {
+    auto& list = *_trivia.list;
+    if (_result.token == Token::comment) {
+      list.push_back({_trivia.comment_kind, _result.start, _position});
+    } else if (
+      !list.empty() &&
+      list.back().kind == TriviaKind::whitespace &&
+      list.back().end == _result.start
+    ) {
+      list.back().end = _position;
+    } else {
+      list.push_back({TriviaKind::whitespace, _result.start, _position});
     }
   }
 
+  static bool skip_token(Token t) {
+    if (t == Token::whitespace) {
+      return !Policy::emit_trivia;
+    }
+    if (t == Token::comment) {
+      return !Policy::emit_comments;
+    }
+    return false;
+  }
+
+  const Result& result() const {
+    return _result;
+  }
+
+  // The cooked value of the current string or template token
+  const std::u32string& value() const {
+    static_assert(Policy::decode_values);
+    return _value;
+  }
+
+  TriviaRange trivia_range() const {
+    static_assert(Policy::collect_trivia);
+    return _trivia.range;
+  }
+
+  // The one-based line and zero-based column of the current token
+  uint32 line() const {
+    static_assert(Policy::track_lines);
+    return _lines.token_line;
+  }
+
+  uint32 column() const {
+    static_assert(Policy::track_lines);
+    return _lines.token_column;
+  }
+
   uint32 shift() {
     assert(_iter != _end);
     uint32 cp = *_iter;
@@ -102,18 +477,98 @@ struct Scanner {
     return _iter != _end;
   }
 
+  // Sources of single byte code units in contiguous memory are scanned with
+  // the vector kernels, which skip code units that need no other handling.
+  // Segmented sources run the kernels within each segment, and continue in
+  // the next segment when a kernel reaches the end of one.
+  static constexpr bool use_kernels =
+    (std::contiguous_iterator<T> || SegmentedIterator<T>) && sizeof(std::iter_value_t<T>) == 1;
+
+  // Selected once at startup, so that the hot loops do not check whether
+  // the table has been initialized
+  static inline const ScanKernels& _kernels = scan_kernels();
+
+  template<typename Kernel, typename... Args>
+  void skip_kernel(Kernel kernel, Args... args) {
+    if constexpr (use_kernels && std::contiguous_iterator<T>) {
+      auto first = reinterpret_cast<const uint8*>(std::to_address(_iter));
+      auto count = uint32(kernel(first, first + (_end - _iter), args...) - first);
+      _iter += count;
+      _position += count;
+    } else if constexpr (use_kernels) {
+      while (_iter != _end) {
+        auto first = reinterpret_cast<const uint8*>(_iter.segment_first());
+        auto last = reinterpret_cast<const uint8*>(_iter.segment_last());
+        auto stop = kernel(first, last, args...);
+        _iter.skip(size_t(stop - first));
+        _position += uint32(stop - first);
+        if (stop != last) {
+          break;
+        }
+      }
+    }
+  }
+
+  // Instrumentation is compiled out unless the policy enables it
+  template<typename F>
+  void record(F f) {
+    if constexpr (Policy::instrument) {
+      if (_stats) {
+        f(*_stats);
+      }
+    }
+  }
+
   void set_token(Token t) {
     _result.token = t;
   }
 
-  void set_error(Error error) {
+  // Counts an error in the stats and, in recovery mode, appends it to the
+  // diagnostics. Returns false if it was not recovered from.
+  bool report(Error error) {
     _result.error = error;
-    _result.token = Token::error;
+    record([&](ScannerStats& stats) { stats.errors[size_t(error)] += 1; });
+    if constexpr (Policy::recovery) {
+      if (_diagnostics) {
+        _diagnostics->push_back({error, _result.start, _position});
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void set_error(Error error) {
+    if (!report(error)) {
+      _result.token = Token::error;
+    }
   }
 
+  // Strict mode errors keep the token type, and are reported only in
+  // strict mode
   void set_strict_error(Error error) {
-    if (_strict_mode) {
-      _result.error = error;
+    if (strict_mode()) {
+      report(error);
+    }
+  }
+
+  void line_break() {
+    if constexpr (Policy::track_lines) {
+      ++_lines.line;
+      _lines.line_start = _position;
+    }
+  }
+
+  void clear_value() {
+    if constexpr (Policy::decode_values) {
+      _value.clear();
+    }
+  }
+
+  void append_value(optional<uint32> cp) {
+    if constexpr (Policy::decode_values) {
+      if (cp) {
+        _value.push_back(char32_t(*cp));
+      }
     }
   }
 
@@ -122,12 +577,26 @@ struct Scanner {
       return set_token(Token::end);
     }
 
-    if (auto cp = shift(); cp < 128) {
+    auto cp = shift();
+    record([&](ScannerStats& stats) {
+      size_t type = cp < 128
+        ? size_t(token_start_table[cp])
+        : ScannerStats::start_type_count - 1;
+      stats.start_types[type] += 1;
+    });
+
+    if (cp < 128) {
       switch (token_start_table[cp]) {
         case TokenStartType::punctuator:
           return punctuator(cp);
 
         case TokenStartType::whitespace:
+          // Whitespace which is not returned need not be split into tokens
+          if constexpr (!Policy::emit_trivia) {
+            if (auto next = peek(); next == ' ' || next == '\t') {
+              skip_kernel(_kernels.whitespace);
+            }
+          }
           return set_token(Token::whitespace);
 
         case TokenStartType::newline:
@@ -176,23 +645,38 @@ struct Scanner {
           return context == Context::template_string
             ? template_string(cp)
             : punctuator(cp);
+
+        case TokenStartType::error:
+          // An unexpected character, reported below
+          break;
       }
     } else if (is_newline_char(cp)) {
       return newline(cp);
     } else if (is_whitespace(cp)) {
       return set_token(Token::whitespace);
     } else if (is_identifier_start(cp)) {
+      record([](ScannerStats& stats) { stats.unicode_identifier_chars += 1; });
       return identifier(cp);
     }
 
+    set_token(Token::whitespace);
     set_error(Error::unexpected_character);
   }
 
+  // The trie matches ".." without a third dot as an error, which recovery
+  // returns as a dot
   void punctuator(uint32 cp) {
-    set_token(TokenTrie<Scanner>::match_punctuator(*this, cp));
+    Token t = TokenTrie<Scanner>::match_punctuator(*this, cp);
+    if (t == Token::error) {
+      set_token(Token::dot);
+      return set_error(Error::unexpected_character);
+    }
+    set_token(t);
   }
 
+  // Line breaks in template values are normalized to "\n"
   void template_string(uint32 cp) {
+    clear_value();
     while (can_shift()) {
       if (auto n = shift(); n == '`') {
         return set_token(cp == '`'
@@ -206,9 +690,18 @@ struct Scanner {
           : Token::template_middle
         );
       } else if (n == '\\') {
-        string_escape(false);
+        append_value(string_escape(false));
+      } else if (is_newline_char(n)) {
+        if (n == '\r' && peek() == '\n') {
+          advance();
+        }
+        line_break();
+        append_value(n == '\r' ? '\n' : n);
+      } else {
+        append_value(n);
       }
     }
+    set_token(cp == '`' ? Token::template_basic : Token::template_tail);
     set_error(Error::unterminated_template);
   }
 
@@ -217,14 +710,19 @@ struct Scanner {
     if (cp == '\r' && peek() == '\n') {
       advance();
     }
+    line_break();
     _result.newline_before = true;
   }
 
   void identifier(uint32 cp) {
     if (
       auto kw = TokenTrie<Scanner>::match_keyword(*this, cp);
+      kw == Token::error
+    ) {
+      set_token(Token::identifier);
+    } else if (
       kw > Token::kw_contextual_begin ||
-      !_strict_mode && kw > Token::kw_strict_begin
+      !strict_mode() && kw > Token::kw_strict_begin
     ) {
       set_token(Token::identifier);
       _result.keyword = kw;
@@ -234,10 +732,16 @@ struct Scanner {
 
     while (true) {
       if (auto n = peek(); is_identifier_part(n)) {
+        if (n >= 128) {
+          record([](ScannerStats& stats) { stats.unicode_identifier_chars += 1; });
+        }
         set_token(Token::identifier);
+        _result.keyword = Token::error;
         advance();
+        skip_kernel(_kernels.identifier);
       } else if (n == '\\') {
         set_token(Token::identifier);
+        _result.keyword = Token::error;
         advance();
         if (peek() != 'u') {
           return set_error(Error::invalid_identifier_escape);
@@ -287,11 +791,10 @@ struct Scanner {
     return false;
   }
 
-  void decimal_integer(uint32 cp) {
+  void decimal_integer([[maybe_unused]] uint32 cp) {
     assert(cp >= '0' && cp <= '9');
-    int val = cp - '0';
     while (peek_range('0', '9')) {
-      val = shift() - '0';
+      advance();
     }
   }
 
@@ -307,10 +810,10 @@ struct Scanner {
   }
 
   void octal_integer() {
+    set_token(Token::number);
     if (!peek_range('0', '7')) {
       return set_error(Error::invalid_octal_literal);
     }
-    set_token(Token::number);
     advance();
     while (true) {
       if (peek_range('0', '7')) {
@@ -325,10 +828,10 @@ struct Scanner {
   void hex_number() {
     assert(peek() == 'x');
     advance();
+    set_token(Token::number);
     if (!hex_char_value(peek())) {
       return set_error(Error::invalid_hex_literal);
     }
-    set_token(Token::number);
     advance();
     while (hex_char_value(peek())) {
       advance();
@@ -339,10 +842,10 @@ struct Scanner {
   void binary_number() {
     assert(peek() == 'b');
     advance();
+    set_token(Token::number);
     if (!peek_range('0', '1')) {
       return set_error(Error::invalid_binary_literal);
     }
-    set_token(Token::number);
     advance();
     while (true) {
       if (peek_range('0', '1')) {
@@ -371,10 +874,8 @@ struct Scanner {
     bool backslash = false;
     bool in_class = false;
 
-    while (can_shift()) {
-      if (auto n = shift(); is_newline_char(n)) {
-        break;
-      } else if (backslash) {
+    while (can_shift() && !is_newline_char(peek())) {
+      if (auto n = shift(); backslash) {
         backslash = false;
       } else if (n == '[') {
         in_class = true;
@@ -395,6 +896,7 @@ struct Scanner {
   void regexp_flags() {
     // TODO: this could be a unicode escape sequence as well
     // TODO: validate flags here?
+    skip_kernel(_kernels.identifier);
     while (is_identifier_part(peek())) {
       advance();
     }
@@ -404,7 +906,16 @@ struct Scanner {
     assert(peek() == '/');
     advance();
     set_token(Token::comment);
-    while (can_shift() && !is_newline_char(peek())) {
+    if constexpr (Policy::collect_trivia) {
+      _trivia.comment_kind = TriviaKind::line_comment;
+    }
+    while (true) {
+      skip_kernel(_kernels.line_comment);
+      // The kernels stop at code units above ASCII, which are taken one at
+      // a time before skipping again
+      if (!can_shift() || is_newline_char(peek())) {
+        break;
+      }
       advance();
     }
   }
@@ -413,11 +924,21 @@ struct Scanner {
     assert(peek() == '*');
     advance();
     set_token(Token::comment);
-    while (can_shift()) {
+    if constexpr (Policy::collect_trivia) {
+      _trivia.comment_kind = peek() == '!'
+        ? TriviaKind::license_comment
+        : TriviaKind::block_comment;
+    }
+    while (true) {
+      skip_kernel(_kernels.block_comment);
+      if (!can_shift()) {
+        break;
+      }
       if (auto cp = shift(); is_newline_char(cp)) {
         if (cp == '\r' && peek() == '\n') {
           advance();
         }
+        line_break();
         _result.newline_before = true;
       } else if (cp == '*' && peek() == '/') {
         advance();
@@ -429,19 +950,31 @@ struct Scanner {
 
   void string(uint32 delim) {
     set_token(Token::string);
-    while (can_shift()) {
+    clear_value();
+    while (true) {
+      // Decoded values are built one code unit at a time
+      if constexpr (!Policy::decode_values) {
+        skip_kernel(_kernels.string_body, uint8(delim));
+      }
+      if (!can_shift() || peek() == '\r' || peek() == '\n') {
+        break;
+      }
       if (auto n = shift(); n == delim) {
         return;
       } else if (n == '\\') {
-        string_escape(true);
-      } else if (n == '\r' || n == '\n') {
-        break;
+        append_value(string_escape(true));
+      } else {
+        if (n == 0x2028 || n == 0x2029) {
+          line_break();
+        }
+        append_value(n);
       }
     }
     set_error(Error::unterminated_string);
   }
 
   optional<uint32> string_escape(bool allow_legacy_octal = false) {
+    record([](ScannerStats& stats) { stats.escapes += 1; });
     if (!can_shift()) {
       return {};
     }
@@ -458,11 +991,13 @@ struct Scanner {
         if (peek() == '\n') {
           advance();
         }
+        line_break();
         return {};
 
       case '\n':
       case 0x2028:
       case 0x2029:
+        line_break();
         return {};
 
       case '0':
@@ -499,6 +1034,7 @@ struct Scanner {
   }
 
   optional<uint32> unicode_escape_sequence() {
+    record([](ScannerStats& stats) { stats.unicode_escapes += 1; });
     if (peek() == '{') {
       advance();
       if (auto v = string_escape_hex(1, 6); v && peek() == '}') {
@@ -552,13 +1088,13 @@ struct Scanner {
 
   static optional<uint32> hex_char_value(uint32 cp) {
     if (cp >= '0' && cp <= '9') {
-      return cp - 0;
+      return cp - '0';
     }
     if (cp >= 'A' && cp <= 'F') {
-      return cp - 'A';
+      return cp - 'A' + 10;
     }
     if (cp >= 'a' && cp <= 'f') {
-      return cp - 'a';
+      return cp - 'a' + 10;
     }
     return {};
   }
@@ -574,10 +1110,34 @@ struct Scanner {
     return false;
   }
 
+  template<bool enabled, typename State>
+  using Feature = std::conditional_t<enabled, State, ScannerFeatureOff<State>>;
+
   T _iter;
   T _end;
-  bool _strict_mode {false};
+  SCANNER_NO_UNIQUE_ADDRESS Feature<Policy::strict_mode == StrictMode::dynamic, bool> _strict_mode {};
   SourcePosition _position {0};
   Result _result;
+  SCANNER_NO_UNIQUE_ADDRESS Feature<Policy::recovery, std::vector<Diagnostic>*> _diagnostics {};
+  SCANNER_NO_UNIQUE_ADDRESS Feature<Policy::decode_values, std::u32string> _value;
+  SCANNER_NO_UNIQUE_ADDRESS Feature<Policy::track_lines, ScannerLines> _lines;
+  SCANNER_NO_UNIQUE_ADDRESS Feature<Policy::collect_trivia, ScannerTrivia> _trivia;
+  SCANNER_NO_UNIQUE_ADDRESS Feature<Policy::instrument, ScannerStats*> _stats {};
 
 };
+
+// With every feature turned off, a scanner holds only its position and the
+// current token
+struct ScannerLeanPolicy : ScannerPolicy {
+  static constexpr StrictMode strict_mode = StrictMode::sloppy;
+  static constexpr bool recovery = false;
+};
+
+struct ScannerLeanLayout {
+  const uint8* iter;
+  const uint8* end;
+  SourcePosition position;
+  Scanner<const uint8*, ScannerLeanPolicy>::Result result;
+};
+
+static_assert(sizeof(Scanner<const uint8*, ScannerLeanPolicy>) == sizeof(ScannerLeanLayout));
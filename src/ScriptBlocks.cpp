@@ -0,0 +1,256 @@
+module;
+
+#include <cassert>
+#include <string.h>
+
+export module ScriptBlocks;
+
+import std.core;
+import BasicTypes;
+import Scanner;
+
+// Finds the <script> elements of HTML documents and of single-file
+// components such as Vue and Svelte files, so that their code can be scanned
+// in place. Positions are offsets into the host file, in its code units.
+//
+// Script content ends at the first "</script" followed by whitespace, "/" or
+// ">", whatever its case. Comments are skipped, so scripts which are
+// commented out are not found; the escaped script states of HTML, in which
+// "<!--" inside a script hides an end tag, are not modelled.
+
+export enum class ScriptKind : uint8 {
+  classic,                    // A script without a type, or with a JavaScript type
+  module,                     // type="module"
+  other,                      // Another type or language, such as JSON or TypeScript
+};
+
+export struct ScriptBlock {
+  SourceSpan tag;             // The start tag, from "<" to ">"
+  SourceSpan content;         // The code between the start and end tags
+  ScriptKind kind {ScriptKind::classic};
+  bool terminated {true};     // False if the content runs to the end of the file
+};
+
+template<typename C>
+const C* find_markup_unit(const C* first, const C* last, C c) {
+  if constexpr (sizeof(C) == 1) {
+    auto found = ::memchr(first, c, size_t(last - first));
+    return found ? static_cast<const C*>(found) : last;
+  } else {
+    return std::find(first, last, c);
+  }
+}
+
+bool is_markup_space(char32_t c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f';
+}
+
+char32_t markup_lower(char32_t c) {
+  return c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c;
+}
+
+// True if the text starts with the lower case ASCII name, in any case
+template<typename C>
+bool markup_starts_with(const C* first, const C* last, std::string_view name) {
+  if (size_t(last - first) < name.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < name.size(); ++i) {
+    if (markup_lower(char32_t(first[i])) != char32_t(name[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// True if a tag with the name starts at p, where the name includes "<" or
+// "</"
+template<typename C>
+bool is_markup_tag(const C* p, const C* last, std::string_view name) {
+  if (!markup_starts_with(p, last, name) || size_t(last - p) == name.size()) {
+    return false;
+  }
+  char32_t next = p[name.size()];
+  return is_markup_space(next) || next == '/' || next == '>';
+}
+
+template<typename C>
+bool markup_equals(const C* first, const C* last, std::string_view value) {
+  return size_t(last - first) == value.size() && markup_starts_with(first, last, value);
+}
+
+ScriptKind script_type_kind(auto first, auto last) {
+  while (first != last && is_markup_space(*first)) {
+    ++first;
+  }
+  while (first != last && is_markup_space(last[-1])) {
+    --last;
+  }
+  if (first == last) {
+    return ScriptKind::classic;
+  }
+  if (markup_equals(first, last, "module")) {
+    return ScriptKind::module;
+  }
+  static constexpr std::string_view javascript_types[] = {
+    "text/javascript",
+    "application/javascript",
+    "text/ecmascript",
+    "application/ecmascript",
+    "application/x-javascript",
+    "text/x-javascript",
+    "text/jscript",
+  };
+  for (auto type : javascript_types) {
+    if (markup_equals(first, last, type)) {
+      return ScriptKind::classic;
+    }
+  }
+  return ScriptKind::other;
+}
+
+ScriptKind script_lang_kind(auto first, auto last) {
+  bool javascript =
+    markup_equals(first, last, "js") ||
+    markup_equals(first, last, "mjs") ||
+    markup_equals(first, last, "javascript");
+  if (javascript) {
+    return ScriptKind::classic;
+  }
+  return ScriptKind::other;
+}
+
+// Reads the attributes of a start tag from after its name. Returns the
+// position after the closing ">", or null if the tag is not closed.
+template<typename C>
+const C* script_attributes(const C* p, const C* last, ScriptKind& kind) {
+  kind = ScriptKind::classic;
+  ScriptKind lang = ScriptKind::classic;
+  while (true) {
+    while (p != last && (is_markup_space(*p) || *p == '/')) {
+      ++p;
+    }
+    if (p == last) {
+      return nullptr;
+    }
+    if (*p == '>') {
+      if (lang == ScriptKind::other) {
+        kind = ScriptKind::other;
+      }
+      return p + 1;
+    }
+
+    const C* name = p;
+    while (p != last && !is_markup_space(*p) && *p != '=' && *p != '>' && *p != '/') {
+      ++p;
+    }
+    const C* name_end = p;
+    while (p != last && is_markup_space(*p)) {
+      ++p;
+    }
+    if (p == last || *p != '=') {
+      continue;
+    }
+    ++p;
+    while (p != last && is_markup_space(*p)) {
+      ++p;
+    }
+    if (p == last) {
+      return nullptr;
+    }
+
+    const C* value = p;
+    const C* value_end;
+    if (*p == '"' || *p == '\'') {
+      value = p + 1;
+      value_end = find_markup_unit(value, last, *p);
+      if (value_end == last) {
+        return nullptr;
+      }
+      p = value_end + 1;
+    } else {
+      while (p != last && !is_markup_space(*p) && *p != '>') {
+        ++p;
+      }
+      value_end = p;
+    }
+
+    if (markup_equals(name, name_end, "type")) {
+      kind = script_type_kind(value, value_end);
+    } else if (markup_equals(name, name_end, "lang")) {
+      lang = script_lang_kind(value, value_end);
+    }
+  }
+}
+
+// Appends the script blocks of the host text to the list. Code units are
+// bytes or code points; in either case the search for "<" runs over the
+// whole text at once. JavaScript blocks without type="module" are given the
+// default kind; the scripts of single-file components are modules, so
+// callers pass ScriptKind::module for those.
+export template<typename C>
+void find_script_blocks(
+  const C* first,
+  const C* last,
+  std::vector<ScriptBlock>& blocks,
+  ScriptKind default_kind = ScriptKind::classic)
+{
+  static_assert(sizeof(C) == 1 || sizeof(C) == 4);
+  auto offset = [first](const C* p) { return SourcePosition(p - first); };
+
+  const C* p = first;
+  while ((p = find_markup_unit(p, last, C('<'))) != last) {
+    if (markup_starts_with(p, last, "<!--")) {
+      p += 4;
+      while ((p = find_markup_unit(p, last, C('-'))) != last && !markup_starts_with(p, last, "-->")) {
+        ++p;
+      }
+      p = p == last ? last : p + 3;
+      continue;
+    }
+    if (!is_markup_tag(p, last, "<script")) {
+      ++p;
+      continue;
+    }
+
+    ScriptBlock block;
+    const C* content = script_attributes(p + 7, last, block.kind);
+    if (!content) {
+      return;
+    }
+    if (block.kind == ScriptKind::classic) {
+      block.kind = default_kind;
+    }
+    block.tag = {offset(p), offset(content)};
+
+    // The content ends at the first end tag
+    const C* end = content;
+    while ((end = find_markup_unit(end, last, C('<'))) != last && !is_markup_tag(end, last, "</script")) {
+      ++end;
+    }
+    block.content = {offset(content), offset(end)};
+    block.terminated = end != last;
+    blocks.push_back(block);
+
+    if (end == last) {
+      return;
+    }
+    p = find_markup_unit(end, last, C('>'));
+  }
+}
+
+// A scanner over the content of a script block, given the start of the host
+// text. The block is scanned in place, and token positions are offsets into
+// the host. Line tracking is not supported, since the scanner resumes at an
+// offset (see Scanner::seek). Module code is strict, so module blocks are
+// scanned in strict mode when the policy allows it to be selected.
+export template<typename Policy = ScannerPolicy, typename I>
+Scanner<I, Policy> script_scanner(I host, const ScriptBlock& block) {
+  static_assert(std::random_access_iterator<I>);
+  Scanner<I, Policy> scanner {host + block.content.start, host + block.content.end};
+  scanner.seek(host + block.content.start, block.content.start);
+  if constexpr (Policy::strict_mode == StrictMode::dynamic) {
+    scanner.set_strict_mode(block.kind == ScriptKind::module);
+  }
+  return scanner;
+}
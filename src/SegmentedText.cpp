@@ -0,0 +1,168 @@
+module;
+
+#include <cassert>
+
+export module SegmentedText;
+
+import std.core;
+import BasicTypes;
+
+// A source held in separate pieces, such as the leaves of a rope or the
+// spans of a piece table, which the scanner reads without copying them into
+// one buffer. The text refers to the pieces, which must outlive it and its
+// iterators and must not change while they are in use; after an edit the
+// list is rebuilt, at the cost of one entry per piece.
+//
+// Iterators expose the rest of their piece (see SegmentedIterator), so that
+// the scanner runs its kernels within a piece and steps to the next at its
+// end. Positions are offsets into the whole text.
+
+export template<typename C>
+struct SegmentedText;
+
+export template<typename C>
+struct SegmentIterator {
+
+  using value_type = C;
+  using difference_type = std::ptrdiff_t;
+  using iterator_concept = std::forward_iterator_tag;
+  using iterator_category = std::forward_iterator_tag;
+
+  SegmentIterator() = default;
+
+  SegmentIterator(const SegmentedText<C>* text, size_t index, size_t offset) :
+    _text {text}
+  {
+    enter(index, offset);
+  }
+
+  C operator*() const {
+    assert(_p != _limit);
+    return *_p;
+  }
+
+  SegmentIterator& operator++() {
+    assert(_p != _limit);
+    if (++_p == _limit) {
+      enter(_index + 1, 0);
+    }
+    return *this;
+  }
+
+  SegmentIterator operator++(int) {
+    SegmentIterator copy = *this;
+    ++*this;
+    return copy;
+  }
+
+  bool operator==(const SegmentIterator& other) const {
+    return _p == other._p;
+  }
+
+  // Moves by an offset, finding the piece with a binary search, so that a
+  // scan can resume in the middle of the text
+  SegmentIterator operator+(difference_type n) const {
+    return _text->at(offset() + uint64(n));
+  }
+
+  // The offset in the whole text
+  uint64 offset() const {
+    if (!_p) {
+      return _text ? _text->size() : 0;
+    }
+    return _text->_segments[_index].offset + uint64(_p - _text->_segments[_index].data);
+  }
+
+  const C* segment_first() const {
+    return _p;
+  }
+
+  const C* segment_last() const {
+    return _limit;
+  }
+
+  void skip(size_t count) {
+    assert(count <= size_t(_limit - _p));
+    _p += count;
+    if (_p == _limit) {
+      enter(_index + 1, 0);
+    }
+  }
+
+  void enter(size_t index, size_t offset) {
+    // Pieces are never empty, so the iterator only stops at the end
+    if (index < _text->_segments.size()) {
+      auto& segment = _text->_segments[index];
+      _index = index;
+      _p = segment.data + offset;
+      _limit = segment.data + segment.size;
+    } else {
+      _p = nullptr;
+      _limit = nullptr;
+    }
+  }
+
+  const SegmentedText<C>* _text {nullptr};
+  size_t _index {0};
+  const C* _p {nullptr};
+  const C* _limit {nullptr};
+
+};
+
+export template<typename C>
+struct SegmentedText {
+
+  struct Segment {
+    const C* data;
+    size_t size;
+    uint64 offset;    // The offset of the first code unit in the text
+  };
+
+  // Empty pieces are dropped
+  void append(const C* data, size_t size) {
+    if (size > 0) {
+      _segments.push_back({data, size, _size});
+      _size += size;
+    }
+  }
+
+  void clear() {
+    _segments.clear();
+    _size = 0;
+  }
+
+  uint64 size() const {
+    return _size;
+  }
+
+  size_t segment_count() const {
+    return _segments.size();
+  }
+
+  SegmentIterator<C> begin() const {
+    return {this, 0, 0};
+  }
+
+  SegmentIterator<C> end() const {
+    return {};
+  }
+
+  // The iterator at an offset, which may be the size of the text
+  SegmentIterator<C> at(uint64 offset) const {
+    assert(offset <= _size);
+    if (offset == _size) {
+      return end();
+    }
+    auto segment = std::upper_bound(
+      _segments.begin(),
+      _segments.end(),
+      offset,
+      [](uint64 value, const Segment& s) { return value < s.offset; });
+    --segment;
+    return {this, size_t(segment - _segments.begin()), size_t(offset - segment->offset)};
+  }
+
+  std::vector<Segment> _segments;
+  uint64 _size {0};
+
+};
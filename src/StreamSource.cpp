@@ -0,0 +1,279 @@
+module;
+
+#include <cassert>
+
+export module StreamSource;
+
+import std.core;
+import BasicTypes;
+import Unicode;
+
+// A source which is produced incrementally, such as the output of a
+// decompressor, read through fixed-size blocks. The blocks form a list which
+// is extended as iterators reach its end, and each iterator holds a reference
+// to its block, so a block is released as soon as no iterator is positioned
+// in or before it. Scanning a stream therefore keeps only the blocks between
+// the start of the current token and the scan position, and their buffers
+// are reused for the blocks which follow.
+//
+// The scanner counts positions itself, so token positions are offsets into
+// the whole stream whatever the block boundaries.
+
+template<typename C>
+struct StreamBlock;
+
+// The interface through which an iterator extends the block list
+template<typename C>
+struct StreamBlocks {
+
+  virtual ~StreamBlocks() = default;
+
+  // Returns the next block, or null at the end of the stream
+  virtual std::shared_ptr<StreamBlock<C>> load() = 0;
+
+  virtual void recycle(std::unique_ptr<C[]> buffer) = 0;
+
+};
+
+template<typename C>
+struct StreamBlock {
+
+  StreamBlock(StreamBlocks<C>* owner, std::unique_ptr<C[]> buffer, size_t size) :
+    owner {owner},
+    buffer {std::move(buffer)},
+    size {size}
+  {}
+
+  StreamBlock(const StreamBlock&) = delete;
+  StreamBlock& operator=(const StreamBlock&) = delete;
+
+  ~StreamBlock() {
+    owner->recycle(std::move(buffer));
+  }
+
+  StreamBlocks<C>* owner;
+  std::unique_ptr<C[]> buffer;
+  size_t size;
+  std::shared_ptr<StreamBlock> next;
+  bool loaded {false};    // True once next has been loaded
+
+};
+
+// A forward iterator over the code units of a stream. Iterators other than
+// the end iterator always point to a code unit, so reaching the end of a
+// block loads the next one.
+export template<typename C>
+struct StreamIterator {
+
+  using value_type = C;
+  using difference_type = std::ptrdiff_t;
+  using iterator_concept = std::forward_iterator_tag;
+  using iterator_category = std::forward_iterator_tag;
+
+  StreamIterator() = default;
+
+  explicit StreamIterator(std::shared_ptr<StreamBlock<C>> block) {
+    enter(std::move(block));
+  }
+
+  C operator*() const {
+    assert(_p != _limit);
+    return *_p;
+  }
+
+  StreamIterator& operator++() {
+    assert(_p != _limit);
+    if (++_p == _limit) {
+      next_block();
+    }
+    return *this;
+  }
+
+  StreamIterator operator++(int) {
+    StreamIterator copy = *this;
+    ++*this;
+    return copy;
+  }
+
+  bool operator==(const StreamIterator& other) const {
+    return _p == other._p;
+  }
+
+  // The rest of the current block, which lets the scanner run its kernels
+  // over streamed bytes (see SegmentedIterator)
+  const C* segment_first() const {
+    return _p;
+  }
+
+  const C* segment_last() const {
+    return _limit;
+  }
+
+  void skip(size_t count) {
+    assert(count <= size_t(_limit - _p));
+    _p += count;
+    if (_p == _limit) {
+      next_block();
+    }
+  }
+
+  void next_block() {
+    StreamBlock<C>& block = *_block;
+    if (!block.loaded) {
+      block.next = block.owner->load();
+      block.loaded = true;
+    }
+    enter(block.next);
+  }
+
+  void enter(std::shared_ptr<StreamBlock<C>> block) {
+    if (block && block->size > 0) {
+      _p = block->buffer.get();
+      _limit = _p + block->size;
+      _block = std::move(block);
+    } else {
+      *this = {};
+    }
+  }
+
+  const C* _p {nullptr};
+  const C* _limit {nullptr};
+  std::shared_ptr<StreamBlock<C>> _block;
+
+};
+
+// Reads the output of a decoder into blocks of block_size code units. A
+// decoder provides size_t read(uint8* out, size_t size), which returns zero
+// at the end of its output. Byte code units are copied as they are; char32_t
+// code units are decoded from UTF-8, with sequences which span reads joined.
+//
+// The source must outlive its iterators.
+export template<typename C, typename Decoder>
+struct StreamSource : StreamBlocks<C> {
+
+  static_assert(std::is_same_v<C, uint8> || std::is_same_v<C, char32_t>);
+
+  static constexpr size_t default_block_size = 64 << 10;
+
+  explicit StreamSource(Decoder& decoder, size_t block_size = default_block_size) :
+    _decoder {decoder},
+    _block_size {block_size}
+  {
+    // Room for the longest UTF-8 sequence
+    assert(block_size >= 4);
+  }
+
+  StreamSource(const StreamSource&) = delete;
+  StreamSource& operator=(const StreamSource&) = delete;
+
+  // Loads the first block; begin may be called only once
+  StreamIterator<C> begin() {
+    assert(_units_read == 0);
+    return StreamIterator<C> {load()};
+  }
+
+  StreamIterator<C> end() const {
+    return {};
+  }
+
+  std::shared_ptr<StreamBlock<C>> load() override {
+    std::unique_ptr<C[]> buffer;
+    if (_free.empty()) {
+      buffer = std::make_unique<C[]>(_block_size);
+      ++_buffers_allocated;
+    } else {
+      buffer = std::move(_free.back());
+      _free.pop_back();
+    }
+
+    size_t size = fill(buffer.get());
+    _units_read += size;
+    if (size == 0) {
+      _free.push_back(std::move(buffer));
+      return nullptr;
+    }
+    return std::make_shared<StreamBlock<C>>(this, std::move(buffer), size);
+  }
+
+  void recycle(std::unique_ptr<C[]> buffer) override {
+    _free.push_back(std::move(buffer));
+  }
+
+  size_t fill(C* out) {
+    if constexpr (std::is_same_v<C, uint8>) {
+      size_t size = 0;
+      while (size < _block_size) {
+        size_t n = _decoder.read(out + size, _block_size - size);
+        if (n == 0) {
+          break;
+        }
+        size += n;
+      }
+      return size;
+    } else {
+      // Bytes are read into a staging buffer, after any partial sequence
+      // left from the last read, and decoded while the block has room
+      if (!_bytes) {
+        _bytes = std::make_unique<uint8[]>(_block_size);
+      }
+      size_t size = 0;
+      while (size < _block_size) {
+        if (_byte_first == _byte_last) {
+          _byte_first = 0;
+          _byte_last = 0;
+        }
+        if (!_at_end && _byte_last < _block_size) {
+          size_t n = _decoder.read(_bytes.get() + _byte_last, _block_size - _byte_last);
+          _byte_last += n;
+          _at_end = n == 0;
+        }
+
+        // At most one code point is decoded from each byte
+        size_t available = _byte_last - _byte_first;
+        bool limited = available > _block_size - size;
+        const uint8* first = _bytes.get() + _byte_first;
+        const uint8* last = first + (limited ? _block_size - size : available);
+        size_t count = decode_utf8(first, last, out + size, _at_end && !limited);
+        size += count;
+        _byte_first = size_t(first - _bytes.get());
+
+        if (_byte_first == _byte_last && _at_end) {
+          break;
+        }
+        if (count == 0 && limited) {
+          // The next sequence does not fit in the rest of the block
+          break;
+        }
+        if (_byte_last == _block_size && _byte_first > 0) {
+          // Move a partial sequence to the front to make room
+          std::memmove(_bytes.get(), _bytes.get() + _byte_first, _byte_last - _byte_first);
+          _byte_last -= _byte_first;
+          _byte_first = 0;
+        }
+      }
+      return size;
+    }
+  }
+
+  // The number of code units produced by the decoder so far
+  uint64 units_read() const {
+    return _units_read;
+  }
+
+  // The number of block buffers allocated, which stays constant once scanning
+  // reaches a steady state
+  size_t buffers_allocated() const {
+    return _buffers_allocated;
+  }
+
+  Decoder& _decoder;
+  size_t _block_size;
+  std::vector<std::unique_ptr<C[]>> _free;
+  size_t _buffers_allocated {0};
+  uint64 _units_read {0};
+  std::unique_ptr<uint8[]> _bytes;
+  size_t _byte_first {0};
+  size_t _byte_last {0};
+  bool _at_end {false};
+
+};
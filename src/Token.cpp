@@ -1,6 +1,8 @@
 export module Token;
 
-export enum class Token {
+import BasicTypes;
+
+export enum class Token : uint8 {
   end,
   error,
   comment,
@@ -0,0 +1,179 @@
+module;
+
+#include <cassert>
+
+export module TokenBuffer;
+
+import std.core;
+import BasicTypes;
+import Scanner;
+
+// A scanned token packed into eight bytes. The detail byte holds the scanner
+// error when the error flag is set, and the keyword of the token otherwise.
+// Lengths which do not fit in the length field are kept by the TokenBuffer
+// which owns the record.
+export struct TokenRecord {
+
+  static constexpr uint16 length_mask = (1 << 14) - 1;
+  static constexpr uint16 flag_newline_before = 1 << 14;
+  static constexpr uint16 flag_error = 1 << 15;
+
+  Token token {Token::end};
+  uint8 detail {0};
+  uint16 bits {0};
+  SourcePosition start {0};
+
+  Token keyword() const {
+    return has_error() ? Token::error : Token(detail);
+  }
+
+  bool newline_before() const {
+    return (bits & flag_newline_before) != 0;
+  }
+
+  bool has_error() const {
+    return (bits & flag_error) != 0;
+  }
+
+  // True if the length is stored outside of the record
+  bool is_long() const {
+    return (bits & length_mask) == length_mask;
+  }
+
+};
+
+static_assert(sizeof(TokenRecord) == 8);
+
+// Stores a token stream in packed form. Scanner results are packed with
+// push_back and restored with result, for any scanner instantiation.
+export struct TokenBuffer {
+
+  struct LongLength {
+    uint32 index;
+    uint32 length;
+  };
+
+  template<typename Result>
+  void push_back(const Result& result) {
+    using Error = decltype(result.error);
+
+    uint32 length = result.end - result.start;
+    TokenRecord record;
+    record.token = result.token;
+    record.start = result.start;
+
+    if (length < TokenRecord::length_mask) {
+      record.bits = uint16(length);
+    } else {
+      record.bits = TokenRecord::length_mask;
+      _long_lengths.push_back({size(), length});
+    }
+
+    if (result.newline_before) {
+      record.bits |= TokenRecord::flag_newline_before;
+    }
+
+    if (result.error != Error::none) {
+      record.bits |= TokenRecord::flag_error;
+      record.detail = uint8(result.error);
+    } else {
+      record.detail = uint8(result.keyword);
+    }
+
+    _records.push_back(record);
+  }
+
+  template<typename Result>
+  Result result(uint32 index) const {
+    using Error = decltype(Result::error);
+
+    const TokenRecord& record = _records[index];
+    Result result;
+    result.token = record.token;
+    result.keyword = record.keyword();
+    result.start = record.start;
+    result.end = record.start + length(index);
+    result.newline_before = record.newline_before();
+    result.error = record.has_error() ? Error(record.detail) : Error::none;
+    return result;
+  }
+
+  const TokenRecord& operator[](uint32 index) const {
+    assert(index < _records.size());
+    return _records[index];
+  }
+
+  uint32 length(uint32 index) const {
+    const TokenRecord& record = (*this)[index];
+    if (!record.is_long()) {
+      return record.bits & TokenRecord::length_mask;
+    }
+    // Long lengths are appended in index order
+    auto iter = std::lower_bound(
+      _long_lengths.begin(),
+      _long_lengths.end(),
+      index,
+      [](const LongLength& entry, uint32 index) { return entry.index < index; });
+    assert(iter != _long_lengths.end() && iter->index == index);
+    return iter->length;
+  }
+
+  SourcePosition end(uint32 index) const {
+    return (*this)[index].start + length(index);
+  }
+
+  uint32 size() const {
+    return uint32(_records.size());
+  }
+
+  void reserve(uint32 count) {
+    _records.reserve(count);
+  }
+
+  // Replaces count records starting at first with the records of another
+  // buffer. The records after the replaced range are moved by shift code
+  // units, for an edit which changed the length of the source.
+  void replace(uint32 first, uint32 count, const TokenBuffer& tokens, int32 shift) {
+    uint32 last = first + count;
+    assert(last <= size());
+
+    for (uint32 i = last; i < size(); ++i) {
+      _records[i].start += SourcePosition(shift);
+    }
+    _records.erase(_records.begin() + first, _records.begin() + last);
+    _records.insert(_records.begin() + first, tokens._records.begin(), tokens._records.end());
+
+    // The new index of the first record after the replaced range
+    uint32 moved_first = first + tokens.size();
+    std::vector<LongLength> long_lengths;
+    for (auto& entry : _long_lengths) {
+      if (entry.index < first) {
+        long_lengths.push_back(entry);
+      }
+    }
+    for (auto& entry : tokens._long_lengths) {
+      long_lengths.push_back({entry.index + first, entry.length});
+    }
+    for (auto& entry : _long_lengths) {
+      if (entry.index >= last) {
+        long_lengths.push_back({entry.index - last + moved_first, entry.length});
+      }
+    }
+    _long_lengths = std::move(long_lengths);
+  }
+
+  void clear() {
+    _records.clear();
+    _long_lengths.clear();
+  }
+
+  size_t bytes_used() const {
+    return
+      _records.capacity() * sizeof(TokenRecord) +
+      _long_lengths.capacity() * sizeof(LongLength);
+  }
+
+  std::vector<TokenRecord> _records;
+  std::vector<LongLength> _long_lengths;
+
+};
@@ -0,0 +1,127 @@
+// Generated by tools/generate-token-strings.js 2026-10-18
+export module TokenNames;
+
+import Token;
+
+export const char* token_name(Token t) {
+  switch (t) {
+    case Token::end: return "end";
+    case Token::error: return "error";
+    case Token::comment: return "comment";
+    case Token::identifier: return "identifier";
+    case Token::whitespace: return "whitespace";
+    case Token::template_basic: return "template_basic";
+    case Token::template_head: return "template_head";
+    case Token::template_middle: return "template_middle";
+    case Token::template_tail: return "template_tail";
+    case Token::string: return "string";
+    case Token::regexp: return "regexp";
+    case Token::number: return "number";
+    case Token::left_brace: return "left_brace";
+    case Token::right_brace: return "right_brace";
+    case Token::left_paren: return "left_paren";
+    case Token::right_paren: return "right_paren";
+    case Token::left_bracket: return "left_bracket";
+    case Token::right_bracket: return "right_bracket";
+    case Token::semicolon: return "semicolon";
+    case Token::colon: return "colon";
+    case Token::comma: return "comma";
+    case Token::question: return "question";
+    case Token::bitwise_and: return "bitwise_and";
+    case Token::bitwise_and_assign: return "bitwise_and_assign";
+    case Token::bitwise_or: return "bitwise_or";
+    case Token::bitwise_or_assign: return "bitwise_or_assign";
+    case Token::bitwise_xor: return "bitwise_xor";
+    case Token::bitwise_xor_assign: return "bitwise_xor_assign";
+    case Token::bitwise_not: return "bitwise_not";
+    case Token::bitwise_not_assign: return "bitwise_not_assign";
+    case Token::left_shift: return "left_shift";
+    case Token::left_shift_assign: return "left_shift_assign";
+    case Token::left_shift_zero: return "left_shift_zero";
+    case Token::left_shift_zero_assign: return "left_shift_zero_assign";
+    case Token::right_shift: return "right_shift";
+    case Token::right_shift_assign: return "right_shift_assign";
+    case Token::right_shift_zero: return "right_shift_zero";
+    case Token::right_shift_zero_assign: return "right_shift_zero_assign";
+    case Token::plus: return "plus";
+    case Token::plus_assign: return "plus_assign";
+    case Token::minus: return "minus";
+    case Token::minus_assign: return "minus_assign";
+    case Token::multiply: return "multiply";
+    case Token::multiply_assign: return "multiply_assign";
+    case Token::divide: return "divide";
+    case Token::divide_assign: return "divide_assign";
+    case Token::mod: return "mod";
+    case Token::mod_assign: return "mod_assign";
+    case Token::pow: return "pow";
+    case Token::pow_assign: return "pow_assign";
+    case Token::logical_and: return "logical_and";
+    case Token::logical_or: return "logical_or";
+    case Token::logical_not: return "logical_not";
+    case Token::less_than: return "less_than";
+    case Token::less_than_equal: return "less_than_equal";
+    case Token::greater_than: return "greater_than";
+    case Token::greater_than_equal: return "greater_than_equal";
+    case Token::assign: return "assign";
+    case Token::equal: return "equal";
+    case Token::strict_equal: return "strict_equal";
+    case Token::not_equal: return "not_equal";
+    case Token::strict_not_equal: return "strict_not_equal";
+    case Token::increment: return "increment";
+    case Token::decrement: return "decrement";
+    case Token::dot: return "dot";
+    case Token::dot_3: return "dot_3";
+    case Token::fat_arrow: return "fat_arrow";
+    case Token::kw_break: return "kw_break";
+    case Token::kw_case: return "kw_case";
+    case Token::kw_catch: return "kw_catch";
+    case Token::kw_class: return "kw_class";
+    case Token::kw_const: return "kw_const";
+    case Token::kw_continue: return "kw_continue";
+    case Token::kw_debugger: return "kw_debugger";
+    case Token::kw_default: return "kw_default";
+    case Token::kw_delete: return "kw_delete";
+    case Token::kw_do: return "kw_do";
+    case Token::kw_else: return "kw_else";
+    case Token::kw_enum: return "kw_enum";
+    case Token::kw_export: return "kw_export";
+    case Token::kw_extends: return "kw_extends";
+    case Token::kw_false: return "kw_false";
+    case Token::kw_finally: return "kw_finally";
+    case Token::kw_for: return "kw_for";
+    case Token::kw_function: return "kw_function";
+    case Token::kw_if: return "kw_if";
+    case Token::kw_import: return "kw_import";
+    case Token::kw_in: return "kw_in";
+    case Token::kw_instanceof: return "kw_instanceof";
+    case Token::kw_new: return "kw_new";
+    case Token::kw_null: return "kw_null";
+    case Token::kw_return: return "kw_return";
+    case Token::kw_super: return "kw_super";
+    case Token::kw_switch: return "kw_switch";
+    case Token::kw_this: return "kw_this";
+    case Token::kw_throw: return "kw_throw";
+    case Token::kw_true: return "kw_true";
+    case Token::kw_try: return "kw_try";
+    case Token::kw_typeof: return "kw_typeof";
+    case Token::kw_var: return "kw_var";
+    case Token::kw_void: return "kw_void";
+    case Token::kw_while: return "kw_while";
+    case Token::kw_with: return "kw_with";
+    case Token::kw_implements: return "kw_implements";
+    case Token::kw_private: return "kw_private";
+    case Token::kw_public: return "kw_public";
+    case Token::kw_interface: return "kw_interface";
+    case Token::kw_let: return "kw_let";
+    case Token::kw_package: return "kw_package";
+    case Token::kw_protected: return "kw_protected";
+    case Token::kw_static: return "kw_static";
+    case Token::kw_yield: return "kw_yield";
+    case Token::kw_as: return "kw_as";
+    case Token::kw_async: return "kw_async";
+    case Token::kw_await: return "kw_await";
+    case Token::kw_from: return "kw_from";
+    case Token::kw_of: return "kw_of";
+    default: return "?";
+  }
+}
@@ -1,4 +1,4 @@
-// Generated by tools/generate-token-start.js 2019-03-07
+// Generated by tools/generate-token-start.js 2026-10-18
 export module TokenStartTable;
 
 export enum class TokenStartType {
@@ -16,6 +16,21 @@ export enum class TokenStartType {
   right_brace,
 };
 
+export constexpr const char* token_start_type_names[] {
+  "error",
+  "whitespace",
+  "newline",
+  "punctuator",
+  "string",
+  "identifier",
+  "dot",
+  "slash",
+  "zero",
+  "digit",
+  "backtick",
+  "right_brace",
+};
+
 export constexpr TokenStartType token_start_table[] {
   TokenStartType::error,
   TokenStartType::error,
@@ -1,4 +1,4 @@
-// Generated by tools/generate-tries.js 2019-03-18
+// Generated by tools/generate-tries.js 2026-10-18
 export module TokenTrie;
 
 import BasicTypes;
@@ -180,22 +180,7 @@ struct TokenTrie {
 
   static Token match_keyword(S& s, uint32 cp) {
     if (cp == 'b') {
-      if (auto n = s.peek(); n == 'e') {
-        s.advance();
-        if (s.peek() == 'g') {
-          s.advance();
-          if (s.peek() == 'i') {
-            s.advance();
-            if (s.peek() == 'n') {
-              s.advance();
-              return Token::kw_begin;
-            }
-            return Token::error;
-          }
-          return Token::error;
-        }
-        return Token::error;
-      } else if (n == 'r') {
+      if (s.peek() == 'r') {
         s.advance();
         if (s.peek() == 'e') {
           s.advance();
@@ -367,16 +352,13 @@ struct TokenTrie {
         return Token::error;
       } else if (n == 'n') {
         s.advance();
-        if (auto n = s.peek(); n == 'u') {
+        if (s.peek() == 'u') {
           s.advance();
           if (s.peek() == 'm') {
             s.advance();
             return Token::kw_enum;
           }
           return Token::error;
-        } else if (n == 'd') {
-          s.advance();
-          return Token::kw_end;
         }
         return Token::error;
       } else if (n == 'x') {
@@ -0,0 +1,339 @@
+module;
+
+#include <cassert>
+
+export module Tokenizer;
+
+import std.core;
+import BasicTypes;
+import Probes;
+import Scanner;
+
+// Produces the token stream of a source file without a parser. The scanner
+// context for each token is inferred from the tokens before it: whether a "/"
+// begins a regular expression or a division, and whether a "}" closes a
+// template substitution.
+//
+// The inference follows the grammar closely but not exactly. A "/" after ")"
+// begins a regular expression only when the parentheses enclose the condition
+// of an if, while, for or with statement. A "/" after "}" begins a regular
+// expression when the braces were opened at the start of a statement or
+// after ")" or "=>", except for the body of a function expression, which is
+// an operand. A block following a label or a case clause is assumed to be an
+// object literal, and so is a class body.
+export template<typename T, typename Policy = ScannerPolicy>
+struct Tokenizer {
+
+  using Context = typename Scanner<T, Policy>::Context;
+  using Result = typename Scanner<T, Policy>::Result;
+
+  enum class Nesting : uint8 {
+    none,
+    paren,
+    condition,
+    bracket,
+    block,
+    object,
+    template_substitution,
+    async_operand,          // "async" where a function expression may follow
+    function_expression,    // From "function" to the "{" of its body
+    function_body,          // The body of a function expression
+  };
+
+  // A tokenizer for a scan of a whole source fires the scan__start and
+  // scan__end probes, if probes is true. Partial scans, such as those which
+  // continue from a scanner or after seek, never fire them, so that each
+  // scan__start is matched by a scan__end.
+  Tokenizer(T begin, T end, bool probes = false) : _scanner {begin, end}, _probes {probes} {}
+
+  // Continues from a scanner positioned at the start of a statement
+  explicit Tokenizer(const Scanner<T, Policy>& scanner) : _scanner {scanner} {}
+
+  // Returns the next token, including the comments and trivia which the
+  // scanner policy emits. The scan__start and scan__end probes fire at the
+  // first token and at the first end or error token of a traced scan.
+  Token next() {
+    if (_probes && _token_count == 0 && probe_scan_active()) {
+      _scan_start = _scanner.result().end;
+      probe_scan_start(_scanner.remaining());
+    }
+    bool in_template =
+      !_nesting.empty() && _nesting.back() == Nesting::template_substitution;
+
+    Context context = _regexp_allowed ? Context::expression : Context::div;
+    if (in_template && context == Context::expression) {
+      context = Context::template_string;
+    }
+
+    Token t;
+    if (in_template && context == Context::div) {
+      // The copy is local so that a streamed source can release the text
+      // before it once the token is scanned
+      Scanner<T, Policy> rewind = _scanner;
+      t = _scanner.next(context);
+      if (t == Token::right_brace) {
+        _scanner = rewind;
+        t = _scanner.next(Context::template_string);
+      }
+    } else {
+      t = _scanner.next(context);
+    }
+
+    if (t != Token::comment && t != Token::whitespace && t != Token::error) {
+      update(t, _scanner.result().keyword);
+    }
+
+    ++_token_count;
+    if (_probes && (t == Token::end || t == Token::error)) {
+      _probes = false;
+      if (probe_scan_active()) {
+        auto& result = _scanner.result();
+        probe_scan_end(result.end - _scan_start, _token_count, uint64(result.error));
+      }
+    }
+    return t;
+  }
+
+  const Result& result() const {
+    return _scanner.result();
+  }
+
+  Scanner<T, Policy>& scanner() {
+    return _scanner;
+  }
+
+  const Scanner<T, Policy>& scanner() const {
+    return _scanner;
+  }
+
+  // The number of open parentheses, brackets, braces and template
+  // substitutions, and of function expressions whose bodies have not begun.
+  // An "async" which may begin a function expression is not counted, so
+  // that it does not change the depth of the token before it.
+  uint32 depth() const {
+    bool async_operand = !_nesting.empty() && _nesting.back() == Nesting::async_operand;
+    return uint32(_nesting.size() - async_operand);
+  }
+
+  // True if a "/" at the current position would begin a regular expression
+  bool regexp_allowed() const {
+    return _regexp_allowed;
+  }
+
+  // The last token returned, other than comments and trivia
+  Token previous() const {
+    return _previous;
+  }
+
+  // The open parentheses, brackets, braces and template substitutions, and
+  // the function expressions whose bodies have not begun
+  const std::vector<Nesting>& nesting() const {
+    return _nesting;
+  }
+
+  // Continues from the end of a token, with the state which a tokenizer had
+  // after returning it. The token must not be a comment or trivia, since the
+  // newline_before flag is not carried over.
+  template<typename I>
+  void seek(
+    const T& iter,
+    SourcePosition position,
+    Token previous,
+    bool regexp_allowed,
+    I nesting_first,
+    I nesting_last)
+  {
+    _scanner.seek(iter, position);
+    _probes = false;
+    _previous = previous;
+    _regexp_allowed = regexp_allowed;
+    _nesting.assign(nesting_first, nesting_last);
+  }
+
+  // True if both tokenizers would scan the same text in the same context,
+  // whatever their scanner positions
+  bool same_state(const Tokenizer& other) const {
+    return
+      _previous == other._previous &&
+      _regexp_allowed == other._regexp_allowed &&
+      _nesting == other._nesting;
+  }
+
+  // Moves the context past a token other than a comment or trivia. The
+  // keyword is the token's keyword field, which tells contextual keywords
+  // such as "await" apart from other identifiers.
+  void update(Token t, Token keyword) {
+    // Reserved words are identifier names after "."
+    if (_previous == Token::dot && t > Token::kw_begin && t < Token::kw_end) {
+      t = Token::identifier;
+    }
+
+    // "async" is followed by "function" for an async function expression
+    bool after_async = false;
+    if (!_nesting.empty() && _nesting.back() == Nesting::async_operand) {
+      _nesting.pop_back();
+      after_async = true;
+    }
+
+    switch (t) {
+      case Token::kw_function:
+        // A "function" after an identifier follows "async"
+        if (_previous == Token::identifier ? after_async : !starts_declaration(_previous)) {
+          _nesting.push_back(Nesting::function_expression);
+        }
+        _regexp_allowed = true;
+        break;
+
+      case Token::left_paren:
+        _nesting.push_back(is_condition_keyword(_previous) ? Nesting::condition : Nesting::paren);
+        _regexp_allowed = true;
+        break;
+
+      case Token::left_bracket:
+        _nesting.push_back(Nesting::bracket);
+        _regexp_allowed = true;
+        break;
+
+      case Token::left_brace:
+        if (!_nesting.empty() && _nesting.back() == Nesting::function_expression) {
+          _nesting.back() = Nesting::function_body;
+        } else {
+          _nesting.push_back(starts_block(_previous) ? Nesting::block : Nesting::object);
+        }
+        _regexp_allowed = true;
+        break;
+
+      case Token::template_head:
+        _nesting.push_back(Nesting::template_substitution);
+        _regexp_allowed = true;
+        break;
+
+      case Token::right_paren:
+        _regexp_allowed = pop() == Nesting::condition;
+        break;
+
+      case Token::right_brace:
+        _regexp_allowed = pop() == Nesting::block;
+        break;
+
+      case Token::right_bracket:
+      case Token::template_tail:
+        pop();
+        _regexp_allowed = false;
+        break;
+
+      case Token::identifier:
+        // "await", "yield" and "of" are scanned as identifiers where they
+        // may be names, but are more often followed by an operand
+        _regexp_allowed =
+          _previous != Token::dot &&
+          takes_operand(keyword);
+        if (keyword == Token::kw_async && _previous != Token::dot && !starts_declaration(_previous)) {
+          _nesting.push_back(Nesting::async_operand);
+        }
+        break;
+
+      case Token::number:
+      case Token::string:
+      case Token::regexp:
+      case Token::template_basic:
+      case Token::increment:
+      case Token::decrement:
+      case Token::kw_this:
+      case Token::kw_super:
+      case Token::kw_null:
+      case Token::kw_true:
+      case Token::kw_false:
+        _regexp_allowed = false;
+        break;
+
+      default:
+        _regexp_allowed = true;
+        break;
+    }
+
+    _previous = t;
+  }
+
+  Nesting pop() {
+    if (_nesting.empty()) {
+      return Nesting::none;
+    }
+    Nesting top = _nesting.back();
+    _nesting.pop_back();
+    return top;
+  }
+
+  static bool takes_operand(Token keyword) {
+    switch (keyword) {
+      case Token::kw_await:
+      case Token::kw_yield:
+      case Token::kw_of:
+        return true;
+      default:
+        return false;
+    }
+  }
+
+  static bool is_condition_keyword(Token token) {
+    switch (token) {
+      case Token::kw_if:
+      case Token::kw_while:
+      case Token::kw_for:
+      case Token::kw_with:
+        return true;
+      default:
+        return false;
+    }
+  }
+
+  // True if "function" following the token begins a function declaration
+  // rather than a function expression. A ":" is taken to belong to a
+  // conditional expression rather than a label.
+  bool starts_declaration(Token token) const {
+    switch (token) {
+      case Token::end:
+      case Token::semicolon:
+      case Token::right_brace:
+      case Token::right_paren:
+      case Token::kw_else:
+      case Token::kw_do:
+      case Token::kw_export:
+      case Token::kw_default:
+        return true;
+      case Token::left_brace:
+        return _nesting.back() == Nesting::block || _nesting.back() == Nesting::function_body;
+      default:
+        return false;
+    }
+  }
+
+  // True if a "{" following the token begins a block or function body
+  // rather than an object literal
+  static bool starts_block(Token token) {
+    switch (token) {
+      case Token::end:
+      case Token::semicolon:
+      case Token::left_brace:
+      case Token::right_brace:
+      case Token::right_paren:
+      case Token::fat_arrow:
+      case Token::kw_else:
+      case Token::kw_do:
+      case Token::kw_try:
+      case Token::kw_finally:
+        return true;
+      default:
+        return false;
+    }
+  }
+
+  Scanner<T, Policy> _scanner;
+  Token _previous {Token::end};
+  bool _regexp_allowed {true};
+  std::vector<Nesting> _nesting;
+  uint32 _token_count {0};
+  SourcePosition _scan_start {0};
+  bool _probes {false};
+
+};
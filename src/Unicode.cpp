@@ -1,5 +1,6 @@
 export module Unicode;
 
+import std.core;
 import BasicTypes;
 import UnicodeData;
 
@@ -16,13 +17,13 @@ struct IdentifierData {
 };
 
 template<typename T>
-typename const T::Element* search_table(uint32 code) {
+const typename T::Element* search_table(uint32 code) {
   int right = T::count - 1;
   int left = 0;
 
   while (left <= right) {
     int mid = (left + right) >> 1;
-    const T::Element& span = T::table[mid];
+    const typename T::Element& span = T::table[mid];
 
     if (code < span.id) {
       right = mid - 1;
@@ -63,3 +64,42 @@ export bool is_identifier_part(uint32 code) {
   }
   return search_table<IdentifierData>(code) != nullptr;
 }
+
+// Decodes the UTF-8 sequences in [first, last) to code points, advancing
+// first and returning the number written; out must have room for one code
+// point per byte. A sequence cut off by last is left unread unless last is
+// the end of the input. Malformed sequences are replaced with U+FFFD.
+export size_t decode_utf8(const uint8*& first, const uint8* last, char32_t* out, bool at_end) {
+  char32_t* start = out;
+  const uint8* p = first;
+  while (p != last) {
+    uint32 c = *p;
+    uint32 length = c < 0x80 ? 0 : c < 0xc2 ? 4 : c < 0xe0 ? 1 : c < 0xf0 ? 2 : c < 0xf5 ? 3 : 4;
+    if (length == 4) {
+      *out++ = 0xfffd;
+      ++p;
+      continue;
+    }
+    if (!at_end && uint32(last - p) <= length) {
+      // Continuation bytes may be in the next block
+      bool complete = true;
+      for (const uint8* q = p + 1; q != last; ++q) {
+        complete = complete && (*q & 0xc0) == 0x80;
+      }
+      if (complete) {
+        break;
+      }
+    }
+    ++p;
+    uint32 cp = length == 0 ? c : c & (0x3f >> length);
+    uint32 i = 0;
+    for (; i < length && p != last && (*p & 0xc0) == 0x80; ++i) {
+      cp = cp << 6 | (*p++ & 0x3f);
+    }
+    bool overlong = (length == 2 && cp < 0x800) || (length == 3 && cp < 0x10000);
+    bool invalid = cp > 0x10ffff || (cp >= 0xd800 && cp <= 0xdfff);
+    *out++ = i < length || overlong || invalid ? 0xfffd : cp;
+  }
+  first = p;
+  return size_t(out - start);
+}
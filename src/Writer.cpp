@@ -0,0 +1,113 @@
+module;
+
+#include <stdio.h>
+
+export module Writer;
+
+import std.core;
+import BasicTypes;
+
+// Output sinks for passes which copy source text. A writer accepts ranges of
+// code units through write(first, last) and single ASCII characters through
+// put(c), and does not allocate for each call.
+
+// Appends output to a string of the source's code unit type
+export template<typename C>
+struct StringWriter {
+
+  explicit StringWriter(std::basic_string<C>& out) : _out {out} {}
+
+  template<typename I>
+  void write(I first, I last) {
+    _out.append(first, last);
+  }
+
+  void put(char c) {
+    _out.push_back(C(c));
+  }
+
+  std::basic_string<C>& _out;
+
+};
+
+// Writes UTF-8 output to a file through a large buffer. Single byte code units
+// are copied as they are; wider code units are encoded.
+export struct FileWriter {
+
+  static constexpr size_t buffer_size = 1 << 20;
+
+  explicit FileWriter(FILE* file) : _file {file}, _buffer {new char[buffer_size]} {}
+
+  FileWriter(const FileWriter&) = delete;
+  FileWriter& operator=(const FileWriter&) = delete;
+
+  ~FileWriter() {
+    flush();
+  }
+
+  template<typename I>
+  void write(I first, I last) {
+    if constexpr (sizeof(*first) == 1) {
+      size_t length = size_t(last - first);
+      if (length >= buffer_size) {
+        flush();
+        fwrite(std::to_address(first), 1, length, _file);
+        return;
+      }
+      reserve(length);
+      std::memcpy(_buffer.get() + _length, std::to_address(first), length);
+      _length += length;
+    } else {
+      for (; first != last; ++first) {
+        encode(uint32(*first));
+      }
+    }
+  }
+
+  void put(char c) {
+    reserve(1);
+    _buffer[_length++] = c;
+  }
+
+  void flush() {
+    if (_length > 0) {
+      fwrite(_buffer.get(), 1, _length, _file);
+      _length = 0;
+    }
+  }
+
+  void reserve(size_t length) {
+    if (_length + length > buffer_size) {
+      flush();
+    }
+  }
+
+  void encode(uint32 cp) {
+    reserve(4);
+    char* out = _buffer.get() + _length;
+    if (cp < 0x80) {
+      out[0] = char(cp);
+      _length += 1;
+    } else if (cp < 0x800) {
+      out[0] = char(0xc0 | cp >> 6);
+      out[1] = char(0x80 | cp & 0x3f);
+      _length += 2;
+    } else if (cp < 0x10000) {
+      out[0] = char(0xe0 | cp >> 12);
+      out[1] = char(0x80 | cp >> 6 & 0x3f);
+      out[2] = char(0x80 | cp & 0x3f);
+      _length += 3;
+    } else {
+      out[0] = char(0xf0 | cp >> 18);
+      out[1] = char(0x80 | cp >> 12 & 0x3f);
+      out[2] = char(0x80 | cp >> 6 & 0x3f);
+      out[3] = char(0x80 | cp & 0x3f);
+      _length += 4;
+    }
+  }
+
+  FILE* _file;
+  std::unique_ptr<char[]> _buffer;
+  size_t _length {0};
+
+};
@@ -0,0 +1,93 @@
+// Generated by tools/generate-ast-strings.js 2026-10-18
+export module test.AstStrings;
+
+import Ast;
+
+export template<typename T>
+T& operator<<(T& out, NodeKind k) {
+  switch (k) {
+    case NodeKind::none: return out << "none";
+    case NodeKind::script: return out << "script";
+    case NodeKind::module: return out << "module";
+    case NodeKind::empty_statement: return out << "empty_statement";
+    case NodeKind::block: return out << "block";
+    case NodeKind::expression_statement: return out << "expression_statement";
+    case NodeKind::directive: return out << "directive";
+    case NodeKind::variable_declaration: return out << "variable_declaration";
+    case NodeKind::variable_declarator: return out << "variable_declarator";
+    case NodeKind::if_statement: return out << "if_statement";
+    case NodeKind::for_statement: return out << "for_statement";
+    case NodeKind::for_in_statement: return out << "for_in_statement";
+    case NodeKind::for_of_statement: return out << "for_of_statement";
+    case NodeKind::while_statement: return out << "while_statement";
+    case NodeKind::do_while_statement: return out << "do_while_statement";
+    case NodeKind::continue_statement: return out << "continue_statement";
+    case NodeKind::break_statement: return out << "break_statement";
+    case NodeKind::return_statement: return out << "return_statement";
+    case NodeKind::with_statement: return out << "with_statement";
+    case NodeKind::switch_statement: return out << "switch_statement";
+    case NodeKind::switch_case: return out << "switch_case";
+    case NodeKind::throw_statement: return out << "throw_statement";
+    case NodeKind::try_statement: return out << "try_statement";
+    case NodeKind::catch_clause: return out << "catch_clause";
+    case NodeKind::labelled_statement: return out << "labelled_statement";
+    case NodeKind::debugger_statement: return out << "debugger_statement";
+    case NodeKind::function_declaration: return out << "function_declaration";
+    case NodeKind::function_expression: return out << "function_expression";
+    case NodeKind::arrow_function: return out << "arrow_function";
+    case NodeKind::formal_parameters: return out << "formal_parameters";
+    case NodeKind::function_body: return out << "function_body";
+    case NodeKind::class_declaration: return out << "class_declaration";
+    case NodeKind::class_expression: return out << "class_expression";
+    case NodeKind::class_body: return out << "class_body";
+    case NodeKind::method_definition: return out << "method_definition";
+    case NodeKind::import_declaration: return out << "import_declaration";
+    case NodeKind::import_namespace: return out << "import_namespace";
+    case NodeKind::import_specifier: return out << "import_specifier";
+    case NodeKind::export_declaration: return out << "export_declaration";
+    case NodeKind::export_default: return out << "export_default";
+    case NodeKind::export_named: return out << "export_named";
+    case NodeKind::export_all: return out << "export_all";
+    case NodeKind::export_specifier: return out << "export_specifier";
+    case NodeKind::identifier: return out << "identifier";
+    case NodeKind::number: return out << "number";
+    case NodeKind::string: return out << "string";
+    case NodeKind::regexp: return out << "regexp";
+    case NodeKind::null_literal: return out << "null_literal";
+    case NodeKind::boolean_literal: return out << "boolean_literal";
+    case NodeKind::this_expression: return out << "this_expression";
+    case NodeKind::super_keyword: return out << "super_keyword";
+    case NodeKind::template_literal: return out << "template_literal";
+    case NodeKind::template_part: return out << "template_part";
+    case NodeKind::tagged_template: return out << "tagged_template";
+    case NodeKind::array_literal: return out << "array_literal";
+    case NodeKind::elision: return out << "elision";
+    case NodeKind::spread: return out << "spread";
+    case NodeKind::object_literal: return out << "object_literal";
+    case NodeKind::property_definition: return out << "property_definition";
+    case NodeKind::shorthand_property: return out << "shorthand_property";
+    case NodeKind::computed_name: return out << "computed_name";
+    case NodeKind::paren_expression: return out << "paren_expression";
+    case NodeKind::member_expression: return out << "member_expression";
+    case NodeKind::computed_member: return out << "computed_member";
+    case NodeKind::call_expression: return out << "call_expression";
+    case NodeKind::new_expression: return out << "new_expression";
+    case NodeKind::import_call: return out << "import_call";
+    case NodeKind::import_meta: return out << "import_meta";
+    case NodeKind::new_target: return out << "new_target";
+    case NodeKind::unary_expression: return out << "unary_expression";
+    case NodeKind::update_expression: return out << "update_expression";
+    case NodeKind::binary_expression: return out << "binary_expression";
+    case NodeKind::conditional_expression: return out << "conditional_expression";
+    case NodeKind::assignment_expression: return out << "assignment_expression";
+    case NodeKind::sequence_expression: return out << "sequence_expression";
+    case NodeKind::yield_expression: return out << "yield_expression";
+    case NodeKind::await_expression: return out << "await_expression";
+    case NodeKind::object_pattern: return out << "object_pattern";
+    case NodeKind::array_pattern: return out << "array_pattern";
+    case NodeKind::pattern_property: return out << "pattern_property";
+    case NodeKind::pattern_default: return out << "pattern_default";
+    case NodeKind::rest_element: return out << "rest_element";
+    default: return out << "?";
+  }
+}
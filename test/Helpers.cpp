@@ -0,0 +1,43 @@
+// Helpers shared by the tests
+export module test.Helpers;
+
+import std.core;
+import BasicTypes;
+import Token;
+import Tokenizer;
+import TokenBuffer;
+
+using std::string;
+
+export [[noreturn]] void fail(const string& test_name, const string& message) {
+  std::cerr << "[" << test_name << "]\nError: " << message << "\n";
+  std::exit(1);
+}
+
+// Tokenizes the text up to and including the end or the first error. The
+// iterator is moved so that a stream does not keep its first block.
+export template<typename I>
+TokenBuffer tokenize(I begin, I end) {
+  Tokenizer<I> tokenizer {std::move(begin), end};
+  TokenBuffer buffer;
+  while (true) {
+    Token t = tokenizer.next();
+    buffer.push_back(tokenizer.result());
+    if (t == Token::end || t == Token::error) {
+      return buffer;
+    }
+  }
+}
+
+// True if the buffers hold the same tokens at the same positions
+export bool same_tokens(const TokenBuffer& a, const TokenBuffer& b) {
+  if (a.size() != b.size()) {
+    return false;
+  }
+  for (uint32 i = 0; i < a.size(); ++i) {
+    if (a[i].token != b[i].token || a[i].start != b[i].start || a.end(i) != b.end(i)) {
+      return false;
+    }
+  }
+  return true;
+}
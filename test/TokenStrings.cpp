@@ -1,4 +1,4 @@
-// Generated by tools/generate-token-strings.js 2019-03-18
+// Generated by tools/generate-token-strings.js 2026-10-18
 export module test.TokenStrings;
 
 import Token;
@@ -0,0 +1,65 @@
+import std.core;
+import Scanner;
+import Tokenizer;
+import TokenBuffer;
+import test.TokenStrings;
+
+using std::string;
+using std::vector;
+
+using Iterator = string::const_iterator;
+using Result = Scanner<Iterator>::Result;
+using Diagnostic = Scanner<Iterator>::Diagnostic;
+
+bool same_result(const Result& a, const Result& b) {
+  return
+    a.token == b.token &&
+    a.keyword == b.keyword &&
+    a.start == b.start &&
+    a.end == b.end &&
+    a.newline_before == b.newline_before &&
+    a.error == b.error;
+}
+
+// Packs every token of the input and checks that each unpacks to the
+// original scanner result
+void test(const string& test_name, const string& input) {
+  Tokenizer tokenizer {input.begin(), input.end()};
+  vector<Diagnostic> diagnostics;
+  tokenizer.scanner().set_recovery(&diagnostics);
+
+  vector<Result> expected;
+  TokenBuffer buffer;
+
+  while (true) {
+    Token t = tokenizer.next();
+    expected.push_back(tokenizer.result());
+    buffer.push_back(tokenizer.result());
+    if (t == Token::end) {
+      break;
+    }
+  }
+
+  for (uint32 i = 0; i < buffer.size(); ++i) {
+    Result actual = buffer.result<Result>(i);
+    if (!same_result(actual, expected[i]) || buffer.end(i) != expected[i].end) {
+      std::cerr
+        << "[" << test_name << "]\n"
+        << "Error: Packed token " << i << " does not match\n"
+        << "Expected: " << expected[i].token << " " << expected[i].start << "-" << expected[i].end << "\n"
+        << "Actual: " << actual.token << " " << actual.start << "-" << actual.end << "\n";
+      std::exit(1);
+    }
+  }
+}
+
+void test_packing() {
+  test("Packing - tokens and keywords", "let x = a.b; await y\nif (x) { return /re/g }");
+  test("Packing - comments", "/* a\n b */ x // c\n y");
+  test("Packing - errors", "a = 'b\n0x; 1e+ #");
+  test("Packing - long tokens", "a = '" + string(20000, 'b') + "'; c = `" + string(16383, 'd') + "`");
+}
+
+int main() {
+  test_packing();
+}
@@ -0,0 +1,160 @@
+import std.core;
+import Scanner;
+import Tokenizer;
+import CheckpointIndex;
+import test.TokenStrings;
+import test.Helpers;
+
+using std::string;
+using std::vector;
+
+using Iterator = string::const_iterator;
+using Result = Scanner<Iterator>::Result;
+using Diagnostic = Scanner<Iterator>::Diagnostic;
+
+bool same_result(const Result& a, const Result& b) {
+  return
+    a.token == b.token &&
+    a.keyword == b.keyword &&
+    a.start == b.start &&
+    a.end == b.end &&
+    a.newline_before == b.newline_before &&
+    a.error == b.error;
+}
+
+vector<Result> scan_all(const string& input) {
+  Tokenizer tokenizer {input.begin(), input.end()};
+  vector<Result> results;
+  while (true) {
+    Token t = tokenizer.next();
+    results.push_back(tokenizer.result());
+    if (t == Token::end || t == Token::error) {
+      return results;
+    }
+  }
+}
+
+// Resumes scanning at each position of the input and checks that the tokens
+// which end after it match a scan from the start
+void test(const string& test_name, const string& input, uint32 interval) {
+  vector<Result> expected = scan_all(input);
+  CheckpointIndex<Iterator> index {interval};
+  index.scan(input.begin(), input.end());
+
+  if (index.size() < 2) {
+    std::cerr << "[" << test_name << "]\nError: No checkpoints were recorded\n";
+    std::exit(1);
+  }
+
+  for (uint32 position = 0; position <= input.size(); ++position) {
+    auto tokenizer = index.resume(input.begin(), input.end(), position);
+    size_t i = 0;
+    while (expected[i].end <= position && expected[i].token != Token::end) {
+      ++i;
+    }
+
+    while (true) {
+      Token t = tokenizer.next();
+      auto& result = tokenizer.result();
+      if (result.end <= position && t != Token::end) {
+        continue;
+      }
+      if (i >= expected.size() || !same_result(result, expected[i])) {
+        std::cerr
+          << "[" << test_name << "]\n"
+          << "Error: Resumed scan does not match at position " << position << "\n"
+          << "Actual: " << t << " " << result.start << "-" << result.end << "\n";
+        std::exit(1);
+      }
+      ++i;
+      if (t == Token::end || t == Token::error) {
+        break;
+      }
+    }
+  }
+}
+
+void test_resume() {
+  string input =
+    "function f(a, b) {\n"
+    "  if (a) /x/g.test(b); // c\n"
+    "  return `t${ a + `u${ b }` }v` / 2 + {x: 1}.x;\n"
+    "}\n"
+    "/* d */ let y = a\n++b\n";
+  test("Resume - small interval", input, 1);
+  test("Resume - large interval", input, 40);
+}
+
+bool same_diagnostics(const vector<Diagnostic>& a, const vector<Diagnostic>& b) {
+  return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](auto& x, auto& y) {
+    return x.error == y.error && x.start == y.start && x.end == y.end;
+  });
+}
+
+// Strict mode is selected after the directive, as a parser would, and a
+// scan resumed after it is strict again
+void test_strict_mode() {
+  string input = "a = 01;\n'use strict';\nb = 02;\nc = [03];\n";
+  vector<Diagnostic> expected;
+  CheckpointIndex<Iterator> index {1};
+  Tokenizer tokenizer {input.cbegin(), input.cend()};
+  tokenizer.scanner().set_recovery(&expected);
+  while (tokenizer.next() != Token::end) {
+    if (tokenizer.result().token == Token::string) {
+      tokenizer.scanner().set_strict_mode(true);
+    }
+    index.update(tokenizer);
+  }
+  if (expected.size() != 2 || expected[0].error != ScannerError::legacy_octal_number) {
+    fail("Strict mode - full scan", "Expected legacy octal errors after the directive");
+  }
+
+  // The first checkpoint in strict code follows the directive
+  SourcePosition directive_end = SourcePosition(input.find("';") + 1);
+  for (uint32 position = directive_end; position <= input.size(); ++position) {
+    vector<Diagnostic> diagnostics = expected;
+    auto resumed = index.resume(input.cbegin(), input.cend(), position, &diagnostics);
+    if (!resumed.scanner().strict_mode()) {
+      fail("Strict mode - resume", "Not strict at position " + std::to_string(position));
+    }
+    while (resumed.next() != Token::end) {}
+    if (!same_diagnostics(diagnostics, expected)) {
+      fail("Strict mode - resume", "Diagnostics differ at position " + std::to_string(position));
+    }
+  }
+}
+
+// With a diagnostics list, checkpoints are recorded past errors
+void test_recovery() {
+  string input = "a = 0x;\nb = 1;\nc = 2;\n";
+  CheckpointIndex<Iterator> index {1};
+  index.scan(input.cbegin(), input.cend());
+  uint32 stopped = index.size();
+
+  vector<Diagnostic> diagnostics;
+  index.scan(input.cbegin(), input.cend(), &diagnostics);
+  if (diagnostics.size() != 1 || index.size() <= stopped || index[index.size() - 1].position < 20) {
+    fail("Recovery - scan", "Expected checkpoints after the error");
+  }
+
+  vector<Diagnostic> resumed_diagnostics = diagnostics;
+  auto tokenizer = index.resume(input.cbegin(), input.cend(), 2, &resumed_diagnostics);
+  while (true) {
+    Token t = tokenizer.next();
+    if (t == Token::end || t == Token::error) {
+      if (t == Token::error) {
+        fail("Recovery - resume", "Expected the scan to continue past the error");
+      }
+      break;
+    }
+  }
+  if (!same_diagnostics(resumed_diagnostics, diagnostics)) {
+    fail("Recovery - resume", "Diagnostics differ");
+  }
+}
+
+int main() {
+  test_resume();
+  test_strict_mode();
+  test_recovery();
+}
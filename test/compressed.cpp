@@ -0,0 +1,103 @@
+import std.core;
+import BasicTypes;
+import StreamSource;
+import cli.Compressed;
+import test.Helpers;
+
+using std::string;
+using std::vector;
+
+const string text = "let x = 'caf\xc3\xa9' + `a${b}c` / 2; // done\n";
+
+const vector<uint8> gzip_data = {
+  0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0xcb, 0x49,
+  0x2d, 0x51, 0xa8, 0x50, 0xb0, 0x55, 0x50, 0x4f, 0x4e, 0x4c, 0x3b, 0xbc,
+  0x52, 0x5d, 0x41, 0x5b, 0x21, 0x21, 0x51, 0xa5, 0x3a, 0xa9, 0x36, 0x39,
+  0x41, 0x41, 0x5f, 0xc1, 0xc8, 0x5a, 0x41, 0x5f, 0x5f, 0x21, 0x25, 0x3f,
+  0x2f, 0x95, 0x0b, 0x00, 0xd2, 0x6c, 0xeb, 0xe9, 0x28, 0x00, 0x00, 0x00,
+};
+
+const vector<uint8> zstd_data = {
+  0x28, 0xb5, 0x2f, 0xfd, 0x20, 0x28, 0x41, 0x01, 0x00, 0x6c, 0x65, 0x74,
+  0x20, 0x78, 0x20, 0x3d, 0x20, 0x27, 0x63, 0x61, 0x66, 0xc3, 0xa9, 0x27,
+  0x20, 0x2b, 0x20, 0x60, 0x61, 0x24, 0x7b, 0x62, 0x7d, 0x63, 0x60, 0x20,
+  0x2f, 0x20, 0x32, 0x3b, 0x20, 0x2f, 0x2f, 0x20, 0x64, 0x6f, 0x6e, 0x65,
+  0x0a,
+};
+
+// Provides the compressed data a byte at a time
+struct ByteInput {
+
+  size_t read(uint8* out, size_t size) {
+    if (size == 0 || position == data.size()) {
+      return 0;
+    }
+    *out = data[position++];
+    return 1;
+  }
+
+  vector<uint8> data;
+  size_t position {0};
+
+};
+
+// Decodes the data through a stream of small blocks. An empty error means
+// that decoding must succeed.
+template<template<typename> typename Decoder>
+void test(const string& test_name, const vector<uint8>& data, const string& expected, const string& error) {
+  ByteInput input {data};
+  Decoder<ByteInput> decoder {input};
+  StreamSource<uint8, Decoder<ByteInput>> source {decoder, 5};
+  string actual;
+  for (auto i = source.begin(); i != source.end(); ++i) {
+    actual += char(*i);
+  }
+  string actual_error = decoder.error() ? decoder.error() : "";
+  if (actual_error != error) {
+    fail(test_name, "Expected error '" + error + "', found '" + actual_error + "'");
+  }
+  if (error.empty() && (actual != expected || decoder.output_size() != expected.size())) {
+    fail(test_name, "Unexpected output: " + actual);
+  }
+}
+
+template<template<typename> typename Decoder>
+void test_format(const string& name, const vector<uint8>& data, size_t header_byte) {
+  vector<uint8> twice = data;
+  twice.insert(twice.end(), data.begin(), data.end());
+  vector<uint8> truncated(data.begin(), data.end() - 6);
+  vector<uint8> corrupt = data;
+  corrupt[header_byte] ^= 0xff;
+
+  test<Decoder>(name + " - single", data, text, "");
+  test<Decoder>(name + " - concatenated", twice, text + text, "");
+  test<Decoder>(name + " - truncated", truncated, "", "truncated " + name + " data");
+  test<Decoder>(name + " - invalid", corrupt, "", "invalid " + name + " data");
+}
+
+void test_detection() {
+  if (detect_compression(gzip_data.data(), gzip_data.size()) != Compression::gzip ||
+      detect_compression(zstd_data.data(), zstd_data.size()) != Compression::zstd ||
+      detect_compression(zstd_data.data(), 3) != Compression::none ||
+      detect_compression(reinterpret_cast<const uint8*>(text.data()), text.size()) != Compression::none) {
+    fail("Detection", "Unexpected format");
+  }
+}
+
+int main() {
+  test_detection();
+  // The libraries are loaded at run time, and formats without one are skipped
+  if (compression_available(Compression::gzip)) {
+    test_format<GzipDecoder>("gzip", gzip_data, 2);
+
+    vector<uint8> padded = gzip_data;
+    padded.resize(padded.size() + 512);
+    test<GzipDecoder>("gzip - zero padding", padded, text, "");
+    padded.resize(gzip_data.size());
+    padded.insert(padded.end(), {0x1f, 0x00});
+    test<GzipDecoder>("gzip - trailing bytes", padded, text, "");
+  }
+  if (compression_available(Compression::zstd)) {
+    test_format<ZstdDecoder>("zstd", zstd_data, 4);
+  }
+}
@@ -0,0 +1,192 @@
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <filesystem>
+
+import std.core;
+import BasicTypes;
+import cli.Tokenize;
+import cli.Daemon;
+import test.Helpers;
+
+using std::string;
+using std::vector;
+
+namespace fs = std::filesystem;
+
+string temp_path(const string& name) {
+  return (fs::temp_directory_path() / ("xxparsejs-test-" + name)).string();
+}
+
+void write_file(const string& path, const string& contents) {
+  std::ofstream out(path, std::ios::binary);
+  out << contents;
+}
+
+// The output of tokenizing the files in this process
+string expected_output(const vector<string>& files, OutputMode output) {
+  Workspace workspace;
+  string out;
+  string errors;
+  for (auto& file : files) {
+    tokenize_file(file, output, workspace, out, errors);
+  }
+  return out + errors;
+}
+
+DaemonResponse handle(const string& test_name, Daemon& daemon, const string& request) {
+  bool shutdown;
+  string payload = daemon.handle(request, shutdown);
+  DaemonResponse response;
+  if (!decode_response(payload, response)) {
+    fail(test_name, "Invalid response");
+  }
+  return response;
+}
+
+void test_handle() {
+  vector<string> files = {temp_path("a.js"), temp_path("b.js")};
+  write_file(files[0], "var a = 1; // one\nlet s = \"héllo\";\n");
+  write_file(files[1], "x = /re/g.test(y) ? `t${z}` : 0x;\n");
+
+  Daemon daemon {2};
+  string request = encode_request(OutputMode::tokens, files);
+
+  DaemonResponse first = handle("Handle - first batch", daemon, request);
+  if (first.out + first.errors != expected_output(files, OutputMode::tokens)) {
+    fail("Handle - first batch", "Output does not match a local run");
+  }
+  if (first.totals.files != 2 || first.totals.errors != 1 || first.totals.cached != 0) {
+    fail("Handle - first batch", "Unexpected totals");
+  }
+
+  DaemonResponse second = handle("Handle - cached batch", daemon, request);
+  if (second.out != first.out || second.errors != first.errors) {
+    fail("Handle - cached batch", "Cached output does not match");
+  }
+  if (second.totals.cached != 2 || second.totals.tokens != first.totals.tokens) {
+    fail("Handle - cached batch", "Unexpected totals");
+  }
+
+  write_file(files[1], "x = 0x1;\n");
+  DaemonResponse third = handle("Handle - changed file", daemon, request);
+  if (third.out + third.errors != expected_output(files, OutputMode::tokens)) {
+    fail("Handle - changed file", "Output does not match a local run");
+  }
+  if (third.totals.cached != 1 || third.totals.errors != 0) {
+    fail("Handle - changed file", "Unexpected totals");
+  }
+
+  DaemonResponse invalid = handle("Handle - invalid request", daemon, "parse\n");
+  if (invalid.errors.empty() || invalid.totals.files != 0) {
+    fail("Handle - invalid request", "Request was not rejected");
+  }
+
+  for (auto& file : files) {
+    fs::remove(file);
+  }
+}
+
+// Entries with the same key are told apart by their path and content size
+void test_cache() {
+  ContentCache cache;
+  Totals totals;
+  totals.files = 1;
+  cache.insert(7, "/a.js", 10, "a", "", totals);
+
+  string out;
+  string errors;
+  Totals found;
+  if (!cache.find(7, "/a.js", 10, out, errors, found) || out != "a" || found.files != 1) {
+    fail("Cache - hit", "Entry was not found");
+  }
+  if (cache.find(7, "/b.js", 10, out, errors, found) || cache.find(7, "/a.js", 11, out, errors, found)) {
+    fail("Cache - collision", "Entry of another file was returned");
+  }
+
+  cache.insert(7, "/b.js", 10, "b", "", totals);
+  if (!cache.find(7, "/b.js", 10, out, errors, found) || out != "b" || cache.size() != 1) {
+    fail("Cache - replace", "Entry was not replaced");
+  }
+}
+
+// A socket path which is taken by another file, or by a running daemon, is
+// not removed. A socket left by a daemon which did not shut down is.
+void test_socket_path() {
+  string path = temp_path("taken.sock");
+  write_file(path, "data");
+  Daemon daemon {1};
+  string error;
+  if (daemon.serve(path, error) || error.find("address in use") == string::npos) {
+    fail("Socket path - regular file", "Daemon served on a file path");
+  }
+  if (!fs::is_regular_file(path)) {
+    fail("Socket path - regular file", "File was removed");
+  }
+  fs::remove(path);
+
+  int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  sockaddr_un address {};
+  address.sun_family = AF_UNIX;
+  std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+  if (::bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+    fail("Socket path - stale socket", "Cannot bind");
+  }
+  ::close(fd);
+
+  std::thread server([&]() { daemon.serve(path, error); });
+  bool reached = false;
+  for (int attempt = 0; attempt < 100 && !reached; ++attempt) {
+    reached = send_request(path, "shutdown\n").has_value();
+    if (!reached) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+  }
+  server.join();
+  if (!reached) {
+    fail("Socket path - stale socket", "Cannot reach the daemon: " + error);
+  }
+}
+
+void test_socket() {
+  string socket_path = temp_path("daemon.sock");
+  string file = temp_path("c.js");
+  write_file(file, "function f(a) { return a / 2; }\n");
+
+  Daemon daemon {1};
+  string error;
+  std::thread server([&]() { daemon.serve(socket_path, error); });
+
+  std::optional<DaemonResponse> response;
+  for (int attempt = 0; attempt < 100 && !response; ++attempt) {
+    response = send_request(socket_path, encode_request(OutputMode::json, {file}));
+    if (!response) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+  }
+  if (!response) {
+    fail("Socket - request", "Cannot reach the daemon: " + error);
+  }
+  if (response->out + response->errors != expected_output({file}, OutputMode::json)) {
+    fail("Socket - request", "Output does not match a local run");
+  }
+  if (fs::status(socket_path).permissions() != (fs::perms::owner_read | fs::perms::owner_write)) {
+    fail("Socket - permissions", "Socket is accessible to other users");
+  }
+
+  if (!send_request(socket_path, "shutdown\n")) {
+    fail("Socket - shutdown", "Cannot reach the daemon");
+  }
+  server.join();
+  if (fs::exists(socket_path)) {
+    fail("Socket - shutdown", "Socket was not removed");
+  }
+  fs::remove(file);
+}
+
+int main() {
+  test_handle();
+  test_cache();
+  test_socket_path();
+  test_socket();
+}
@@ -0,0 +1,92 @@
+import std.core;
+import Highlighter;
+import Writer;
+
+using std::string;
+
+// Checks the output of the highlighter in the given format. Spans in the expected
+// string are written as ~class:text~ and are converted to each format.
+template<typename Format>
+void test_format(const string& test_name, const string& input, const string& expected) {
+  string output;
+  StringWriter writer {output};
+  Highlighter<string::const_iterator, StringWriter<char>, Format> highlighter {input.begin(), input.end(), writer};
+  highlighter.highlight();
+
+  if (output != expected) {
+    std::cerr
+      << "[" << test_name << "]\n"
+      << "Error: Unexpected highlighter output\n"
+      << "Input string: " << input << "\n"
+      << "Expected: " << expected << "\n"
+      << "Actual: " << output << "\n";
+    std::exit(1);
+  }
+}
+
+string html_markup(const string& expected) {
+  string result;
+  bool in_span = false;
+  for (size_t i = 0; i < expected.size(); ++i) {
+    char c = expected[i];
+    if (c == '~' && !in_span) {
+      size_t colon = expected.find(':', i);
+      result += "<span class=\"" + expected.substr(i + 1, colon - i - 1) + "\">";
+      i = colon;
+      in_span = true;
+    } else if (c == '~') {
+      result += "</span>";
+      in_span = false;
+    } else if (c == '<') {
+      result += "&lt;";
+    } else if (c == '>') {
+      result += "&gt;";
+    } else if (c == '&') {
+      result += "&amp;";
+    } else {
+      result += c;
+    }
+  }
+  return result;
+}
+
+void test(const string& test_name, const string& input, const string& expected) {
+  test_format<HtmlFormat>(test_name, input, html_markup(expected));
+}
+
+void test_classes() {
+  test("Classes - keywords", "if (a) return this", "~kw:if~ (a) ~kw:return~ ~kw:this~");
+  test("Classes - literals", "x = true && null", "x = ~lit:true~ && ~lit:null~");
+  test("Classes - numbers and strings", "f(1.5e3, 'a', \"b\")", "f(~num:1.5e3~, ~str:'a'~, ~str:\"b\"~)");
+  test("Classes - templates", "`a${ b }c`", "~tpl:`a${~ b ~tpl:}c`~");
+  test("Classes - regular expressions", "x = /a/g; y = a / b / c", "x = ~re:/a/g~; y = a / b / c");
+  test("Classes - comments", "a // b\n/* c */ d", "a ~com:// b~\n~com:/* c */~ d");
+  test("Classes - contextual keywords", "let x = async () => await y; for (a of b);", "~kw:let~ x = ~kw:async~ () => ~kw:await~ y; ~kw:for~ (a of b);");
+  test("Classes - property names", "a.class.if", "a.class.if");
+}
+
+void test_escaping() {
+  test("Escaping - punctuators", "a<b && c>d", "a<b && c>d");
+  test("Escaping - tokens", "'<&>' // <a>", "~str:'<&>'~ ~com:// <a>~");
+}
+
+void test_partial_code() {
+  test("Partial code - unterminated string", "a = 'b\nc", "a = ~str:'b~\nc");
+  test("Partial code - unterminated template", "`a${ b", "~tpl:`a${~ b");
+  test("Partial code - unexpected characters", "a # b @@", "a ~err:#~ b ~err:@~~err:@~");
+  test("Partial code - unterminated comment", "a /* b", "a ~com:/* b~");
+}
+
+void test_ansi() {
+  test_format<AnsiFormat>("ANSI", "if (a < 1) x", "\x1b[35mif\x1b[0m (a < \x1b[33m1\x1b[0m) x");
+  test_format<AnsiFormat>("ANSI - control characters",
+    "x = '\x1b[2J' // \a\r\n\tb \x7f",
+    "x = \x1b[32m'^[[2J'\x1b[0m \x1b[90m// ^G\x1b[0m^M\n\tb \x1b[41m^?\x1b[0m");
+}
+
+int main() {
+  test_classes();
+  test_escaping();
+  test_partial_code();
+  test_ansi();
+}
@@ -0,0 +1,94 @@
+import std.core;
+import BasicTypes;
+import ScanKernels;
+
+using std::string;
+using std::vector;
+
+// Bytes which each kernel treats specially, mixed with filler so that runs
+// of every length appear at every alignment
+const char test_bytes[] = "aZ09_$ \t\n\r*/'\"\\`x-\xa0\xe2\x80";
+
+string test_input(uint32 seed, size_t length, uint32 density) {
+  string input;
+  for (size_t i = 0; i < length; ++i) {
+    seed = seed * 1103515245 + 12345;
+    uint32 r = seed >> 16;
+    input.push_back(r % density == 0
+      ? test_bytes[r / density % (sizeof(test_bytes) - 1)]
+      : "abcdefgh   "[r / density % 11]);
+  }
+  return input;
+}
+
+void fail(const string& test_name, KernelLevel level, const char* kernel, size_t offset) {
+  std::cerr
+    << "[" << test_name << "]\n"
+    << "Error: Kernel " << kernel << " at level " << kernel_level_name(level)
+    << " does not match the scalar kernel at offset " << offset << "\n";
+  std::exit(1);
+}
+
+// Runs each kernel from every offset of the input and compares the result
+// with the scalar kernel
+void test(const string& test_name, const ScanKernels& kernels, const string& input) {
+  ScanKernels scalar = scan_kernels_for(KernelLevel::scalar);
+  auto first = reinterpret_cast<const uint8*>(input.data());
+  auto last = first + input.size();
+
+  for (size_t i = 0; i <= input.size(); ++i) {
+    auto p = first + i;
+    if (kernels.identifier(p, last) != scalar.identifier(p, last)) {
+      fail(test_name, kernels.level, "identifier", i);
+    }
+    for (uint8 delim : {'\'', '"'}) {
+      if (kernels.string_body(p, last, delim) != scalar.string_body(p, last, delim)) {
+        fail(test_name, kernels.level, "string_body", i);
+      }
+    }
+    if (kernels.line_comment(p, last) != scalar.line_comment(p, last)) {
+      fail(test_name, kernels.level, "line_comment", i);
+    }
+    if (kernels.block_comment(p, last) != scalar.block_comment(p, last)) {
+      fail(test_name, kernels.level, "block_comment", i);
+    }
+    if (kernels.whitespace(p, last) != scalar.whitespace(p, last)) {
+      fail(test_name, kernels.level, "whitespace", i);
+    }
+    if (kernels.count_newlines(p, last) != scalar.count_newlines(p, last)) {
+      fail(test_name, kernels.level, "count_newlines", i);
+    }
+  }
+}
+
+void test_levels() {
+  KernelLevel detected = detect_kernel_level();
+  for (auto level : {KernelLevel::sse42, KernelLevel::avx2, KernelLevel::avx512}) {
+    if (level > detected) {
+      break;
+    }
+    ScanKernels kernels = scan_kernels_for(level);
+    test("Kernels - sparse", kernels, test_input(1, 600, 40));
+    test("Kernels - dense", kernels, test_input(2, 600, 3));
+    test("Kernels - runs", kernels, string(100, 'a') + string(100, ' ') + string(100, '/'));
+  }
+}
+
+void test_override() {
+  auto check = [](const char* name, KernelLevel detected, KernelLevel expected) {
+    if (kernel_level_override(name, detected) != expected) {
+      std::cerr << "[Override]\nError: Unexpected level for \"" << (name ? name : "") << "\"\n";
+      std::exit(1);
+    }
+  };
+  check(nullptr, KernelLevel::avx2, KernelLevel::avx2);
+  check("scalar", KernelLevel::avx512, KernelLevel::scalar);
+  check("avx2", KernelLevel::avx512, KernelLevel::avx2);
+  check("avx512", KernelLevel::sse42, KernelLevel::sse42);
+  check("other", KernelLevel::avx2, KernelLevel::avx2);
+}
+
+int main() {
+  test_levels();
+  test_override();
+}
@@ -0,0 +1,166 @@
+import std.core;
+import Scanner;
+import ModuleLexer;
+
+using std::string;
+using std::ostringstream;
+
+const char* kind_name(ImportKind kind) {
+  switch (kind) {
+    case ImportKind::static_import: return "import";
+    case ImportKind::reexport: return "reexport";
+    case ImportKind::dynamic_import: return "dynamic";
+    case ImportKind::import_meta: return "meta";
+  }
+  return "";
+}
+
+string text(const string& input, SourceSpan span) {
+  return input.substr(span.start, span.end - span.start);
+}
+
+using Lexer = ModuleLexer<string::const_iterator>;
+
+const char* error_name(Lexer::Error error) {
+  switch (error) {
+    case Lexer::Error::none: return "none";
+    case Lexer::Error::invalid_token: return "invalid_token";
+    case Lexer::Error::unexpected_token: return "unexpected_token";
+  }
+  return "";
+}
+
+void test(
+  const string& test_name,
+  const string& input,
+  const string& expected_imports,
+  const string& expected_exports,
+  const string& expected_diagnostics = ""
+) {
+  Lexer lexer {input.begin(), input.end()};
+  bool ok = lexer.lex();
+
+  ostringstream diagnostics;
+  for (auto& diagnostic : lexer.diagnostics()) {
+    diagnostics << "(" << error_name(diagnostic.error) << " ";
+    if (diagnostic.scanner_error != ScannerError::none) {
+      diagnostics << scanner_error_name(diagnostic.scanner_error) << " ";
+    }
+    diagnostics << text(input, diagnostic.span) << ")";
+  }
+
+  ostringstream imports;
+  for (auto& entry : lexer.imports()) {
+    imports << "(" << kind_name(entry.kind) << " " << text(input, entry.specifier) << ")";
+  }
+
+  ostringstream exports;
+  for (auto& entry : lexer.exports()) {
+    exports << "(" << text(input, entry.name) << " " << text(input, entry.local) << ")";
+  }
+
+  if (
+    ok != expected_diagnostics.empty() ||
+    imports.str() != expected_imports ||
+    exports.str() != expected_exports ||
+    diagnostics.str() != expected_diagnostics
+  ) {
+    std::cerr
+      << "[" << test_name << "]\n"
+      << "Error: Module records are not equal\n"
+      << "Input string: " << input << "\n"
+      << "Expected diagnostics: " << expected_diagnostics << "\n"
+      << "Actual diagnostics:   " << diagnostics.str() << "\n"
+      << "Expected imports: " << expected_imports << "\n"
+      << "Actual imports:   " << imports.str() << "\n"
+      << "Expected exports: " << expected_exports << "\n"
+      << "Actual exports:   " << exports.str() << "\n";
+
+    std::exit(1);
+  }
+}
+
+void test_imports() {
+  test("Imports - declarations",
+    "import a from 'a'; import { b as c } from \"b\"; import * as d from 'd'; import 'e';",
+    "(import 'a')(import \"b\")(import 'd')(import 'e')", "");
+
+  test("Imports - dynamic import",
+    "x = import('a'); y = import(z + '.js');",
+    "(dynamic 'a')(dynamic )", "");
+
+  test("Imports - import.meta", "f(import.meta.url)", "(meta )", "");
+  test("Imports - other import properties", "import.metal; import.url", "", "");
+
+  test("Imports - property names are skipped",
+    "a.import('x'); ({ import: 'y' }); a.export",
+    "", "");
+
+  test("Imports - methods named import",
+    "class A { import() {} static import(a, b = (c)) {} } ({ async import(x) { import('y'); } })",
+    "(dynamic 'y')", "");
+
+  test("Imports - methods in Allman style",
+    "class A\n{\n  import()\n  {\n    import('x');\n  }\n}\nx = {\n  get import()\n  {\n  }\n}",
+    "(dynamic 'x')", "");
+
+  test("Imports - dynamic imports in bodies",
+    "({ a: import('x'), b: [import('y')] }); { import('z') } class B { c = import('w') }",
+    "(dynamic 'x')(dynamic 'y')(dynamic 'z')(dynamic 'w')", "");
+
+  test("Imports - awaited imports in object literals",
+    "const m = { home: await import('./home.js') };",
+    "(dynamic './home.js')", "");
+
+  test("Imports - imports in case blocks",
+    "switch (k) { case 'a': { await import('./a.js'); } }",
+    "(dynamic './a.js')", "");
+
+  test("Imports - imports in labelled blocks",
+    "label: { import('./e.js') }",
+    "(dynamic './e.js')", "");
+
+  test("Imports - strings, regexps and templates",
+    "'import a from \"x\"'; /import 'y'/; `${ { a: `import 'z'` } }`; a / import('w') / 2",
+    "(dynamic 'w')", "");
+}
+
+void test_exports() {
+  test("Exports - declarations",
+    "export function f() {} export async function g() {} export class C {} export default 1;",
+    "", "(f f)(g g)(C C)(default )");
+
+  test("Exports - variables",
+    "export const a = { b: 1 }, c = [d, e]\nexport let f\n", "", "(a a)(c c)(f f)");
+
+  test("Exports - lists", "export { a, b as c, d as default }",
+    "", "(a a)(c b)(default d)");
+
+  test("Exports - re-exports",
+    "export * from 'a'; export * as b from 'b'; export { c as d } from 'c';",
+    "(reexport 'a')(reexport 'b')(reexport 'c')", "(b )(d )");
+}
+
+// Errors are reported with the sites, which are still found after them
+void test_errors() {
+  test("Errors - invalid tokens",
+    "import a from 'a'; x = 0x # 1; export { b }",
+    "(import 'a')", "(b b)",
+    "(invalid_token invalid_hex_literal 0x)(invalid_token unexpected_character #)");
+
+  test("Errors - malformed import",
+    "import a from ; import 'b'; export * as 1 from 'c'; export { d }",
+    "(import 'b')", "(d d)",
+    "(unexpected_token ;)(unexpected_token 1)");
+
+  test("Errors - unterminated import",
+    "x = 'y\nimport { a",
+    "", "",
+    "(invalid_token unterminated_string 'y)(unexpected_token )");
+}
+
+int main() {
+  test_imports();
+  test_exports();
+  test_errors();
+}
@@ -0,0 +1,93 @@
+import std.core;
+import Scanner;
+import Tokenizer;
+import Minifier;
+import Writer;
+import test.TokenStrings;
+
+using std::string;
+using std::vector;
+
+vector<Token> tokens(const string& input) {
+  Tokenizer tokenizer {input.begin(), input.end()};
+  vector<Token> result;
+  while (true) {
+    Token t = tokenizer.next();
+    if (t != Token::comment) {
+      result.push_back(t);
+    }
+    if (t == Token::end || t == Token::error) {
+      return result;
+    }
+  }
+}
+
+// Checks the minified output, and that it scans to the same tokens as the
+// input
+void test(const string& test_name, const string& input, const string& expected) {
+  string output;
+  StringWriter writer {output};
+  Minifier minifier {input.begin(), input.end(), writer};
+  bool ok = minifier.minify();
+
+  if (!ok || output != expected || tokens(output) != tokens(input)) {
+    std::cerr
+      << "[" << test_name << "]\n"
+      << "Error: Unexpected minifier output\n"
+      << "Input string: " << input << "\n"
+      << "Output string: " << output << "\n"
+      << "Output tokens:\n";
+
+    for (auto t : tokens(output)) {
+      std::cerr << "- " << t << "\n";
+    }
+
+    std::exit(1);
+  }
+}
+
+void test_separators() {
+  test("Separators - words", "var  a = typeof b in c ;", "var a=typeof b in c;");
+  test("Separators - punctuators", "a + +b - -c + ++d - --e", "a+ +b- -c+ ++d- --e");
+  test("Separators - comment openers", "a / /b/ / c; x = /a/ * 2", "a/ /b/ /c;x=/a/ *2");
+  test("Separators - number suffixes", "1 .toString(); 1. in x; /a/ in y", "1 .toString();1. in x;/a/ in y");
+  test("Separators - html comments", "a < !b; c-- > d", "a< !b;c-- >d");
+  test("Separators - regexp after await", "async () => await / a b /.exec(c)", "async()=>await/ a b /.exec(c)");
+  test("Separators - templates", "`a${ b }c${ `d` }`", "`a${b}c${`d`}`");
+}
+
+void test_line_breaks() {
+  test("Line breaks - automatic semicolons", "a = b\nc = d\n", "a=b\nc=d");
+  test("Line breaks - continuation", "a = b\n.c\n* d\n, e", "a=b.c*d,e");
+  test("Line breaks - declarations", "let a\n[b] = c\nlet d\n(e)", "let a\n[b]=c\nlet d\n(e)");
+  test("Line breaks - restricted productions", "return\n-1; a\n++b; x = y\n/* c\n */ z", "return\n-1;a\n++b;x=y\nz");
+  test("Line breaks - blocks", "if (a) {\n  b()\n}\nelse {\n  c()\n}", "if(a){b()}\nelse{c()}");
+}
+
+void test_comments() {
+  test("Comments - removed", "// a\na /* b */ = /* c */ 1", "a=1");
+  test("Comments - license", "/*! MIT */\n/* x */ a = 1 /*! y */ + 2", "/*! MIT */\na=1 /*! y */+2");
+  test("Comments - license before return value", "return /*! keep */ x", "return /*! keep */x");
+  test("Comments - license before thrown value", "throw /*! k */ e", "throw /*! k */e");
+  test("Comments - license before yielded value", "function* g() { yield /*! k */ x }", "function*g(){yield /*! k */x}");
+  test("Comments - license before postfix", "a /*! k */ ++; b /*! k */ / c", "a /*! k */++;b /*! k */ /c");
+  test("Comments - license before line break", "return /*! k */\nx; y /* a */ /*! k */ /* b\n */ z", "return /*! k */\nx;y /*! k */\nz");
+}
+
+void test_errors() {
+  string input = "a = 'b\nc";
+  string output;
+  StringWriter writer {output};
+  Minifier minifier {input.begin(), input.end(), writer};
+  if (minifier.minify() || minifier.error_position() != 4 || output != "a=") {
+    std::cerr << "[Errors - invalid token]\nError: Expected an error at position 4\n";
+    std::exit(1);
+  }
+}
+
+int main() {
+  test_separators();
+  test_line_breaks();
+  test_comments();
+  test_errors();
+}
@@ -0,0 +1,648 @@
+import std.core;
+import Ast;
+import Parser;
+import test.AstStrings;
+
+using std::string;
+using std::ostringstream;
+
+void print(std::ostream& out, const Ast& ast, NodeIndex index) {
+  const Node& node = ast[index];
+  if (!ast.last_child(index)) {
+    out << node.kind;
+    return;
+  }
+  // Children are found from the last
+  std::vector<NodeIndex> children;
+  for (NodeIndex child = ast.last_child(index); child; child = ast.previous_sibling(index, child)) {
+    children.push_back(child);
+  }
+  out << "(" << node.kind;
+  for (auto child = children.rbegin(); child != children.rend(); ++child) {
+    out << " ";
+    print(out, ast, *child);
+  }
+  out << ")";
+}
+
+void test(
+  const string& test_name,
+  const string& input,
+  const string& expected,
+  bool module = false
+) {
+  Ast ast;
+  Parser parser {input.begin(), input.end(), ast};
+  NodeIndex root = module ? parser.parse_module() : parser.parse_script();
+
+  ostringstream out;
+  print(out, ast, root);
+
+  if (parser.error() != decltype(parser)::Error::none || out.str() != expected) {
+    std::cerr
+      << "[" << test_name << "]\n"
+      << "Error: Syntax trees are not equal\n"
+      << "Input string: " << input << "\n"
+      << "Parse error: " << int(parser.error()) << "\n"
+      << "Expected: " << expected << "\n"
+      << "Actual:   " << out.str() << "\n";
+
+    std::exit(1);
+  }
+}
+
+void test_module(
+  const string& test_name,
+  const string& input,
+  const string& expected
+) {
+  test(test_name, input, expected, true);
+}
+
+void test_error(
+  const string& test_name,
+  const string& input,
+  bool module = false
+) {
+  Ast ast;
+  Parser parser {input.begin(), input.end(), ast};
+  if (module) {
+    parser.parse_module();
+  } else {
+    parser.parse_script();
+  }
+
+  if (parser.error() == decltype(parser)::Error::none) {
+    std::cerr
+      << "[" << test_name << "]\n"
+      << "Error: Expected a syntax error\n"
+      << "Input string: " << input << "\n";
+
+    std::exit(1);
+  }
+}
+
+void test_valid(
+  const string& test_name,
+  const string& input,
+  bool module = false
+) {
+  Ast ast;
+  Parser parser {input.begin(), input.end(), ast};
+  if (module) {
+    parser.parse_module();
+  } else {
+    parser.parse_script();
+  }
+
+  if (parser.error() != decltype(parser)::Error::none) {
+    std::cerr
+      << "[" << test_name << "]\n"
+      << "Error: Unexpected syntax error\n"
+      << "Input string: " << input << "\n"
+      << "Parse error: " << int(parser.error()) << "\n";
+
+    std::exit(1);
+  }
+}
+
+void test_lazy(
+  const string& test_name,
+  const string& input,
+  const string& expected_free,
+  uint16 expected_uses
+) {
+  Ast eager_ast;
+  Parser eager {input.begin(), input.end(), eager_ast};
+  ostringstream expected;
+  print(expected, eager_ast, eager.parse_script());
+
+  Ast ast;
+  Parser parser {input.begin(), input.end(), ast};
+  parser.set_lazy_functions(true);
+  NodeIndex root = parser.parse_script();
+
+  ostringstream free;
+  uint16 uses = 0;
+  if (!ast.lazy_functions.empty()) {
+    const LazyFunction& lazy = ast.lazy_functions.front();
+    for (uint32 i = lazy.free_begin; i < lazy.free_end; ++i) {
+      SourceSpan span = ast.free_variables[i];
+      free << (i > lazy.free_begin ? " " : "") << input.substr(span.start, span.end - span.start);
+    }
+    uses = lazy.uses;
+  }
+
+  // Parsing each lazy body in turn must produce the same tree as an eager parse
+  for (size_t i = 0; i < ast.lazy_functions.size(); ++i) {
+    parser.parse_lazy_body(ast.lazy_functions[i].body);
+  }
+  ostringstream actual;
+  print(actual, ast, root);
+
+  if (
+    parser.error() != decltype(parser)::Error::none ||
+    free.str() != expected_free ||
+    uses != expected_uses ||
+    actual.str() != expected.str()
+  ) {
+    std::cerr
+      << "[" << test_name << "]\n"
+      << "Error: Lazy parse does not match\n"
+      << "Input string: " << input << "\n"
+      << "Parse error: " << int(parser.error()) << "\n"
+      << "Expected free variables: " << expected_free << " (uses " << expected_uses << ")\n"
+      << "Actual free variables:   " << free.str() << " (uses " << uses << ")\n"
+      << "Expected: " << expected.str() << "\n"
+      << "Actual:   " << actual.str() << "\n";
+
+    std::exit(1);
+  }
+}
+
+void test_statements() {
+  test("Statements - variable declaration", "var a = 1, b, [c] = d;",
+    "(script (variable_declaration "
+      "(variable_declarator number) "
+      "variable_declarator "
+      "(variable_declarator (array_pattern identifier) identifier)))");
+
+  test("Statements - if else", "if (a) b; else {}",
+    "(script (if_statement identifier (expression_statement identifier) block))");
+
+  test("Statements - for", "for (let i = 0; i < n; ++i) {}",
+    "(script (for_statement "
+      "(variable_declaration (variable_declarator number)) "
+      "(binary_expression identifier identifier) "
+      "(update_expression identifier) "
+      "block))");
+
+  test("Statements - for of with pattern", "for ([a, b] of c);",
+    "(script (for_of_statement (array_pattern identifier identifier) identifier empty_statement))");
+
+  test("Statements - labelled break", "a: while (1) break a;",
+    "(script (labelled_statement identifier "
+      "(while_statement number (break_statement identifier))))");
+
+  test("Statements - try catch finally", "try {} catch ({ a }) {} finally {}",
+    "(script (try_statement block "
+      "(catch_clause (object_pattern (shorthand_property identifier)) block) "
+      "block))");
+
+  test("Statements - switch", "switch (a) { case 1: b; default: }",
+    "(script (switch_statement identifier "
+      "(switch_case number (expression_statement identifier)) "
+      "switch_case))");
+
+  test_error("Statements - return outside function", "return 1;");
+  test_error("Statements - try without handler", "try {}");
+  test_error("Statements - const without initializer", "const a;");
+  test_error("Statements - for await in", "async function f() { for await (a in b); }");
+  test_error("Statements - for await", "async function f() { for await (;;); }");
+  test_error("Statements - for in with let initializer", "for (let a = 1 in b);");
+  test_error("Statements - for of with const initializer", "for (const a = 1 of b);");
+  test_error("Statements - for of with var initializer", "for (var a = 1 of b);");
+  test_error("Statements - strict for in with var initializer", "'use strict'; for (var a = 1 in b);");
+  test_error("Statements - class in if", "if (a) class B {}");
+  test_error("Statements - function in while", "while (a) function f() {}");
+  test_error("Statements - function in else", "if (a); else for (;;) function f() {}");
+  test_error("Statements - strict function in if", "'use strict'; if (a) function f() {}");
+  test_error("Statements - strict labelled function", "'use strict'; a: function f() {}");
+
+  test("Statements - sloppy function in if", "if (a) function f() {} else function g() {}",
+    "(script (if_statement identifier "
+      "(function_declaration identifier formal_parameters function_body) "
+      "(function_declaration identifier formal_parameters function_body)))");
+
+  test("Statements - sloppy for in with var initializer", "for (var a = 1 in b);",
+    "(script (for_in_statement "
+      "(variable_declaration (variable_declarator number)) "
+      "identifier empty_statement))");
+
+  test("Statements - for await of", "async function f() { for await (a of b); }",
+    "(script (function_declaration identifier formal_parameters "
+      "(function_body (for_of_statement identifier identifier empty_statement))))");
+}
+
+void test_asi() {
+  test("ASI - newline", "a\nb",
+    "(script (expression_statement identifier) (expression_statement identifier))");
+
+  test("ASI - restricted return", "function f() { return\na }",
+    "(script (function_declaration identifier formal_parameters "
+      "(function_body return_statement (expression_statement identifier))))");
+
+  test("ASI - restricted postfix", "a\n++b",
+    "(script (expression_statement identifier) "
+      "(expression_statement (update_expression identifier)))");
+
+  test("ASI - newline in block comment", "a /*\n*/ b",
+    "(script (expression_statement identifier) (expression_statement identifier))");
+
+  test_error("ASI - no newline", "a b");
+}
+
+void test_expressions() {
+  test("Expressions - precedence", "a + b * c",
+    "(script (expression_statement (binary_expression identifier "
+      "(binary_expression identifier identifier))))");
+
+  test("Expressions - exponent is right associative", "a ** b ** c",
+    "(script (expression_statement (binary_expression identifier "
+      "(binary_expression identifier identifier))))");
+
+  test("Expressions - divide and regexp", "a / b / /c/g",
+    "(script (expression_statement (binary_expression "
+      "(binary_expression identifier identifier) regexp)))");
+
+  test("Expressions - conditional", "a ? b : c",
+    "(script (expression_statement (conditional_expression identifier identifier identifier)))");
+
+  test("Expressions - member and call", "a.b[c](d, ...e)",
+    "(script (expression_statement (call_expression "
+      "(computed_member (member_expression identifier) identifier) "
+      "identifier (spread identifier))))");
+
+  test("Expressions - new", "new a.b(c)",
+    "(script (expression_statement (new_expression "
+      "(member_expression identifier) identifier)))");
+
+  test("Expressions - template", "`a${ b }c${ `d${ e }` }f`",
+    "(script (expression_statement (template_literal template_part identifier template_part "
+      "(template_literal template_part identifier template_part) template_part)))");
+
+  test("Expressions - object literal", "({ a, b: 1, [c]: 2, get d() {}, async *e() {} })",
+    "(script (expression_statement (paren_expression (object_literal "
+      "(shorthand_property identifier) "
+      "(property_definition number) "
+      "(property_definition (computed_name identifier) number) "
+      "(method_definition identifier formal_parameters function_body) "
+      "(method_definition identifier formal_parameters function_body)))))");
+
+  test("Expressions - contextual keywords as identifiers", "of = async + let",
+    "(script (expression_statement (assignment_expression identifier "
+      "(binary_expression identifier identifier))))");
+
+  test_error("Expressions - invalid assignment target", "a + b = c");
+  test_error("Expressions - unary before exponent", "-a ** b");
+  test_error("Expressions - await before exponent", "async function f() { await x ** 2; }");
+
+  // Later than ES2019
+  test_error("Expressions - optional chaining", "a?.b");
+  test_error("Expressions - nullish coalescing", "a ?? b");
+  test_error("Expressions - logical or assignment", "a ||= b");
+  test_error("Expressions - logical and assignment", "a &&= b");
+  test_error("Expressions - nullish assignment", "a ?\?= b");
+  test_error("Expressions - class fields", "class A { b = 1; }");
+}
+
+void test_patterns() {
+  test("Patterns - destructuring assignment", "[a, { b = 1 }, ...c] = d",
+    "(script (expression_statement (assignment_expression "
+      "(array_pattern identifier "
+      "(object_pattern (shorthand_property identifier number)) "
+      "(rest_element identifier)) "
+      "identifier)))");
+
+  test("Patterns - property names", "({ a: b, 'c': [d] } = e); var { f: g } = h",
+    "(script (expression_statement (paren_expression (assignment_expression (object_pattern "
+      "(pattern_property identifier) "
+      "(pattern_property string (array_pattern identifier))) "
+      "identifier))) "
+      "(variable_declaration (variable_declarator (object_pattern (pattern_property identifier)) identifier)))");
+
+  test_error("Patterns - cover initializer outside pattern", "({ a = 1 })");
+  test_error("Patterns - invalid rest position", "[...a, b] = c");
+}
+
+void test_functions() {
+  test("Functions - arrow", "(a, b = 1) => a",
+    "(script (expression_statement (arrow_function "
+      "(formal_parameters identifier (pattern_default identifier number)) "
+      "identifier)))");
+
+  test("Functions - arrow without parameters", "() => {}",
+    "(script (expression_statement (arrow_function formal_parameters function_body)))");
+
+  test("Functions - async arrow", "async x => await x",
+    "(script (expression_statement (arrow_function "
+      "(formal_parameters identifier) (await_expression identifier))))");
+
+  test("Functions - async call is not an arrow", "async(x)",
+    "(script (expression_statement (call_expression identifier identifier)))");
+
+  test("Functions - generator", "function* g() { yield* a; }",
+    "(script (function_declaration identifier formal_parameters "
+      "(function_body (expression_statement (yield_expression identifier)))))");
+
+  test("Functions - octal escape in sloppy directive", "'\\01'; 010",
+    "(script directive (expression_statement number))");
+
+  test("Functions - use strict directive", "function f() { 'use strict'; }",
+    "(script (function_declaration identifier formal_parameters "
+      "(function_body directive)))");
+
+  test("Functions - class", "class A extends B { static m() {} constructor() {} }",
+    "(script (class_declaration identifier identifier (class_body "
+      "(method_definition identifier formal_parameters function_body) "
+      "(method_definition identifier formal_parameters function_body))))");
+
+  test_error("Functions - strict legacy octal number", "'use strict'; 010");
+  test_error("Functions - strict legacy octal in function", "function f() { 'use strict'; 010 }");
+  test_error("Functions - octal escape before use strict", "'\\01'; 'use strict';");
+  test_error("Functions - octal escape before use strict in function", "function f() { '\\01'; 'use strict'; }");
+  test_error("Functions - strict mode reserved word", "function f() { 'use strict'; var let; }");
+  test_error("Functions - newline before arrow", "(a)\n=> a");
+  test_error("Functions - rest parameter is not an expression", "(...a)");
+}
+
+void test_early_errors() {
+  test_error("Early errors - unlabelled break in labelled block", "a: { break; }");
+  test_error("Early errors - undefined label", "a: while (1) break b;");
+  test_error("Early errors - continue to a block label", "a: { while (1) continue a; }");
+  test_error("Early errors - label across a function", "a: while (1) { (function() { break a; }); }");
+  test_valid("Early errors - labelled block break", "a: { break a; }");
+  test_valid("Early errors - nested labels", "a: b: while (1) continue a;");
+
+  test_error("Early errors - super call in a method", "({ m() { super(); } })");
+  test_error("Early errors - super call in a base constructor", "class A { constructor() { super(); } }");
+  test_error("Early errors - super property in a function", "function f() { super.a; }");
+  test_valid("Early errors - super call in a derived constructor", "class A extends B { constructor() { () => super(); } }");
+  test_valid("Early errors - super property in a method", "({ m() { return super.a; } })");
+
+  test_error("Early errors - new.target outside function", "new.target");
+  test_error("Early errors - new.target in a top level arrow", "() => new.target");
+  test_error("Early errors - new.target in a nested arrow", "() => { () => new.target; }");
+  test_valid("Early errors - new.target in an arrow in a function", "function f() { () => new.target; }");
+
+  test_error("Early errors - strict delete of an identifier", "'use strict'; delete (x);");
+  test_error("Early errors - strict assignment to eval", "'use strict'; eval = 1;");
+  test_error("Early errors - strict update of arguments", "'use strict'; arguments++;");
+  test_valid("Early errors - sloppy delete and assignment", "delete x; eval = 1;");
+
+  test_error("Early errors - duplicate __proto__", "({ __proto__: a, '__proto__': b })");
+  test_valid("Early errors - __proto__ shorthand and computed", "({ __proto__: a, __proto__, ['__proto__']: b })");
+  test_valid("Early errors - duplicate __proto__ in a pattern", "({ __proto__: a, __proto__: b } = c)");
+
+  test_error("Early errors - duplicate default", "switch (a) { default: case 1: default: }");
+
+  test_error("Early errors - duplicate let", "let a; let a;");
+  test_error("Early errors - let and var", "let a; { var a; }");
+  test_error("Early errors - var and let", "{ var a; } let a;");
+  test_error("Early errors - let and function", "{ let a; function a() {} }");
+  test_error("Early errors - catch parameter pattern and var", "try {} catch ([e]) { var e; }");
+  test_error("Early errors - module function and var", "function a() {} var a;", true);
+  test_error("Early errors - strict block functions", "'use strict'; { function a() {} function a() {} }");
+  test_valid("Early errors - var redeclaration", "var a; var a; function a() {}");
+  test_valid("Early errors - shadowing", "let a; { let a; } function f(a) { var a; }");
+  test_valid("Early errors - catch parameter and var", "try {} catch (e) { var e; }");
+  test_valid("Early errors - sloppy block functions", "{ function a() {} function a() {} }");
+  test_valid("Early errors - for declarations", "for (let a;;) { let a; } let a;");
+  test_valid("Early errors - function expression names", "let a = function a() {}, b = class b {};");
+
+  test_error("Early errors - const without initializer in for", "for (const a;;);");
+  test_error("Early errors - pattern without initializer", "let [a];");
+  test_valid("Early errors - const in for of", "for (const a of b);");
+
+  test_error("Early errors - use strict with default parameter", "function f(a = 1) { 'use strict'; }");
+  test_error("Early errors - use strict with pattern parameter", "({ m([a]) { 'use strict'; } })");
+  test_error("Early errors - use strict in arrow with rest", "(...a) => { 'use strict'; }");
+  test_valid("Early errors - use strict with simple parameters", "function f(a, b) { 'use strict'; }");
+}
+
+void test_modules() {
+  test_module("Modules - imports", "import a, { b as c, d } from 'x'; import * as e from 'y';",
+    "(module (import_declaration "
+      "identifier "
+      "(import_specifier identifier identifier) "
+      "(import_specifier identifier) "
+      "string) "
+      "(import_declaration import_namespace string))");
+
+  test_module("Modules - exports", "export { a as b }; export * from 'x'; export default 1;",
+    "(module (export_named (export_specifier identifier identifier)) "
+      "(export_all string) "
+      "(export_default number))");
+
+  test_module("Modules - export declaration", "export default function() {}",
+    "(module (export_default (function_declaration formal_parameters function_body)))");
+
+  test_module("Modules - dynamic import and import.meta", "import('a'); import.meta",
+    "(module (expression_statement (import_call string)) "
+      "(expression_statement import_meta))");
+
+  test_error("Modules - await is reserved", "await = 1", true);
+  test_error("Modules - legacy octal number", "010", true);
+  test_error("Modules - legacy octal escape", "'\\010'", true);
+  test_error("Modules - import.meta in script", "import.meta");
+}
+
+void test_lazy_functions() {
+  test_lazy("Lazy - super in a skipped constructor", "class A extends B { constructor() { super(); } }",
+    "", lazy_none);
+
+  test_lazy("Lazy - free variables", "function f(a, { b }) { var c = a + b + d; return c.e(g); }",
+    "d g", lazy_none);
+
+  test_lazy("Lazy - property names are not references", "function f() { return { a: b, c }; }",
+    "b c", lazy_none);
+
+  test_lazy("Lazy - nested declarations are conservative", "function f() { x(); { let x; } }",
+    "x", lazy_none);
+
+  test_lazy("Lazy - regexp and template braces", "function f() { return /}/.test(`${ { a } }`) / b; }",
+    "a b", lazy_none);
+
+  test_lazy("Lazy - arguments and eval", "function f() { eval(arguments[0]); }",
+    "eval", lazy_uses_arguments | lazy_uses_eval);
+
+  test_lazy("Lazy - await", "async function f() { await g(); }",
+    "g", lazy_uses_await);
+
+  test_lazy("Lazy - yield", "function* f() { yield; }",
+    "", lazy_uses_yield);
+
+  test_lazy("Lazy - nested functions", "function f() { function g() { return h; } return g; }",
+    "h", lazy_none);
+
+  test_lazy("Lazy - function expression names are not declarations",
+    "function f() { var x = function g() {}; return g; }",
+    "g", lazy_none);
+
+  test_lazy("Lazy - class expression names are not declarations",
+    "function f() { x = class C {}; return C; }",
+    "x C", lazy_none);
+
+  test_lazy("Lazy - async function declarations",
+    "function f() { async function g() { await h; } return g + async; }",
+    "h async", lazy_none);
+
+  test_lazy("Lazy - await in nested functions",
+    "function f() { async function g() { await a; } function h() { await; } x => { await; } }",
+    "a await x", lazy_none);
+
+  test_lazy("Lazy - methods and arrows", "({ m() { return a; } }); x => { b; }",
+    "a", lazy_none);
+
+  {
+    string input = "function f() { {";
+    Ast ast;
+    Parser parser {input.begin(), input.end(), ast};
+    parser.set_lazy_functions(true);
+    parser.parse_script();
+    if (parser.error() == decltype(parser)::Error::none) {
+      std::cerr << "[Lazy - unbalanced braces]\nError: Expected a syntax error\n";
+      std::exit(1);
+    }
+  }
+
+  {
+    string input = "() => { new.target; }";
+    Ast ast;
+    Parser parser {input.begin(), input.end(), ast};
+    parser.set_lazy_functions(true);
+    parser.parse_script();
+    for (size_t i = 0; i < ast.lazy_functions.size(); ++i) {
+      parser.parse_lazy_body(ast.lazy_functions[i].body);
+    }
+    if (parser.error() == decltype(parser)::Error::none) {
+      std::cerr << "[Lazy - new.target in a top level arrow]\nError: Expected a syntax error\n";
+      std::exit(1);
+    }
+  }
+}
+
+// Missing optional children are left out rather than stored as nodes, with
+// flags where the children present would otherwise be ambiguous
+void test_absent_children() {
+  string input =
+    "for (;;) {} for (a;; b) {} switch (c) { default: } "
+    "class D extends E {} (class {}); try {} catch {}";
+  Ast ast;
+  Parser parser {input.begin(), input.end(), ast};
+  NodeIndex root = parser.parse_script();
+
+  auto fail = [&](const string& message) {
+    std::cerr << "[Nodes - absent children]\nError: " << message << "\n";
+    std::exit(1);
+  };
+
+  if (parser.error() != decltype(parser)::Error::none) {
+    fail("Unexpected parse error");
+  }
+  for (NodeIndex i = 1; i <= ast.node_count(); ++i) {
+    if (ast[i].kind == NodeKind::none) {
+      fail("Found a none node");
+    }
+  }
+
+  NodeIndex empty_for = ast.child(root, 0);
+  NodeIndex for_with_update = ast.child(root, 1);
+  NodeIndex default_case = ast.child(ast.child(root, 2), 1);
+  NodeIndex derived_class = ast.child(root, 3);
+  NodeIndex anonymous_class = ast.child(ast.child(ast.child(root, 4), 0), 0);
+  NodeIndex try_statement = ast.child(root, 5);
+
+  uint16 loop_flags = flag_has_init | flag_has_test | flag_has_update;
+  if ((ast[empty_for].flags & loop_flags) != 0 || ast.child_count(empty_for) != 1) {
+    fail("Unexpected children of for (;;)");
+  }
+  if ((ast[for_with_update].flags & loop_flags) != (flag_has_init | flag_has_update)) {
+    fail("Unexpected flags of for (a;; b)");
+  }
+  if (ast[default_case].has_flag(flag_has_test) || ast.child_count(default_case) != 0) {
+    fail("Unexpected children of default case");
+  }
+  if (!ast[derived_class].has_flag(flag_has_heritage) || ast.child_count(derived_class) != 3) {
+    fail("Unexpected children of derived class");
+  }
+  if (
+    ast[anonymous_class].kind != NodeKind::class_expression ||
+    ast[anonymous_class].has_flag(flag_has_heritage) ||
+    ast.child_count(anonymous_class) != 1
+  ) {
+    fail("Unexpected children of anonymous class");
+  }
+  if (ast.child_count(try_statement) != 2 || ast.child_count(ast.child(try_statement, 1)) != 1) {
+    fail("Unexpected children of try statement");
+  }
+}
+
+void test_memory_source(const string& test_name, const string& input) {
+  Ast ast;
+  Parser parser {input.begin(), input.end(), ast};
+  parser.parse_script();
+
+  if (parser.error() != decltype(parser)::Error::none || ast.bytes_used() > 2 * input.size()) {
+    std::cerr
+      << "[" << test_name << "]\n"
+      << "Error: Syntax tree is larger than twice the source\n"
+      << "Parse error: " << int(parser.error()) << "\n"
+      << "Source bytes: " << input.size() << "\n"
+      << "Arena bytes: " << ast.bytes_used() << "\n";
+
+    std::exit(1);
+  }
+}
+
+// The tree takes at most two bytes per source byte, including minified code
+// where most tokens are a character or two long
+void test_memory() {
+  test_memory_source("Memory - formatted source",
+    "// Queue of pending callbacks, flushed once per tick\n"
+    "var EventQueue = (function () {\n"
+    "  function EventQueue(options) {\n"
+    "    this.pending = [];\n"
+    "    this.limit = options && options.limit || 16;\n"
+    "  }\n"
+    "\n"
+    "  EventQueue.prototype.push = function (callback, context) {\n"
+    "    if (typeof callback !== 'function') {\n"
+    "      throw new TypeError('Expected a function, got ' + typeof callback);\n"
+    "    }\n"
+    "    this.pending.push({ callback: callback, context: context });\n"
+    "    return this.pending.length;\n"
+    "  };\n"
+    "\n"
+    "  EventQueue.prototype.flush = function () {\n"
+    "    var count = Math.min(this.pending.length, this.limit);\n"
+    "    for (var i = 0; i < count; i++) {\n"
+    "      var entry = this.pending[i];\n"
+    "      entry.callback.call(entry.context, i);\n"
+    "    }\n"
+    "    this.pending = this.pending.slice(count);\n"
+    "  };\n"
+    "\n"
+    "  return EventQueue;\n"
+    "})();\n");
+
+  test_memory_source("Memory - minified source",
+    "!function(e,t){\"object\"==typeof exports&&\"undefined\"!=typeof module?"
+    "module.exports=t():\"function\"==typeof define&&define.amd?define(t):"
+    "(e=e||self).Tooltip=t()}(this,function(){\"use strict\";"
+    "var e={placement:\"top\",delay:150,className:\"tooltip\"};"
+    "function t(t,n){if(!(this instanceof t))throw new TypeError(\"Cannot call a class as a function\")}"
+    "function n(n,o){t(this,n),this.element=n,this.options=Object.assign({},e,o),this.visible=!1,"
+    "n.addEventListener(\"mouseenter\",this.show.bind(this)),"
+    "n.addEventListener(\"mouseleave\",this.hide.bind(this))}"
+    "return n.prototype.show=function(){var e=this;this.timer=setTimeout(function(){"
+    "var t=document.createElement(\"div\");"
+    "t.className=e.options.className+\" \"+e.options.className+\"-\"+e.options.placement,"
+    "t.textContent=e.element.getAttribute(\"data-title\"),document.body.appendChild(t),"
+    "e.tip=t,e.visible=!0},this.options.delay)},n.prototype.hide=function(){"
+    "clearTimeout(this.timer),this.visible&&(this.tip.parentNode.removeChild(this.tip),"
+    "this.tip=null,this.visible=!1)},n});");
+}
+
+int main() {
+  test_statements();
+  test_asi();
+  test_expressions();
+  test_patterns();
+  test_functions();
+  test_early_errors();
+  test_modules();
+  test_lazy_functions();
+  test_absent_children();
+  test_memory();
+}
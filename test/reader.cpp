@@ -0,0 +1,76 @@
+#include <filesystem>
+
+import std.core;
+import BasicTypes;
+import cli.FileReader;
+import test.Helpers;
+
+using std::string;
+using std::vector;
+
+namespace fs = std::filesystem;
+
+// Reads every file with the backend and checks the contents, whatever the
+// order of delivery. An empty expectation marks a file which cannot be read.
+void test(
+  const string& test_name,
+  ReadBackend backend,
+  const vector<string>& paths,
+  const vector<string>& expected,
+  uint32 jobs = 1)
+{
+  vector<bool> seen(paths.size());
+  FileReader reader {paths, backend, jobs};
+  if (backend == ReadBackend::automatic && jobs == 1 && reader.backend() != ReadBackend::pread) {
+    fail(test_name, "Expected pread for a single job");
+  }
+  for (ReadFile file; reader.pop(file);) {
+    if (file.index >= paths.size() || seen[file.index]) {
+      fail(test_name, "File delivered twice");
+    }
+    seen[file.index] = true;
+    bool missing = expected[file.index].empty();
+    if (file.ok == missing || (file.ok && file.contents != expected[file.index])) {
+      fail(test_name, "Unexpected contents for " + paths[file.index]);
+    }
+  }
+  for (size_t i = 0; i < seen.size(); ++i) {
+    if (!seen[i]) {
+      fail(test_name, "File not delivered: " + paths[i]);
+    }
+  }
+}
+
+void test_backends() {
+  fs::path dir = fs::temp_directory_path() / "xxparsejs-test-reader";
+  fs::create_directories(dir);
+
+  vector<string> paths;
+  vector<string> expected;
+  for (int i = 0; i < 300; ++i) {
+    // More files than the ring has slots, and files which fill its buffers
+    size_t size = i % 50 == 0 ? size_t(300000 + i) : i == 1 ? size_t(128 << 10) : size_t(i * 7 + 1);
+    string contents(size, '\0');
+    for (size_t j = 0; j < size; ++j) {
+      contents[j] = char('a' + (i + j) % 26);
+    }
+    string path = (dir / ("f" + std::to_string(i) + ".js")).string();
+    std::ofstream(path, std::ios::binary) << contents;
+    paths.push_back(path);
+    expected.push_back(contents);
+  }
+  paths.push_back((dir / "missing.js").string());
+  expected.push_back("");
+
+  test("Backends - automatic", ReadBackend::automatic, paths, expected);
+  test("Backends - automatic with several jobs", ReadBackend::automatic, paths, expected, 4);
+  test("Backends - uring", ReadBackend::uring, paths, expected);
+  test("Backends - pread", ReadBackend::pread, paths, expected);
+  test("Backends - no files", ReadBackend::automatic, {}, {});
+
+  fs::remove_all(dir);
+}
+
+int main() {
+  test_backends();
+}
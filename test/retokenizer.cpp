@@ -0,0 +1,269 @@
+import std.core;
+import Scanner;
+import Tokenizer;
+import TokenBuffer;
+import Retokenizer;
+import CheckpointIndex;
+import test.TokenStrings;
+
+using std::string;
+using std::vector;
+
+using Iterator = string::const_iterator;
+using Result = Scanner<Iterator>::Result;
+using Diagnostic = Scanner<Iterator>::Diagnostic;
+
+TokenBuffer tokenize(const string& input, vector<Diagnostic>* diagnostics, bool strict_mode = false) {
+  Tokenizer tokenizer {input.begin(), input.end()};
+  tokenizer.scanner().set_strict_mode(strict_mode);
+  if (diagnostics) {
+    tokenizer.scanner().set_recovery(diagnostics);
+  }
+  TokenBuffer buffer;
+  while (true) {
+    Token t = tokenizer.next();
+    buffer.push_back(tokenizer.result());
+    if (t == Token::end || t == Token::error) {
+      return buffer;
+    }
+  }
+}
+
+bool same_buffer(const TokenBuffer& a, const TokenBuffer& b) {
+  if (a.size() != b.size()) {
+    return false;
+  }
+  for (uint32 i = 0; i < a.size(); ++i) {
+    Result x = a.result<Result>(i);
+    Result y = b.result<Result>(i);
+    bool same =
+      x.token == y.token &&
+      x.keyword == y.keyword &&
+      x.start == y.start &&
+      x.end == y.end &&
+      x.newline_before == y.newline_before &&
+      x.error == y.error;
+    if (!same) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void print_buffer(const TokenBuffer& buffer) {
+  for (uint32 i = 0; i < buffer.size(); ++i) {
+    std::cerr << "- " << buffer[i].token << " " << buffer[i].start << "-" << buffer.end(i) << "\n";
+  }
+}
+
+// Replaces deleted code units at offset with the inserted string, and checks
+// that applying the token delta gives the tokens of the edited input. If
+// max_inserted is given, the delta may contain no more records than that.
+void test(
+  const string& test_name,
+  const string& input,
+  uint32 offset,
+  uint32 deleted,
+  const string& inserted,
+  uint32 max_inserted = ~0u,
+  bool recovery = true)
+{
+  vector<Diagnostic> diagnostics;
+  vector<Diagnostic>* list = recovery ? &diagnostics : nullptr;
+
+  string edited = input;
+  edited.replace(offset, deleted, inserted);
+
+  TokenBuffer tokens = tokenize(input, list);
+  TextEdit edit {offset, deleted, uint32(inserted.size())};
+  TokenDelta delta = retokenize(tokens, edit, edited.cbegin(), edited.cend(), list);
+  apply_delta(tokens, delta);
+
+  vector<Diagnostic> expected_diagnostics;
+  TokenBuffer expected = tokenize(edited, recovery ? &expected_diagnostics : nullptr);
+  bool same_diagnostics = diagnostics.size() == expected_diagnostics.size();
+  for (size_t i = 0; same_diagnostics && i < diagnostics.size(); ++i) {
+    same_diagnostics =
+      diagnostics[i].error == expected_diagnostics[i].error &&
+      diagnostics[i].start == expected_diagnostics[i].start &&
+      diagnostics[i].end == expected_diagnostics[i].end;
+  }
+
+  if (!same_buffer(tokens, expected) || !same_diagnostics || delta.inserted.size() > max_inserted) {
+    std::cerr
+      << "[" << test_name << "]\n"
+      << "Error: Retokenized stream does not match\n"
+      << "Input string: " << input << "\n"
+      << "Edited string: " << edited << "\n"
+      << "Delta: " << delta.first << " " << delta.removed << " " << delta.inserted.size() << "\n"
+      << "Diagnostics: " << diagnostics.size() << ", expected " << expected_diagnostics.size() << "\n"
+      << "Expected:\n";
+    print_buffer(expected);
+    std::cerr << "Actual:\n";
+    print_buffer(tokens);
+    std::exit(1);
+  }
+}
+
+void test_local_edits() {
+  test("Local - extend identifier", "let abc = d + e;", 6, 0, "x", 2);
+  test("Local - replace number", "a = 1; b = 2; c = 3;", 11, 1, "42", 2);
+  test("Local - insert statement", "a(); b();", 4, 0, " x = 1;", 6);
+  test("Local - delete token", "a = b + c; d = e;", 6, 2, "", 2);
+  test("Local - append", "a = b", 5, 0, " + c", 3);
+  test("Local - prepend", "a = b", 0, 0, "x; ", 3);
+  test("Local - long token", "a = '" + string(20000, 'b') + "'; c = d", 10, 0, "x", 2);
+}
+
+void test_context_changes() {
+  test("Context - division becomes regexp", "a = b / c / d;", 4, 1, "(", 8);
+  test("Context - line break", "a\nb", 1, 1, " ");
+  test("Context - open comment", "a /* b */ c; d", 2, 2, "", 10);
+  test("Context - open string", "a = 'b'; c = d", 6, 1, "");
+  test("Context - template substitution", "`a${ b }c${ d }e`", 7, 1, "+ {");
+  test("Context - close template", "x = `a${ b }c`; y", 11, 1, "");
+  test("Context - after comment", "a // b\nc", 6, 1, "");
+  test("Context - errors", "a = 1; b = 2", 5, 0, "#", ~0u, false);
+  test("Context - regexp after await", "await /a/g", 6, 0, " ");
+  test("Context - regexp after yield", "x = yield /a/g;", 10, 0, " ");
+  test("Context - regexp after of", "for (x of /a/g) ;", 10, 0, " ");
+  test("Context - errors after the edit", "'a\nx = 1;\ny = 2;\n'b\n", 7, 1, "12", 2);
+  test("Context - edit after an error", "a = 'b\nc = d;", 10, 0, "x", ~0u, false);
+}
+
+// Strict code is rescanned in strict mode when the retokenizer is told so,
+// directly or by a checkpoint, and reports the errors of a strict scan
+void test_strict_mode() {
+  string input = "a = 1;\nb = 2;\nc = 3;\n";
+  string edited = input;
+  edited.insert(11, "0");
+  TextEdit edit {11, 0, 1};
+
+  vector<Diagnostic> expected;
+  TokenBuffer expected_tokens = tokenize(edited, &expected, true);
+
+  vector<Diagnostic> diagnostics;
+  TokenBuffer tokens = tokenize(input, &diagnostics, true);
+  TokenDelta delta = retokenize(tokens, edit, edited.cbegin(), edited.cend(), &diagnostics, nullptr, true);
+  apply_delta(tokens, delta);
+  if (!same_buffer(tokens, expected_tokens) || diagnostics.size() != 1 ||
+    diagnostics[0].error != ScannerError::legacy_octal_number)
+  {
+    std::cerr << "[Strict mode - module]\nError: Expected a legacy octal error\n";
+    std::exit(1);
+  }
+
+  input = "'use strict';\n" + input;
+  edited = "'use strict';\n" + edited;
+  edit.offset += 14;
+  expected.clear();
+  expected_tokens = tokenize(edited, &expected, true);
+
+  // The directive takes effect after its string, as for a parser
+  diagnostics.clear();
+  CheckpointIndex<Iterator> checkpoints {1};
+  Tokenizer tokenizer {input.cbegin(), input.cend()};
+  tokenizer.scanner().set_recovery(&diagnostics);
+  tokens.clear();
+  while (true) {
+    Token t = tokenizer.next();
+    tokens.push_back(tokenizer.result());
+    if (t == Token::end) {
+      break;
+    }
+    if (t == Token::string) {
+      tokenizer.scanner().set_strict_mode(true);
+    }
+    checkpoints.update(tokenizer);
+  }
+  delta = retokenize(tokens, edit, edited.cbegin(), edited.cend(), &diagnostics, &checkpoints);
+  apply_delta(tokens, delta);
+  if (!same_buffer(tokens, expected_tokens) || diagnostics.size() != 1) {
+    std::cerr << "[Strict mode - directive]\nError: Expected a legacy octal error\n";
+    std::exit(1);
+  }
+}
+
+// A script with regular expressions, nested templates, comments and a
+// restricted production
+string sample =
+    "function f(a, b) {\n"
+    "  if (a) /x/g.test(b); // c\n"
+    "  return `t${ a + `u${ b }` }v` / 2 + {x: 1}.x;\n"
+    "}\n"
+    "/* d */ let y = a\n++b\n";
+
+// Deletes each code unit of a script in turn
+void test_every_deletion() {
+  for (uint32 i = 0; i < sample.size(); ++i) {
+    test("Every deletion", sample, i, 1, "");
+  }
+}
+
+// Inserts characters which change the scanner context at each position
+void test_every_insertion() {
+  for (uint32 i = 0; i <= sample.size(); ++i) {
+    test("Every insertion - slash", sample, i, 0, "/");
+    test("Every insertion - quote", sample, i, 0, "'");
+    test("Every insertion - brace", sample, i, 0, "}");
+    test("Every insertion - line break", sample, i, 0, "\n");
+  }
+}
+
+// With checkpoints, only the records after the last checkpoint before an
+// edit are replayed. The checkpoints are kept up to date over a series of
+// edits, some of which change the context of the rest of the source.
+void test_checkpoints() {
+  string input;
+  for (int i = 0; i < 500; ++i) {
+    input += "a = b / c; `d${ e }f`; // g\n";
+  }
+  TokenBuffer tokens = tokenize(input, nullptr);
+  CheckpointIndex<Iterator> checkpoints {256};
+  checkpoints.scan(input.cbegin(), input.cend());
+
+  struct Edit {
+    uint32 offset;
+    uint32 deleted;
+    string inserted;
+  };
+  vector<Edit> edits = {
+    {12000, 1, "x"},
+    {11000, 0, "("},
+    {11001, 0, "1)"},
+    {500, 4, ""},
+    {7000, 0, "`"},
+    {7000, 1, ""},
+    {3000, 0, "x"},
+  };
+
+  for (auto& [offset, deleted, inserted] : edits) {
+    input.replace(offset, deleted, inserted);
+    TextEdit edit {offset, deleted, uint32(inserted.size())};
+    TokenDelta delta = retokenize(tokens, edit, input.cbegin(), input.cend(), nullptr, &checkpoints);
+    apply_delta(checkpoints, tokens, delta);
+    apply_delta(tokens, delta);
+
+    if (!same_buffer(tokens, tokenize(input, nullptr))) {
+      std::cerr << "[Checkpoints - edit at " << offset << "]\nError: Retokenized stream does not match\n";
+      std::exit(1);
+    }
+    // About 256 code units of records, plus the records of the token
+    // before the edit
+    if (delta.replayed > 100) {
+      std::cerr
+        << "[Checkpoints - edit at " << offset << "]\n"
+        << "Error: " << delta.replayed << " records were replayed\n";
+      std::exit(1);
+    }
+  }
+}
+
+int main() {
+  test_local_edits();
+  test_context_changes();
+  test_strict_mode();
+  test_every_deletion();
+  test_every_insertion();
+  test_checkpoints();
+}
@@ -1,21 +1,23 @@
 import std.core;
 import Scanner;
+import TokenStartTable;
 import test.TokenStrings;
 
 using std::string;
 using std::vector;
 
+template<typename Policy = ScannerPolicy>
 void test(
   const string& test_name,
   const string& input,
   const vector<Token>& expected,
   bool strict_mode = false
 ) {
-  Scanner scanner {input.begin(), input.end()};
+  Scanner<string::const_iterator, Policy> scanner {input.begin(), input.end()};
   vector<Token> actual;
 
-  if (strict_mode) {
-    scanner.set_strict_mode(true);
+  if constexpr (Policy::strict_mode == StrictMode::dynamic) {
+    scanner.set_strict_mode(strict_mode);
   }
 
   while (true) {
@@ -49,6 +51,163 @@ void test_strict(
   test(test_name, input, expected, true);
 }
 
+using TestScanner = Scanner<string::const_iterator>;
+
+void test_recovery(
+  const string& test_name,
+  const string& input,
+  const vector<Token>& expected,
+  const vector<TestScanner::Diagnostic>& expected_diagnostics
+) {
+  TestScanner scanner {input.begin(), input.end()};
+  vector<TestScanner::Diagnostic> diagnostics;
+  scanner.set_recovery(&diagnostics);
+  vector<Token> actual;
+
+  while (true) {
+    Token t = scanner.next();
+    actual.push_back(t);
+    if (t == Token::end || actual.size() > expected.size()) {
+      break;
+    }
+  }
+
+  bool diagnostics_equal = std::equal(
+    diagnostics.begin(), diagnostics.end(),
+    expected_diagnostics.begin(), expected_diagnostics.end(),
+    [](auto& a, auto& b) {
+      return a.error == b.error && a.start == b.start && a.end == b.end;
+    });
+
+  if (actual != expected || !diagnostics_equal) {
+    std::cerr
+      << "[" << test_name << "]\n"
+      << "Error: Recovered token streams are not equal\n"
+      << "Input string: " << input << "\n"
+      << "Output tokens:\n";
+
+    for (auto t : actual) {
+      std::cerr << "- " << t << "\n";
+    }
+
+    std::cerr << "Diagnostics:\n";
+    for (auto& d : diagnostics) {
+      std::cerr << "- " << int(d.error) << " " << d.start << "-" << d.end << "\n";
+    }
+
+    std::exit(1);
+  }
+}
+
+struct StrictPolicy : ScannerPolicy {
+  static constexpr StrictMode strict_mode = StrictMode::strict;
+  static constexpr bool recovery = false;
+};
+
+struct TriviaPolicy : ScannerPolicy {
+  static constexpr bool emit_comments = false;
+  static constexpr bool emit_trivia = true;
+};
+
+struct ValuePolicy : ScannerPolicy {
+  static constexpr bool decode_values = true;
+  static constexpr bool track_lines = true;
+};
+
+using ValueScanner = Scanner<string::const_iterator, ValuePolicy>;
+
+// Scans the input and checks the value, line and column of the last token
+// before the end
+void test_value(
+  const string& test_name,
+  const string& input,
+  const std::u32string& expected_value,
+  uint32 expected_line,
+  uint32 expected_column
+) {
+  ValueScanner scanner {input.begin(), input.end()};
+  std::u32string value;
+  uint32 line = 0;
+  uint32 column = 0;
+
+  while (true) {
+    Token t = scanner.next(ValueScanner::Context::div);
+    if (t == Token::end || t == Token::error) {
+      break;
+    }
+    value = scanner.value();
+    line = scanner.line();
+    column = scanner.column();
+  }
+
+  if (value != expected_value || line != expected_line || column != expected_column) {
+    std::cerr
+      << "[" << test_name << "]\n"
+      << "Error: Unexpected value or position\n"
+      << "Input string: " << input << "\n"
+      << "Value:";
+
+    for (char32_t c : value) {
+      std::cerr << " " << uint32(c);
+    }
+
+    std::cerr << "\nPosition: " << line << ":" << column << "\n";
+    std::exit(1);
+  }
+}
+
+struct TriviaTablePolicy : ScannerPolicy {
+  static constexpr bool emit_comments = false;
+  static constexpr bool collect_trivia = true;
+};
+
+using TriviaScanner = Scanner<string::const_iterator, TriviaTablePolicy>;
+
+// Describes each token by the trivia before it, using one letter for each
+// trivia kind: "w" whitespace, "l" line comment, "b" block comment and "L"
+// license comment
+void test_trivia(
+  const string& test_name,
+  const string& input,
+  const vector<string>& expected
+) {
+  TriviaScanner scanner {input.begin(), input.end()};
+  vector<Trivia> trivia;
+  scanner.set_trivia(&trivia);
+  vector<TriviaRange> ranges;
+
+  while (true) {
+    Token t = scanner.next(TriviaScanner::Context::div);
+    ranges.push_back(scanner.trivia_range());
+    if (t == Token::end || t == Token::error) {
+      break;
+    }
+  }
+
+  vector<string> actual;
+  for (auto& range : ranges) {
+    string kinds;
+    for (uint32 i = range.begin; i < range.end; ++i) {
+      kinds += "wlbL"[int(trivia[i].kind)];
+    }
+    actual.push_back(kinds);
+  }
+
+  if (actual != expected) {
+    std::cerr
+      << "[" << test_name << "]\n"
+      << "Error: Trivia are not equal\n"
+      << "Input string: " << input << "\n"
+      << "Trivia by token:\n";
+
+    for (auto& kinds : actual) {
+      std::cerr << "- " << kinds << "\n";
+    }
+
+    std::exit(1);
+  }
+}
+
 void test_number() {
   test("Number - integer", "1234", {
     Token::number,
@@ -151,6 +310,12 @@ void test_line_comment() {
     Token::comment,
     Token::end,
   });
+
+  test("Line comment - non-ASCII", "// h\xc3\xa9llo " + string(100, 'a') + " w\xc3\xb6rld\xe2\x80\xa6 ;\n;", {
+    Token::comment,
+    Token::semicolon,
+    Token::end,
+  });
 }
 
 void test_block_comment() {
@@ -256,6 +421,209 @@ void test_regexp() {
   });
 }
 
+void test_recovery() {
+  using Error = TestScanner::Error;
+
+  test_recovery("Recovery - unterminated string", "a = 'bc\nd", {
+    Token::identifier,
+    Token::assign,
+    Token::string,
+    Token::identifier,
+    Token::end,
+  }, {
+    {Error::unterminated_string, 4, 7},
+  });
+
+  test_recovery("Recovery - unexpected character", "a # b @", {
+    Token::identifier,
+    Token::identifier,
+    Token::end,
+  }, {
+    {Error::unexpected_character, 2, 3},
+    {Error::unexpected_character, 6, 7},
+  });
+
+  test_recovery("Recovery - malformed number", "0x; 1e+", {
+    Token::number,
+    Token::semicolon,
+    Token::number,
+    Token::end,
+  }, {
+    {Error::invalid_hex_literal, 0, 2},
+    {Error::missing_exponent, 4, 7},
+  });
+
+  test_recovery("Recovery - unterminated regexp", "/a\nb", {
+    Token::regexp,
+    Token::identifier,
+    Token::end,
+  }, {
+    {Error::unterminated_regexp, 0, 2},
+  });
+
+  test_recovery("Recovery - unterminated comment", "a /* b", {
+    Token::identifier,
+    Token::comment,
+    Token::end,
+  }, {
+    {Error::unterminated_comment, 2, 6},
+  });
+
+  test("Recovery - two dots without recovery", "a..b", {
+    Token::identifier,
+    Token::error,
+  });
+
+  test_recovery("Recovery - two dots", "a..b", {
+    Token::identifier,
+    Token::dot,
+    Token::identifier,
+    Token::end,
+  }, {
+    {Error::unexpected_character, 1, 3},
+  });
+
+  test_recovery("Recovery - two dots at the end", "a..", {
+    Token::identifier,
+    Token::dot,
+    Token::end,
+  }, {
+    {Error::unexpected_character, 1, 3},
+  });
+
+  test_recovery("Recovery - dot at the end", "a.", {
+    Token::identifier,
+    Token::dot,
+    Token::end,
+  }, {});
+
+  // Diagnostics from a discarded lookahead are reported once
+  {
+    string input = "a @";
+    TestScanner scanner {input.begin(), input.end()};
+    vector<TestScanner::Diagnostic> diagnostics;
+    scanner.set_recovery(&diagnostics);
+    scanner.next();
+    TestScanner lookahead = scanner;
+    lookahead.next();
+    scanner.next();
+    if (diagnostics.size() != 1) {
+      std::cerr << "[Recovery - rescan]\nError: Expected a single diagnostic\n";
+      std::exit(1);
+    }
+  }
+}
+
+void test_policies() {
+  test<StrictPolicy>("Policy - strict", "let;", {
+    Token::kw_let,
+    Token::semicolon,
+    Token::end,
+  });
+
+  test<TriviaPolicy>("Policy - trivia", "a /* b */ c\n// d", {
+    Token::identifier,
+    Token::whitespace,
+    Token::whitespace,
+    Token::identifier,
+    Token::whitespace,
+    Token::end,
+  });
+
+  test_value("Policy - string value", "'a\\x41\\u{62}\\n\\\nb'", U"aAb\nb", 1, 0);
+  test_value("Policy - legacy octal value", "'\\101\\0'", std::u32string(U"A\0", 2), 1, 0);
+  test_value("Policy - template value", "/* a\n */ x\r\n  `b\r\nc`", U"b\nc", 3, 2);
+  test_value("Policy - line continuation", "'a\\\nb'\n  'c'", U"c", 3, 2);
+}
+
+void test_trivia() {
+  test_trivia("Trivia - kinds", "/*! MIT */\na /* b */ // c\n  d", {
+    "Lw",
+    "wbwlw",
+    "",
+  });
+
+  test_trivia("Trivia - whitespace runs are merged", "a \t\n\r\n b  ", {
+    "",
+    "w",
+    "w",
+  });
+
+  // Trivia from a discarded lookahead are recorded once
+  {
+    string input = "a /* b */ c";
+    TriviaScanner scanner {input.begin(), input.end()};
+    vector<Trivia> trivia;
+    scanner.set_trivia(&trivia);
+    scanner.next();
+    TriviaScanner lookahead = scanner;
+    lookahead.next();
+    scanner.next();
+    if (trivia.size() != 3 || trivia[1].start != 2 || trivia[1].end != 9) {
+      std::cerr << "[Trivia - rescan]\nError: Expected three trivia\n";
+      std::exit(1);
+    }
+  }
+}
+
+struct StatsPolicy : ScannerPolicy {
+  static constexpr bool instrument = true;
+};
+
+using StatsScanner = Scanner<std::u32string::const_iterator, StatsPolicy>;
+
+void test_stats() {
+  std::u32string input = U"a /* b */ '\\x41\\u0042' + \u00e9t\u00e9 # 'c";
+  StatsScanner scanner {input.begin(), input.end()};
+  vector<StatsScanner::Diagnostic> diagnostics;
+  ScannerStats stats;
+  scanner.set_recovery(&diagnostics);
+  scanner.set_stats(&stats);
+  while (scanner.next() != Token::end) {}
+
+  bool ok =
+    stats.tokens[size_t(Token::identifier)] == 2 &&
+    stats.tokens[size_t(Token::string)] == 2 &&
+    stats.tokens[size_t(Token::comment)] == 1 &&
+    stats.token_code_units[size_t(Token::comment)] == 7 &&
+    stats.token_code_units[size_t(Token::string)] == 14 &&
+    stats.start_types[size_t(TokenStartType::string)] == 2 &&
+    stats.start_types[ScannerStats::start_type_count - 1] == 1 &&
+    stats.unicode_identifier_chars == 2 &&
+    stats.escapes == 2 &&
+    stats.unicode_escapes == 1 &&
+    stats.errors[size_t(ScannerError::unexpected_character)] == 1 &&
+    stats.errors[size_t(ScannerError::unterminated_string)] == 1;
+
+  string json = stats.to_json();
+  string expected_errors = "\"errors\":{\"unexpected_character\":1,\"unterminated_string\":1}";
+  if (!ok || json.find(expected_errors) == string::npos || json.find("\"string\":{\"count\":2,\"code_units\":14}") == string::npos) {
+    std::cerr
+      << "[Stats]\n"
+      << "Error: Unexpected scanner stats\n"
+      << "Stats: " << json << "\n";
+    std::exit(1);
+  }
+
+  // Strict mode errors are counted like others
+  std::u32string octal = U"'\\01' 010";
+  StatsScanner strict {octal.begin(), octal.end()};
+  ScannerStats strict_stats;
+  strict.set_strict_mode(true);
+  strict.set_stats(&strict_stats);
+  while (strict.next() != Token::end) {}
+  if (
+    strict_stats.errors[size_t(ScannerError::legacy_octal_escape)] != 1 ||
+    strict_stats.errors[size_t(ScannerError::legacy_octal_number)] != 1
+  ) {
+    std::cerr
+      << "[Stats - strict mode errors]\n"
+      << "Error: Unexpected scanner stats\n"
+      << "Stats: " << strict_stats.to_json() << "\n";
+    std::exit(1);
+  }
+}
+
 int main() {
   test_number();
   test_hex_number();
@@ -266,4 +634,8 @@ int main() {
   test_string();
   test_identifier();
   test_regexp();
+  test_recovery();
+  test_policies();
+  test_trivia();
+  test_stats();
 }
@@ -0,0 +1,174 @@
+import std.core;
+import Scanner;
+import Tokenizer;
+import ScriptBlocks;
+import test.Helpers;
+
+using std::string;
+using std::vector;
+
+struct Expected {
+  string content;
+  ScriptKind kind {ScriptKind::classic};
+  bool terminated {true};
+};
+
+// Finds the blocks of the host text as bytes and as code points, and checks
+// their content, kind and tags
+void test(
+  const string& test_name,
+  const string& host,
+  const vector<Expected>& expected,
+  ScriptKind default_kind = ScriptKind::classic)
+{
+  auto first = reinterpret_cast<const uint8*>(host.data());
+  vector<ScriptBlock> blocks;
+  find_script_blocks(first, first + host.size(), blocks, default_kind);
+
+  std::u32string wide(host.begin(), host.end());
+  vector<ScriptBlock> wide_blocks;
+  find_script_blocks(wide.data(), wide.data() + wide.size(), wide_blocks, default_kind);
+
+  if (blocks.size() != expected.size() || wide_blocks.size() != expected.size()) {
+    fail(test_name, "Expected " + std::to_string(expected.size()) + " blocks, found " +
+      std::to_string(blocks.size()));
+  }
+  for (size_t i = 0; i < blocks.size(); ++i) {
+    auto& block = blocks[i];
+    string content = host.substr(block.content.start, block.content.end - block.content.start);
+    string tag = host.substr(block.tag.start, block.tag.end - block.tag.start);
+    if (content != expected[i].content) {
+      fail(test_name, "Unexpected content: " + content);
+    }
+    if (block.kind != expected[i].kind || block.terminated != expected[i].terminated) {
+      fail(test_name, "Unexpected kind or termination of block " + std::to_string(i));
+    }
+    if (tag.size() < 8 || tag[0] != '<' || tag.back() != '>' || block.tag.end != block.content.start) {
+      fail(test_name, "Unexpected tag: " + tag);
+    }
+    auto& wide_block = wide_blocks[i];
+    if (wide_block.content.start != block.content.start || wide_block.content.end != block.content.end) {
+      fail(test_name, "Code point blocks differ from byte blocks");
+    }
+  }
+}
+
+void test_html() {
+  test("HTML - blocks", "<html><script>a = 1;</script><p>x</p><SCRIPT type=module>b</Script >", {
+    {"a = 1;", ScriptKind::classic},
+    {"b", ScriptKind::module},
+  });
+
+  test("HTML - attributes", "<script src='a.js' data-x=\"y > z\" defer></script><script async>c</script>", {
+    {"", ScriptKind::classic},
+    {"c", ScriptKind::classic},
+  });
+
+  test("HTML - types", "<script type='text/JavaScript'>a</script><script type=\"application/json\">{}</script>", {
+    {"a", ScriptKind::classic},
+    {"{}", ScriptKind::other},
+  });
+
+  test("HTML - end tags", "<script>if (a </scripts) b = '</scriptx>';</script\n>", {
+    {"if (a </scripts) b = '</scriptx>';", ScriptKind::classic},
+  });
+
+  test("HTML - comments", "<!-- <script>hidden()</script> --><scripts></scripts><script>shown()</script>", {
+    {"shown()", ScriptKind::classic},
+  });
+
+  test("HTML - unterminated block", "<script>let a = 1", {
+    {"let a = 1", ScriptKind::classic, false},
+  });
+
+  test("HTML - unterminated tag", "<script type='module", {});
+  test("HTML - empty", "", {});
+}
+
+void test_components() {
+  string vue =
+    "<template>\n  <div>{{ message }}</div>\n</template>\n\n"
+    "<script>\nexport default { data() { return { message: 'hi' }; } };\n</script>\n\n"
+    "<script setup lang=\"ts\">\nconst a: number = 1;\n</script>\n\n"
+    "<style scoped>\ndiv { color: red; }\n</style>\n";
+
+  test("Components - Vue", vue, {
+    {"\nexport default { data() { return { message: 'hi' }; } };\n", ScriptKind::classic},
+    {"\nconst a: number = 1;\n", ScriptKind::other},
+  });
+
+  string svelte =
+    "<script context=\"module\">\n  export const prerender = true;\n</script>\n"
+    "<script lang=js>\n  let count = 0;\n</script>\n"
+    "<button on:click={() => count++}>{count}</button>\n";
+
+  test("Components - Svelte", svelte, {
+    {"\n  export const prerender = true;\n", ScriptKind::classic},
+    {"\n  let count = 0;\n", ScriptKind::classic},
+  });
+
+  test("Components - module scripts", svelte, {
+    {"\n  export const prerender = true;\n", ScriptKind::module},
+    {"\n  let count = 0;\n", ScriptKind::module},
+  }, ScriptKind::module);
+
+  test("Components - other languages", vue, {
+    {"\nexport default { data() { return { message: 'hi' }; } };\n", ScriptKind::module},
+    {"\nconst a: number = 1;\n", ScriptKind::other},
+  }, ScriptKind::module);
+}
+
+// Module blocks are strict, so legacy octal literals are errors in them
+void test_strict_mode() {
+  string host = "<script>a = 017;</script><script type=module>b = 017;</script>";
+  auto first = reinterpret_cast<const uint8*>(host.data());
+  vector<ScriptBlock> blocks;
+  find_script_blocks(first, first + host.size(), blocks);
+
+  vector<size_t> errors;
+  for (auto& block : blocks) {
+    using Diagnostic = Scanner<const uint8*>::Diagnostic;
+    vector<Diagnostic> diagnostics;
+    auto scanner = script_scanner(first, block);
+    scanner.set_recovery(&diagnostics);
+    Tokenizer<const uint8*> tokenizer {scanner};
+    while (tokenizer.next() != Token::end) {}
+    errors.push_back(diagnostics.size());
+    if (!diagnostics.empty() && (
+      diagnostics[0].error != ScannerError::legacy_octal_number ||
+      host.substr(diagnostics[0].start, 3) != "017"))
+    {
+      fail("Strict mode - module", "Unexpected diagnostic");
+    }
+  }
+  if (errors != vector<size_t> {0, 1}) {
+    fail("Strict mode - module", "Expected a legacy octal error in the module block only");
+  }
+}
+
+// Tokens of a block scanned in place refer to the host text
+void test_positions() {
+  string host = "<p>\xc3\xa9</p>\n<script>\n  let answer = /* six */ 6 * 7;\n</script>";
+  auto first = reinterpret_cast<const uint8*>(host.data());
+  vector<ScriptBlock> blocks;
+  find_script_blocks(first, first + host.size(), blocks);
+
+  auto scanner = script_scanner(first, blocks.at(0));
+  Tokenizer<const uint8*> tokenizer {scanner};
+  vector<string> tokens;
+  while (tokenizer.next() != Token::end) {
+    auto& result = tokenizer.result();
+    tokens.push_back(host.substr(result.start, result.end - result.start));
+  }
+  vector<string> expected = {"let", "answer", "=", "/* six */", "6", "*", "7", ";"};
+  if (tokens != expected || tokenizer.result().start != blocks[0].content.end) {
+    fail("Positions - host offsets", "Unexpected tokens");
+  }
+}
+
+int main() {
+  test_html();
+  test_components();
+  test_strict_mode();
+  test_positions();
+}
@@ -0,0 +1,120 @@
+import std.core;
+import Scanner;
+import TokenBuffer;
+import Retokenizer;
+import SegmentedText;
+import test.Helpers;
+
+using std::string;
+using std::vector;
+
+// Splits the text into pieces at the given offsets
+template<typename C>
+SegmentedText<C> split(const std::basic_string<C>& text, const vector<size_t>& offsets) {
+  SegmentedText<C> pieces;
+  size_t start = 0;
+  for (size_t offset : offsets) {
+    pieces.append(text.data() + start, offset - start);
+    start = offset;
+  }
+  pieces.append(text.data() + start, text.size() - start);
+  return pieces;
+}
+
+// Scans the text split at every offset, and in pieces of several sizes, and
+// checks that tokens and positions match a scan of the whole text
+template<typename C>
+void test(const string& test_name, const std::basic_string<C>& text) {
+  TokenBuffer expected = tokenize(text.cbegin(), text.cend());
+
+  vector<vector<size_t>> splits;
+  for (size_t i = 0; i <= text.size(); ++i) {
+    splits.push_back({i});
+    splits.push_back({i, i, std::min(i + 2, text.size())});
+  }
+  for (size_t size : {1, 3, 7, 64}) {
+    vector<size_t> offsets;
+    for (size_t i = size; i < text.size(); i += size) {
+      offsets.push_back(i);
+    }
+    splits.push_back(offsets);
+  }
+
+  for (auto& offsets : splits) {
+    SegmentedText<C> pieces = split(text, offsets);
+    if (pieces.size() != text.size() || !same_tokens(tokenize(pieces.begin(), pieces.end()), expected)) {
+      string at;
+      for (size_t offset : offsets) {
+        at += " " + std::to_string(offset);
+      }
+      fail(test_name, "Tokens differ when split at" + at);
+    }
+  }
+}
+
+// Byte pieces are scanned with the vector kernels
+static_assert(Scanner<SegmentIterator<char>>::use_kernels);
+
+void test_pieces() {
+  string code =
+    "function f(a, b) {\n"
+    "  // A line comment\n"
+    "  /* A block comment ** with stars */\n"
+    "  let identifier_name = 'a string \\' with escapes' + \"another\";\n"
+    "  return a /= b / 2 + `x${ a }y${ { b } }z` / /re[/]+/gi.exec(x);\n"
+    "}\n";
+
+  test<char>("Pieces - bytes", code);
+  test<char>("Pieces - empty", "");
+  test<char>("Pieces - unterminated comment", "a /* b c");
+  test<char>("Pieces - unterminated string", "a = 'b c\nd");
+  test<char32_t>("Pieces - code points", U"let été = '€\U0001F600' + `${ x }` //   y");
+}
+
+void test_offsets() {
+  string code = "let x = 'abc' + y;";
+  SegmentedText<char> pieces = split(code, {0, 3, 4, 11});
+  for (size_t i = 0; i < code.size(); ++i) {
+    auto iter = pieces.at(i);
+    if (iter.offset() != i || *iter != code[i] || pieces.begin() + i != iter) {
+      fail("Offsets - at", "Wrong iterator at " + std::to_string(i));
+    }
+  }
+  if (pieces.at(code.size()) != pieces.end() || pieces.segment_count() != 4) {
+    fail("Offsets - end", "Wrong end iterator");
+  }
+}
+
+// An editor's piece table after an edit: the original text before and after
+// the edit, with the inserted text between them
+void test_edit(const string& test_name, const string& input, uint32 offset, uint32 deleted, const string& inserted) {
+  string edited = input;
+  edited.replace(offset, deleted, inserted);
+
+  SegmentedText<char> pieces;
+  pieces.append(input.data(), offset);
+  pieces.append(inserted.data(), inserted.size());
+  pieces.append(input.data() + offset + deleted, input.size() - offset - deleted);
+
+  TokenBuffer tokens = tokenize(input.cbegin(), input.cend());
+  TextEdit edit {offset, deleted, uint32(inserted.size())};
+  apply_delta(tokens, retokenize(tokens, edit, pieces.begin(), pieces.end()));
+
+  if (!same_tokens(tokens, tokenize(edited.cbegin(), edited.cend()))) {
+    fail(test_name, "Retokenized stream differs from a full scan");
+  }
+}
+
+void test_edits() {
+  string code = "let a = 1;\n/* comment */\nlet b = `x${ a }y` / 2;\nf(a, b);\n";
+  test_edit("Edits - insert identifier", code, 4, 1, "value");
+  test_edit("Edits - open comment", code, 11, 0, "/*");
+  test_edit("Edits - open template", code, 33, 0, "`");
+  test_edit("Edits - delete all", code, 0, uint32(code.size()), "");
+}
+
+int main() {
+  test_pieces();
+  test_offsets();
+  test_edits();
+}
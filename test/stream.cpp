@@ -0,0 +1,89 @@
+import std.core;
+import BasicTypes;
+import Unicode;
+import TokenBuffer;
+import StreamSource;
+import test.Helpers;
+
+using std::string;
+
+// Produces the text in reads of at most chunk bytes
+struct ChunkDecoder {
+
+  size_t read(uint8* out, size_t size) {
+    size_t n = std::min({size, chunk, text.size() - position});
+    std::memcpy(out, text.data() + position, n);
+    position += n;
+    return n;
+  }
+
+  string text;
+  size_t chunk;
+  size_t position {0};
+
+};
+
+// Scans the text through a stream with each block and read size, and checks
+// that tokens and positions match a scan of the whole text
+template<typename C>
+void test(const string& test_name, const string& text) {
+  TokenBuffer expected;
+  if constexpr (std::is_same_v<C, uint8>) {
+    auto first = reinterpret_cast<const uint8*>(text.data());
+    expected = tokenize(first, first + text.size());
+  } else {
+    std::u32string decoded(text.size(), U'\0');
+    auto first = reinterpret_cast<const uint8*>(text.data());
+    decoded.resize(decode_utf8(first, first + text.size(), decoded.data(), true));
+    expected = tokenize(decoded.cbegin(), decoded.cend());
+  }
+
+  for (size_t block_size : {4, 5, 7, 64, 4096}) {
+    for (size_t chunk : {1, 3, 10, 1000}) {
+      ChunkDecoder decoder {text, chunk};
+      StreamSource<C, ChunkDecoder> source {decoder, block_size};
+      TokenBuffer actual = tokenize(source.begin(), source.end());
+      if (!same_tokens(actual, expected)) {
+        fail(test_name, "Tokens differ with block size " + std::to_string(block_size) +
+          " and reads of " + std::to_string(chunk));
+      }
+    }
+  }
+}
+
+void test_positions() {
+  string code =
+    "function f(a, b) {\n"
+    "  // A comment\n"
+    "  return a /= b / 2 + `x${ a }y${ { b } }z` / /re+/g.exec('str');\n"
+    "}\n";
+
+  test<uint8>("Positions - bytes", code);
+  test<char32_t>("Positions - code points", code);
+  test<uint8>("Positions - empty", "");
+  test<char32_t>("Positions - empty code points", "");
+  test<char32_t>("Positions - multibyte", "let \xc3\xa9t\xc3\xa9 = '\xe2\x82\xac\xf0\x9f\x98\x80' + \xe2\x82\xac;");
+  test<char32_t>("Positions - malformed", "'\xe2\x82' + '\xff' + \xf0\x9f\x98");
+}
+
+void test_buffers() {
+  string code;
+  for (int i = 0; i < 2000; ++i) {
+    code += "var x" + std::to_string(i) + " = 'value' + (y / 2);\n";
+  }
+  ChunkDecoder decoder {code, 100};
+  StreamSource<char32_t, ChunkDecoder> source {decoder, 256};
+  size_t count = tokenize(source.begin(), source.end()).size();
+  if (count < 2000 * 10 || source.units_read() != code.size()) {
+    fail("Buffers - units", "Unexpected token or unit count");
+  }
+  // Only the blocks between a token start and the scan position are kept
+  if (source.buffers_allocated() > 4) {
+    fail("Buffers - reuse", std::to_string(source.buffers_allocated()) + " buffers allocated");
+  }
+}
+
+int main() {
+  test_positions();
+  test_buffers();
+}
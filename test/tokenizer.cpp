@@ -0,0 +1,267 @@
+import std.core;
+import Tokenizer;
+import test.TokenStrings;
+
+using std::string;
+using std::vector;
+
+void test(
+  const string& test_name,
+  const string& input,
+  const vector<Token>& expected
+) {
+  Tokenizer tokenizer {input.begin(), input.end()};
+  vector<Token> actual;
+
+  while (true) {
+    Token t = tokenizer.next();
+    actual.push_back(t);
+    if (t == Token::end || t == Token::error) {
+      break;
+    }
+  }
+
+  if (actual != expected) {
+    std::cerr
+      << "[" << test_name << "]\n"
+      << "Error: Token streams are not equal\n"
+      << "Input string: " << input << "\n"
+      << "Output tokens:\n";
+
+    for (auto t : actual) {
+      std::cerr << "- " << t << "\n";
+    }
+
+    std::exit(1);
+  }
+}
+
+void test_division() {
+  test("Division - after operands", "a / b / 2", {
+    Token::identifier,
+    Token::divide,
+    Token::identifier,
+    Token::divide,
+    Token::number,
+    Token::end,
+  });
+
+  test("Division - after parenthesized expression", "(a) / b", {
+    Token::left_paren,
+    Token::identifier,
+    Token::right_paren,
+    Token::divide,
+    Token::identifier,
+    Token::end,
+  });
+
+  test("Division - after object literal", "x = {} / 2", {
+    Token::identifier,
+    Token::assign,
+    Token::left_brace,
+    Token::right_brace,
+    Token::divide,
+    Token::number,
+    Token::end,
+  });
+
+  test("Division - after function expression", "x = function(){} / 1", {
+    Token::identifier,
+    Token::assign,
+    Token::kw_function,
+    Token::left_paren,
+    Token::right_paren,
+    Token::left_brace,
+    Token::right_brace,
+    Token::divide,
+    Token::number,
+    Token::end,
+  });
+
+  test("Division - after async function expression", "x = async function f(a) { if (a) {} } / 1", {
+    Token::identifier,
+    Token::assign,
+    Token::identifier,
+    Token::kw_function,
+    Token::identifier,
+    Token::left_paren,
+    Token::identifier,
+    Token::right_paren,
+    Token::left_brace,
+    Token::kw_if,
+    Token::left_paren,
+    Token::identifier,
+    Token::right_paren,
+    Token::left_brace,
+    Token::right_brace,
+    Token::right_brace,
+    Token::divide,
+    Token::number,
+    Token::end,
+  });
+
+  test("Regexp - after block ending in async", "{ x = async } / 1 /", {
+    Token::left_brace,
+    Token::identifier,
+    Token::assign,
+    Token::identifier,
+    Token::right_brace,
+    Token::regexp,
+    Token::end,
+  });
+
+  test("Division - after reserved word property", "a.return / 2", {
+    Token::identifier,
+    Token::dot,
+    Token::kw_return,
+    Token::divide,
+    Token::number,
+    Token::end,
+  });
+
+  test("Division - after contextual keyword property", "a.await / 2", {
+    Token::identifier,
+    Token::dot,
+    Token::identifier,
+    Token::divide,
+    Token::number,
+    Token::end,
+  });
+
+  test("Division - after postfix increment", "a++ /= 2", {
+    Token::identifier,
+    Token::increment,
+    Token::divide_assign,
+    Token::number,
+    Token::end,
+  });
+}
+
+void test_regexp() {
+  test("Regexp - at start", "/a/g", {
+    Token::regexp,
+    Token::end,
+  });
+
+  test("Regexp - after keyword", "return /a/", {
+    Token::kw_return,
+    Token::regexp,
+    Token::end,
+  });
+
+  test("Regexp - after condition", "if (a) /b/.test(c)", {
+    Token::kw_if,
+    Token::left_paren,
+    Token::identifier,
+    Token::right_paren,
+    Token::regexp,
+    Token::dot,
+    Token::identifier,
+    Token::left_paren,
+    Token::identifier,
+    Token::right_paren,
+    Token::end,
+  });
+
+  test("Regexp - after await", "await /a b/.exec(c)", {
+    Token::identifier,
+    Token::regexp,
+    Token::dot,
+    Token::identifier,
+    Token::left_paren,
+    Token::identifier,
+    Token::right_paren,
+    Token::end,
+  });
+
+  test("Regexp - after yield", "yield /a/g", {
+    Token::identifier,
+    Token::regexp,
+    Token::end,
+  });
+
+  test("Regexp - after of", "for (x of /a/) ;", {
+    Token::kw_for,
+    Token::left_paren,
+    Token::identifier,
+    Token::identifier,
+    Token::regexp,
+    Token::right_paren,
+    Token::semicolon,
+    Token::end,
+  });
+
+  test("Regexp - after block", "{} /a/", {
+    Token::left_brace,
+    Token::right_brace,
+    Token::regexp,
+    Token::end,
+  });
+
+  test("Regexp - after function declaration", "function f() {} /a/; async function g() {} /b/", {
+    Token::kw_function,
+    Token::identifier,
+    Token::left_paren,
+    Token::right_paren,
+    Token::left_brace,
+    Token::right_brace,
+    Token::regexp,
+    Token::semicolon,
+    Token::identifier,
+    Token::kw_function,
+    Token::identifier,
+    Token::left_paren,
+    Token::right_paren,
+    Token::left_brace,
+    Token::right_brace,
+    Token::regexp,
+    Token::end,
+  });
+
+  test("Regexp - comments are skipped", "a = /* b */ /c/", {
+    Token::identifier,
+    Token::assign,
+    Token::comment,
+    Token::regexp,
+    Token::end,
+  });
+}
+
+void test_template() {
+  test("Template - substitution", "`a${ b / c }d`", {
+    Token::template_head,
+    Token::identifier,
+    Token::divide,
+    Token::identifier,
+    Token::template_tail,
+    Token::end,
+  });
+
+  test("Template - nested braces", "`a${ { b: `c${ d }` } }e${ f }g`", {
+    Token::template_head,
+    Token::left_brace,
+    Token::identifier,
+    Token::colon,
+    Token::template_head,
+    Token::identifier,
+    Token::template_tail,
+    Token::right_brace,
+    Token::template_middle,
+    Token::identifier,
+    Token::template_tail,
+    Token::end,
+  });
+
+  test("Template - regexp in substitution", "`${ /}/ }`", {
+    Token::template_head,
+    Token::regexp,
+    Token::template_tail,
+    Token::end,
+  });
+}
+
+int main() {
+  test_division();
+  test_regexp();
+  test_template();
+}
@@ -0,0 +1,155 @@
+#include <stdio.h>
+#include <sys/wait.h>
+#include <filesystem>
+
+import std.core;
+import BasicTypes;
+import cli.FileReader;
+import cli.Tokenize;
+import test.Helpers;
+
+using std::string;
+using std::vector;
+
+namespace fs = std::filesystem;
+
+// Runs the xxtok program built next to this test. Build it first with
+// "node build.js cli.xxtok".
+
+string temp_path(const string& name) {
+  return (fs::temp_directory_path() / ("xxparsejs-test-" + name)).string();
+}
+
+void write_file(const string& path, const string& contents) {
+  std::ofstream out(path, std::ios::binary);
+  out << contents;
+}
+
+struct Run {
+  string out;
+  int status {-1};
+};
+
+string program;
+
+// Runs xxtok with the arguments and returns its stdout and exit status. The
+// summary on stderr is discarded.
+Run run(const string& arguments) {
+  Run result;
+  string command = "'" + program + "' " + arguments + " 2>/dev/null";
+  FILE* pipe = ::popen(command.c_str(), "r");
+  if (!pipe) {
+    return result;
+  }
+  char buffer[4096];
+  for (size_t n; (n = std::fread(buffer, 1, sizeof buffer, pipe)) > 0;) {
+    result.out.append(buffer, n);
+  }
+  int status = ::pclose(pipe);
+  if (status != -1 && WIFEXITED(status)) {
+    result.status = WEXITSTATUS(status);
+  }
+  return result;
+}
+
+void expect(const string& test_name, const string& arguments, int status, const string& out) {
+  Run result = run(arguments);
+  if (result.status != status) {
+    fail(test_name, "Expected exit status " + std::to_string(status) +
+      ", found " + std::to_string(result.status));
+  }
+  if (result.out != out) {
+    fail(test_name, "Unexpected output:\n" + result.out);
+  }
+}
+
+void expect_prefix(const string& test_name, const string& arguments, const string& prefix) {
+  Run result = run(arguments);
+  if (result.status != 0) {
+    fail(test_name, "Expected exit status 0, found " + std::to_string(result.status));
+  }
+  if (!result.out.starts_with(prefix)) {
+    fail(test_name, "Unexpected output:\n" + result.out);
+  }
+}
+
+void test_output_modes() {
+  string file = temp_path("modes.js");
+  write_file(file, "a = 1;\n");
+
+  expect("Output - none", file, 0, "");
+  expect("Output - tokens", "--output tokens " + file, 0,
+    "# " + file + "\n"
+    "0 1 identifier\n"
+    "2 3 assign\n"
+    "4 5 number\n"
+    "5 6 semicolon\n"
+    "7 7 end\n");
+  expect_prefix("Output - json", "--output json " + file, "{");
+  expect_prefix("Output - stats", "--output stats " + file, "{");
+
+  Run stats = run("--output stats " + file + " " + file);
+  if (stats.out.find("\"newlines\":2") == string::npos) {
+    fail("Output - stats newlines", "Unexpected output:\n" + stats.out);
+  }
+
+  Run binary = run("--output binary " + file);
+  if (binary.status != 0 || binary.out.empty()) {
+    fail("Output - binary", "Expected token records");
+  }
+
+  Run jobs = run("--output tokens --jobs 2 --io pread " + file + " " + file);
+  if (jobs.status != 0 || jobs.out != run("--output tokens " + file).out + run("--output tokens " + file).out) {
+    fail("Output - jobs", "Files are not written in order");
+  }
+
+  fs::remove(file);
+}
+
+void test_exit_status() {
+  string valid = temp_path("valid.js");
+  string invalid = temp_path("invalid.js");
+  write_file(valid, "a = 1;\n");
+  write_file(invalid, "a = 0x;\n");
+
+  expect("Exit status - valid", valid, 0, "");
+  expect("Exit status - invalid token", valid + " " + invalid, 1, "");
+  expect("Exit status - missing path", temp_path("missing.js"), 1, "");
+  expect("Exit status - unknown option", "--verbose " + valid, 1, "");
+  expect("Exit status - no paths", "", 1, "");
+
+  fs::remove(valid);
+  fs::remove(invalid);
+}
+
+// A file which cannot be read counts as a file with an error
+void test_unreadable() {
+  string missing = temp_path("unreadable.js");
+  Workspace workspace;
+  string out;
+  string errors;
+  Totals totals = tokenize_file(missing, OutputMode::tokens, workspace, out, errors);
+  if (totals.files != 1 || totals.errors != 1 || errors.empty()) {
+    fail("Unreadable - file", "Unexpected totals");
+  }
+
+  WorkerPool pool {1};
+  auto process = [&](const string& path, Workspace& workspace, string& out, string& errors) {
+    return tokenize_contents(path, OutputMode::tokens, workspace, out, errors);
+  };
+  auto sink = [&](const string&, const string&) {};
+  BatchResult result = run_batch(pool, {missing}, ReadBackend::automatic, process, sink);
+  if (result.totals.files != 1 || result.totals.errors != 1) {
+    fail("Unreadable - batch", "Unexpected totals");
+  }
+}
+
+int main(int, char** argv) {
+  program = (fs::path(argv[0]).parent_path() / "cli.xxtok").string();
+  if (!fs::exists(program)) {
+    fail("Setup", "Cannot find " + program + "; build cli.xxtok first");
+  }
+  test_output_modes();
+  test_exit_status();
+  test_unreadable();
+}
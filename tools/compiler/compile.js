@@ -5,6 +5,7 @@ import { promisify } from 'util';
 import { spawnSync } from 'child_process';
 
 import { MsvsCompiler } from './msvs.js';
+import { GccCompiler, ClangCompiler } from './gcc.js';
 
 const importPattern = /(?:^|\n)import ([^;\n\r]+)/g;
 
@@ -33,12 +34,23 @@ function getHostArch() {
       return process.env[key] === 'AMD64' ? 'x64' : 'x86';
     }
   }
+  switch (process.arch) {
+    case 'x64':
+    case 'arm64': return process.arch;
+    case 'ia32': return 'x86';
+  }
   throw new Error('Unable to determine host processor architecture');
 }
 
+export function defaultCompiler() {
+  return process.platform === 'win32' ? 'msvs' : 'gcc';
+}
+
 function getCompiler(type) {
   switch (type) {
     case 'msvs': return new MsvsCompiler();
+    case 'gcc': return new GccCompiler();
+    case 'clang': return new ClangCompiler();
     default: throw new Error(`Unsupported compiler "${ type }"`);
   }
 }
@@ -50,13 +62,16 @@ export async function compile(options) {
     target = host,
     log = () => {},
     run = false,
+    force = false,
+    mode = 'debug',
+    profileDirectory,
     main,
     outputDirectory,
     resolveModule,
   } = options;
 
   if (!await AFS.exists(outputDirectory)) {
-    await AFS.mkdir(outputDirectory);
+    await AFS.mkdir(outputDirectory, { recursive: true });
   }
 
   log('Initializing environment');
@@ -65,6 +80,8 @@ export async function compile(options) {
     outputDirectory,
     host,
     target,
+    mode,
+    profileDirectory,
   });
 
   log(`Compiling ${ target } -> ${ outputDirectory }`);
@@ -78,7 +95,7 @@ export async function compile(options) {
 
     outputs.unshift(info.output);
 
-    if (!info.imports.some(id => compiled.has(id))) {
+    if (!force && !info.imports.some(id => compiled.has(id))) {
       let outPath = Path.resolve(outputDirectory, info.output);
       let newer = await isNewer(info.filename, outPath);
       if (!newer) {
@@ -102,13 +119,59 @@ export async function compile(options) {
 
   log(`Linking ${ target } -> ${ linkOutput }`);
 
-  if (compiled.size > 0 || !await AFS.exists(linkOutput)) {
-    await compiler.link({ outputs });
+  // Module outputs may have been rebuilt by another program since this one
+  // was linked, so their times are compared with the program's
+  let stale = force || compiled.size > 0;
+  for (let output of outputs) {
+    if (stale) {
+      break;
+    }
+    stale = await isNewer(Path.resolve(outputDirectory, output), linkOutput);
+  }
+
+  if (stale) {
+    await compiler.link({ outputs, output: linkOutput });
   }
 
   return linkOutput;
 }
 
+// Builds with profile-guided optimization. The program is built with
+// instrumentation and run with the training arguments, and then rebuilt using
+// the profile written by the training run.
+export async function compileWithProfile(options) {
+  let { outputDirectory, trainingArgs, log = () => {} } = options;
+  let compiler = getCompiler(options.compiler);
+  if (!compiler.mergeProfile) {
+    throw new Error(`Compiler "${ options.compiler }" does not support PGO builds`);
+  }
+
+  let profileDirectory = Path.resolve(outputDirectory, 'profile');
+  FS.rmSync(profileDirectory, { recursive: true, force: true });
+  await AFS.mkdir(profileDirectory, { recursive: true });
+
+  let filename = await compile({
+    ...options,
+    mode: 'pgo-generate',
+    profileDirectory,
+    force: true,
+  });
+
+  log(`Training ${ filename } ${ trainingArgs.join(' ') }`);
+  let { status } = spawnSync(filename, trainingArgs, { stdio: 'inherit' });
+  if (status !== 0) {
+    throw new Error(`Training run exited with status: ${ status }`);
+  }
+  compiler.mergeProfile(profileDirectory);
+
+  return compile({
+    ...options,
+    mode: 'pgo-use',
+    profileDirectory,
+    force: true,
+  });
+}
+
 async function getImportsFromFile(filename) {
   let source = await AFS.readFile(filename, 'utf8');
   let imports = [];
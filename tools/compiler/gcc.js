@@ -0,0 +1,188 @@
+import * as Path from 'path';
+import * as FS from 'fs';
+import { spawnSync } from 'child_process';
+
+// Standard library headers which stand in for the "std.core" module
+const stdCoreHeaders = [
+  'algorithm',
+  'array',
+  'atomic',
+  'bit',
+  'cassert',
+  'chrono',
+  'cmath',
+  'condition_variable',
+  'cstddef',
+  'cstdint',
+  'cstdio',
+  'cstdlib',
+  'cstring',
+  'deque',
+  'exception',
+  'fstream',
+  'functional',
+  'initializer_list',
+  'iomanip',
+  'iostream',
+  'iterator',
+  'limits',
+  'list',
+  'map',
+  'memory',
+  'mutex',
+  'new',
+  'numeric',
+  'optional',
+  'queue',
+  'set',
+  'sstream',
+  'stdexcept',
+  'string',
+  'string_view',
+  'thread',
+  'tuple',
+  'type_traits',
+  'unordered_map',
+  'unordered_set',
+  'utility',
+  'variant',
+  'vector',
+];
+
+const modulePattern = /^\s*(export\s+)?(module\s*[\w.]*|import\s+[\w.]+)\s*;\s*$/;
+const exportPattern = /^(\s*)export\s+/;
+
+// Module support in GCC (as of version 12) fails on this source tree, so
+// modules are compiled as headers instead. Each module is translated by
+// removing its module declaration, its imports and its export keywords, and
+// the program is compiled as a single translation unit which includes the
+// translated modules in dependency order. Names which are private to a module
+// must therefore be unique within each program.
+export function translateModule(source) {
+  return source
+    .split(/\r?\n/)
+    .map(line => modulePattern.test(line) ? '' : line.replace(exportPattern, '$1'))
+    .join('\n');
+}
+
+// Compiler flags for each build mode. PGO builds are compiled twice: once
+// with "pgo-generate" to produce an instrumented training program, and again
+// with "pgo-use" after the training run has written its profile.
+function modeFlags(mode, profileDirectory) {
+  switch (mode) {
+    case 'debug': return ['-g'];
+    case 'release': return ['-O2', '-DNDEBUG'];
+    case 'lto': return ['-O2', '-DNDEBUG', '-flto'];
+    case 'pgo-generate': return ['-O2', '-DNDEBUG', `-fprofile-generate=${ profileDirectory }`];
+    case 'pgo-use': return [
+      '-O2',
+      '-DNDEBUG',
+      '-flto',
+      `-fprofile-use=${ profileDirectory }`,
+      '-Wno-missing-profile',
+    ];
+    default: throw new Error(`Unsupported build mode "${ mode }"`);
+  }
+}
+
+export class GccCompiler {
+
+  constructor(command = process.env.CXX || 'g++') {
+    this._command = command;
+  }
+
+  initialize({ outputDirectory, mode = 'debug', profileDirectory }) {
+    this._out = outputDirectory;
+    this._flags = modeFlags(mode, profileDirectory);
+  }
+
+  moduleOutputFile(name) {
+    return name + '.hpp';
+  }
+
+  linkOutputFile(name) {
+    return name;
+  }
+
+  compileModule({ filename, output }) {
+    let source = FS.readFileSync(filename, 'utf8');
+    let header = `#line 1 "${ filename.replace(/\\/g, '/') }"\n` + translateModule(source);
+    FS.writeFileSync(Path.resolve(this._out, output), header, 'utf8');
+  }
+
+  // Modules are listed with the main module first
+  link({ outputs, output }) {
+    let unit = Path.basename(output) + '.unity.cpp';
+    let includes = [
+      ...stdCoreHeaders.map(name => `<${ name }>`),
+      ...outputs.slice().reverse().map(name => `"${ name }"`),
+    ];
+    FS.writeFileSync(
+      Path.resolve(this._out, unit),
+      includes.map(name => `#include ${ name }\n`).join(''),
+      'utf8');
+
+    this._run(this._command, [
+      '-std=c++20',
+      '-Wall',
+      '-Wextra',
+      '-Wno-parentheses',
+      ...this._flags,
+      unit,
+      '-o',
+      output,
+    ]);
+  }
+
+  // GCC reads the profile files written by the training run directly
+  mergeProfile(profileDirectory) {}
+
+  _run(cmd, args) {
+    let result = spawnSync(cmd, args, {
+      stdio: 'pipe',
+      cwd: this._out,
+      encoding: 'utf8',
+    });
+
+    if (result.error) {
+      throw result.error;
+    }
+
+    if (result.status !== 0) {
+      console.log(`${ cmd } ${ args.join(' ') }`);
+      console.log('');
+      console.log(result.stdout);
+      console.log(result.stderr);
+      process.exit(result.status);
+    }
+
+    // Warnings are shown even when the build succeeds
+    if (result.stderr) {
+      console.log(result.stderr);
+    }
+  }
+
+}
+
+// Clang writes raw profiles which must be merged with llvm-profdata before
+// they can be used
+export class ClangCompiler extends GccCompiler {
+
+  constructor(command = process.env.CXX || 'clang++') {
+    super(command);
+  }
+
+  mergeProfile(profileDirectory) {
+    let raw = FS.readdirSync(profileDirectory)
+      .filter(name => name.endsWith('.profraw'))
+      .map(name => Path.resolve(profileDirectory, name));
+
+    this._run(process.env.LLVM_PROFDATA || 'llvm-profdata', [
+      'merge',
+      '-o',
+      Path.resolve(profileDirectory, 'default.profdata'),
+      ...raw,
+    ]);
+  }
+
+}
@@ -82,11 +82,22 @@ function getEnvVars(outDir, hostArch, target) {
   return vars;
 }
 
+// Compiler and linker flags for each build mode. PGO builds are not supported.
+function modeFlags(mode) {
+  switch (mode) {
+    case 'debug': return { compile: [], link: [] };
+    case 'release': return { compile: ['/O2', '/DNDEBUG'], link: [] };
+    case 'lto': return { compile: ['/O2', '/DNDEBUG', '/GL'], link: ['/LTCG'] };
+    default: throw new Error(`Unsupported build mode "${ mode }"`);
+  }
+}
+
 export class MsvsCompiler {
 
-  initialize({ outputDirectory, host, target }) {
+  initialize({ outputDirectory, host, target, mode = 'debug' }) {
     this._out = outputDirectory;
     this._env = getEnvVars(outputDirectory, host, target);
+    this._flags = modeFlags(mode);
   }
 
   moduleOutputFile(name) {
@@ -111,7 +122,7 @@ export class MsvsCompiler {
   }
 
   link({ outputs }) {
-    this._run('link', ['/nologo', ...outputs]);
+    this._run('link', ['/nologo', ...this._flags.link, ...outputs]);
   }
 
   _cl(...args) {
@@ -121,6 +132,7 @@ export class MsvsCompiler {
       '/EHsc',
       '/nologo',
       '/experimental:module',
+      ...this._flags.compile,
       ...args
     ]);
   }
@@ -0,0 +1,40 @@
+const FS = require('fs');
+const Path = require('path');
+
+const OUT_PATH = Path.resolve(__dirname, '../test/AstStrings.cpp');
+const IN_PATH = Path.resolve(__dirname, '../src/Ast.cpp');
+
+let astFile = FS.readFileSync(IN_PATH, 'utf8');
+
+function matchAll(text, re) {
+  let out = [];
+  re.lastIndex = 0;
+  for (let m; m = re.exec(text);) {
+    out.push(m);
+  }
+  return out;
+}
+
+let enumBody = astFile.match(/enum class NodeKind[^{]*\{([^}]*)\}/)[1];
+let identifiers = matchAll(enumBody, /\n[ \t]+(\w+),/g).map(m => m[1]);
+
+const genDate = new Date().toISOString().replace(/T.*/, '');
+
+let code = `\
+// Generated by tools/generate-ast-strings.js ${ genDate }
+export module test.AstStrings;
+
+import Ast;
+
+export template<typename T>
+T& operator<<(T& out, NodeKind k) {
+  switch (k) {
+${ identifiers.map(id => {
+  return `    case NodeKind::${ id }: return out << "${ id }";`;
+}).join('\n') }
+    default: return out << "?";
+  }
+}
+`;
+
+FS.writeFileSync(OUT_PATH, code, 'utf8');
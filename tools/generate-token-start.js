@@ -42,6 +42,10 @@ export enum class TokenStartType {
 ${ table.typeNames.map(name => `  ${ name },`).join('\n') }
 };
 
+export constexpr const char* token_start_type_names[] {
+${ table.typeNames.map(name => `  "${ name }",`).join('\n') }
+};
+
 export constexpr TokenStartType token_start_table[] {
 ${ table.map(type => `  TokenStartType::${ type },`).join('\n') }
 };
@@ -2,6 +2,7 @@ const FS = require('fs');
 const Path = require('path');
 
 const OUT_PATH = Path.resolve(__dirname, '../test/TokenStrings.cpp');
+const NAMES_PATH = Path.resolve(__dirname, '../src/TokenNames.cpp');
 const IN_PATH = Path.resolve(__dirname, '../src/Token.cpp');
 
 let typesFile = FS.readFileSync(IN_PATH, 'utf8');
@@ -39,3 +40,21 @@ ${ identifiers.map(id => {
 `;
 
 FS.writeFileSync(OUT_PATH, code, 'utf8');
+
+let names = `\
+// Generated by tools/generate-token-strings.js ${ genDate }
+export module TokenNames;
+
+import Token;
+
+export const char* token_name(Token t) {
+  switch (t) {
+${ identifiers.map(id => {
+  return `    case Token::${ id }: return "${ id }";`;
+}).join('\n') }
+    default: return "?";
+  }
+}
+`;
+
+FS.writeFileSync(NAMES_PATH, names, 'utf8');
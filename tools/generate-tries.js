@@ -77,10 +77,20 @@ function trieToCode(t, depth = 0) {
   return out;
 }
 
+// Enum entries which mark the ends of keyword ranges rather than keywords
+const rangeMarkers = new Set([
+  'begin',
+  'end',
+  'strict_begin',
+  'strict_end',
+  'contextual_begin',
+  'contextual_end',
+]);
+
 function generateTokens() {
   let tok = matchAll(typesFile, /[ \t]+kw_(\w+)/g)
     .map(m => m[1])
-    .filter(k => !k.endsWith('_begin') && !k.endsWith('_end'))
+    .filter(k => !rangeMarkers.has(k))
     .map(k => [k, 'kw_' + k]);
 
   return trieToCode(makeTrie(tok));